@@ -0,0 +1,274 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * Tests for the file descriptor readers/writers in upb/bindings/stdc.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "upb/bindings/stdc/fdreader.h"
+#include "upb/bindings/stdc/fdwriter.h"
+#include "upb/sink.h"
+#include "upb_test.h"
+
+#define DATA_LEN 100000
+#define MAX_PINS 64
+
+static char data[DATA_LEN];
+
+// Returns the fd of a new, empty, unlinked temporary file.
+static int emptyfd() {
+  FILE *f = tmpfile();
+  ASSERT(f);
+  int fd = dup(fileno(f));
+  fclose(f);
+  return fd;
+}
+
+// Like emptyfd(), but the file contains "data" and the fd is positioned at
+// the beginning.
+static int tmpfd() {
+  int fd = emptyfd();
+  ASSERT(write(fd, data, DATA_LEN) == DATA_LEN);
+  ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+  return fd;
+}
+
+// Checks that the file behind "fd" contains exactly "data".
+static void checkcontents(int fd) {
+  static char buf[DATA_LEN + 1];
+  ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+  size_t len = 0;
+  ssize_t n;
+  while ((n = read(fd, buf + len, sizeof(buf) - len)) > 0) {
+    len += n;
+  }
+  ASSERT(n == 0);
+  ASSERT(len == DATA_LEN);
+  ASSERT(memcmp(buf, data, DATA_LEN) == 0);
+}
+
+/* FdReader *******************************************************************/
+
+typedef struct {
+  size_t ofs;
+  int bufs;
+  bool started, ended;
+
+  // Every other buffer is pinned and checked again after the run completes,
+  // to make sure that pinned buffers are not recycled underneath us.
+  const upb_fdreader_buf *pins[MAX_PINS];
+  const char *pinned_data[MAX_PINS];
+  size_t pinned_ofs[MAX_PINS];
+  size_t pinned_len[MAX_PINS];
+  int npins;
+} readstate;
+
+static void *startstr(void *c, const void *hd, size_t size_hint) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(size_hint);
+  readstate *st = c;
+  st->started = true;
+  return st;
+}
+
+static size_t putbuf(void *c, const void *hd, const char *buf, size_t n,
+                     const upb_bufhandle *h) {
+  UPB_UNUSED(hd);
+  readstate *st = c;
+  ASSERT(st->ofs + n <= DATA_LEN);
+  ASSERT(memcmp(buf, data + st->ofs, n) == 0);
+
+  if ((st->bufs++ & 1) == 0 && st->npins < MAX_PINS) {
+    const upb_fdreader_buf *pin = upb_fdreader_pin(h);
+    ASSERT(pin);
+    st->pins[st->npins] = pin;
+    st->pinned_data[st->npins] = buf;
+    st->pinned_ofs[st->npins] = st->ofs;
+    st->pinned_len[st->npins] = n;
+    st->npins++;
+  }
+
+  st->ofs += n;
+  return n;
+}
+
+static bool endstr(void *c, const void *hd) {
+  UPB_UNUSED(hd);
+  readstate *st = c;
+  st->ended = true;
+  return true;
+}
+
+static void test_fdreader() {
+  upb_byteshandler handler;
+  upb_byteshandler_init(&handler);
+  upb_byteshandler_setstartstr(&handler, &startstr, NULL);
+  upb_byteshandler_setstring(&handler, &putbuf, NULL);
+  upb_byteshandler_setendstr(&handler, &endstr, NULL);
+
+  readstate st;
+  memset(&st, 0, sizeof(st));
+  upb_bytessink sink;
+  upb_bytessink_reset(&sink, &handler, &st);
+
+  int fd = tmpfd();
+  upb_fdreader r;
+  upb_fdreader_init(&r, fd);
+  // Small buffers so that the ring wraps many times.
+  upb_fdreader_setbuffers(&r, 1000, 3);
+
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_fdreader_run(&r, &sink, &status), &status);
+  ASSERT(st.started);
+  ASSERT(st.ended);
+  ASSERT(st.ofs == DATA_LEN);
+  ASSERT(upb_fdreader_bytesread(&r) == DATA_LEN);
+  ASSERT(st.npins > 0);
+
+  upb_fdreader_uninit(&r);
+  close(fd);
+
+  // The pinned buffers must have survived both recycling and the reader.
+  int i;
+  for (i = 0; i < st.npins; i++) {
+    ASSERT(memcmp(st.pinned_data[i], data + st.pinned_ofs[i],
+                  st.pinned_len[i]) == 0);
+    upb_fdreader_unpin(st.pins[i]);
+  }
+
+  // A handle that didn't come from an FdReader can't be pinned.
+  upb_bufhandle h;
+  upb_bufhandle_init(&h);
+  ASSERT(upb_fdreader_pin(&h) == NULL);
+
+  upb_byteshandler_uninit(&handler);
+}
+
+static size_t shortbuf(void *c, const void *hd, const char *buf, size_t n,
+                       const upb_bufhandle *h) {
+  UPB_UNUSED(c);
+  UPB_UNUSED(hd);
+  UPB_UNUSED(buf);
+  UPB_UNUSED(h);
+  return n / 2;
+}
+
+static void test_fdreader_errors() {
+  upb_byteshandler handler;
+  upb_byteshandler_init(&handler);
+  upb_bytessink sink;
+  upb_bytessink_reset(&sink, &handler, NULL);
+
+  // read(2) failure is reported through the status.
+  upb_fdreader r;
+  upb_fdreader_init(&r, -1);
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT(!upb_fdreader_run(&r, &sink, &status));
+  ASSERT(!upb_ok(&status));
+  ASSERT(upb_status_errcode(&status) == EBADF);
+  upb_fdreader_uninit(&r);
+
+  // So is a sink that doesn't consume the whole buffer.
+  upb_byteshandler_setstring(&handler, &shortbuf, NULL);
+  int fd = tmpfd();
+  upb_fdreader_init(&r, fd);
+  upb_status_clear(&status);
+  ASSERT(!upb_fdreader_run(&r, &sink, &status));
+  ASSERT(!upb_ok(&status));
+  upb_fdreader_uninit(&r);
+  close(fd);
+
+  upb_byteshandler_uninit(&handler);
+}
+
+/* FdWriter *******************************************************************/
+
+static void test_fdwriter() {
+  int fd = emptyfd();
+  upb_status status = UPB_STATUS_INIT;
+  upb_fdwriter w;
+  upb_fdwriter_init(&w, fd, &status);
+  upb_fdwriter_setbuffers(&w, 4096, 4, 2048);
+
+  // Lots of small writes with a few large ones mixed in, like an encoder or
+  // printer would produce.
+  upb_bytessink *sink = upb_fdwriter_input(&w);
+  void *subc;
+  ASSERT(upb_bytessink_start(sink, 0, &subc));
+  size_t ofs = 0;
+  size_t n = 1;
+  size_t small = 0, large = 0;
+  while (ofs < DATA_LEN) {
+    size_t len = UPB_MIN(n, DATA_LEN - ofs);
+    ASSERT(upb_bytessink_putbuf(sink, subc, data + ofs, len, NULL) == len);
+    if (len >= 2048) large++; else small++;
+    ofs += len;
+    n = (n % 50 == 0) ? 3000 : (n % 97) + 1;
+  }
+  ASSERT(upb_bytessink_end(sink));
+  ASSERT_STATUS(upb_ok(&status), &status);
+
+  const upb_fdwriter_stats *stats = upb_fdwriter_getstats(&w);
+  ASSERT(stats->bytes == DATA_LEN);
+  ASSERT(stats->copies == small);
+  ASSERT(stats->passthrough == large);
+  // Each syscall writes out either a pass-through buffer or all four of our
+  // buffers, with perhaps one more for the final flush.
+  ASSERT(stats->syscalls <= large + DATA_LEN / (4 * 4096) + 1);
+
+  upb_fdwriter_uninit(&w);
+  checkcontents(fd);
+  close(fd);
+}
+
+static void test_fdwriter_errors() {
+  upb_status status = UPB_STATUS_INIT;
+  upb_fdwriter w;
+  upb_fdwriter_init(&w, -1, &status);
+  ASSERT(!upb_bufsrc_putbuf(data, 10, upb_fdwriter_input(&w)));
+  ASSERT(upb_status_errcode(&status) == EBADF);
+  upb_fdwriter_uninit(&w);
+}
+
+// Copies a file from one fd to another through an FdReader and FdWriter.
+static void test_copy() {
+  int in = tmpfd();
+  int out = emptyfd();
+  upb_status status = UPB_STATUS_INIT;
+
+  upb_fdwriter w;
+  upb_fdwriter_init(&w, out, &status);
+  upb_fdreader r;
+  upb_fdreader_init(&r, in);
+  upb_fdreader_setbuffers(&r, 3000, 2);
+  ASSERT_STATUS(upb_fdreader_run(&r, upb_fdwriter_input(&w), &status),
+                &status);
+  upb_fdreader_uninit(&r);
+  upb_fdwriter_uninit(&w);
+
+  checkcontents(out);
+  close(in);
+  close(out);
+}
+
+int run_tests(int argc, char *argv[]) {
+  UPB_UNUSED(argc);
+  UPB_UNUSED(argv);
+  size_t i;
+  for (i = 0; i < DATA_LEN; i++) {
+    data[i] = (char)(i * 7 + i / 251);
+  }
+  test_fdreader();
+  test_fdreader_errors();
+  test_fdwriter();
+  test_fdwriter_errors();
+  test_copy();
+  return 0;
+}
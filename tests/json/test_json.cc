@@ -10,10 +10,33 @@
 #include "upb/handlers.h"
 #include "upb/symtab.h"
 #include "upb/json/printer.h"
+#include "upb/json/base64.int.h"
+#include "upb/json/names.int.h"
+#include "upb/json/number.int.h"
 #include "upb/json/parser.h"
+#include "upb/json/transcoder.h"
+#include "upb/pb/decoder.h"
+#include "upb/pb/encoder.h"
+#include "upb/pb/glue.h"
+#include "upb/pb/textprinter.h"
 #include "upb/upb.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <algorithm>
 #include <string>
+#include <vector>
+
+bool benchmark = false;
+#define CPU_TIME_PER_TEST 0.5
+
+double get_usertime() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + (usage.ru_utime.tv_usec/1000000.0);
+}
 
 // Macros for readability in test case list: allows us to give TEST("...") /
 // EXPECT("...") pairs.
@@ -82,6 +105,30 @@ static TestCase kTestRoundtripMessages[] = {
     TEST("{\"optional_string\":\"\\uFFFF\"}"),
     EXPECT("{\"optional_string\":\"\xEF\xBF\xBF\"}")
   },
+  // Long strings, with escapes at different offsets within a 16 or 32-byte
+  // block.
+  {
+    TEST("{\"optional_string\":\"0123456789abcdefghijklmnopqrstuvwxyzABCD\\n"
+         "0123456789abcdefg\\\"0123456789abcdefghijklmnopqrstuvw\\u001f\\\\"
+         "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMN\","
+         "\"repeated_string\":[\"\\t0123456789abcdefghijklmnopqrstuvwxyzAB"
+         "CDEF\",\"0123456789abcdefghijklmnopqrstu\\u0001\"]}"),
+    EXPECT_SAME
+  },
+  // Member names can be in lowerCamelCase, and like enum names and base64 they
+  // can contain escapes.
+  {
+    TEST("{\"optionalInt32\":-42,\"optionalMsg\":{\"foo\":1},"
+         "\"repeatedString\":[\"a\",\"b\"]}"),
+    EXPECT("{\"optional_int32\":-42,\"optional_msg\":{\"foo\":1},"
+           "\"repeated_string\":[\"a\",\"b\"]}")
+  },
+  {
+    TEST("{\"optional\\u005fint32\":1,\"\\u006fptional_enum\":\"\\u0042\","
+         "\"optional_bytes\":\"YW\\/i\"}"),
+    EXPECT("{\"optional_int32\":1,\"optional_enum\":\"B\","
+           "\"optional_bytes\":\"YW/i\"}")
+  },
   TEST_SENTINEL
 };
 
@@ -180,7 +227,6 @@ class StringSink {
     UPB_UNUSED(hd);
     UPB_UNUSED(handle);
     std::string* s = static_cast<std::string*>(_closure);
-    std::string appended(data, len);
     s->append(data, len);
     return len;
   }
@@ -190,6 +236,44 @@ class StringSink {
   std::string s_;
 };
 
+// Like upb::BufferSource::PutBuffer(), but passes "json" to the sink in
+// pieces: the first "first" bytes, and then "piece" bytes at a time.  Each
+// piece gets a buffer of its own, so the parser can't look past it.
+static bool PutInPieces(const std::string& json, size_t first, size_t piece,
+                        upb::BytesSink* sink) {
+  void* subc;
+  if (!upb_bytessink_start(sink, json.size(), &subc)) return false;
+  for (size_t ofs = 0; ofs < json.size(); ) {
+    size_t n = std::min(ofs == 0 ? first : piece, json.size() - ofs);
+    std::string buf(json, ofs, n);
+    upb_bufhandle handle;
+    upb_bufhandle_init(&handle);
+    upb_bufhandle_setbuf(&handle, buf.data(), 0);
+    bool ok = upb_bytessink_putbuf(sink, subc, buf.data(), n, &handle) == n;
+    upb_bufhandle_uninit(&handle);
+    if (!ok) return false;
+    ofs += n;
+  }
+  return upb_bytessink_end(sink);
+}
+
+static std::string RoundtripInPieces(const upb::Handlers* serialize_handlers,
+                                     const std::string& json, size_t first,
+                                     size_t piece) {
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::json::Printer printer(serialize_handlers);
+  StringSink data_sink;
+  parser.ResetOutput(printer.input());
+  printer.ResetOutput(data_sink.Sink());
+  bool ok = PutInPieces(json, first, piece, parser.input());
+  if (!ok) {
+    fprintf(stderr, "upb parse error: %s\n", st.error_message());
+  }
+  ASSERT(ok);
+  return data_sink.Data();
+}
+
 // Starts with a message in JSON format, parses and directly serializes again,
 // and compares the result.
 void test_json_roundtrip() {
@@ -231,14 +315,1202 @@ void test_json_roundtrip() {
               json_src, data_sink.Data().c_str());
       abort();
     }
+
+    // Strings, member names, numbers and escapes that span input buffers.
+    std::string json(json_src);
+    for (size_t first = 1; first < json.size(); first++) {
+      ASSERT(RoundtripInPieces(serialize_handlers.get(), json, first,
+                               json.size()) == json_expected);
+    }
+    ASSERT(RoundtripInPieces(serialize_handlers.get(), json, 1, 1) ==
+           json_expected);
+  }
+}
+
+// Like test_json_roundtrip(), but goes through the protobuf binary format and
+// the Transcoder, which must produce exactly what the Encoder and Printer do.
+void test_json_transcode() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> encode_handlers(
+      upb::pb::Encoder::NewHandlers(md));
+  upb::json::TranscoderCache cache;
+  upb::Status status;
+  const upb::json::TranscoderMethod* method =
+      cache.GetTranscoderMethod(md, &status);
+  ASSERT_STATUS(method, &status);
+  ASSERT(cache.GetTranscoderMethod(md, &status) == method);
+  upb::json::Transcoder transcoder;
+
+  for (const TestCase* test_case = kTestRoundtripMessages;
+       test_case->input != NULL; test_case++) {
+    const char *json_src = test_case->input;
+    const char *json_expected = test_case->expected;
+    if (json_expected == EXPECT_SAME) {
+      json_expected = json_src;
+    }
+
+    upb::Status st;
+    upb::json::Parser parser(&st);
+    upb::pb::Encoder encoder(encode_handlers.get());
+    StringSink pb_sink;
+    parser.ResetOutput(encoder.input());
+    encoder.ResetOutput(pb_sink.Sink());
+    ASSERT(upb::BufferSource::PutBuffer(json_src, strlen(json_src),
+                                        parser.input()));
+    const std::string& pb = pb_sink.Data();
+
+    StringSink direct_pb_sink;
+    ASSERT_STATUS(transcoder.JsonToProtobuf(method, json_src, strlen(json_src),
+                                            direct_pb_sink.Sink(), &st), &st);
+    ASSERT(direct_pb_sink.Data() == pb);
+
+    StringSink json_sink;
+    bool ok = transcoder.ProtobufToJson(method, pb.data(), pb.size(),
+                                        json_sink.Sink(), &st);
+    if (!ok) {
+      fprintf(stderr, "transcode error: %s\n", st.error_message());
+    }
+    ASSERT(ok);
+
+    if (json_sink.Data() != json_expected) {
+      fprintf(stderr,
+              "JSON transcode result differs:\n"
+              "Original:\n%s\nTranscoded:\n%s\n",
+              json_src, json_sink.Data().c_str());
+      abort();
+    }
+  }
+
+  // Truncated input is an error, not a crash.
+  StringSink json_sink;
+  upb::Status st;
+  const char truncated[] = "\x0a\x05" "ab";  // optional_string, 5 bytes.
+  ASSERT(!transcoder.ProtobufToJson(method, truncated, 4, json_sink.Sink(),
+                                    &st));
+  ASSERT(!st.ok());
+
+  // Nested submessages whose lengths take more than one byte, with an
+  // escaped string, a packed-size array and null members mixed in.
+  std::string big(200, 'x');
+  std::string json =
+      "{\"optional_msg\":{\"foo\":1},\"repeated_msg\":[{\"foo\":2},null],"
+      "\"optional_string\":\"" + big + "\\n\",\"optional_int64\":null,"
+      "\"repeated_int32\":[1,-2,3],\"optional_bytes\":\"YWJj\"}";
+  StringSink pb_sink;
+  st.Clear();
+  ASSERT_STATUS(transcoder.JsonToProtobuf(method, json.data(), json.size(),
+                                          pb_sink.Sink(), &st), &st);
+  StringSink roundtrip_sink;
+  ASSERT_STATUS(transcoder.ProtobufToJson(method, pb_sink.Data().data(),
+                                          pb_sink.Data().size(),
+                                          roundtrip_sink.Sink(), &st), &st);
+  ASSERT(roundtrip_sink.Data() ==
+         "{\"optional_msg\":{\"foo\":1},\"repeated_msg\":[{\"foo\":2}],"
+         "\"optional_string\":\"" + big + "\\n\","
+         "\"repeated_int32\":[1,-2,3],\"optional_bytes\":\"YWJj\"}");
+
+  // Bad JSON, unknown fields and mismatched types are errors.
+  const char* bad[] = {
+    "{\"optional_int32\":1",
+    "{\"optional_int32\":1}x",
+    "{\"no_such_field\":1}",
+    "{\"optional_int32\":\"1\"}",
+    "{\"optional_int32\":1.5}",
+    "{\"optional_int32\":3000000000}",
+    "{\"optional_uint32\":-1}",
+    "{\"optional_bool\":1}",
+    "{\"optional_int32\":[1]}",
+    "{\"optional_msg\":1}",
+    "{\"optional_bytes\":\"YWJ\"}",
+    "{\"optional_enum\":\"Z\"}",
+    "{\"optional_string\":\"\\q\"}",
+  };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    st.Clear();
+    ASSERT(!transcoder.JsonToProtobuf(method, bad[i], strlen(bad[i]),
+                                      pb_sink.Sink(), &st));
+    ASSERT(!st.ok());
+  }
+}
+
+static std::string FormatDouble(double val) {
+  char buf[UPB_JSON_MAX_NUMBER_LEN];
+  return std::string(buf, upb_json_fmtdouble(val, buf));
+}
+
+static std::string FormatFloat(float val) {
+  char buf[UPB_JSON_MAX_NUMBER_LEN];
+  return std::string(buf, upb_json_fmtfloat(val, buf));
+}
+
+static std::string FormatInt(int64_t val) {
+  char buf[UPB_JSON_MAX_NUMBER_LEN];
+  return std::string(buf, upb_json_fmtint64(val, buf));
+}
+
+static bool ParseInt(const std::string& str, int64_t* val) {
+  return upb_json_parseint64(str.data(), str.size(), val);
+}
+
+static bool ParseUInt(const std::string& str, uint64_t* val) {
+  return upb_json_parseuint64(str.data(), str.size(), val);
+}
+
+static double ParseDouble(const std::string& str) {
+  double val;
+  ASSERT(upb_json_parsedouble(str.data(), str.size(), &val));
+  return val;
+}
+
+static float ParseFloat(const std::string& str) {
+  float val;
+  ASSERT(upb_json_parsefloat(str.data(), str.size(), &val));
+  return val;
+}
+
+static bool SameBits(double a, double b) {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool SameBits(float a, float b) {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+void test_json_numbers() {
+  ASSERT(FormatInt(0) == "0");
+  ASSERT(FormatInt(-7) == "-7");
+  ASSERT(FormatInt(INT64_MIN) == "-9223372036854775808");
+  char buf[UPB_JSON_MAX_NUMBER_LEN];
+  ASSERT(std::string(buf, upb_json_fmtuint64(UINT64_MAX, buf)) ==
+         "18446744073709551615");
+
+  ASSERT(FormatDouble(0.0) == "0");
+  ASSERT(FormatDouble(-0.0) == "-0");
+  ASSERT(FormatDouble(0.1) == "0.1");
+  ASSERT(FormatDouble(1.0 / 3) == "0.3333333333333333");
+  ASSERT(FormatDouble(-42.5) == "-42.5");
+  ASSERT(FormatDouble(1e20) == "100000000000000000000");
+  ASSERT(FormatDouble(1e21) == "1e+21");
+  ASSERT(FormatDouble(0.000001) == "0.000001");
+  ASSERT(FormatDouble(1.5e-7) == "1.5e-7");
+  ASSERT(FormatDouble(5e-324) == "5e-324");
+  ASSERT(FormatDouble(1.7976931348623157e308) == "1.7976931348623157e+308");
+  ASSERT(FormatDouble(INFINITY) == "inf");
+  ASSERT(FormatDouble(-INFINITY) == "-inf");
+  ASSERT(FormatFloat(0.1f) == "0.1");
+  ASSERT(FormatFloat(1.0f / 3) == "0.33333334");
+  ASSERT(FormatFloat(1e-45f) == "1e-45");
+
+  int64_t i64;
+  uint64_t u64;
+  ASSERT(ParseInt("-9223372036854775808", &i64) && i64 == INT64_MIN);
+  ASSERT(ParseInt("9223372036854775807", &i64) && i64 == INT64_MAX);
+  ASSERT(!ParseInt("9223372036854775808", &i64));
+  ASSERT(!ParseInt("-9223372036854775809", &i64));
+  ASSERT(ParseInt("-0", &i64) && i64 == 0);
+  ASSERT(!ParseInt("1.0", &i64));
+  ASSERT(!ParseInt("1e3", &i64));
+  ASSERT(ParseUInt("18446744073709551615", &u64) && u64 == UINT64_MAX);
+  ASSERT(!ParseUInt("18446744073709551616", &u64));
+  ASSERT(!ParseUInt("99999999999999999999", &u64));
+  ASSERT(!ParseUInt("100000000000000000000", &u64));
+  ASSERT(!ParseUInt("-1", &u64));
+
+  ASSERT(SameBits(ParseDouble("0"), 0.0));
+  ASSERT(SameBits(ParseDouble("-0.0e5"), -0.0));
+  ASSERT(ParseDouble("0.1") == 0.1);
+  ASSERT(ParseDouble("-42.5") == -42.5);
+  ASSERT(ParseDouble("0.000001") == 0.000001);
+  ASSERT(ParseDouble("1.7976931348623157e308") == 1.7976931348623157e308);
+  ASSERT(ParseDouble("2.2250738585072014e-308") == 2.2250738585072014e-308);
+  ASSERT(ParseDouble("5e-324") == 5e-324);
+  ASSERT(ParseDouble("1e-400") == 0);
+  ASSERT(ParseDouble("9007199254740993") == 9007199254740992.0);
+  ASSERT(ParseDouble("0.30000000000000000000000000000001") == 0.3);
+  ASSERT(ParseFloat("0.1") == 0.1f);
+  ASSERT(ParseFloat("3.4028235e38") == 3.4028235e38f);
+  ASSERT(ParseFloat("1e-45") == 1e-45f);
+  double d;
+  float f;
+  ASSERT(!upb_json_parsedouble("1e309", 5, &d));
+  ASSERT(!upb_json_parsedouble("-1e99999999999", 14, &d));
+  ASSERT(!upb_json_parsefloat("3.5e38", 6, &f));
+
+  // Whatever we print must read back as the same value, both with strtod()
+  // and with our own parser.
+  srand(1);
+  for (int i = 0; i < 100000; i++) {
+    uint64_t bits =
+        ((uint64_t)rand() << 33) ^ ((uint64_t)rand() << 11) ^ rand();
+    memcpy(&d, &bits, sizeof(d));
+    if (isfinite(d)) {
+      std::string str = FormatDouble(d);
+      ASSERT(SameBits(strtod(str.c_str(), NULL), d));
+      ASSERT(SameBits(ParseDouble(str), d));
+    }
+    uint32_t fbits = bits;
+    memcpy(&f, &fbits, sizeof(f));
+    if (isfinite(f)) {
+      std::string str = FormatFloat(f);
+      ASSERT(SameBits(strtof(str.c_str(), NULL), f));
+      ASSERT(SameBits(ParseFloat(str), f));
+    }
+  }
+
+  // Arbitrary decimal strings must parse exactly like strtod() does.
+  for (int i = 0; i < 100000; i++) {
+    std::string str = (rand() & 1) ? "-" : "";
+    int digits = 1 + rand() % 25;
+    int point = rand() % (digits + 1);
+    for (int j = 0; j < digits; j++) {
+      if (j == point && j > 0) str += '.';
+      str += (char)((j == 0 && digits > 1) ? '1' + rand() % 9
+                                           : '0' + rand() % 10);
+    }
+    if (rand() & 1) {
+      char exp[16];
+      sprintf(exp, "e%d", rand() % 700 - 350);
+      str += exp;
+    }
+    double expected_d = strtod(str.c_str(), NULL);
+    if (isfinite(expected_d)) {
+      ASSERT(SameBits(ParseDouble(str), expected_d));
+    }
+    float expected_f = strtof(str.c_str(), NULL);
+    if (isfinite(expected_f)) {
+      ASSERT(SameBits(ParseFloat(str), expected_f));
+    }
+  }
+}
+
+static bool Parses(const upb::Handlers* serialize_handlers, const char* json) {
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::json::Printer printer(serialize_handlers);
+  StringSink data_sink;
+  parser.ResetOutput(printer.input());
+  printer.ResetOutput(data_sink.Sink());
+  bool ok = upb::BufferSource::PutBuffer(json, strlen(json), parser.input());
+  ASSERT(ok == st.ok());
+  return ok;
+}
+
+// The Parser reports numbers that don't fit their field as errors.
+void test_json_bad_numbers() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> serialize_handlers(
+      upb::json::Printer::NewHandlers(md));
+
+  const char* bad[] = {
+    "{\"optional_int32\":3000000000}",
+    "{\"optional_int32\":-2147483649}",
+    "{\"optional_int32\":1.5}",
+    "{\"optional_int64\":9223372036854775808}",
+    "{\"optional_uint32\":4294967296}",
+    "{\"optional_uint32\":-1}",
+    "{\"optional_uint64\":1e3}",
+    "{\"repeated_int32\":[1,2,30000000000]}",
+  };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    ASSERT(!Parses(serialize_handlers.get(), bad[i]));
+  }
+}
+
+void test_json_bad_keys() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> serialize_handlers(
+      upb::json::Printer::NewHandlers(md));
+
+  const char* bad[] = {
+    "{\"\":1}",
+    "{\"optional\":1}",
+    "{\"optional_int32x\":1}",
+    "{\"optionalint32\":1}",
+    "{\"OptionalInt32\":1}",
+    "{\"optional_msg\":{\"bar\":1}}",
+    "{\"optional_msg\":{\"optional_int32\":1}}",
+  };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    ASSERT(!Parses(serialize_handlers.get(), bad[i]));
+  }
+}
+
+// Parses "json" with unknown members ignored, passing it in pieces as
+// PutInPieces() does, and returns what the Printer makes of it.
+static std::string IgnoreUnknownInPieces(
+    const upb::Handlers* serialize_handlers, const std::string& json,
+    size_t first, size_t piece, bool* ok) {
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::json::Printer printer(serialize_handlers);
+  StringSink data_sink;
+  parser.ResetOutput(printer.input());
+  printer.ResetOutput(data_sink.Sink());
+  parser.SetIgnoreUnknown(true);
+  *ok = PutInPieces(json, first, piece, parser.input());
+  ASSERT(*ok == st.ok());
+  return data_sink.Data();
+}
+
+void test_json_ignore_unknown() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> serialize_handlers(
+      upb::json::Printer::NewHandlers(md));
+
+  // Unknown members of every kind, with brackets and quotes in their strings,
+  // at the start, middle and end of objects.
+  const std::string json =
+      "{\"x\":1,\"optional_int32\":1, \"y\" : -2.5e3 ,"
+      "\"optional_msg\":{\"z\":{\"a\":[1,{\"b\":\"}]\\\"[\"}],\"c\":null},"
+      "\"foo\":7,\"w\":[]},"
+      "\"optional_string\":\"s\",\"v\":\"\\\\\",\"u\":\"\\u005d\","
+      "\"t\":true,\"repeated_int32\":[1,2],\"f\":false,\"n\":null,"
+      "\"e\":{},\"a\":[[],[[]],{\"]\":\"{\"}]}";
+  const std::string expected =
+      "{\"optional_int32\":1,\"optional_msg\":{\"foo\":7},"
+      "\"optional_string\":\"s\",\"repeated_int32\":[1,2]}";
+
+  // Skipped values that span input buffers, in every possible way.
+  bool ok;
+  for (size_t first = 1; first <= json.size(); first++) {
+    ASSERT(IgnoreUnknownInPieces(serialize_handlers.get(), json, first,
+                                 json.size(), &ok) == expected);
+    ASSERT(ok);
+  }
+  ASSERT(IgnoreUnknownInPieces(serialize_handlers.get(), json, 1, 1, &ok) ==
+         expected);
+  ASSERT(ok);
+
+  // Nothing at all is sent for a skipped value.
+  ASSERT(IgnoreUnknownInPieces(serialize_handlers.get(),
+                               "{\"x\":{\"optional_int32\":1}}", 1, 1,
+                               &ok) == "{}");
+  ASSERT(ok);
+
+  const char* bad[] = {
+    "{\"x\":,\"optional_int32\":1}",
+    "{\"x\":}",
+    "{\"x\":]}",
+    "{\"x\":abc}",
+    "{\"x\"}",
+  };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    std::string str(bad[i]);
+    IgnoreUnknownInPieces(serialize_handlers.get(), str, str.size(),
+                          str.size(), &ok);
+    ASSERT(!ok);
+  }
+}
+
+struct RecordCounter {
+  int records;
+  int limit;  // Stop after this many.
+};
+
+static bool CountRecord(void* closure) {
+  RecordCounter* c = static_cast<RecordCounter*>(closure);
+  return ++c->records < c->limit;
+}
+
+// Parses "json" in streaming mode, passing it in pieces as PutInPieces()
+// does, and returns what the Printer makes of it.
+static std::string StreamInPieces(const upb::Handlers* serialize_handlers,
+                                  const std::string& json, size_t first,
+                                  size_t piece, RecordCounter* counter,
+                                  bool* ok) {
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::json::Printer printer(serialize_handlers);
+  StringSink data_sink;
+  parser.ResetOutput(printer.input());
+  printer.ResetOutput(data_sink.Sink());
+  parser.SetStreaming(true);
+  parser.SetRecordHandler(&CountRecord, counter);
+  *ok = PutInPieces(json, first, piece, parser.input());
+  ASSERT(*ok == st.ok());
+  return data_sink.Data();
+}
+
+// In streaming mode the Parser takes any number of objects, eg. one per line.
+void test_json_streaming() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> serialize_handlers(
+      upb::json::Printer::NewHandlers(md));
+
+  const std::string json =
+      "{\"optional_int32\":1,\"optional_string\":\"a\\nb\"}\n"
+      "{}\n"
+      "  {\"optional_msg\":{\"foo\":-5},\"repeated_int32\":[1,2]}\r\n"
+      "{\"optional_bytes\":\"YWJj\"}{\"optional_bool\":true}\n";
+  const std::string expected =
+      "{\"optional_int32\":1,\"optional_string\":\"a\\nb\"}"
+      "{}"
+      "{\"optional_msg\":{\"foo\":-5},\"repeated_int32\":[1,2]}"
+      "{\"optional_bytes\":\"YWJj\"}{\"optional_bool\":true}";
+
+  // Records that span input buffers, in every possible way.
+  bool ok;
+  for (size_t first = 1; first <= json.size(); first++) {
+    RecordCounter counter = {0, 100};
+    ASSERT(StreamInPieces(serialize_handlers.get(), json, first, json.size(),
+                          &counter, &ok) == expected);
+    ASSERT(ok);
+    ASSERT(counter.records == 5);
+  }
+  RecordCounter counter = {0, 100};
+  ASSERT(StreamInPieces(serialize_handlers.get(), json, 1, 1, &counter, &ok) ==
+         expected);
+  ASSERT(ok);
+  ASSERT(counter.records == 5);
+
+  // The record handler can stop the parse.
+  counter.records = 0;
+  counter.limit = 2;
+  StreamInPieces(serialize_handlers.get(), json, json.size(), json.size(),
+                 &counter, &ok);
+  ASSERT(!ok);
+  ASSERT(counter.records == 2);
+
+  // Errors in later records are still errors.
+  counter.records = 0;
+  counter.limit = 100;
+  StreamInPieces(serialize_handlers.get(), "{}\n{\"bar\":1}", 3, 3, &counter,
+                 &ok);
+  ASSERT(!ok);
+  ASSERT(counter.records == 1);
+  counter.records = 0;
+  StreamInPieces(serialize_handlers.get(), "{}\n[]", 3, 3, &counter, &ok);
+  ASSERT(!ok);
+
+  // Without streaming mode, only one object is allowed.
+  ASSERT(Parses(serialize_handlers.get(), "{}\n"));
+  ASSERT(!Parses(serialize_handlers.get(), "{}\n{}"));
+}
+
+// Checks the name map on a message big enough that not every name can have
+// its home slot.
+// An allocator that counts the blocks it has handed out and not yet freed,
+// and gets them from the heap.
+struct CountingAllocator {
+  upb_alloc alloc;  // Must be first.
+  int live;
+  int calls;
+};
+
+static void* CountingAllocFunc(upb_alloc* alloc, void* ptr, size_t oldsize,
+                               size_t size) {
+  CountingAllocator* a = reinterpret_cast<CountingAllocator*>(alloc);
+  a->calls++;
+  if (!ptr && size) a->live++;
+  if (ptr && !size) a->live--;
+  return upb_realloc(&upb_alloc_global, ptr, oldsize, size);
+}
+
+// The parser, printers and transcoder take all of their per-request memory
+// from the allocator they are given.
+void test_json_allocator() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> serialize_handlers(
+      upb::json::Printer::NewHandlers(md));
+  upb::reffed_ptr<const upb::Handlers> text_handlers(
+      upb::pb::TextPrinter::NewHandlers(md));
+
+  // Escapes and one-byte pieces make the parser copy member names, strings
+  // and numbers into its own buffers.
+  const std::string json =
+      "{\"optional_string\":\"a\\nb\",\"optional_int32\":12345,"
+      "\"repeated_msg\":[{\"foo\":1}],\"optional_bytes\":\"YWJj\"}";
+  CountingAllocator counting = {{&CountingAllocFunc}, 0, 0};
+  upb::Allocator* alloc = &counting.alloc;
+  {
+    upb::Status st;
+    upb::json::Parser parser(&st);
+    upb::json::Printer printer(serialize_handlers.get());
+    parser.SetAllocator(alloc);
+    printer.SetAllocator(alloc);
+    StringSink data_sink;
+    parser.ResetOutput(printer.input());
+    printer.ResetOutput(data_sink.Sink());
+    ASSERT(PutInPieces(json, 1, 1, parser.input()));
+    ASSERT(data_sink.Data() == json);
+    ASSERT(counting.live > 0);
+  }
+  ASSERT(counting.live == 0);
+
+  int calls = counting.calls;
+  {
+    upb::Status st;
+    upb::json::Parser parser(&st);
+    upb::pb::TextPrinter printer(text_handlers.get());
+    printer.SetAllocator(alloc);
+    StringSink data_sink;
+    parser.ResetOutput(printer.input());
+    printer.ResetOutput(data_sink.Sink());
+    ASSERT(PutInPieces(json, 1, 1, parser.input()));
+    ASSERT(data_sink.Data().find("optional_int32: 12345") != std::string::npos);
+    ASSERT(counting.calls > calls);
+  }
+  ASSERT(counting.live == 0);
+
+  calls = counting.calls;
+  {
+    upb::json::TranscoderCache cache;
+    upb::Status st;
+    const upb::json::TranscoderMethod* method =
+        cache.GetTranscoderMethod(md, &st);
+    ASSERT_STATUS(method, &st);
+    upb::json::Transcoder transcoder;
+    transcoder.SetAllocator(alloc);
+    StringSink pb_sink;
+    ASSERT_STATUS(transcoder.JsonToProtobuf(method, json.data(), json.size(),
+                                            pb_sink.Sink(), &st), &st);
+    StringSink json_sink;
+    ASSERT_STATUS(transcoder.ProtobufToJson(method, pb_sink.Data().data(),
+                                            pb_sink.Data().size(),
+                                            json_sink.Sink(), &st), &st);
+    ASSERT(json_sink.Data() == json);
+    ASSERT(counting.calls > calls);
+  }
+  ASSERT(counting.live == 0);
+
+  // With an arena nothing needs to be freed one by one.
+  char seed[256];
+  upb::Arena arena(seed, sizeof(seed), NULL);
+  {
+    upb::Status st;
+    upb::json::Parser parser(&st);
+    upb::json::Printer printer(serialize_handlers.get());
+    parser.SetAllocator(arena.allocator());
+    printer.SetAllocator(arena.allocator());
+    StringSink data_sink;
+    parser.ResetOutput(printer.input());
+    printer.ResetOutput(data_sink.Sink());
+    ASSERT(PutInPieces(json, 1, 1, parser.input()));
+    ASSERT(data_sink.Data() == json);
+  }
+  ASSERT(arena.BytesAllocated() > 0);
+}
+
+void test_json_namemap() {
+  upb::reffed_ptr<upb::MessageDef> md(upb::MessageDef::New());
+  const int n = 1000;
+  for (int i = 0; i < n; i++) {
+    char name[32];
+    sprintf(name, "field_%d_x", i);
+    AddField(md.get(), i + 1, name, UPB_TYPE_INT32, false);
+  }
+  // "a_b" is "aB" in lowerCamelCase, but a field actually called "aB" wins.
+  AddField(md.get(), n + 1, "a_b", UPB_TYPE_INT32, false);
+  AddField(md.get(), n + 2, "aB", UPB_TYPE_INT32, false);
+
+  upb_json_namemap map;
+  ASSERT(upb_json_namemap_init(&map, md.get(), &upb_alloc_global));
+  for (int i = 0; i < n; i++) {
+    char name[32];
+    char camel[32];
+    sprintf(name, "field_%d_x", i);
+    sprintf(camel, "field%dX", i);
+    const upb_json_nameent* e = upb_json_namemap_lookup(&map, name,
+                                                        strlen(name));
+    ASSERT(e && upb_fielddef_number(e->f) == (uint32_t)i + 1);
+    const upb_json_nameent* c = upb_json_namemap_lookup(&map, camel,
+                                                        strlen(camel));
+    ASSERT(c && c->f == e->f && c->index == e->index);
+    ASSERT(!upb_json_namemap_lookup(&map, name, strlen(name) - 1));
+  }
+  const upb_json_nameent* e = upb_json_namemap_lookup(&map, "aB", 2);
+  ASSERT(e && upb_fielddef_number(e->f) == n + 2);
+  e = upb_json_namemap_lookup(&map, "a_b", 3);
+  ASSERT(e && upb_fielddef_number(e->f) == n + 1);
+  ASSERT(!upb_json_namemap_lookup(&map, "", 0));
+  upb_json_namemap_uninit(&map);
+}
+
+void test_json_base64() {
+  // Every length, to cover both the vectorized and the byte-at-a-time code.
+  std::string data;
+  srand(3);
+  for (int i = 0; i < 200; i++) data += (char)rand();
+  for (size_t len = 0; len <= data.size(); len++) {
+    std::string encoded(UPB_JSON_BASE64_ENCLEN(len), '\0');
+    ASSERT(upb_json_base64encode(data.data(), len, &encoded[0]) ==
+           encoded.size());
+    std::string decoded(len / 3 * 3 + 3, '\0');
+    size_t decoded_len;
+    ASSERT(upb_json_base64decode(encoded.data(), encoded.size(), &decoded[0],
+                                 &decoded_len) == UPB_JSON_BASE64_OK);
+    ASSERT(decoded_len == len);
+    ASSERT(decoded.compare(0, len, data, 0, len) == 0);
+
+    // A bad character anywhere is caught.
+    if (len > 0) {
+      std::string bad = encoded;
+      bad[rand() % (encoded.size() - 2)] = '!';
+      ASSERT(upb_json_base64decode(bad.data(), bad.size(), &decoded[0],
+                                   &decoded_len) == UPB_JSON_BASE64_BADCHAR);
+    }
+  }
+
+  char out[16];
+  size_t out_len;
+  ASSERT(upb_json_base64encode("ab", 2, out) == 4 &&
+         memcmp(out, "YWI=", 4) == 0);
+  ASSERT(upb_json_base64decode("YWJj", 4, out, &out_len) ==
+         UPB_JSON_BASE64_OK && out_len == 3 && memcmp(out, "abc", 3) == 0);
+  ASSERT(upb_json_base64decode("YWJ", 3, out, &out_len) ==
+         UPB_JSON_BASE64_BADLENGTH);
+  ASSERT(upb_json_base64decode("YW==YWJj", 8, out, &out_len) ==
+         UPB_JSON_BASE64_BADPADDING);
+  ASSERT(upb_json_base64decode("Y===", 4, out, &out_len) ==
+         UPB_JSON_BASE64_BADPADDING);
+  ASSERT(upb_json_base64decode("YW=j", 4, out, &out_len) ==
+         UPB_JSON_BASE64_BADPADDING);
+
+  // The printer encodes values that arrive in pieces of any size.
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> print_handlers(
+      upb::json::Printer::NewHandlers(md));
+  const upb::FieldDef* f = md->FindFieldByName("optional_bytes");
+  upb::Handlers::Selector start, str, end;
+  ASSERT(upb::Handlers::GetSelector(f, UPB_HANDLER_STARTSTR, &start));
+  ASSERT(upb::Handlers::GetSelector(f, UPB_HANDLER_STRING, &str));
+  ASSERT(upb::Handlers::GetSelector(f, UPB_HANDLER_ENDSTR, &end));
+
+  upb::json::Printer printer(print_handlers.get());
+  StringSink json_sink;
+  printer.ResetOutput(json_sink.Sink());
+  upb::Sink sub;
+  upb::Status st;
+  ASSERT(printer.input()->StartMessage());
+  ASSERT(printer.input()->StartString(start, 0, &sub));
+  for (size_t ofs = 0, n = 1; ofs < data.size(); ofs += n, n = n % 7 + 1) {
+    n = UPB_MIN(n, data.size() - ofs);
+    ASSERT(sub.PutStringBuffer(str, data.data() + ofs, n, NULL) == n);
+  }
+  ASSERT(printer.input()->EndString(end));
+  ASSERT(printer.input()->EndMessage(&st));
+  std::string encoded(UPB_JSON_BASE64_ENCLEN(data.size()), '\0');
+  upb_json_base64encode(data.data(), data.size(), &encoded[0]);
+  ASSERT(json_sink.Data() == "{\"optional_bytes\":\"" + encoded + "\"}");
+
+  // A value too big to decode in one piece.
+  std::string big;
+  for (int i = 0; i < 100000; i++) big += (char)rand();
+  encoded.resize(UPB_JSON_BASE64_ENCLEN(big.size()));
+  upb_json_base64encode(big.data(), big.size(), &encoded[0]);
+  std::string json = "{\"optional_bytes\":\"" + encoded + "\"}";
+  upb::json::Parser parser(&st);
+  StringSink roundtrip_sink;
+  parser.ResetOutput(printer.input());
+  printer.ResetOutput(roundtrip_sink.Sink());
+  ASSERT_STATUS(upb::BufferSource::PutBuffer(json.data(), json.size(),
+                                             parser.input()), &st);
+  ASSERT(roundtrip_sink.Data() == json);
+}
+
+// Runs "json" through "parser" (which must already be hooked up to its
+// output) repeatedly for CPU_TIME_PER_TEST seconds and prints the throughput.
+static void time_parse(const char* desc, upb::json::Parser* parser,
+                       StringSink* sink, const std::string& json) {
+  printf("%s: ", desc);
+  fflush(stdout);
+  double before = get_usertime();
+  size_t bytes = 0;
+  do {
+    parser->Reset();
+    ASSERT(upb::BufferSource::PutBuffer(json.data(), json.size(),
+                                        parser->input()));
+    bytes += json.size();
+    const_cast<std::string&>(sink->Data()).clear();
+  } while (get_usertime() - before < CPU_TIME_PER_TEST);
+  printf("%.1f MB/s\n", bytes / (get_usertime() - before) / 1e6);
+}
+
+// Parsing and printing of string-heavy JSON, where nearly all of the time
+// goes to scanning string contents.
+void benchmark_json_strings() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> encode_handlers(
+      upb::pb::Encoder::NewHandlers(md));
+  upb::reffed_ptr<const upb::Handlers> print_handlers(
+      upb::json::Printer::NewHandlers(md));
+
+  // Strings of 10-400 bytes of text, with an escape here and there.
+  std::string json = "{\"repeated_string\":[";
+  srand(1);
+  for (int i = 0; i < 200; i++) {
+    if (i > 0) json += ",";
+    json += "\"";
+    int len = 10 + rand() % 390;
+    for (int j = 0; j < len; j++) {
+      json += (rand() % 100 == 0) ? "\\n" : std::string(1, 'a' + rand() % 26);
+    }
+    json += "\"";
+  }
+  json += "]}";
+
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::pb::Encoder encoder(encode_handlers.get());
+  StringSink pb_sink;
+  parser.ResetOutput(encoder.input());
+  encoder.ResetOutput(pb_sink.Sink());
+  time_parse("upb::json::Parser -> upb::pb::Encoder (strings)", &parser,
+             &pb_sink, json);
+
+  upb::json::Printer printer(print_handlers.get());
+  StringSink json_sink;
+  parser.ResetOutput(printer.input());
+  printer.ResetOutput(json_sink.Sink());
+  time_parse("upb::json::Parser -> upb::json::Printer (strings)", &parser,
+             &json_sink, json);
+}
+
+// Parsing of JSON with many short members, where looking up the member names
+// is a big part of the work.
+void benchmark_json_members() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> encode_handlers(
+      upb::pb::Encoder::NewHandlers(md));
+
+  const char* members[] = {
+    "\"optional_int32\":1", "\"optional_int64\":2", "\"optional_uint32\":3",
+    "\"optional_uint64\":4", "\"optional_bool\":true",
+    "\"optional_enum\":\"B\"", "\"optional_msg\":{\"foo\":5}",
+    "\"optionalInt32\":6", "\"optionalBool\":false",
+  };
+  std::string json = "{";
+  srand(1);
+  for (int i = 0; i < 20000; i++) {
+    if (i > 0) json += ",";
+    json += members[rand() % (sizeof(members) / sizeof(members[0]))];
+  }
+  json += "}";
+
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::pb::Encoder encoder(encode_handlers.get());
+  StringSink pb_sink;
+  parser.ResetOutput(encoder.input());
+  encoder.ResetOutput(pb_sink.Sink());
+  time_parse("upb::json::Parser -> upb::pb::Encoder (members)", &parser,
+             &pb_sink, json);
+}
+
+// Parsing of JSON that is mostly unknown members, which are skipped rather
+// than parsed.  For comparison, the same values under known fields.
+void benchmark_json_skip() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> encode_handlers(
+      upb::pb::Encoder::NewHandlers(md));
+
+  std::string strings = "[";
+  std::string ints = "[";
+  srand(1);
+  for (int i = 0; i < 1000; i++) {
+    if (i > 0) {
+      strings += ",";
+      ints += ",";
+    }
+    strings += "\"";
+    int len = 10 + rand() % 90;
+    for (int j = 0; j < len; j++) strings += 'a' + rand() % 26;
+    strings += "\"";
+    ints += FormatInt(rand());
+  }
+  strings += "]";
+  ints += "]";
+
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::pb::Encoder encoder(encode_handlers.get());
+  StringSink pb_sink;
+  parser.ResetOutput(encoder.input());
+  encoder.ResetOutput(pb_sink.Sink());
+  time_parse("upb::json::Parser -> upb::pb::Encoder (known members)", &parser,
+             &pb_sink, "{\"repeated_string\":" + strings +
+                       ",\"repeated_int32\":" + ints + "}");
+  parser.SetIgnoreUnknown(true);
+  time_parse("upb::json::Parser -> upb::pb::Encoder (skipped members)",
+             &parser, &pb_sink, "{\"a\":" + strings + ",\"b\":" + ints + "}");
+}
+
+// Parsing and printing of a 1MB bytes field, which is all base64.
+void benchmark_json_bytes() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> encode_handlers(
+      upb::pb::Encoder::NewHandlers(md));
+  upb::reffed_ptr<const upb::Handlers> print_handlers(
+      upb::json::Printer::NewHandlers(md));
+
+  std::string data;
+  srand(1);
+  for (int i = 0; i < 1000000; i++) data += (char)rand();
+  std::string encoded(UPB_JSON_BASE64_ENCLEN(data.size()), '\0');
+  upb_json_base64encode(data.data(), data.size(), &encoded[0]);
+  std::string json = "{\"optional_bytes\":\"" + encoded + "\"}";
+
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::pb::Encoder encoder(encode_handlers.get());
+  StringSink pb_sink;
+  parser.ResetOutput(encoder.input());
+  encoder.ResetOutput(pb_sink.Sink());
+  time_parse("upb::json::Parser -> upb::pb::Encoder (bytes)", &parser,
+             &pb_sink, json);
+
+  upb::json::Printer printer(print_handlers.get());
+  StringSink json_sink;
+  parser.ResetOutput(printer.input());
+  printer.ResetOutput(json_sink.Sink());
+  time_parse("upb::json::Parser -> upb::json::Printer (bytes)", &parser,
+             &json_sink, json);
+}
+
+// Formatting and parsing of numbers on their own, compared with the
+// snprintf() and strtod() that the printer and parser used to call, and then
+// numbers through the parser and printer.
+void benchmark_json_numbers() {
+  std::vector<double> doubles;
+  std::vector<int64_t> ints;
+  srand(1);
+  for (int i = 0; i < 10000; i++) {
+    // Random mantissas over a wide range of exponents.
+    doubles.push_back(ldexp((double)rand() / RAND_MAX, rand() % 200 - 100));
+    ints.push_back(((int64_t)rand() << (rand() % 32)) - RAND_MAX / 2);
+  }
+  std::vector<std::string> strs;
+  for (size_t i = 0; i < doubles.size(); i++) {
+    strs.push_back(FormatDouble(doubles[i]));
+  }
+
+  char buf[UPB_JSON_MAX_NUMBER_LEN];
+  size_t chars = 0;
+  size_t n = 0;
+  double before = get_usertime();
+  do {
+    for (size_t i = 0; i < doubles.size(); i++) {
+      chars += upb_json_fmtdouble(doubles[i], buf);
+    }
+    n += doubles.size();
+  } while (get_usertime() - before < CPU_TIME_PER_TEST);
+  printf("upb_json_fmtdouble(): %.1f M numbers/s\n",
+         n / (get_usertime() - before) / 1e6);
+
+  n = 0;
+  before = get_usertime();
+  do {
+    for (size_t i = 0; i < doubles.size(); i++) {
+      chars += snprintf(buf, sizeof(buf), "%.17g", doubles[i]);
+    }
+    n += doubles.size();
+  } while (get_usertime() - before < CPU_TIME_PER_TEST);
+  printf("snprintf(\"%%.17g\"): %.1f M numbers/s\n",
+         n / (get_usertime() - before) / 1e6);
+
+  n = 0;
+  before = get_usertime();
+  do {
+    for (size_t i = 0; i < ints.size(); i++) {
+      chars += upb_json_fmtint64(ints[i], buf);
+    }
+    n += ints.size();
+  } while (get_usertime() - before < CPU_TIME_PER_TEST);
+  printf("upb_json_fmtint64(): %.1f M numbers/s\n",
+         n / (get_usertime() - before) / 1e6);
+
+  n = 0;
+  before = get_usertime();
+  do {
+    for (size_t i = 0; i < ints.size(); i++) {
+      chars += snprintf(buf, sizeof(buf), "%lld", (long long)ints[i]);
+    }
+    n += ints.size();
+  } while (get_usertime() - before < CPU_TIME_PER_TEST);
+  printf("snprintf(\"%%lld\"): %.1f M numbers/s\n",
+         n / (get_usertime() - before) / 1e6);
+  ASSERT(chars > 0);
+
+  double sum = 0;
+  n = 0;
+  before = get_usertime();
+  do {
+    for (size_t i = 0; i < strs.size(); i++) {
+      double val;
+      ASSERT(upb_json_parsedouble(strs[i].data(), strs[i].size(), &val));
+      sum += val;
+    }
+    n += strs.size();
+  } while (get_usertime() - before < CPU_TIME_PER_TEST);
+  printf("upb_json_parsedouble(): %.1f M numbers/s\n",
+         n / (get_usertime() - before) / 1e6);
+
+  n = 0;
+  before = get_usertime();
+  do {
+    for (size_t i = 0; i < strs.size(); i++) {
+      sum += strtod(strs[i].c_str(), NULL);
+    }
+    n += strs.size();
+  } while (get_usertime() - before < CPU_TIME_PER_TEST);
+  printf("strtod(): %.1f M numbers/s\n", n / (get_usertime() - before) / 1e6);
+  ASSERT(sum != 0);
+
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> print_handlers(
+      upb::json::Printer::NewHandlers(md));
+  std::string json = "{\"repeated_int64\":[";
+  for (size_t i = 0; i < ints.size(); i++) {
+    if (i > 0) json += ",";
+    json += FormatInt(ints[i]);
+  }
+  json += "]}";
+
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::json::Printer printer(print_handlers.get());
+  StringSink json_sink;
+  parser.ResetOutput(printer.input());
+  printer.ResetOutput(json_sink.Sink());
+  time_parse("upb::json::Parser -> upb::json::Printer (numbers)", &parser,
+             &json_sink, json);
+}
+
+static size_t count_write(void* closure, const void* hd, const char* buf,
+                          size_t n, const upb_bufhandle* handle) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(buf);
+  UPB_UNUSED(handle);
+  (*static_cast<size_t*>(closure))++;
+  return n;
+}
+
+// Runs "pb" through "decoder", which must already be hooked up to "printer",
+// and prints the printer's output rate and how many writes it makes to its
+// output for one message.
+template <class T>
+static void time_print(const char* desc, upb::pb::Decoder* decoder,
+                       T* printer, const std::string& pb) {
+  size_t writes = 0;
+  upb::BytesHandler counting_handler;
+  upb_byteshandler_setstring(&counting_handler, &count_write, NULL);
+  upb::BytesSink counting(&counting_handler, &writes);
+  printer->ResetOutput(&counting);
+  decoder->Reset();
+  ASSERT(upb::BufferSource::PutBuffer(pb, decoder->input()));
+
+  StringSink sink;
+  printer->ResetOutput(sink.Sink());
+  std::string& out = const_cast<std::string&>(sink.Data());
+  double before = get_usertime();
+  size_t bytes = 0;
+  do {
+    out.clear();
+    decoder->Reset();
+    ASSERT(upb::BufferSource::PutBuffer(pb, decoder->input()));
+    bytes += out.size();
+  } while (get_usertime() - before < CPU_TIME_PER_TEST);
+  printf("%s: %.1f MB/s of output, %zu writes per message\n", desc,
+         bytes / (get_usertime() - before) / 1e6, writes);
+}
+
+// Printing of many small values, where the printers used to hand every
+// quote, comma and number to the output sink on its own.
+void benchmark_json_printers() {
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  const upb::MessageDef* md = BuildTestMessage(symtab.get());
+  upb::reffed_ptr<const upb::Handlers> encode_handlers(
+      upb::pb::Encoder::NewHandlers(md));
+
+  std::string ints, strs, msgs;
+  srand(1);
+  for (int i = 0; i < 1000; i++) {
+    const char* sep = i > 0 ? "," : "";
+    ints += sep + FormatInt(rand() % 100000);
+    strs += sep + std::string("\"") + (char)('a' + rand() % 26) + "bc\"";
+    msgs += sep + std::string("{\"foo\":") + FormatInt(rand() % 100) + "}";
+  }
+  std::string json = "{\"repeated_int32\":[" + ints +
+                     "],\"repeated_string\":[" + strs +
+                     "],\"repeated_msg\":[" + msgs + "]}";
+
+  upb::Status st;
+  upb::json::Parser parser(&st);
+  upb::pb::Encoder encoder(encode_handlers.get());
+  StringSink pb_sink;
+  parser.ResetOutput(encoder.input());
+  encoder.ResetOutput(pb_sink.Sink());
+  ASSERT(upb::BufferSource::PutBuffer(json, parser.input()));
+  const std::string& pb = pb_sink.Data();
+
+  upb::reffed_ptr<const upb::Handlers> print_handlers(
+      upb::json::Printer::NewHandlers(md));
+  upb::pb::CodeCache codecache;
+  upb::reffed_ptr<const upb::pb::DecoderMethod> print_method(
+      codecache.GetDecoderMethod(
+          upb::pb::DecoderMethodOptions(print_handlers.get())));
+  upb::pb::Decoder decoder(print_method.get(), &st);
+  upb::json::Printer printer(print_handlers.get());
+  decoder.ResetOutput(printer.input());
+  time_print("upb::pb::Decoder -> upb::json::Printer", &decoder, &printer, pb);
+
+  upb::reffed_ptr<const upb::Handlers> text_handlers(
+      upb::pb::TextPrinter::NewHandlers(md));
+  upb::reffed_ptr<const upb::pb::DecoderMethod> text_method(
+      codecache.GetDecoderMethod(
+          upb::pb::DecoderMethodOptions(text_handlers.get())));
+  upb::pb::Decoder text_decoder(text_method.get(), &st);
+  upb::pb::TextPrinter text_printer(text_handlers.get());
+  text_decoder.ResetOutput(text_printer.input());
+  time_print("upb::pb::Decoder -> upb::pb::TextPrinter", &text_decoder,
+             &text_printer, pb);
+}
+
+// The messages from tests/google_messages.proto that we have sample data for.
+static const char* kGoogleMessages[][2] = {
+  { "benchmarks.SpeedMessage1", "tests/google_message1.dat" },
+  { "benchmarks.SpeedMessage2", "tests/google_message2.dat" },
+};
+
+// Prints the throughput of a loop that started at "before".
+static void print_rate(const char* desc, const char* msg, size_t bytes,
+                       double before) {
+  printf("%s (%s): %.1f MB/s\n", desc, msg,
+         bytes / (get_usertime() - before) / 1e6);
+}
+
+// Conversion of the google_message1/2 benchmark messages, both ways, through
+// handlers and through the Transcoder.  tests/google_messages.proto.pb is
+// generated with protoc, so we skip these if it hasn't been built.
+void benchmark_json_google_messages() {
+  upb::Status st;
+  upb::reffed_ptr<upb::SymbolTable> symtab(upb::SymbolTable::New());
+  if (!upb::LoadDescriptorFileIntoSymtab(
+          symtab.get(), "tests/google_messages.proto.pb", &st)) {
+    printf("Skipping google_message benchmarks: %s\n", st.error_message());
+    return;
+  }
+  upb::json::TranscoderCache cache;
+  upb::json::Transcoder transcoder;
+
+  for (size_t i = 0; i < 2; i++) {
+    const upb::MessageDef* md = symtab->LookupMessage(kGoogleMessages[i][0]);
+    ASSERT(md);
+    const char* msg = strrchr(kGoogleMessages[i][1], '/') + 1;
+    size_t len;
+    char* data = upb_readfile(kGoogleMessages[i][1], &len);
+    ASSERT(data);
+    std::string pb(data, len);
+    free(data);
+
+    upb::reffed_ptr<const upb::Handlers> print_handlers(
+        upb::json::Printer::NewHandlers(md));
+    upb::pb::CodeCache codecache;
+    upb::reffed_ptr<const upb::pb::DecoderMethod> decoder_method(
+        codecache.GetDecoderMethod(
+            upb::pb::DecoderMethodOptions(print_handlers.get())));
+    upb::pb::Decoder decoder(decoder_method.get(), &st);
+    upb::json::Printer printer(print_handlers.get());
+    StringSink json_sink;
+    std::string& json = const_cast<std::string&>(json_sink.Data());
+    decoder.ResetOutput(printer.input());
+    printer.ResetOutput(json_sink.Sink());
+
+    double before = get_usertime();
+    size_t bytes = 0;
+    do {
+      json.clear();
+      decoder.Reset();
+      ASSERT(upb::BufferSource::PutBuffer(pb, decoder.input()));
+      bytes += pb.size();
+    } while (get_usertime() - before < CPU_TIME_PER_TEST);
+    print_rate("upb::pb::Decoder -> upb::json::Printer", msg, bytes, before);
+    std::string expected = json;
+
+    const upb::json::TranscoderMethod* method =
+        cache.GetTranscoderMethod(md, &st);
+    ASSERT_STATUS(method, &st);
+    before = get_usertime();
+    bytes = 0;
+    do {
+      json.clear();
+      ASSERT(transcoder.ProtobufToJson(method, pb.data(), pb.size(),
+                                       json_sink.Sink(), &st));
+      bytes += pb.size();
+    } while (get_usertime() - before < CPU_TIME_PER_TEST);
+    print_rate("upb::json::Transcoder, protobuf -> JSON", msg, bytes, before);
+    ASSERT(json == expected);
+
+    // And back, from the JSON we just printed.
+    upb::reffed_ptr<const upb::Handlers> encode_handlers(
+        upb::pb::Encoder::NewHandlers(md));
+    upb::json::Parser parser(&st);
+    upb::pb::Encoder encoder(encode_handlers.get());
+    StringSink pb_sink;
+    std::string& out = const_cast<std::string&>(pb_sink.Data());
+    parser.ResetOutput(encoder.input());
+    encoder.ResetOutput(pb_sink.Sink());
+
+    before = get_usertime();
+    bytes = 0;
+    do {
+      out.clear();
+      parser.Reset();
+      ASSERT(upb::BufferSource::PutBuffer(expected, parser.input()));
+      bytes += expected.size();
+    } while (get_usertime() - before < CPU_TIME_PER_TEST);
+    print_rate("upb::json::Parser -> upb::pb::Encoder", msg, bytes, before);
+    std::string expected_pb = out;
+
+    before = get_usertime();
+    bytes = 0;
+    do {
+      out.clear();
+      ASSERT(transcoder.JsonToProtobuf(method, expected.data(),
+                                       expected.size(), pb_sink.Sink(), &st));
+      bytes += expected.size();
+    } while (get_usertime() - before < CPU_TIME_PER_TEST);
+    print_rate("upb::json::Transcoder, JSON -> protobuf", msg, bytes, before);
+    ASSERT(out == expected_pb);
   }
 }
 
 extern "C" {
 int run_tests(int argc, char *argv[]) {
-  UPB_UNUSED(argc);
-  UPB_UNUSED(argv);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--benchmark") == 0) benchmark = true;
+  }
   test_json_roundtrip();
+  test_json_transcode();
+  test_json_numbers();
+  test_json_bad_numbers();
+  test_json_bad_keys();
+  test_json_ignore_unknown();
+  test_json_streaming();
+  test_json_namemap();
+  test_json_base64();
+  test_json_allocator();
+  if (benchmark) {
+    benchmark_json_strings();
+    benchmark_json_members();
+    benchmark_json_skip();
+    benchmark_json_bytes();
+    benchmark_json_numbers();
+    benchmark_json_printers();
+    benchmark_json_google_messages();
+  }
   return 0;
 }
 }
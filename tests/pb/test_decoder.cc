@@ -33,13 +33,22 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <utility>
+#include <vector>
 
 #include "tests/upb_test.h"
+#include "upb/bindings/stdc++/string.h"
 #include "upb/handlers.h"
 #include "upb/pb/decoder.h"
+#include "upb/pb/encoder.h"
 #include "upb/pb/varint.int.h"
+#include "upb/shim/shim.h"
 #include "upb/upb.h"
 
 #undef PRINT_FAILURE
@@ -59,6 +68,7 @@
   }
 
 uint32_t filter_hash = 0;
+bool benchmark = false;
 double completed;
 double total;
 double *count;
@@ -1151,6 +1161,808 @@ void test_emptyhandlers(bool allowjit) {
   NewMethod(h.get(), allowjit);
 }
 
+// Size hints received by the hint handlers below, as (field number, hint).
+std::vector<std::pair<uint32_t, size_t> > hints;
+
+int* startseq_hint(int* depth, const uint32_t* num, size_t size_hint) {
+  hints.push_back(std::make_pair(*num, size_hint));
+  return depth;
+}
+
+int* startsubmsg_hint(int* depth, const uint32_t* num, size_t size_hint) {
+  hints.push_back(std::make_pair(*num, size_hint));
+  return depth + 1;
+}
+
+void test_sizehints(bool allowjit) {
+  uint32_t repfx_fn = rep_fn(UPB_DESCRIPTOR_TYPE_FIXED32);
+  uint32_t msg_fn = UPB_DESCRIPTOR_TYPE_MESSAGE;
+  uint32_t repm_fn = rep_fn(UPB_DESCRIPTOR_TYPE_MESSAGE);
+
+  upb::reffed_ptr<const upb::MessageDef> md = NewMessageDef();
+  upb::reffed_ptr<upb::Handlers> h(upb::Handlers::New(md.get()));
+  ASSERT(h->SetStartSequenceHintHandler(
+      md->FindFieldByNumber(repfx_fn),
+      UpbBind(startseq_hint, new uint32_t(repfx_fn))));
+  ASSERT(h->SetStartSequenceHintHandler(
+      md->FindFieldByNumber(repm_fn),
+      UpbBind(startseq_hint, new uint32_t(repm_fn))));
+  ASSERT(h->SetStartSubMessageHintHandler(
+      md->FindFieldByNumber(msg_fn),
+      UpbBind(startsubmsg_hint, new uint32_t(msg_fn))));
+  ASSERT(h->SetStartSubMessageHintHandler(
+      md->FindFieldByNumber(repm_fn),
+      UpbBind(startsubmsg_hint, new uint32_t(repm_fn))));
+  ASSERT(upb_handlers_setsubhandlers(h.get(), md->FindFieldByNumber(msg_fn),
+                                     h.get()));
+  ASSERT(upb_handlers_setsubhandlers(h.get(), md->FindFieldByNumber(repm_fn),
+                                     h.get()));
+  ASSERT(h->Freeze(NULL));
+  upb::reffed_ptr<const upb::pb::DecoderMethod> method =
+      NewMethod(h.get(), allowjit);
+
+  string packed = cat( uint32(1), uint32(2), uint32(3) );
+  // The packed field ends exactly where its enclosing submessage does.
+  string inner = cat( tag(repfx_fn, UPB_WIRE_TYPE_DELIMITED), delim(packed) );
+  string proto = cat(
+      tag(repfx_fn, UPB_WIRE_TYPE_DELIMITED), delim(packed),
+      tag(repfx_fn, UPB_WIRE_TYPE_32BIT), uint32(4),
+      submsg(msg_fn, inner),
+      submsg(repm_fn, inner) );
+
+  upb::Status status;
+  upb::pb::Decoder decoder(method.get(), &status);
+  upb::Sink sink(h.get(), &closures[0]);
+  decoder.ResetOutput(&sink);
+  hints.clear();
+  ASSERT(upb::BufferSource::PutBuffer(proto, decoder.input()));
+  ASSERT(status.ok());
+
+  // Length-delimited frames get their exact length; tag-delimited frames (the
+  // non-packed sequences) get 0.
+  std::pair<uint32_t, size_t> expected[] = {
+    std::make_pair(repfx_fn, packed.size()),
+    std::make_pair(repfx_fn, (size_t)0),
+    std::make_pair(msg_fn, inner.size()),
+    std::make_pair(repfx_fn, packed.size()),
+    std::make_pair(repm_fn, (size_t)0),
+    std::make_pair(repm_fn, inner.size()),
+    std::make_pair(repfx_fn, packed.size()),
+  };
+  ASSERT(hints.size() == sizeof(expected) / sizeof(expected[0]));
+  for (size_t i = 0; i < hints.size(); i++) {
+    ASSERT(hints[i] == expected[i]);
+  }
+}
+
+void test_stats(bool allowjit) {
+  upb::reffed_ptr<const upb::pb::DecoderMethod> method =
+      NewMethod(global_handlers, allowjit);
+  uint32_t repfx_fn = rep_fn(UPB_DESCRIPTOR_TYPE_FIXED32);
+  string proto = cat(
+      tag(UPB_DESCRIPTOR_TYPE_INT32, UPB_WIRE_TYPE_VARINT), varint(1),
+      tag(UNKNOWN_FIELD, UPB_WIRE_TYPE_VARINT), varint(2345678),
+      tag(repfx_fn, UPB_WIRE_TYPE_DELIMITED),
+      delim(cat( uint32(1), uint32(2), uint32(3) )) );
+
+  upb::Status status;
+  upb::pb::Decoder decoder(method.get(), &status);
+  upb::Sink sink(global_handlers, &closures[0]);
+  decoder.ResetOutput(&sink);
+
+  // Split the input in the middle of the last value, so that it has to be
+  // completed from the residual buffer.
+  size_t split = proto.size() - 2;
+  void *sub;
+  upb::BytesSink* input = decoder.input();
+  output.clear();
+  ASSERT(input->Start(proto.size(), &sub));
+  ASSERT(input->PutBuffer(sub, proto.c_str(), split, NULL) == split);
+  ASSERT(input->PutBuffer(sub, proto.c_str() + split, proto.size() - split,
+                          NULL) == proto.size() - split);
+  ASSERT(input->End());
+  ASSERT(status.ok());
+
+  const upb_pbdecoder_stats* stats = decoder.stats();
+  upb_pbdecoder_stats totals;
+  method->GetStats(&totals);
+  ASSERT(memcmp(&totals, stats, sizeof(totals)) == 0);
+
+  if (upb::pb::Decoder::HasStats()) {
+    ASSERT(stats->bytes == proto.size());
+    ASSERT(stats->fields == 4);
+    ASSERT(stats->unknown_fields == 1);
+    ASSERT(stats->dispatch_fallbacks >= 1);
+    ASSERT(stats->tag_mispredicts >= 1);
+    ASSERT(stats->resumes >= 2);
+    ASSERT(stats->suspends >= 1);
+    ASSERT(stats->residual_saves >= 1);
+    ASSERT(stats->residual_bytes >= 2);
+
+    char buf[256];
+    ASSERT(upb_pbdecoder_printstats(stats, buf, sizeof(buf)) < sizeof(buf));
+    ASSERT(strstr(buf, "fields=4 ") != NULL);
+    ASSERT(strstr(buf, "unknown_fields=1") != NULL);
+  } else {
+    upb_pbdecoder_stats zero;
+    memset(&zero, 0, sizeof(zero));
+    ASSERT(memcmp(stats, &zero, sizeof(zero)) == 0);
+  }
+
+  // Counters are per-decoder, but the method's totals include all of them.
+  upb::pb::Decoder decoder2(method.get(), &status);
+  decoder2.ResetOutput(&sink);
+  ASSERT(upb::BufferSource::PutBuffer(proto, decoder2.input()));
+  decoder2.Reset();
+  method->GetStats(&totals);
+  ASSERT(totals.bytes == stats->bytes + decoder2.stats()->bytes);
+  ASSERT(totals.fields == stats->fields + decoder2.stats()->fields);
+}
+
+// A plain C struct for DecoderTest, filled in entirely by shims.  Hasbits
+// are bit offsets from the start of the struct.
+#define SHIMTEST_HASBIT(n) (offsetof(ShimTest, hasbits) * 8 + (n))
+
+struct ShimTest {
+  upb::Arena* arena;
+  uint8_t hasbits;
+  int32_t i32;
+  upb::Shim::StringView str;
+  upb::Shim::Array ints;
+  upb::Shim::Array doubles;
+  ShimTest* child;
+};
+
+void test_shims(bool allowjit) {
+  uint32_t repi_fn = rep_fn(UPB_DESCRIPTOR_TYPE_INT32);
+  uint32_t repd_fn = rep_fn(UPB_DESCRIPTOR_TYPE_DOUBLE);
+  uint32_t msg_fn = UPB_DESCRIPTOR_TYPE_MESSAGE;
+
+  upb::reffed_ptr<const upb::MessageDef> md = NewMessageDef();
+  upb::reffed_ptr<upb::Handlers> h(upb::Handlers::New(md.get()));
+  int32_t arena_ofs = offsetof(ShimTest, arena);
+  ASSERT(upb::Shim::Set(h.get(),
+                        md->FindFieldByNumber(UPB_DESCRIPTOR_TYPE_INT32),
+                        offsetof(ShimTest, i32), SHIMTEST_HASBIT(4)));
+  ASSERT(upb::Shim::SetStringView(
+      h.get(), md->FindFieldByNumber(UPB_DESCRIPTOR_TYPE_STRING),
+      offsetof(ShimTest, str), SHIMTEST_HASBIT(1), arena_ofs));
+  ASSERT(upb::Shim::SetArray(h.get(), md->FindFieldByNumber(repi_fn),
+                             offsetof(ShimTest, ints), SHIMTEST_HASBIT(3),
+                             arena_ofs));
+  ASSERT(upb::Shim::SetArray(h.get(), md->FindFieldByNumber(repd_fn),
+                             offsetof(ShimTest, doubles), -1, arena_ofs));
+  ASSERT(upb::Shim::SetSubMessage(h.get(), md->FindFieldByNumber(msg_fn),
+                                  offsetof(ShimTest, child), SHIMTEST_HASBIT(2),
+                                  sizeof(ShimTest), arena_ofs, arena_ofs));
+  ASSERT(upb_handlers_setsubhandlers(h.get(), md->FindFieldByNumber(msg_fn),
+                                     h.get()));
+  ASSERT(h->Freeze(NULL));
+
+  upb::FieldDef::Type type;
+  upb::Handlers::Selector sel;
+  ASSERT(upb::Handlers::GetSelector(md->FindFieldByNumber(repi_fn),
+                                    UPB_HANDLER_INT32, &sel));
+  ASSERT(upb::Shim::GetArrayData(h.get(), sel, &type));
+  ASSERT(type == UPB_TYPE_INT32);
+  ASSERT(!upb::Shim::GetData(h.get(), sel, &type));
+  ASSERT(upb::Handlers::GetSelector(md->FindFieldByNumber(msg_fn),
+                                    UPB_HANDLER_STARTSUBMSG, &sel));
+  ASSERT(upb::Shim::GetSubMessageData(h.get(), sel)->size ==
+         sizeof(ShimTest));
+  ASSERT(!upb::Shim::GetStringViewData(h.get(), sel));
+
+  upb::reffed_ptr<const upb::pb::DecoderMethod> method =
+      NewMethod(h.get(), allowjit);
+
+  // Enough ints to grow the array a few times.
+  string ints;
+  for (int i = 0; i < 20; i++) {
+    ints += cat( tag(repi_fn, UPB_WIRE_TYPE_VARINT), varint(i) );
+  }
+  string inner = cat(
+      tag(UPB_DESCRIPTOR_TYPE_STRING, UPB_WIRE_TYPE_DELIMITED),
+      delim("child"),
+      submsg(msg_fn, cat( tag(UPB_DESCRIPTOR_TYPE_INT32, UPB_WIRE_TYPE_VARINT),
+                          varint(9) )) );
+  string proto = cat(
+      tag(UPB_DESCRIPTOR_TYPE_INT32, UPB_WIRE_TYPE_VARINT), varint(5),
+      tag(UPB_DESCRIPTOR_TYPE_STRING, UPB_WIRE_TYPE_DELIMITED),
+      delim("hello, world"),
+      ints,
+      tag(repd_fn, UPB_WIRE_TYPE_DELIMITED),
+      delim(cat( dbl(0.5), dbl(1.5), dbl(2.5) )),
+      submsg(msg_fn, inner) );
+
+  upb::Arena arena;
+  ShimTest st;
+  memset(&st, 0, sizeof(st));
+  st.arena = &arena;
+
+  upb::Status status;
+  upb::pb::Decoder decoder(method.get(), &status);
+  upb::Sink sink(h.get(), &st);
+  decoder.ResetOutput(&sink);
+  ASSERT(upb::BufferSource::PutBuffer(proto, decoder.input()));
+  ASSERT(status.ok());
+
+  ASSERT(st.hasbits == 0x1e);
+  ASSERT(st.i32 == 5);
+  // The string arrived in one piece, so it aliases the input.
+  ASSERT(st.str.size == 12);
+  ASSERT(st.str.data > proto.data() &&
+         st.str.data < proto.data() + proto.size());
+  ASSERT(memcmp(st.str.data, "hello, world", 12) == 0);
+  ASSERT(st.ints.len == 20);
+  ASSERT(st.ints.size >= 20);
+  for (int i = 0; i < 20; i++) {
+    ASSERT(static_cast<int32_t*>(st.ints.data)[i] == i);
+  }
+  // Reserved exactly from the packed field's size hint.
+  ASSERT(st.doubles.len == 3);
+  ASSERT(st.doubles.size == 3);
+  ASSERT(static_cast<double*>(st.doubles.data)[2] == 2.5);
+  ASSERT(st.child && st.child->arena == &arena);
+  ASSERT(st.child->hasbits == 0x06);
+  ASSERT(st.child->str.size == 5);
+  ASSERT(memcmp(st.child->str.data, "child", 5) == 0);
+  ASSERT(st.child->child && st.child->child->i32 == 9);
+  ASSERT(st.child->child->hasbits == 0x10);
+
+  // Serializing the struct and parsing the result gives us the same struct.
+  upb::pb::SerializerCache cache;
+  const upb::pb::SerializerMethod* serializer_method =
+      cache.GetSerializerMethod(h.get(), &status);
+  ASSERT(serializer_method);
+  ASSERT(cache.GetSerializerMethod(h.get(), &status) == serializer_method);
+  upb::pb::Serializer serializer;
+  string out;
+  upb::StringSink out_sink(&out);
+  ASSERT(serializer.Serialize(serializer_method, &st, out_sink.input(),
+                              &status));
+  // Fields are written in field number order.
+  ASSERT(out.substr(0, 2) ==
+         cat( tag(UPB_DESCRIPTOR_TYPE_INT32, UPB_WIRE_TYPE_VARINT), varint(5) ));
+
+  ShimTest st2;
+  memset(&st2, 0, sizeof(st2));
+  st2.arena = &arena;
+  upb::pb::Decoder decoder2(method.get(), &status);
+  upb::Sink sink2(h.get(), &st2);
+  decoder2.ResetOutput(&sink2);
+  ASSERT(upb::BufferSource::PutBuffer(out, decoder2.input()));
+  ASSERT(status.ok());
+  ASSERT(st2.hasbits == st.hasbits);
+  ASSERT(st2.i32 == 5);
+  ASSERT(st2.str.size == 12);
+  ASSERT(memcmp(st2.str.data, "hello, world", 12) == 0);
+  ASSERT(st2.ints.len == 20);
+  ASSERT(memcmp(st2.ints.data, st.ints.data, 20 * sizeof(int32_t)) == 0);
+  ASSERT(st2.doubles.len == 3);
+  ASSERT(memcmp(st2.doubles.data, st.doubles.data, 3 * sizeof(double)) == 0);
+  ASSERT(st2.child && st2.child->str.size == 5);
+  ASSERT(st2.child->child && st2.child->child->i32 == 9);
+
+  // Handlers that aren't shims can't be serialized from.
+  if (test_mode == ALL_HANDLERS) {
+    upb::Status status2;
+    ASSERT(!cache.GetSerializerMethod(global_handlers, &status2));
+    ASSERT(!status2.ok());
+  }
+
+  // A string that is split across buffers is copied into the arena.
+  string str = cat( tag(UPB_DESCRIPTOR_TYPE_STRING, UPB_WIRE_TYPE_DELIMITED),
+                    delim("hello, world") );
+  string first = str.substr(0, 8);
+  string second = str.substr(8);
+  memset(&st, 0, sizeof(st));
+  st.arena = &arena;
+  decoder.Reset();
+  void *subc;
+  upb::BytesSink* input = decoder.input();
+  ASSERT(input->Start(0, &subc));
+  ASSERT(input->PutBuffer(subc, first.data(), first.size(), &global_handle) ==
+         first.size());
+  ASSERT(input->PutBuffer(subc, second.data(), second.size(),
+                          &global_handle) == second.size());
+  ASSERT(input->End());
+  ASSERT(status.ok());
+  ASSERT(st.str.size == 12);
+  ASSERT(st.str.data < first.data() ||
+         st.str.data >= first.data() + first.size());
+  ASSERT(memcmp(st.str.data, "hello, world", 12) == 0);
+
+  // JIT code allocates a child straight from the arena's current block, and
+  // only calls the shim when it is full.  The seed block has room for exactly
+  // one child, so the grandchild (and then the array) comes from a new block.
+  // A submessage that occurs again merges into the child it already has and
+  // an array that does is appended to, while a string is replaced.
+  uint64_t seed[UPB_ARENA_ALIGN_UP(sizeof(ShimTest)) / sizeof(uint64_t)];
+  upb::Arena seeded(seed, sizeof(seed), NULL);
+  string more_ints = cat( tag(repi_fn, UPB_WIRE_TYPE_VARINT), varint(20),
+                          tag(repi_fn, UPB_WIRE_TYPE_VARINT), varint(21) );
+  proto = cat(
+      submsg(msg_fn, submsg(msg_fn, cat( tag(UPB_DESCRIPTOR_TYPE_INT32,
+                                             UPB_WIRE_TYPE_VARINT),
+                                         varint(9) ))),
+      tag(UPB_DESCRIPTOR_TYPE_STRING, UPB_WIRE_TYPE_DELIMITED), delim("a"),
+      ints,
+      tag(UPB_DESCRIPTOR_TYPE_INT32, UPB_WIRE_TYPE_VARINT), varint(5),
+      more_ints,
+      submsg(msg_fn, cat( tag(UPB_DESCRIPTOR_TYPE_INT32, UPB_WIRE_TYPE_VARINT),
+                          varint(7) )),
+      tag(UPB_DESCRIPTOR_TYPE_STRING, UPB_WIRE_TYPE_DELIMITED), delim("bc") );
+  memset(&st, 0, sizeof(st));
+  st.arena = &seeded;
+  decoder.Reset();
+  ASSERT(upb::BufferSource::PutBuffer(proto, decoder.input()));
+  ASSERT(status.ok());
+  ASSERT(st.child == reinterpret_cast<ShimTest*>(seed));
+  ASSERT(st.child->arena == &seeded);
+  ASSERT(st.child->i32 == 7);
+  ASSERT(st.child->child && st.child->child->i32 == 9);
+  ASSERT(st.child->child->arena == &seeded);
+  ASSERT(reinterpret_cast<char*>(st.child->child) <
+             reinterpret_cast<char*>(seed) ||
+         reinterpret_cast<char*>(st.child->child) >=
+             reinterpret_cast<char*>(seed) + sizeof(seed));
+  ASSERT(st.str.size == 2 && memcmp(st.str.data, "bc", 2) == 0);
+  ASSERT(st.ints.len == 22);
+  for (int i = 0; i < 22; i++) {
+    ASSERT(static_cast<int32_t*>(st.ints.data)[i] == i);
+  }
+}
+
+// A struct with a slot for every field of DecoderTest that the serializer can
+// handle.  Scalar field n lives in vals[n] and, if hasbits are used, has
+// hasbit n.
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+#define SERIALIZERTEST_HASBIT(n) (offsetof(SerializerTest, hasbits) * 8 + (n))
+
+struct SerializerTest {
+  upb::Arena* arena;
+  uint8_t hasbits[3];
+  uint64_t vals[UPB_DESCRIPTOR_TYPE_SINT64 + 1];
+  upb::Shim::StringView str;
+  upb::Shim::StringView bytes;
+  upb::Shim::Array ints;
+  upb::Shim::Array sint64s;
+  upb::Shim::Array doubles;
+  upb::Shim::Array bools;
+  SerializerTest* child;
+};
+
+const upb_descriptortype_t serializer_scalars[] = {
+  UPB_DESCRIPTOR_TYPE_DOUBLE, UPB_DESCRIPTOR_TYPE_FLOAT,
+  UPB_DESCRIPTOR_TYPE_INT64, UPB_DESCRIPTOR_TYPE_UINT64,
+  UPB_DESCRIPTOR_TYPE_INT32, UPB_DESCRIPTOR_TYPE_FIXED64,
+  UPB_DESCRIPTOR_TYPE_FIXED32, UPB_DESCRIPTOR_TYPE_BOOL,
+  UPB_DESCRIPTOR_TYPE_UINT32, UPB_DESCRIPTOR_TYPE_ENUM,
+  UPB_DESCRIPTOR_TYPE_SFIXED32, UPB_DESCRIPTOR_TYPE_SFIXED64,
+  UPB_DESCRIPTOR_TYPE_SINT32, UPB_DESCRIPTOR_TYPE_SINT64,
+};
+
+upb::reffed_ptr<const upb::Handlers> NewSerializerTestHandlers(
+    bool hasbits) {
+  upb::reffed_ptr<const upb::MessageDef> md = NewMessageDef();
+  upb::reffed_ptr<upb::Handlers> h(upb::Handlers::New(md.get()));
+  int32_t arena_ofs = offsetof(SerializerTest, arena);
+  for (size_t i = 0; i < ARRAY_SIZE(serializer_scalars); i++) {
+    uint32_t fn = serializer_scalars[i];
+    ASSERT(upb::Shim::Set(h.get(), md->FindFieldByNumber(fn),
+                          offsetof(SerializerTest, vals) + fn * 8,
+                          hasbits ? SERIALIZERTEST_HASBIT(fn) : -1));
+  }
+  ASSERT(upb::Shim::SetStringView(
+      h.get(), md->FindFieldByNumber(UPB_DESCRIPTOR_TYPE_STRING),
+      offsetof(SerializerTest, str),
+      hasbits ? SERIALIZERTEST_HASBIT(UPB_DESCRIPTOR_TYPE_STRING) : -1,
+      arena_ofs));
+  ASSERT(upb::Shim::SetStringView(
+      h.get(), md->FindFieldByNumber(UPB_DESCRIPTOR_TYPE_BYTES),
+      offsetof(SerializerTest, bytes),
+      hasbits ? SERIALIZERTEST_HASBIT(UPB_DESCRIPTOR_TYPE_BYTES) : -1,
+      arena_ofs));
+  ASSERT(upb::Shim::SetArray(
+      h.get(), md->FindFieldByNumber(rep_fn(UPB_DESCRIPTOR_TYPE_INT32)),
+      offsetof(SerializerTest, ints), -1, arena_ofs));
+  ASSERT(upb::Shim::SetArray(
+      h.get(), md->FindFieldByNumber(rep_fn(UPB_DESCRIPTOR_TYPE_SINT64)),
+      offsetof(SerializerTest, sint64s), -1, arena_ofs));
+  ASSERT(upb::Shim::SetArray(
+      h.get(), md->FindFieldByNumber(rep_fn(UPB_DESCRIPTOR_TYPE_DOUBLE)),
+      offsetof(SerializerTest, doubles), -1, arena_ofs));
+  ASSERT(upb::Shim::SetArray(
+      h.get(), md->FindFieldByNumber(rep_fn(UPB_DESCRIPTOR_TYPE_BOOL)),
+      offsetof(SerializerTest, bools), -1, arena_ofs));
+  const upb::FieldDef* msg_f =
+      md->FindFieldByNumber(UPB_DESCRIPTOR_TYPE_MESSAGE);
+  ASSERT(upb::Shim::SetSubMessage(
+      h.get(), msg_f, offsetof(SerializerTest, child),
+      hasbits ? SERIALIZERTEST_HASBIT(UPB_DESCRIPTOR_TYPE_MESSAGE) : -1,
+      sizeof(SerializerTest), arena_ofs, arena_ofs));
+  ASSERT(upb_handlers_setsubhandlers(h.get(), msg_f, h.get()));
+  ASSERT(h->Freeze(NULL));
+  return upb::reffed_ptr<const upb::Handlers>(h.get());
+}
+
+template <class T>
+void setslot(SerializerTest* st, uint32_t fn, T val) {
+  memcpy(&st->vals[fn], &val, sizeof(val));
+  st->hasbits[fn / 8] |= 1 << (fn % 8);
+}
+
+// Fills in the scalars with one of a few sets of values: all zeros, the
+// extremes of every type, and values around the varint length boundaries.
+void setscalars(SerializerTest* st, int set) {
+  switch (set) {
+    case 0:
+      for (size_t i = 0; i < ARRAY_SIZE(serializer_scalars); i++) {
+        setslot<uint64_t>(st, serializer_scalars[i], 0);
+      }
+      break;
+    case 1:
+      setslot<double>  (st, UPB_DESCRIPTOR_TYPE_DOUBLE, -0.0);
+      setslot<float>   (st, UPB_DESCRIPTOR_TYPE_FLOAT, -1.5);
+      setslot<int64_t> (st, UPB_DESCRIPTOR_TYPE_INT64, INT64_MIN);
+      setslot<uint64_t>(st, UPB_DESCRIPTOR_TYPE_UINT64, UINT64_MAX);
+      setslot<int32_t> (st, UPB_DESCRIPTOR_TYPE_INT32, -1);
+      setslot<uint64_t>(st, UPB_DESCRIPTOR_TYPE_FIXED64, UINT64_MAX);
+      setslot<uint32_t>(st, UPB_DESCRIPTOR_TYPE_FIXED32, UINT32_MAX);
+      setslot<bool>    (st, UPB_DESCRIPTOR_TYPE_BOOL, true);
+      setslot<uint32_t>(st, UPB_DESCRIPTOR_TYPE_UINT32, UINT32_MAX);
+      setslot<int32_t> (st, UPB_DESCRIPTOR_TYPE_ENUM, INT32_MIN);
+      setslot<int32_t> (st, UPB_DESCRIPTOR_TYPE_SFIXED32, INT32_MIN);
+      setslot<int64_t> (st, UPB_DESCRIPTOR_TYPE_SFIXED64, INT64_MIN);
+      setslot<int32_t> (st, UPB_DESCRIPTOR_TYPE_SINT32, INT32_MIN);
+      setslot<int64_t> (st, UPB_DESCRIPTOR_TYPE_SINT64, INT64_MIN);
+      break;
+    case 2:
+      setslot<double>  (st, UPB_DESCRIPTOR_TYPE_DOUBLE, 0.5);
+      setslot<float>   (st, UPB_DESCRIPTOR_TYPE_FLOAT, 3.0);
+      setslot<int64_t> (st, UPB_DESCRIPTOR_TYPE_INT64, 1LL << 35);
+      setslot<uint64_t>(st, UPB_DESCRIPTOR_TYPE_UINT64, 127);
+      setslot<int32_t> (st, UPB_DESCRIPTOR_TYPE_INT32, 128);
+      setslot<uint64_t>(st, UPB_DESCRIPTOR_TYPE_FIXED64, 1);
+      setslot<uint32_t>(st, UPB_DESCRIPTOR_TYPE_FIXED32, 0x01020304);
+      setslot<bool>    (st, UPB_DESCRIPTOR_TYPE_BOOL, false);
+      setslot<uint32_t>(st, UPB_DESCRIPTOR_TYPE_UINT32, 16383);
+      setslot<int32_t> (st, UPB_DESCRIPTOR_TYPE_ENUM, 1);
+      setslot<int32_t> (st, UPB_DESCRIPTOR_TYPE_SFIXED32, -2);
+      setslot<int64_t> (st, UPB_DESCRIPTOR_TYPE_SFIXED64, 2);
+      setslot<int32_t> (st, UPB_DESCRIPTOR_TYPE_SINT32, -64);
+      setslot<int64_t> (st, UPB_DESCRIPTOR_TYPE_SINT64, 64);
+      break;
+  }
+}
+
+template <class T>
+void setarray(upb::Shim::Array* arr, T* vals, size_t n) {
+  arr->data = vals;
+  arr->len = n;
+  arr->size = n;
+}
+
+bool arrays_equal(const upb::Shim::Array& a, const upb::Shim::Array& b,
+                  size_t elemsize) {
+  return a.len == b.len &&
+         (a.len == 0 || memcmp(a.data, b.data, a.len * elemsize) == 0);
+}
+
+bool strviews_equal(const upb::Shim::StringView& a,
+                    const upb::Shim::StringView& b) {
+  return a.size == b.size &&
+         (a.size == 0 || memcmp(a.data, b.data, a.size) == 0);
+}
+
+bool serializer_tests_equal(const SerializerTest* a, const SerializerTest* b) {
+  if (!a || !b) return a == b;
+  return memcmp(a->hasbits, b->hasbits, sizeof(a->hasbits)) == 0 &&
+         memcmp(a->vals, b->vals, sizeof(a->vals)) == 0 &&
+         strviews_equal(a->str, b->str) &&
+         strviews_equal(a->bytes, b->bytes) &&
+         arrays_equal(a->ints, b->ints, sizeof(int32_t)) &&
+         arrays_equal(a->sint64s, b->sint64s, sizeof(int64_t)) &&
+         arrays_equal(a->doubles, b->doubles, sizeof(double)) &&
+         arrays_equal(a->bools, b->bools, sizeof(bool)) &&
+         serializer_tests_equal(a->child, b->child);
+}
+
+string serialize(const upb::pb::SerializerMethod* method, const void* msg) {
+  upb::pb::Serializer serializer;
+  upb::Status status;
+  string out;
+  upb::StringSink sink(&out);
+  ASSERT(serializer.Serialize(method, msg, sink.input(), &status));
+  ASSERT(status.ok());
+  return out;
+}
+
+// Serializes every field type with both the interpreter and (if allowjit)
+// the JIT, which must agree byte for byte, and checks that the output parses
+// back into the same struct.
+void test_serializer(bool allowjit) {
+  for (int hasbits = 0; hasbits < 2; hasbits++) {
+    upb::reffed_ptr<const upb::Handlers> h =
+        NewSerializerTestHandlers(hasbits);
+    upb::reffed_ptr<const upb::pb::DecoderMethod> decoder_method =
+        NewMethod(h.get(), false);
+
+    upb::pb::SerializerCache interpreted;
+    ASSERT(interpreted.allow_jit());
+    ASSERT(interpreted.set_allow_jit(false));
+    ASSERT(!interpreted.allow_jit());
+    upb::pb::SerializerCache cache;
+    ASSERT(cache.set_allow_jit(allowjit));
+
+    upb::Status status;
+    const upb::pb::SerializerMethod* interpreted_method =
+        interpreted.GetSerializerMethod(h.get(), &status);
+    const upb::pb::SerializerMethod* method =
+        cache.GetSerializerMethod(h.get(), &status);
+    ASSERT(interpreted_method && method);
+    ASSERT(!interpreted_method->is_native());
+#ifdef UPB_USE_JIT_X64
+    ASSERT(method->is_native() == allowjit);
+#else
+    ASSERT(!method->is_native());
+#endif
+    // Too late once methods have been compiled.
+    ASSERT(!cache.set_allow_jit(!allowjit));
+
+    int32_t ints[] = {0, 1, -1, 300, INT32_MAX, INT32_MIN};
+    int64_t sint64s[] = {INT64_MIN, -1, 0, 1, INT64_MAX};
+    double doubles[] = {0.5};
+    bool bools[] = {true, false, true};
+    string longstr(200, 'x');
+
+    for (int set = 0; set < 3; set++) {
+      SerializerTest grandchild, child, st;
+      memset(&grandchild, 0, sizeof(grandchild));
+      memset(&child, 0, sizeof(child));
+      memset(&st, 0, sizeof(st));
+      setscalars(&grandchild, (set + 2) % 3);
+      setscalars(&child, (set + 1) % 3);
+      setscalars(&st, set);
+
+      // Strings: empty, short and with a two byte length.
+      st.hasbits[UPB_DESCRIPTOR_TYPE_STRING / 8] |=
+          1 << (UPB_DESCRIPTOR_TYPE_STRING % 8);
+      st.str.data = set == 2 ? longstr.data() : "hello";
+      st.str.size = set == 0 ? 0 : (set == 1 ? 5 : longstr.size());
+      child.hasbits[UPB_DESCRIPTOR_TYPE_BYTES / 8] |=
+          1 << (UPB_DESCRIPTOR_TYPE_BYTES % 8);
+      child.bytes.data = "\0\1\2";
+      child.bytes.size = 3;
+
+      if (set > 0) {
+        setarray(&st.ints, ints, ARRAY_SIZE(ints));
+        setarray(&st.sint64s, sint64s, ARRAY_SIZE(sint64s));
+        setarray(&child.doubles, doubles, ARRAY_SIZE(doubles));
+        setarray(&grandchild.bools, bools, ARRAY_SIZE(bools));
+      }
+
+      st.child = &child;
+      child.child = &grandchild;
+      st.hasbits[UPB_DESCRIPTOR_TYPE_MESSAGE / 8] |=
+          1 << (UPB_DESCRIPTOR_TYPE_MESSAGE % 8);
+      child.hasbits[UPB_DESCRIPTOR_TYPE_MESSAGE / 8] |=
+          1 << (UPB_DESCRIPTOR_TYPE_MESSAGE % 8);
+
+      string out = serialize(method, &st);
+      ASSERT(out == serialize(interpreted_method, &st));
+
+      upb::Arena arena;
+      SerializerTest st2;
+      memset(&st2, 0, sizeof(st2));
+      st2.arena = &arena;
+      upb::pb::Decoder decoder(decoder_method.get(), &status);
+      upb::Sink sink(h.get(), &st2);
+      decoder.ResetOutput(&sink);
+      ASSERT(upb::BufferSource::PutBuffer(out, decoder.input()));
+      ASSERT(status.ok());
+
+      if (hasbits) {
+        ASSERT(serializer_tests_equal(&st, &st2));
+      } else {
+        // Without hasbits the decoder doesn't touch them, and only non-zero
+        // scalars and non-empty strings are written.
+        ASSERT(serialize(interpreted_method, &st2) == out);
+        ASSERT(memcmp(st.vals, st2.vals, sizeof(st.vals)) == 0);
+        if (set == 0) {
+          ASSERT(out.substr(0, 1) == tag(UPB_DESCRIPTOR_TYPE_MESSAGE,
+                                         UPB_WIRE_TYPE_DELIMITED));
+        }
+      }
+    }
+
+    // The nesting limit applies to native code too.
+    std::vector<SerializerTest> chain(UPB_PBENCODER_MAX_NESTING + 2);
+    memset(&chain[0], 0, chain.size() * sizeof(SerializerTest));
+    for (size_t i = 0; i + 1 < chain.size(); i++) {
+      chain[i].child = &chain[i + 1];
+      chain[i].hasbits[UPB_DESCRIPTOR_TYPE_MESSAGE / 8] |=
+          1 << (UPB_DESCRIPTOR_TYPE_MESSAGE % 8);
+    }
+    upb::pb::Serializer serializer;
+    string out;
+    upb::StringSink sink(&out);
+    ASSERT(!serializer.Serialize(method, &chain[0], sink.input(), &status));
+    ASSERT(!status.ok());
+    status.Clear();
+    ASSERT(serializer.Serialize(method, &chain[1], sink.input(), &status));
+  }
+}
+
+#if defined(UPB_USE_JIT_X64) && defined(__linux__)
+void test_jitdebug() {
+  upb::pb::CodeCache cache;
+  ASSERT(cache.set_jit_debug(UPB_JITDEBUG_PERFMAP | UPB_JITDEBUG_GDB));
+  ASSERT(cache.jit_debug() == (UPB_JITDEBUG_PERFMAP | UPB_JITDEBUG_GDB));
+  upb::reffed_ptr<const upb::pb::DecoderMethod> method =
+      cache.GetDecoderMethod(upb::pb::DecoderMethodOptions(global_handlers));
+  ASSERT(method->is_native());
+
+  // Too late to change it now.
+  ASSERT(!cache.set_jit_debug(0));
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+  FILE *f = fopen(path, "r");
+  ASSERT(f);
+  char line[512];
+  bool found_entry = false;
+  bool found_op = false;
+  while (fgets(line, sizeof(line), f)) {
+    unsigned long start, size;
+    char name[256];
+    ASSERT(sscanf(line, "%lx %lx %255s", &start, &size, name) == 3);
+    ASSERT(size > 0);
+    if (strcmp(name, "upb:enterjit") == 0) found_entry = true;
+    // Each bytecode op gets a label like "upb:<msg>.0x<pc>.OP_<name>".
+    if (strncmp(name, "upb:", 4) == 0 && strstr(name, ".0x") &&
+        strstr(name, ".OP_CHECKDELIM")) {
+      found_op = true;
+    }
+  }
+  fclose(f);
+  unlink(path);
+  ASSERT(found_entry);
+  ASSERT(found_op);
+}
+#endif
+
+#ifdef UPB_USE_JIT_X64
+// Decodes "proto" in two buffers split at "split", pausing in between to run
+// "between".
+string tiered_parse(const upb::pb::DecoderMethod* method, const string& proto,
+                    size_t split,
+                    void (*between)(const upb::pb::DecoderMethod*,
+                                    const string&)) {
+  upb::Status status;
+  upb::pb::Decoder decoder(method, &status);
+  upb::Sink sink(global_handlers, &closures[0]);
+  decoder.ResetOutput(&sink);
+  void *sub;
+  upb::BytesSink* input = decoder.input();
+  output.clear();
+  ASSERT(input->Start(proto.size(), &sub));
+  // A long byte count means the decoder skipped ahead.
+  size_t ofs = input->PutBuffer(sub, proto.c_str(), split, &global_handle);
+  ASSERT(ofs >= split);
+  string first = output;
+  if (between) between(method, proto);
+  output = first;
+  if (ofs < proto.size()) {
+    size_t len = proto.size() - ofs;
+    ASSERT(input->PutBuffer(sub, proto.c_str() + ofs, len, &global_handle) >=
+           len);
+  }
+  ASSERT(input->End());
+  ASSERT(status.ok());
+  return output;
+}
+
+string tiered_parse(const upb::pb::DecoderMethod* method, const string& proto,
+                    void (*between)(const upb::pb::DecoderMethod*,
+                                    const string&)) {
+  return tiered_parse(method, proto, proto.size() / 2, between);
+}
+
+string tiered_parse(const upb::pb::DecoderMethod* method,
+                    const string& proto) {
+  return tiered_parse(method, proto, NULL);
+}
+
+// Makes the method hot and waits until it has been compiled.
+void tiered_heatup(const upb::pb::DecoderMethod* method, const string& proto) {
+  tiered_parse(method, proto);
+  int i;
+  for (i = 0; i < 10000 && !method->is_native(); i++) {
+    usleep(1000);
+  }
+  ASSERT(method->is_native());
+}
+
+void test_tiered(bool background) {
+  upb::pb::CodeCache cache;
+  ASSERT(cache.set_tiered(true));
+  ASSERT(cache.set_tier_thresholds(3, UINT64_MAX));
+  ASSERT(cache.set_background_compile(background));
+  upb::reffed_ptr<const upb::pb::DecoderMethod> method =
+      cache.GetDecoderMethod(upb::pb::DecoderMethodOptions(global_handlers));
+  ASSERT(cache.tiered());
+  ASSERT(!cache.set_tiered(false));
+
+  string proto = cat(
+      tag(UPB_DESCRIPTOR_TYPE_INT32, UPB_WIRE_TYPE_VARINT), varint(1),
+      submsg(UPB_DESCRIPTOR_TYPE_MESSAGE,
+             cat( tag(UPB_DESCRIPTOR_TYPE_INT64, UPB_WIRE_TYPE_VARINT),
+                  varint(12345678901LL) )),
+      tag(UPB_DESCRIPTOR_TYPE_STRING, UPB_WIRE_TYPE_DELIMITED),
+      delim("abcdefgh"));
+
+  // Cold: bytecode.
+  string expected = tiered_parse(method.get(), proto);
+  ASSERT(!method->is_native());
+
+  // The second stream is still on bytecode when it starts, and stays there
+  // even though the third stream makes the method hot while it is paused.
+  ASSERT(tiered_parse(method.get(), proto, &tiered_heatup) == expected);
+
+  // Hot: machine code.
+  ASSERT(method->is_native());
+  ASSERT(tiered_parse(method.get(), proto) == expected);
+}
+
+// Like tiered_heatup(), but for a method that only gets hot by bytes: the
+// first stream pushes the byte count over the threshold, and the second
+// notices at its start.
+void tiered_heatup_bytes(const upb::pb::DecoderMethod* method,
+                         const string& proto) {
+  ASSERT(!method->is_native());
+  tiered_parse(method, proto);
+  tiered_heatup(method, proto);
+}
+
+// Tiers up while a stream is paused at every possible point in the input,
+// including mid-varint, mid-tag, and inside submessages and strings.
+void test_tiered_midstream(bool background) {
+  string proto = cat(
+      tag(UPB_DESCRIPTOR_TYPE_INT32, UPB_WIRE_TYPE_VARINT), varint(1),
+      submsg(UPB_DESCRIPTOR_TYPE_MESSAGE,
+             cat( tag(UPB_DESCRIPTOR_TYPE_INT64, UPB_WIRE_TYPE_VARINT),
+                  varint(12345678901LL),
+                  tag(UPB_DESCRIPTOR_TYPE_STRING, UPB_WIRE_TYPE_DELIMITED),
+                  delim("xyz") )),
+      tag(rep_fn(UPB_DESCRIPTOR_TYPE_DOUBLE), UPB_WIRE_TYPE_DELIMITED),
+      delim(cat( dbl(1.5), dbl(2.5) )),
+      tag(UPB_DESCRIPTOR_TYPE_STRING, UPB_WIRE_TYPE_DELIMITED),
+      delim("abcdefgh"));
+
+  string expected;
+  size_t split;
+  for (split = 1; split < proto.size(); split++) {
+    upb::pb::CodeCache cache;
+    ASSERT(cache.set_tiered(true));
+    ASSERT(cache.set_tier_thresholds(UINT64_MAX, proto.size()));
+    ASSERT(cache.set_background_compile(background));
+    upb::reffed_ptr<const upb::pb::DecoderMethod> method =
+        cache.GetDecoderMethod(upb::pb::DecoderMethodOptions(global_handlers));
+
+    // The stream started on bytecode, so it finishes there.
+    string out =
+        tiered_parse(method.get(), proto, split, &tiered_heatup_bytes);
+    if (expected.empty()) expected = out;
+    ASSERT(out == expected);
+
+    // The next stream runs the machine code, split at the same point.
+    ASSERT(method->is_native());
+    ASSERT(tiered_parse(method.get(), proto, split, NULL) == expected);
+  }
+}
+#endif
+
 void run_tests(bool use_jit) {
   upb::reffed_ptr<const upb::pb::DecoderMethod> method;
   upb::reffed_ptr<const upb::Handlers> handlers;
@@ -1167,6 +1979,21 @@ void run_tests(bool use_jit) {
   test_valid();
 
   test_emptyhandlers(false);
+  test_sizehints(use_jit);
+  test_stats(use_jit);
+  test_shims(use_jit);
+  test_serializer(use_jit);
+#ifdef UPB_USE_JIT_X64
+  if (use_jit) {
+#ifdef __linux__
+    test_jitdebug();
+#endif
+    test_tiered(false);
+    test_tiered(true);
+    test_tiered_midstream(false);
+    test_tiered_midstream(true);
+  }
+#endif
 }
 
 void run_test_suite() {
@@ -1177,11 +2004,172 @@ void run_test_suite() {
 #endif
 }
 
+/* Benchmarks ****************************************************************/
+
+#define CPU_TIME_PER_TEST 0.5
+
+double get_usertime() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + (usage.ru_utime.tv_usec/1000000.0);
+}
+
+template <class T>
+bool sum_value(uint64_t* sum, T val) {
+  *sum += static_cast<uint64_t>(val);
+  return true;
+}
+
+template <class T>
+void regsum(upb::Handlers* h, uint32_t num) {
+  const upb::FieldDef* f = h->message_def()->FindFieldByNumber(num);
+  ASSERT(f);
+  ASSERT(h->SetValueHandler<T>(f, UpbMakeHandlerT(sum_value<T>)));
+}
+
+// Decoding of many small scalar fields that all have (cheap) handlers, where
+// the cost of calling out to the handlers is a big part of the work.
+void benchmark_decode_handlers() {
+  upb::reffed_ptr<upb::Handlers> h(upb::Handlers::New(NewMessageDef().get()));
+  regsum<double>  (h.get(), UPB_DESCRIPTOR_TYPE_DOUBLE);
+  regsum<int64_t> (h.get(), UPB_DESCRIPTOR_TYPE_INT64);
+  regsum<int32_t> (h.get(), UPB_DESCRIPTOR_TYPE_INT32);
+  regsum<uint32_t>(h.get(), UPB_DESCRIPTOR_TYPE_FIXED32);
+  regsum<bool>    (h.get(), UPB_DESCRIPTOR_TYPE_BOOL);
+  regsum<uint32_t>(h.get(), UPB_DESCRIPTOR_TYPE_UINT32);
+  regsum<int64_t> (h.get(), UPB_DESCRIPTOR_TYPE_SINT64);
+  ASSERT(h->Freeze(NULL));
+
+  string proto;
+  size_t fields = 0;
+  srand(1);
+  while (proto.size() < 1 << 20) {
+    switch (rand() % 7) {
+      case 0:
+        proto += cat( tag(UPB_DESCRIPTOR_TYPE_DOUBLE, UPB_WIRE_TYPE_64BIT),
+                      dbl(rand() / 3.0) );
+        break;
+      case 1:
+        proto += cat( tag(UPB_DESCRIPTOR_TYPE_INT64, UPB_WIRE_TYPE_VARINT),
+                      varint((uint64_t)rand() << 20) );
+        break;
+      case 2:
+        proto += cat( tag(UPB_DESCRIPTOR_TYPE_INT32, UPB_WIRE_TYPE_VARINT),
+                      varint(rand() % 1000) );
+        break;
+      case 3:
+        proto += cat( tag(UPB_DESCRIPTOR_TYPE_FIXED32, UPB_WIRE_TYPE_32BIT),
+                      uint32(rand()) );
+        break;
+      case 4:
+        proto += cat( tag(UPB_DESCRIPTOR_TYPE_BOOL, UPB_WIRE_TYPE_VARINT),
+                      varint(rand() % 2) );
+        break;
+      case 5:
+        proto += cat( tag(UPB_DESCRIPTOR_TYPE_UINT32, UPB_WIRE_TYPE_VARINT),
+                      varint(rand() % 100) );
+        break;
+      case 6:
+        proto += cat( tag(UPB_DESCRIPTOR_TYPE_SINT64, UPB_WIRE_TYPE_VARINT),
+                      zz64(rand() - RAND_MAX / 2) );
+        break;
+    }
+    fields++;
+  }
+
+  for (int jit = 0; jit < 2; jit++) {
+    upb::reffed_ptr<const upb::pb::DecoderMethod> method =
+        NewMethod(h.get(), jit);
+    if (jit && !method->is_native()) break;
+
+    upb::Status status;
+    upb::pb::Decoder decoder(method.get(), &status);
+    uint64_t sum = 0;
+    upb::Sink sink(h.get(), &sum);
+    decoder.ResetOutput(&sink);
+
+    size_t n = 0;
+    double before = get_usertime();
+    do {
+      decoder.Reset();
+      ASSERT(upb::BufferSource::PutBuffer(proto, decoder.input()));
+      n++;
+    } while (get_usertime() - before < CPU_TIME_PER_TEST);
+    double elapsed = get_usertime() - before;
+    ASSERT(sum != 0);
+    printf("Decode scalars with handlers (%s): %.1f MB/s, %.1f M fields/s\n",
+           jit ? "JIT" : "bytecode", n * proto.size() / elapsed / 1e6,
+           n * fields / elapsed / 1e6);
+    if (upb::pb::Decoder::HasStats()) {
+      char buf[256];
+      upb_pbdecoder_stats totals;
+      method->GetStats(&totals);
+      upb_pbdecoder_printstats(&totals, buf, sizeof(buf));
+      printf("  %s\n", buf);
+    }
+  }
+}
+
+// Serializing a struct of mostly scalars, where the per-field dispatch of the
+// interpreter is a big part of the work.
+void benchmark_serialize() {
+  upb::reffed_ptr<const upb::Handlers> h = NewSerializerTestHandlers(true);
+  SerializerTest grandchild, child, st;
+  memset(&grandchild, 0, sizeof(grandchild));
+  memset(&child, 0, sizeof(child));
+  memset(&st, 0, sizeof(st));
+  setscalars(&grandchild, 2);
+  setscalars(&child, 1);
+  setscalars(&st, 2);
+  st.hasbits[UPB_DESCRIPTOR_TYPE_STRING / 8] |=
+      1 << (UPB_DESCRIPTOR_TYPE_STRING % 8);
+  st.str.data = "hello, world";
+  st.str.size = 12;
+  st.child = &child;
+  child.child = &grandchild;
+  st.hasbits[UPB_DESCRIPTOR_TYPE_MESSAGE / 8] |=
+      1 << (UPB_DESCRIPTOR_TYPE_MESSAGE % 8);
+  child.hasbits[UPB_DESCRIPTOR_TYPE_MESSAGE / 8] |=
+      1 << (UPB_DESCRIPTOR_TYPE_MESSAGE % 8);
+
+  for (int jit = 0; jit < 2; jit++) {
+    upb::pb::SerializerCache cache;
+    cache.set_allow_jit(jit);
+    upb::Status status;
+    const upb::pb::SerializerMethod* method =
+        cache.GetSerializerMethod(h.get(), &status);
+    ASSERT(method);
+    if (jit && !method->is_native()) break;
+
+    upb::pb::Serializer serializer;
+    string out;
+    upb::StringSink sink(&out);
+
+    size_t n = 0, bytes = 0;
+    double before = get_usertime();
+    do {
+      for (int i = 0; i < 1000; i++) {
+        out.clear();
+        ASSERT(serializer.Serialize(method, &st, sink.input(), &status));
+        bytes += out.size();
+      }
+      n += 1000;
+    } while (get_usertime() - before < CPU_TIME_PER_TEST);
+    double elapsed = get_usertime() - before;
+    printf("Serialize struct (%s): %.1f MB/s, %.2f M msgs/s\n",
+           jit ? "JIT" : "interpreted", bytes / elapsed / 1e6,
+           n / elapsed / 1e6);
+  }
+}
+
 extern "C" {
 
 int run_tests(int argc, char *argv[]) {
-  if (argc > 1)
+  if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+    benchmark = true;
+  } else if (argc > 1) {
     filter_hash = strtol(argv[1], NULL, 16);
+  }
   for (int i = 0; i < UPB_DECODER_MAX_NESTING; i++) {
     closures[i] = i;
   }
@@ -1204,6 +2192,11 @@ int run_tests(int argc, char *argv[]) {
   test_mode = ALL_HANDLERS;
   run_test_suite();
 
+  if (benchmark) {
+    benchmark_decode_handlers();
+    benchmark_serialize();
+  }
+
   printf("All tests passed, %d assertions.\n", num_assertions);
   return 0;
 }
@@ -1117,6 +1117,98 @@ void TestHandlerDataDestruction() {
   ASSERT(x == 0);
 }
 
+static void DecrementInt(void* p) { --*static_cast<int*>(p); }
+
+void TestArena() {
+  int x = 0;
+  char seed[100];
+  {
+    upb::Arena arena(seed, sizeof(seed), NULL);
+    upb::Allocator* a = arena.allocator();
+
+    // The first allocation comes out of the seed block.
+    char* p = static_cast<char*>(a->Malloc(10));
+    ASSERT(p >= seed && p < seed + sizeof(seed));
+    memset(p, 'x', 10);
+
+    // The most recent allocation grows in place if there is room, and is
+    // copied elsewhere otherwise.
+    char* q = static_cast<char*>(a->Realloc(p, 10, 20));
+    ASSERT(q == p);
+    q = static_cast<char*>(a->Realloc(q, 20, 1000));
+    ASSERT(q != p);
+    ASSERT(memcmp(q, "xxxxxxxxxx", 10) == 0);
+    a->Free(q);  // A no-op.
+
+    // Lots of small and large allocations, all of which must be distinct and
+    // writable.
+    std::set<char*> seen;
+    for (int i = 0; i < 1000; i++) {
+      size_t size = (i % 10 == 0) ? 100000 : i % 64 + 1;
+      char* mem = static_cast<char*>(a->Malloc(size));
+      ASSERT(mem);
+      ASSERT(reinterpret_cast<uintptr_t>(mem) % 8 == 0);
+      memset(mem, i, size);
+      AssertInsert(&seen, mem);
+    }
+
+    ASSERT(arena.BytesAllocated() >= 100 * 100000);
+    ASSERT(arena.AddCleanup(&DecrementInt, &x));
+    ASSERT(arena.AddCleanup(&DecrementInt, &x));
+    x = 2;
+  }
+
+  ASSERT(x == 0);
+}
+
+// An allocator that counts the blocks it has handed out and not yet freed,
+// and gets them from the heap.
+struct CountingAllocator {
+  upb_alloc alloc;  // Must be first.
+  int live;
+};
+
+static void* CountingAllocFunc(upb_alloc* alloc, void* ptr, size_t oldsize,
+                               size_t size) {
+  CountingAllocator* a = reinterpret_cast<CountingAllocator*>(alloc);
+  if (!ptr && size) a->live++;
+  if (ptr && !size) a->live--;
+  return upb_realloc(&upb_alloc_global, ptr, oldsize, size);
+}
+
+// The descriptor reader's scratch strings and def array come from its
+// allocator; the defs themselves don't.
+void TestReaderAllocator(const char *descriptor_file) {
+  size_t len;
+  char* data = upb_readfile(descriptor_file, &len);
+  ASSERT(data);
+  const upb_handlers* reader_h = upb_descreader_newhandlers(&reader_h);
+  upb::pb::CodeCache cache;
+  const upb::pb::DecoderMethod* method =
+      cache.GetDecoderMethod(upb::pb::DecoderMethodOptions(reader_h));
+  CountingAllocator counting = {{&CountingAllocFunc}, 0};
+  int n;
+  upb::Def** defs;
+  {
+    upb::Status status;
+    upb::descriptor::Reader reader(reader_h, &status);
+    reader.SetAllocator(&counting.alloc);
+    upb::pb::Decoder decoder(method, &status);
+    decoder.ResetOutput(reader.input());
+    ASSERT(upb::BufferSource::PutBuffer(data, len, decoder.input()));
+    defs = reader.GetDefs(&defs, &n);
+    ASSERT(n > 0);
+    ASSERT(counting.live > 0);
+
+    upb::reffed_ptr<upb::SymbolTable> s(upb::SymbolTable::New());
+    ASSERT(s->Add(defs, n, &defs, &status));
+    ASSERT(s->LookupMessage("C"));
+  }
+  ASSERT(counting.live == 0);
+  upb_handlers_unref(reader_h, &reader_h);
+  free(data);
+}
+
 extern "C" {
 
 int run_tests(int argc, char *argv[]) {
@@ -1125,6 +1217,7 @@ int run_tests(int argc, char *argv[]) {
     return 1;
   }
   TestSymbolTable(argv[1]);
+  TestReaderAllocator(argv[1]);
   TestCastsUpDown();
   TestCasts1();
   TestCasts2();
@@ -1172,6 +1265,7 @@ int run_tests(int argc, char *argv[]) {
   TestMismatchedTypes();
 
   TestHandlerDataDestruction();
+  TestArena();
 
   return 0;
 }
@@ -8,6 +8,7 @@
  */
 
 #include "upb/def.h"
+#include "upb/descriptor/descriptor.upb.h"
 #include "upb/pb/glue.h"
 #include "upb_test.h"
 #include <stdlib.h>
@@ -342,12 +343,161 @@ static void test_descriptor_flags() {
   upb_msgdef_unref(m2, &m2);
 }
 
+static void test_freeze_compacts_tables() {
+  upb_msgdef *m = upb_msgdef_newnamed("Big", &m);
+  upb_enumdef *e = upb_enumdef_newnamed("BigEnum", &e);
+  for (int i = 1; i <= 100; i++) {
+    char name[32];
+    sprintf(name, "field_%d", i);
+    upb_fielddef *f = upb_fielddef_new(&f);
+    upb_fielddef_settype(f, UPB_TYPE_INT32);
+    ASSERT(upb_fielddef_setnumber(f, i, NULL));
+    ASSERT(upb_fielddef_setname(f, name, NULL));
+    ASSERT(upb_msgdef_addfield(m, f, &f, NULL));
+    sprintf(name, "VALUE_%d", i);
+    ASSERT(upb_enumdef_addval(e, name, i, NULL));
+  }
+  size_t ntof_bytes = upb_strtable_bytes(&m->ntof);
+  size_t ntoi_bytes = upb_strtable_bytes(&e->ntoi);
+
+  upb_def *defs[] = {UPB_UPCAST(m), UPB_UPCAST(e)};
+  ASSERT(upb_def_freeze(defs, 2, NULL));
+
+  // The tables shrink, and the keys fill their block exactly.
+  ASSERT(upb_strtable_bytes(&m->ntof) < ntof_bytes);
+  ASSERT(upb_strtable_bytes(&e->ntoi) < ntoi_bytes);
+  ASSERT(m->ntof.keys_ptr == m->ntof.keys_end);
+  ASSERT(e->ntoi.keys_ptr == e->ntoi.keys_end);
+
+  for (int i = 1; i <= 100; i++) {
+    char name[32];
+    sprintf(name, "field_%d", i);
+    const upb_fielddef *f = upb_msgdef_ntofz(m, name);
+    ASSERT(f && upb_fielddef_number(f) == (uint32_t)i);
+    sprintf(name, "VALUE_%d", i);
+    int32_t num;
+    ASSERT(upb_enumdef_ntoiz(e, name, &num) && num == i);
+  }
+  ASSERT(!upb_msgdef_ntofz(m, "field_0"));
+
+  upb_msgdef_unref(m, &m);
+  upb_enumdef_unref(e, &e);
+}
+
+// Returns the hash that "t" uses for the key "str".
+static uint32_t strtable_hash(const upb_strtable *t, const char *str,
+                              size_t len) {
+  switch (t->hashfn) {
+    case UPB_HASH_MURMUR2:
+      return MurmurHash2(str, len, 0);
+    case UPB_HASH_WYHASH:
+      return upb_wyhash(str, len, 0);
+#ifdef UPB_HAVE_CRC32C
+    case UPB_HASH_CRC32C:
+      return upb_crc32chash(str, len, 0);
+#endif
+    default:
+      ASSERT(false);
+      return 0;
+  }
+}
+
+// Checks the cached hash of every entry of a statically-initialized table
+// against its key, and that lookups find every key.
+static void check_static_strtable(const upb_strtable *t) {
+  ASSERT(t->t.entries);
+  size_t count = 0;
+  for (size_t i = 0; i < upb_table_size(&t->t); i++) {
+    const upb_tabent *e = &t->t.entries[i];
+    if (upb_tabent_isempty(e)) continue;
+    size_t len;
+    const char *str = upb_tabstr(e->key, &len);
+    ASSERT(str[len] == '\0');
+    ASSERT(e->hash == strtable_hash(t, str, len));
+    ASSERT(upb_strtable_lookup2(t, str, len, NULL));
+    count++;
+  }
+  ASSERT(count == upb_strtable_count(t));
+}
+
+// The hashes in descriptor.upb.c are generated along with the rest of it, so
+// they have to match what the table would compute.
+static void test_static_hashes() {
+  const upb_symtab *s = upbdefs_google_protobuf_descriptor(&s);
+  check_static_strtable(&s->symtab);
+
+  upb_symtab_iter i;
+  for (upb_symtab_begin(&i, s, UPB_DEF_ANY); !upb_symtab_done(&i);
+       upb_symtab_next(&i)) {
+    const upb_def *def = upb_symtab_iter_def(&i);
+    const upb_msgdef *m = upb_dyncast_msgdef(def);
+    const upb_enumdef *e = upb_dyncast_enumdef(def);
+    if (m) check_static_strtable(&m->ntof);
+    if (e) check_static_strtable(&e->ntoi);
+  }
+  upb_symtab_unref(s, &s);
+}
+
+// Returns the memory of the name table of "def", if it has one.
+static size_t name_table_bytes(const upb_def *def) {
+  const upb_msgdef *m = upb_dyncast_msgdef(def);
+  const upb_enumdef *e = upb_dyncast_enumdef(def);
+  if (m) return upb_strtable_bytes(&m->ntof);
+  if (e) return upb_strtable_bytes(&e->ntoi);
+  return 0;
+}
+
+// Reports how much freezing shrinks the string tables of the defs in
+// descriptor.proto and of their symtab.  tests/descriptor.proto.pb is generated
+// with protoc, so we skip this if it hasn't been built.
+static void benchmark_freeze_compaction() {
+  size_t len;
+  char *data = upb_readfile("tests/descriptor.proto.pb", &len);
+  if (!data) {
+    printf("Skipping freeze benchmark: can't read tests/descriptor.proto.pb\n");
+    return;
+  }
+  int n;
+  upb_status status = UPB_STATUS_INIT;
+  upb_def **defs = upb_load_defs_from_descriptor(data, len, &n, &defs, &status);
+  free(data);
+  ASSERT(defs);
+
+  size_t defs_before = 0;
+  for (int i = 0; i < n; i++) {
+    defs_before += name_table_bytes(defs[i]);
+  }
+
+  // Adding the defs resolves and freezes them.
+  upb_symtab *s = upb_symtab_new(&s);
+  ASSERT(upb_symtab_add(s, defs, n, &defs, &status));
+  free(defs);
+  size_t symtab_before = upb_strtable_bytes(&s->symtab);
+  upb_symtab_freeze(s);
+
+  size_t defs_after = 0;
+  upb_symtab_iter i;
+  for (upb_symtab_begin(&i, s, UPB_DEF_ANY); !upb_symtab_done(&i);
+       upb_symtab_next(&i)) {
+    defs_after += name_table_bytes(upb_symtab_iter_def(&i));
+  }
+  printf("descriptor.proto name tables (%d defs): %zu -> %zu bytes frozen\n",
+         n, defs_before, defs_after);
+  printf("descriptor.proto symtab: %zu -> %zu bytes frozen\n",
+         symtab_before, upb_strtable_bytes(&s->symtab));
+  upb_symtab_unref(s, &s);
+}
+
 int run_tests(int argc, char *argv[]) {
   if (argc < 2) {
-    fprintf(stderr, "Usage: test_def <test.proto.pb>\n");
+    fprintf(stderr, "Usage: test_def <test.proto.pb> [--benchmark]\n");
     return 1;
   }
   descriptor_file = argv[1];
+  bool benchmark = false;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--benchmark") == 0) benchmark = true;
+  }
   test_empty_symtab();
   test_cycles();
   test_symbol_resolution();
@@ -358,5 +508,10 @@ int run_tests(int argc, char *argv[]) {
   test_partial_freeze();
   test_noreftracking();
   test_descriptor_flags();
+  test_freeze_compacts_tables();
+  test_static_hashes();
+  if (benchmark) {
+    benchmark_freeze_compaction();
+  }
   return 0;
 }
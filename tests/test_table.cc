@@ -7,6 +7,7 @@
  */
 
 #include <limits.h>
+#include <math.h>
 #include <string.h>
 #include <sys/resource.h>
 #include <ext/hash_map>
@@ -21,6 +22,7 @@
 
 bool benchmark = false;
 #define CPU_TIME_PER_TEST 0.5
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
 
 using std::vector;
 
@@ -304,6 +306,325 @@ void test_delete() {
   upb_inttable_uninit(&t);
 }
 
+// Removing the head of a chain moves the next entry into its slot; the key
+// that the table frees must still be the removed one.  Each removal is followed
+// by an insert of the same length, which tends to reuse whatever was freed.
+void test_remove_chain_head() {
+  upb_strtable t;
+  upb_strtable_init(&t, UPB_CTYPE_INT32);
+  std::set<std::string> live;
+  for (int i = 0; i < 64; i++) {
+    char key[32];
+    sprintf(key, "google.protobuf.Key%03d", i);
+    ASSERT(upb_strtable_insert(&t, key, upb_value_int32(i)));
+    live.insert(key);
+  }
+
+  for (int i = 0; i < 64; i++) {
+    char key[32];
+    sprintf(key, "google.protobuf.Key%03d", i);
+    upb_value v;
+    ASSERT(upb_strtable_remove(&t, key, &v));
+    ASSERT(upb_value_getint32(v) == i);
+    live.erase(key);
+    sprintf(key, "google.protobuf.New%03d", i);
+    ASSERT(upb_strtable_insert(&t, key, upb_value_int32(i + 64)));
+    live.insert(key);
+
+    std::set<std::string>::iterator it;
+    for (it = live.begin(); it != live.end(); ++it) {
+      ASSERT(upb_strtable_lookup(&t, it->c_str(), &v));
+    }
+    size_t count = 0;
+    upb_strtable_iter iter;
+    for (upb_strtable_begin(&iter, &t); !upb_strtable_done(&iter);
+         upb_strtable_next(&iter), count++) {
+      ASSERT(live.count(upb_strtable_iter_key(&iter)) == 1);
+    }
+    ASSERT(count == live.size());
+  }
+
+  upb_strtable_uninit(&t);
+}
+
+// Many rounds of inserts and removes with a steady number of entries, which
+// must not make the tables grow without bound.
+void test_churn() {
+  upb_strtable strtab;
+  upb_inttable inttab;
+  upb_strtable_init(&strtab, UPB_CTYPE_INT32);
+  upb_inttable_init(&inttab, UPB_CTYPE_INT32);
+  std::map<std::string, int32_t> m;
+
+  for (int32_t i = 0; i < 20000; i++) {
+    char key[32];
+    sprintf(key, "google.protobuf.Churn%d", i);
+    ASSERT(upb_strtable_insert(&strtab, key, upb_value_int32(i)));
+    ASSERT(upb_inttable_insert(&inttab, 1000 + i * 7, upb_value_int32(i)));
+    m[key] = i;
+    if (i >= 50) {
+      int32_t old = i - 50;
+      sprintf(key, "google.protobuf.Churn%d", old);
+      upb_value v;
+      ASSERT(upb_strtable_remove(&strtab, key, &v));
+      ASSERT(upb_value_getint32(v) == old);
+      ASSERT(upb_inttable_remove(&inttab, 1000 + old * 7, &v));
+      ASSERT(upb_value_getint32(v) == old);
+      m.erase(key);
+    }
+  }
+
+  ASSERT(upb_strtable_count(&strtab) == 50);
+  ASSERT(upb_inttable_count(&inttab) == 50);
+  ASSERT(strtab.t.size_lg2 <= 8);
+  ASSERT(inttab.t.size_lg2 <= 8);
+  // The space of removed keys is reclaimed too.
+  ASSERT(strtab.keys_used - strtab.keys_dead <= 50 * 32);
+  ASSERT(strtab.keys_used <= 4 * 50 * 32);
+
+  size_t count = 0;
+  upb_strtable_iter i;
+  for (upb_strtable_begin(&i, &strtab); !upb_strtable_done(&i);
+       upb_strtable_next(&i), count++) {
+    std::map<std::string, int32_t>::iterator it =
+        m.find(upb_strtable_iter_key(&i));
+    ASSERT(it != m.end());
+    ASSERT(upb_value_getint32(upb_strtable_iter_value(&i)) == it->second);
+  }
+  ASSERT(count == 50);
+  for (int32_t k = 0; k < 20000; k++) {
+    upb_value v;
+    bool found = upb_inttable_lookup32(&inttab, 1000 + k * 7, &v);
+    ASSERT(found == (k >= 20000 - 50));
+    if (found) ASSERT(upb_value_getint32(v) == k);
+  }
+
+  upb_strtable_uninit(&strtab);
+  upb_inttable_uninit(&inttab);
+}
+
+#ifdef UPB_USE_SWISSTABLE
+#define LAYOUT "open addressing"
+#else
+#define LAYOUT "chained"
+#endif
+
+// Runs "lookup" on keys[i % n] (with "n" a power of two) for
+// CPU_TIME_PER_TEST seconds and prints the rate.
+template <class T, class F>
+void time_lookups(const char *desc, const vector<T>& keys, F lookup) {
+  printf("%s (" LAYOUT "): ", desc);
+  fflush(stdout);
+  const size_t mask = keys.size() - 1;
+  int time_mask = 0xffff;
+  size_t x = 0;
+  double before = get_usertime();
+  unsigned int i;
+  for (i = 0; true; i++) {
+    MAYBE_BREAK;
+    x += lookup(keys[i & mask]);
+  }
+  double total = get_usertime() - before;
+  if (x == SIZE_MAX) abort();
+  printf("%s/s\n", eng(i / total, 3, false));
+}
+
+struct StrLookup {
+  const upb_strtable *t;
+  bool operator()(const std::string& key) const {
+    upb_value v;
+    return upb_strtable_lookup2(t, key.data(), key.size(), &v);
+  }
+};
+
+struct IntLookup {
+  const upb_inttable *t;
+  bool operator()(uint32_t key) const {
+    upb_value v;
+    return upb_inttable_lookup32(t, key, &v);
+  }
+};
+
+// Lookups in the hash part of the tables where every key is found, and where
+// none are.  The string keys are like the fully-qualified names in a symtab,
+// with long shared prefixes.
+void benchmark_hash_lookups() {
+  printf("Hash lookups, 1024 keys ====\n");
+  vector<std::string> names, missing_names;
+  upb_strtable strtab;
+  upb_strtable_init(&strtab, UPB_CTYPE_INT32);
+  for (int i = 0; i < 1024; i++) {
+    char name[64];
+    sprintf(name, "google.protobuf.test.Message%d.field_%d", i / 8, i % 8);
+    names.push_back(name);
+    upb_strtable_insert(&strtab, name, upb_value_int32(i));
+    sprintf(name, "google.protobuf.test.Message%d.field_%d", i / 8, i % 8 + 8);
+    missing_names.push_back(name);
+  }
+  StrLookup str_lookup = {&strtab};
+  time_lookups("upb_strtable(hit)", names, str_lookup);
+  time_lookups("upb_strtable(miss)", missing_names, str_lookup);
+  upb_strtable_uninit(&strtab);
+
+  // Sparse keys, which all go in the hash part.
+  vector<uint32_t> keys, missing_keys;
+  upb_inttable inttab;
+  upb_inttable_init(&inttab, UPB_CTYPE_INT32);
+  srandom(1);
+  while (keys.size() < 1024) {
+    uint32_t key = (random() & 0x3fffffff) + 0x10000;
+    upb_value v;
+    if (upb_inttable_lookup(&inttab, key, &v)) continue;
+    upb_inttable_insert(&inttab, key, upb_value_int32(0));
+    keys.push_back(key);
+    missing_keys.push_back(key | 0x40000000);
+  }
+  upb_inttable_compact(&inttab);
+  IntLookup int_lookup = {&inttab};
+  time_lookups("upb_inttable(hit)", keys, int_lookup);
+  time_lookups("upb_inttable(miss)", missing_keys, int_lookup);
+  upb_inttable_uninit(&inttab);
+  printf("\n");
+}
+
+// Names like those in the symtab and the name tables of a large schema:
+// fully-qualified message names in a few packages, with their fields and enum
+// values.  So there are long shared prefixes, and many names that differ only
+// in a digit or in their last few characters.
+vector<std::string> get_symbol_names(size_t n) {
+  static const char *packages[] = {
+    "google.protobuf", "google.api", "com.example.ads.v3",
+    "org.apache.beam.model.pipeline.v1",
+  };
+  static const char *messages[] = {
+    "Request", "Response", "Options", "Descriptor", "Config", "Status",
+    "Metadata", "Entry", "Spec", "Info",
+  };
+  static const char *fields[] = {
+    "id", "name", "type", "value", "options", "create_time", "update_time",
+    "parent", "page_size", "page_token", "field_mask", "labels",
+  };
+  vector<std::string> names;
+  char buf[128];
+  for (int i = 0; names.size() < n; i++) {
+    const char *package = packages[i % ARRAY_SIZE(packages)];
+    int m = i / ARRAY_SIZE(packages);
+    sprintf(buf, "%s.%s%d", package, messages[m % ARRAY_SIZE(messages)],
+            m / (int)ARRAY_SIZE(messages));
+    std::string message = buf;
+    names.push_back(message);
+    for (size_t j = 0; j < ARRAY_SIZE(fields); j++) {
+      names.push_back(message + "." + fields[j]);
+    }
+    for (int j = 0; j < 4; j++) {
+      sprintf(buf, ".Kind.KIND_%d", j);
+      names.push_back(message + buf);
+    }
+  }
+  names.resize(n);
+  return names;
+}
+
+typedef uint32_t hashfunc(const char *str, size_t len);
+
+uint32_t murmur2(const char *str, size_t len) {
+  return MurmurHash2(str, len, 0);
+}
+uint32_t wyhash(const char *str, size_t len) {
+  return upb_wyhash(str, len, 0);
+}
+#ifdef UPB_HAVE_CRC32C
+uint32_t crc32chash(const char *str, size_t len) {
+  return upb_crc32chash(str, len, 0);
+}
+#endif
+
+struct {
+  const char *name;
+  hashfunc *func;
+} hashes[] = {
+  {"MurmurHash2", &murmur2},
+  {"wyhash", &wyhash},
+#ifdef UPB_HAVE_CRC32C
+  {"CRC32C", &crc32chash},
+#endif
+};
+
+// The number of names that land in an already-occupied bucket of a table of
+// 2^size_lg2 buckets, like the main positions of a chained table.
+size_t bucket_collisions(hashfunc *func, const vector<std::string>& names,
+                         int size_lg2) {
+  vector<bool> full(1 << size_lg2);
+  size_t collisions = 0;
+  for (size_t i = 0; i < names.size(); i++) {
+    uint32_t bucket = func(names[i].data(), names[i].size()) &
+                      ((1 << size_lg2) - 1);
+    if (full[bucket]) collisions++;
+    full[bucket] = true;
+  }
+  return collisions;
+}
+
+// The same for a random function.
+double expected_collisions(size_t n, int size_lg2) {
+  double buckets = 1 << size_lg2;
+  return n - buckets * (1 - pow(1 - 1 / buckets, n));
+}
+
+void test_hash_quality() {
+  vector<std::string> names = get_symbol_names(4096);
+  for (size_t i = 0; i < ARRAY_SIZE(hashes); i++) {
+    // At the load factor of a table that has just grown, and at a full one.
+    for (int size_lg2 = 12; size_lg2 <= 13; size_lg2++) {
+      size_t collisions = bucket_collisions(hashes[i].func, names, size_lg2);
+      double expected = expected_collisions(names.size(), size_lg2);
+      ASSERT(collisions < expected * 1.1);
+    }
+  }
+
+  // The seed changes the hash.
+  ASSERT(upb_wyhash("google.protobuf", 15, 0) !=
+         upb_wyhash("google.protobuf", 15, 1));
+#ifdef UPB_HAVE_CRC32C
+  ASSERT(upb_crc32chash("google.protobuf", 15, 0) !=
+         upb_crc32chash("google.protobuf", 15, 1));
+#endif
+}
+
+// Hashes per second and bucket collisions of each hash function over 4096
+// symbol names, averaging 40 bytes or so.
+void benchmark_string_hashes() {
+  vector<std::string> names = get_symbol_names(4096);
+  size_t bytes = 0;
+  for (size_t i = 0; i < names.size(); i++) bytes += names[i].size();
+  printf("String hashes, %zu names of %.1f bytes on average ====\n",
+         names.size(), (double)bytes / names.size());
+  printf("Bucket collisions at 8192 buckets expected of a random hash: %.0f\n",
+         expected_collisions(names.size(), 13));
+
+  for (size_t h = 0; h < ARRAY_SIZE(hashes); h++) {
+    printf("%s: ", hashes[h].name);
+    fflush(stdout);
+    const size_t mask = names.size() - 1;
+    int time_mask = 0xffff;
+    uint32_t x = 0;
+    double before = get_usertime();
+    unsigned int i;
+    for (i = 0; true; i++) {
+      MAYBE_BREAK;
+      const std::string& name = names[i & mask];
+      x += hashes[h].func(name.data(), name.size());
+    }
+    double total = get_usertime() - before;
+    if (x == 1) printf(" ");  // Keep the hashing from being optimized out.
+    printf("%s/s, ", eng(i / total, 3, false));
+    printf("%sB/s, ", eng(i / total * bytes / names.size(), 3, false));
+    printf("%zu bucket collisions\n",
+           bucket_collisions(hashes[h].func, names, 13));
+  }
+  printf("\n");
+}
+
 extern "C" {
 
 int run_tests(int argc, char *argv[]) {
@@ -358,6 +679,14 @@ int run_tests(int argc, char *argv[]) {
   delete[] keys4;
 
   test_delete();
+  test_remove_chain_head();
+  test_churn();
+  test_hash_quality();
+
+  if (benchmark) {
+    benchmark_string_hashes();
+    benchmark_hash_lookups();
+  }
 
   return 0;
 }
@@ -214,7 +214,13 @@ function Dumper:tabkey(key)
   if type(key) == "nil" then
     return "UPB_TABKEY_NONE"
   elseif type(key) == "string" then
-    return string.format('UPB_TABKEY_STR("%s")', key)
+    -- The length prefix, least significant byte first.
+    local len = {}
+    for i = 0, 3 do
+      len[#len + 1] = string.format('"\\%03o"', math.floor(#key / 256^i) % 256)
+    end
+    return string.format('UPB_TABKEY_STR(%s, "%s")',
+                         table.concat(len, ", "), key)
   else
     return string.format("UPB_TABKEY_NUM(%d)", key)
   end
@@ -225,7 +231,13 @@ function Dumper:tabent(ent)
   local key = self:tabkey(ent.key)
   local val = self:_value(ent.value, ent.valtype)
   local next = self.linktab:addr(ent.next)
-  return string.format('  {%s, %s, %s},\n', key, val, next)
+  local hash = "0"
+  if type(ent.key) == "string" then
+    hash = string.format("0x%08x", ent.hash)
+  elseif type(ent.key) == "number" then
+    hash = string.format("%d", ent.hash)
+  end
+  return string.format('  {%s, %s, %s, %s},\n', key, val, next, hash)
 end
 
 -- Dumps an inttable array entry.  This is almost the same as value() above,
@@ -241,11 +253,11 @@ end
 -- Dumps an initializer for the given strtable/inttable (respectively).  Its
 -- entries must have previously been added to the linktable.
 function Dumper:strtable(t)
-  -- UPB_STRTABLE_INIT(count, mask, type, size_lg2, entries)
+  -- UPB_STRTABLE_INIT(count, mask, type, size_lg2, entries, hashfn)
   return string.format(
-      "UPB_STRTABLE_INIT(%d, %d, %s, %d, %s)",
+      "UPB_STRTABLE_INIT(%d, %d, %s, %d, %s, %s)",
       t.count, t.mask, const(t, "ctype", upbtable) , t.size_lg2,
-      self.linktab:addr(t.entries[1].ptr))
+      self.linktab:addr(t.entries[1].ptr), const(t, "hash", upbtable))
 end
 
 function Dumper:inttable(t)
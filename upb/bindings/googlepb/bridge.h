@@ -15,18 +15,19 @@
 //
 //   // JIT the parser; should only be done once ahead-of-time.
 //   upb::reffed_ptr<const upb::Handlers> write_myproto(
-//       upb::google::NewWriteHandlers(MyProto()));
-//   upb::reffed_ptr<const upb::Handlers> parse_myproto(
-//       upb::Decoder::NewDecoderHandlers(write_myproto.get(), true));
+//       upb::googlepb::WriteHandlers::New(MyProto()));
+//   upb::pb::CodeCache cache;
+//   upb::reffed_ptr<const upb::pb::DecoderMethod> parse_myproto(
+//       cache.GetDecoderMethod(
+//           upb::pb::DecoderMethodOptions(write_myproto.get())));
 //
 //   // The actual parsing.
 //   MyProto proto;
-//   upb::SeededPipeline<8192> pipeline(upb_realloc, NULL);
-//   upb::Sink* write_sink = pipeline.NewSink(write_myproto.get());
-//   upb::Sink* parse_sink = pipeline.NewSink(parse_myproto.get());
-//   upb::pb::Decoder* decoder = decoder_sink->GetObject<upb::pb::Decoder>();
-//   upb::pb::ResetDecoderSink(decoder, write_sink);
-//   write_sink->Reset(&proto);
+//   upb::Status status;
+//   upb::pb::Decoder decoder(parse_myproto.get(), &status);
+//   upb::Sink write_sink(write_myproto.get(), &proto);
+//   decoder.ResetOutput(&write_sink);
+//   upb::BufferSource::PutBuffer(buf, len, decoder.input());
 //
 // Note that there is currently no support for
 // CodedInputStream::SetExtensionRegistry(), which allows specifying a separate
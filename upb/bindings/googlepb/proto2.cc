@@ -534,14 +534,59 @@ case goog::FieldDescriptor::cpptype:                                           \
 
   // StartSequence /////////////////////////////////////////////////////////////
 
+  class RepeatedFieldData : public FieldOffset {
+   public:
+    RepeatedFieldData(const goog::FieldDescriptor* f,
+                      const goog::internal::GeneratedMessageReflection* r)
+        : FieldOffset(f, r), width_(GetWireWidth(f)) {}
+
+    // Bytes per element on the wire, or 0 if elements are varints.
+    size_t width() const { return width_; }
+
+   private:
+    static size_t GetWireWidth(const goog::FieldDescriptor* f) {
+      switch (f->type()) {
+        case goog::FieldDescriptor::TYPE_BOOL:
+          return 1;
+        case goog::FieldDescriptor::TYPE_FIXED32:
+        case goog::FieldDescriptor::TYPE_SFIXED32:
+        case goog::FieldDescriptor::TYPE_FLOAT:
+          return 4;
+        case goog::FieldDescriptor::TYPE_FIXED64:
+        case goog::FieldDescriptor::TYPE_SFIXED64:
+        case goog::FieldDescriptor::TYPE_DOUBLE:
+          return 8;
+        default:
+          return 0;
+      }
+    }
+
+    size_t width_;
+  };
+
   template <class T>
   static void SetStartRepeatedField(
       const goog::FieldDescriptor* proto2_f,
       const goog::internal::GeneratedMessageReflection* r,
       const upb::FieldDef* f, upb::Handlers* h) {
-    CHKRET(h->SetStartSequenceHandler(
-        f, UpbBindT(&PushOffset<goog::RepeatedField<T> >,
-                    new FieldOffset(proto2_f, r))));
+    CHKRET(h->SetStartSequenceHintHandler(
+        f, UpbBindT(&StartRepeatedField<T>,
+                    new RepeatedFieldData(proto2_f, r))));
+  }
+
+  template <class T>
+  static goog::RepeatedField<T>* StartRepeatedField(
+      goog::Message* message, const RepeatedFieldData* data,
+      size_t size_hint) {
+    goog::RepeatedField<T>* r =
+        data->GetFieldPointer<goog::RepeatedField<T> >(message);
+    // The hint is only non-zero for packed fields, so for fixed-width types
+    // it tells us exactly how many elements are coming.  For varints it is
+    // only an upper bound, which could overshoot by 10x, so we don't use it.
+    if (size_hint > 0 && data->width() > 0) {
+      r->Reserve(r->size() + size_hint / data->width());
+    }
+    return r;
   }
 
   template <class T>
@@ -27,6 +27,12 @@
 #include "upb/def.h"
 #include "upb/symtab.h"
 
+#ifdef UPB_USE_SWISSTABLE
+// Static initializers always have the chained layout, which only the default
+// build gives the tables we dump.
+#error "Generating static initializers requires a build without UPB_USE_SWISSTABLE"
+#endif
+
 static void lupbtable_setnum(lua_State *L, int tab, const char *key,
                              lua_Number val) {
   lua_pushnumber(L, val);
@@ -68,7 +74,9 @@ static void lupbtable_pushent(lua_State *L, const upb_tabent *e,
     if (inttab) {
       lua_pushnumber(L, e->key.num);
     } else {
-      lua_pushlstring(L, e->key.s.str, e->key.s.length);
+      size_t len;
+      const char *str = upb_tabstr(e->key, &len);
+      lua_pushlstring(L, str, len);
     }
     lua_setfield(L, -2, "key");
     lupbtable_pushval(L, e->val, ctype);
@@ -76,6 +84,8 @@ static void lupbtable_pushent(lua_State *L, const upb_tabent *e,
   }
   lua_pushlightuserdata(L, (void*)e->next);
   lua_setfield(L, -2, "next");
+  lua_pushnumber(L, e->hash);
+  lua_setfield(L, -2, "hash");
   lupbtable_setmetafields(L, ctype, e);
 }
 
@@ -116,6 +126,7 @@ static void lupbtable_pushinttable(lua_State *L, const upb_inttable *t) {
 
 static void lupbtable_pushstrtable(lua_State *L, const upb_strtable *t) {
   lupbtable_pushtable(L, &t->t, false);
+  lupbtable_setnum(L, -1, "hash", t->hashfn);
 }
 
 static int lupbtable_msgdef_itof(lua_State *L) {
@@ -172,6 +183,9 @@ int luaopen_upbtable(lua_State *L) {
   lupbtable_setfieldi(L, "CTYPE_PTR",   UPB_CTYPE_PTR);
   lupbtable_setfieldi(L, "CTYPE_CSTR",  UPB_CTYPE_CSTR);
   lupbtable_setfieldi(L, "CTYPE_INT32", UPB_CTYPE_INT32);
+  lupbtable_setfieldi(L, "HASH_MURMUR2", UPB_HASH_MURMUR2);
+  lupbtable_setfieldi(L, "HASH_WYHASH",  UPB_HASH_WYHASH);
+  lupbtable_setfieldi(L, "HASH_CRC32C",  UPB_HASH_CRC32C);
 
   lua_pushlightuserdata(L, NULL);
   lua_setfield(L, -2, "NULL");
@@ -22,14 +22,15 @@ class FillStringHandler {
  private:
   // TODO(haberman): add UpbBind/UpbMakeHandler support to BytesHandler so these
   // can be prettier callbacks.
-  static void* StartString(void *c, const void *hd, size_t size) {
+  static void* StartString(void *c, const void * /* hd */,
+                           size_t /* size */) {
     T* str = static_cast<T*>(c);
     str->clear();
     return c;
   }
 
-  static size_t StringBuf(void* c, const void* hd, const char* buf, size_t n,
-                          const BufferHandle* h) {
+  static size_t StringBuf(void* c, const void* /* hd */, const char* buf,
+                          size_t n, const BufferHandle* /* h */) {
     T* str = static_cast<T*>(c);
     try {
       str->append(buf, n);
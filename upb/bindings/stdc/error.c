@@ -7,14 +7,14 @@
  * Handling of errno.
  */
 
-#include "upb/stdc/error.h"
+#include "upb/bindings/stdc/error.h"
 
+#include <errno.h>
 #include <string.h>
 
 void upb_status_fromerrno(upb_status *status, int code) {
   if (code != 0 && !upb_errno_is_wouldblock(code)) {
-    status->error = true;
-    upb_status_setcode(status, &upb_stdc_errorspace, code);
+    upb_status_seterrcode(status, &upb_stdc_errorspace, code);
   }
 }
 
@@ -29,15 +29,12 @@ bool upb_errno_is_wouldblock(int code) {
       false;
 }
 
-bool upb_stdc_codetostr(int code, char *buf, size_t len) {
+static void upb_stdc_setmessage(upb_status *status, int code) {
   // strerror() may use static buffers and is not guaranteed to be thread-safe,
   // but it appears that it is not subject to buffer overflows in practice, and
   // it used by other portable and high-quality software like Lua.  For more
   // discussion see: http://thread.gmane.org/gmane.comp.lang.lua.general/89506
-  char *err = strerror(code);
-  if (strlen(err) >= len) return false;
-  strcpy(buf, err);
-  return true;
+  upb_status_seterrmsg(status, strerror(code));
 }
 
-upb_errorspace upb_stdc_errorspace = {"stdc", &upb_stdc_codetostr};
+upb_errorspace upb_stdc_errorspace = {"stdc", &upb_stdc_setmessage};
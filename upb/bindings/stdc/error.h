@@ -15,6 +15,9 @@
 UPB_BEGIN_EXTERN_C
 
 extern upb_errorspace upb_stdc_errorspace;
+
+// Sets "status" to the given errno value, unless "code" is zero or merely
+// indicates that the operation would have blocked.
 void upb_status_fromerrno(upb_status *status, int code);
 bool upb_errno_is_wouldblock(int code);
 
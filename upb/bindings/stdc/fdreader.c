@@ -0,0 +1,251 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ * Author: Josh Haberman <jhaberman@gmail.com>
+ *
+ * We use a plain pthread and blocking read(2) rather than something like
+ * io_uring or POSIX AIO: those are either not portable or not meaningfully
+ * faster for the purely sequential access pattern we have here, and a single
+ * reader thread that stays a few buffers ahead is enough to keep the disk busy
+ * while the sink decodes.
+ */
+
+#include "upb/bindings/stdc/fdreader.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "upb/bindings/stdc/error.h"
+
+struct upb_fdreader_buf {
+  // One ref for the ring slot (if it is still in the ring) plus one for every
+  // outstanding pin.
+  uint32_t refcount;
+  size_t len;
+  char data[];
+};
+
+// The address of this is used to tag the BufferHandles we hand out, so that
+// upb_fdreader_pin() can recognize them.
+static const char bufhandle_type;
+
+static upb_fdreader_buf *newbuf(size_t size) {
+  upb_fdreader_buf *buf = malloc(sizeof(*buf) + size);
+  if (!buf) return NULL;
+  buf->refcount = 1;
+  buf->len = 0;
+  return buf;
+}
+
+static void unref(upb_fdreader_buf *buf) {
+  if (__sync_sub_and_fetch(&buf->refcount, 1) == 0) {
+    free(buf);
+  }
+}
+
+// Returns true if the ring holds the only reference to "buf", ie. nobody has
+// pinned it.
+static bool unpinned(upb_fdreader_buf *buf) {
+  return __sync_add_and_fetch(&buf->refcount, 0) == 1;
+}
+
+static void freering(upb_fdreader *r) {
+  int i;
+  if (!r->ring) return;
+  for (i = 0; i < r->nbufs; i++) {
+    if (r->ring[i]) unref(r->ring[i]);
+  }
+  free(r->ring);
+  r->ring = NULL;
+}
+
+static bool allocring(upb_fdreader *r) {
+  int i;
+  r->ring = calloc(r->nbufs, sizeof(*r->ring));
+  if (!r->ring) return false;
+  for (i = 0; i < r->nbufs; i++) {
+    r->ring[i] = newbuf(r->bufsize);
+    if (!r->ring[i]) {
+      freering(r);
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/* Reader thread **************************************************************/
+
+static void *readloop(void *closure) {
+  upb_fdreader *r = closure;
+  pthread_mutex_lock(&r->mu);
+  while (true) {
+    while (r->full == r->nbufs && !r->shutdown) {
+      pthread_cond_wait(&r->cv, &r->mu);
+    }
+    if (r->shutdown) break;
+
+    // The consumer never touches the slot at "head" while it is empty, so we
+    // can fill it without holding the lock.
+    upb_fdreader_buf *buf = r->ring[r->head];
+    pthread_mutex_unlock(&r->mu);
+
+    ssize_t n;
+    do {
+      n = read(r->fd, buf->data, r->bufsize);
+    } while (n < 0 && errno == EINTR);
+    int err = (n < 0) ? errno : 0;
+
+    pthread_mutex_lock(&r->mu);
+    if (n > 0) {
+      buf->len = n;
+      r->total += n;
+      r->head = (r->head + 1) % r->nbufs;
+      r->full++;
+    } else {
+      r->err = err;
+      r->eof = true;
+    }
+    pthread_cond_broadcast(&r->cv);
+    if (r->eof) break;
+  }
+  pthread_mutex_unlock(&r->mu);
+  return NULL;
+}
+
+
+/* Public API *****************************************************************/
+
+void upb_fdreader_init(upb_fdreader *r, int fd) {
+  r->fd = fd;
+  r->bufsize = UPB_FDREADER_DEFAULT_BUFSIZE;
+  r->nbufs = UPB_FDREADER_DEFAULT_NUMBUFS;
+  r->ring = NULL;
+  r->head = r->tail = r->full = 0;
+  r->eof = r->shutdown = false;
+  r->err = 0;
+  r->total = 0;
+  pthread_mutex_init(&r->mu, NULL);
+  pthread_cond_init(&r->cv, NULL);
+}
+
+void upb_fdreader_uninit(upb_fdreader *r) {
+  assert(r->ring == NULL);  // Run() cleans up after itself.
+  pthread_cond_destroy(&r->cv);
+  pthread_mutex_destroy(&r->mu);
+}
+
+void upb_fdreader_setbuffers(upb_fdreader *r, size_t size, int buffers) {
+  assert(r->ring == NULL);
+  assert(size > 0);
+  assert(buffers >= 2);
+  r->bufsize = size;
+  r->nbufs = buffers;
+}
+
+uint64_t upb_fdreader_bytesread(const upb_fdreader *r) {
+  return r->total;
+}
+
+bool upb_fdreader_run(upb_fdreader *r, upb_bytessink *sink, upb_status *s) {
+  r->head = r->tail = r->full = 0;
+  r->eof = r->shutdown = false;
+  r->err = 0;
+  r->total = 0;
+
+  if (!allocring(r)) {
+    upb_status_seterrmsg(s, "Out of memory allocating read buffers.");
+    return false;
+  }
+
+  int err = pthread_create(&r->thread, NULL, &readloop, r);
+  if (err != 0) {
+    freering(r);
+    upb_status_fromerrno(s, err);
+    return false;
+  }
+
+  void *subc;
+  bool ok = upb_bytessink_start(sink, 0, &subc);
+  if (!ok) upb_status_seterrmsg(s, "Sink refused to start.");
+
+  while (ok) {
+    pthread_mutex_lock(&r->mu);
+    while (r->full == 0 && !r->eof) {
+      pthread_cond_wait(&r->cv, &r->mu);
+    }
+    if (r->full == 0) {
+      // EOF (or a read error) and we have drained everything before it.
+      pthread_mutex_unlock(&r->mu);
+      break;
+    }
+    upb_fdreader_buf *buf = r->ring[r->tail];
+    pthread_mutex_unlock(&r->mu);
+
+    upb_bufhandle handle;
+    upb_bufhandle_init(&handle);
+    upb_bufhandle_setbuf(&handle, buf->data, 0);
+    upb_bufhandle_setobj(&handle, buf, &bufhandle_type);
+    size_t n = upb_bytessink_putbuf(sink, subc, buf->data, buf->len, &handle);
+    upb_bufhandle_uninit(&handle);
+
+    if (n != buf->len) {
+      upb_status_seterrf(s, "Sink accepted only %zu of %zu bytes.", n,
+                         buf->len);
+      ok = false;
+      break;
+    }
+
+    if (!unpinned(buf)) {
+      // Somebody is aliasing this buffer; hand it over to them and put a fresh
+      // one in its slot.
+      upb_fdreader_buf *fresh = newbuf(r->bufsize);
+      if (!fresh) {
+        upb_status_seterrmsg(s, "Out of memory allocating read buffers.");
+        ok = false;
+        break;
+      }
+      unref(buf);
+      buf = fresh;
+    }
+
+    pthread_mutex_lock(&r->mu);
+    r->ring[r->tail] = buf;
+    r->tail = (r->tail + 1) % r->nbufs;
+    r->full--;
+    pthread_cond_broadcast(&r->cv);
+    pthread_mutex_unlock(&r->mu);
+  }
+
+  pthread_mutex_lock(&r->mu);
+  r->shutdown = true;
+  pthread_cond_broadcast(&r->cv);
+  pthread_mutex_unlock(&r->mu);
+  pthread_join(r->thread, NULL);
+  freering(r);
+
+  if (ok && r->err != 0) {
+    upb_status_fromerrno(s, r->err);
+    ok = false;
+  }
+
+  if (ok) {
+    ok = upb_bytessink_end(sink);
+    if (!ok) upb_status_seterrmsg(s, "Sink refused to end.");
+  }
+
+  return ok;
+}
+
+const upb_fdreader_buf *upb_fdreader_pin(const upb_bufhandle *h) {
+  if (upb_bufhandle_objtype(h) != &bufhandle_type) return NULL;
+  upb_fdreader_buf *buf = (upb_fdreader_buf*)upb_bufhandle_obj(h);
+  __sync_fetch_and_add(&buf->refcount, 1);
+  return buf;
+}
+
+void upb_fdreader_unpin(const upb_fdreader_buf *buf) {
+  unref((upb_fdreader_buf*)buf);
+}
@@ -0,0 +1,150 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ * Author: Josh Haberman <jhaberman@gmail.com>
+ *
+ * upb::stdc::FdReader streams the contents of a POSIX file descriptor into a
+ * upb::BytesSink (for example the input of a upb::pb::Decoder or
+ * upb::json::Parser).
+ *
+ * Reading happens on a background thread that fills a ring of buffers ahead of
+ * the consumer.  This lets read(2) overlap with decoding instead of
+ * alternating with it, which matters when streaming large files: otherwise
+ * neither the disk nor the CPU is ever kept busy.
+ *
+ * A buffer is recycled as soon as the sink has accepted all of its bytes.
+ * Sinks that want to alias the input (ie. keep pointers into it after the
+ * StringBuf handler returns) can pin the buffer with upb_fdreader_pin(), which
+ * keeps it alive until the matching upb_fdreader_unpin(); a pinned buffer is
+ * taken out of the ring and replaced by a fresh one, so pins never stall the
+ * reader thread.
+ */
+
+#ifndef UPB_STDC_FDREADER_H_
+#define UPB_STDC_FDREADER_H_
+
+#include <pthread.h>
+
+#include "upb/sink.h"
+
+#ifdef __cplusplus
+namespace upb {
+namespace stdc {
+class FdReader;
+}  // namespace stdc
+}  // namespace upb
+#endif
+
+UPB_DECLARE_TYPE(upb::stdc::FdReader, upb_fdreader);
+
+// A single buffer of the ring.  Opaque; only used as a pin handle.
+typedef struct upb_fdreader_buf upb_fdreader_buf;
+
+#define UPB_FDREADER_DEFAULT_BUFSIZE (256 * 1024)
+#define UPB_FDREADER_DEFAULT_NUMBUFS 4
+
+/* upb::stdc::FdReader ********************************************************/
+
+UPB_DEFINE_CLASS0(upb::stdc::FdReader,
+ public:
+  // Does not take ownership of "fd"; the caller must close it.
+  explicit FdReader(int fd);
+  ~FdReader();
+
+  // Sets the size and number of the buffers in the ring.  May only be called
+  // when Run() is not in progress.  Must have buffers >= 2.
+  void SetBuffers(size_t size, int buffers);
+
+  // Reads the file descriptor until EOF, pushing everything into "sink" as a
+  // single string (ie. one Start()/End() pair).  Returns false and sets
+  // "status" on error, which is either a read(2) error, an allocation failure,
+  // or the sink not accepting the full count of a buffer.
+  bool Run(BytesSink* sink, Status* status);
+
+  // Total number of bytes that were read from the file descriptor by the last
+  // (or current) call to Run().
+  uint64_t bytes_read() const;
+
+  // Pins the buffer behind "handle" if it came from an FdReader, so that it
+  // stays alive after the StringBuf handler returns.  Returns NULL if the
+  // handle does not belong to an FdReader.  Every successful pin must be
+  // matched by a call to Unpin(), which may happen on any thread and may
+  // outlive the FdReader itself.
+  static const upb_fdreader_buf* Pin(const BufferHandle* handle);
+  static void Unpin(const upb_fdreader_buf* buf);
+
+ private:
+  UPB_DISALLOW_COPY_AND_ASSIGN(FdReader);
+,
+UPB_DEFINE_STRUCT0(upb_fdreader, UPB_QUOTE(
+  int fd;
+  size_t bufsize;
+  int nbufs;
+
+  // The ring.  The reader thread fills slots starting at "head" and the
+  // consumer drains them starting at "tail"; "full" is the number of filled
+  // slots in between.  All of these (and the flags below) are protected by
+  // "mu".
+  upb_fdreader_buf **ring;
+  int head, tail, full;
+
+  // Set by the reader thread once it has hit EOF or an error; no more slots
+  // will be filled after this.
+  bool eof;
+
+  // Set by the consumer to ask the reader thread to exit early.
+  bool shutdown;
+
+  // errno from a failed read(2), or 0.
+  int err;
+
+  // Bytes read so far by the current or last run.
+  uint64_t total;
+
+  pthread_t thread;
+  pthread_mutex_t mu;
+
+  // Signaled whenever "full", "eof" or "shutdown" changes.
+  pthread_cond_t cv;
+)));
+
+UPB_BEGIN_EXTERN_C
+
+void upb_fdreader_init(upb_fdreader *r, int fd);
+void upb_fdreader_uninit(upb_fdreader *r);
+void upb_fdreader_setbuffers(upb_fdreader *r, size_t size, int buffers);
+bool upb_fdreader_run(upb_fdreader *r, upb_bytessink *sink, upb_status *s);
+uint64_t upb_fdreader_bytesread(const upb_fdreader *r);
+const upb_fdreader_buf *upb_fdreader_pin(const upb_bufhandle *h);
+void upb_fdreader_unpin(const upb_fdreader_buf *buf);
+
+UPB_END_EXTERN_C
+
+#ifdef __cplusplus
+
+namespace upb {
+namespace stdc {
+inline FdReader::FdReader(int fd) { upb_fdreader_init(this, fd); }
+inline FdReader::~FdReader() { upb_fdreader_uninit(this); }
+inline void FdReader::SetBuffers(size_t size, int buffers) {
+  upb_fdreader_setbuffers(this, size, buffers);
+}
+inline bool FdReader::Run(BytesSink* sink, Status* status) {
+  return upb_fdreader_run(this, sink, status);
+}
+inline uint64_t FdReader::bytes_read() const {
+  return upb_fdreader_bytesread(this);
+}
+inline const upb_fdreader_buf* FdReader::Pin(const BufferHandle* handle) {
+  return upb_fdreader_pin(handle);
+}
+inline void FdReader::Unpin(const upb_fdreader_buf* buf) {
+  upb_fdreader_unpin(buf);
+}
+}  // namespace stdc
+}  // namespace upb
+
+#endif
+
+#endif  /* UPB_STDC_FDREADER_H_ */
@@ -0,0 +1,187 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ * Author: Josh Haberman <jhaberman@gmail.com>
+ */
+
+#include "upb/bindings/stdc/fdwriter.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "upb/bindings/stdc/error.h"
+
+// Buffers are aligned to this so that the kernel can copy them efficiently
+// (and so that O_DIRECT fds have a chance of working).
+#define BUFALIGN 4096
+
+// Writes out all of "iov", retrying after short writes.
+static bool writeall(upb_fdwriter *w, struct iovec *iov, int n) {
+  while (n > 0) {
+    ssize_t written = writev(w->fd, iov, n);
+    w->counters.syscalls++;
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      upb_status_seterrcode(w->status, &upb_stdc_errorspace, errno);
+      return false;
+    }
+    w->counters.bytes += written;
+
+    // Skip whatever was written fully, and trim the iovec that was written
+    // partially, if any.
+    while (n > 0 && (size_t)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char*)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+// Writes out all buffered data, followed by "extra" (which is not copied).
+static bool flush(upb_fdwriter *w, const char *extra, size_t extralen) {
+  struct iovec iov[UPB_FDWRITER_MAX_NUMBUFS + 1];
+  int n = 0;
+  int i;
+  for (i = 0; i < w->cur; i++) {
+    iov[n].iov_base = w->bufs[i];
+    iov[n].iov_len = w->bufsize;
+    n++;
+  }
+  if (w->len > 0) {
+    iov[n].iov_base = w->bufs[w->cur];
+    iov[n].iov_len = w->len;
+    n++;
+  }
+  if (extralen > 0) {
+    iov[n].iov_base = (char*)extra;
+    iov[n].iov_len = extralen;
+    n++;
+  }
+  w->cur = 0;
+  w->len = 0;
+  return writeall(w, iov, n);
+}
+
+static void freebufs(upb_fdwriter *w) {
+  int i;
+  for (i = 0; i < UPB_FDWRITER_MAX_NUMBUFS; i++) {
+    free(w->bufs[i]);
+    w->bufs[i] = NULL;
+  }
+}
+
+
+/* Handlers *******************************************************************/
+
+static void *startstr(void *closure, const void *hd, size_t size_hint) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(size_hint);
+  return closure;
+}
+
+static size_t putbuf(void *closure, const void *hd, const char *buf,
+                     size_t len, const upb_bufhandle *handle) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(handle);
+  upb_fdwriter *w = closure;
+
+  if (len >= w->threshold) {
+    w->counters.passthrough++;
+    return flush(w, buf, len) ? len : 0;
+  }
+
+  w->counters.copies++;
+  w->counters.copied_bytes += len;
+
+  const char *ptr = buf;
+  const char *end = buf + len;
+  while (ptr < end) {
+    char **dst = &w->bufs[w->cur];
+    if (!*dst && posix_memalign((void**)dst, BUFALIGN, w->bufsize) != 0) {
+      *dst = NULL;
+      upb_status_seterrmsg(w->status, "Out of memory allocating buffer.");
+      return 0;
+    }
+
+    size_t n = UPB_MIN((size_t)(end - ptr), w->bufsize - w->len);
+    memcpy(*dst + w->len, ptr, n);
+    ptr += n;
+    w->len += n;
+
+    if (w->len == w->bufsize) {
+      if (w->cur + 1 == w->nbufs) {
+        if (!flush(w, NULL, 0)) return 0;
+      } else {
+        w->cur++;
+        w->len = 0;
+      }
+    }
+  }
+
+  return len;
+}
+
+static bool endstr(void *closure, const void *hd) {
+  UPB_UNUSED(hd);
+  return upb_fdwriter_flush(closure);
+}
+
+
+/* Public API *****************************************************************/
+
+void upb_fdwriter_init(upb_fdwriter *w, int fd, upb_status *status) {
+  w->fd = fd;
+  w->status = status;
+  memset(w->bufs, 0, sizeof(w->bufs));
+  w->nbufs = UPB_FDWRITER_DEFAULT_NUMBUFS;
+  w->bufsize = UPB_FDWRITER_DEFAULT_BUFSIZE;
+  w->threshold = UPB_FDWRITER_DEFAULT_BUFSIZE;
+  w->cur = 0;
+  w->len = 0;
+  memset(&w->counters, 0, sizeof(w->counters));
+
+  upb_byteshandler_init(&w->handler);
+  upb_byteshandler_setstartstr(&w->handler, startstr, NULL);
+  upb_byteshandler_setstring(&w->handler, putbuf, NULL);
+  upb_byteshandler_setendstr(&w->handler, endstr, NULL);
+  upb_bytessink_reset(&w->input_, &w->handler, w);
+}
+
+void upb_fdwriter_uninit(upb_fdwriter *w) {
+  // Like fclose(), this makes a best-effort attempt to write out what is left.
+  // Callers that care about errors should call upb_fdwriter_flush() first.
+  upb_fdwriter_flush(w);
+  freebufs(w);
+  upb_byteshandler_uninit(&w->handler);
+}
+
+void upb_fdwriter_setbuffers(upb_fdwriter *w, size_t size, int buffers,
+                             size_t threshold) {
+  assert(w->cur == 0 && w->len == 0);
+  assert(size > 0);
+  assert(buffers > 0 && buffers <= UPB_FDWRITER_MAX_NUMBUFS);
+  freebufs(w);
+  w->bufsize = size;
+  w->nbufs = buffers;
+  w->threshold = threshold;
+}
+
+upb_bytessink *upb_fdwriter_input(upb_fdwriter *w) {
+  return &w->input_;
+}
+
+bool upb_fdwriter_flush(upb_fdwriter *w) {
+  return flush(w, NULL, 0);
+}
+
+const upb_fdwriter_stats *upb_fdwriter_getstats(const upb_fdwriter *w) {
+  return &w->counters;
+}
@@ -0,0 +1,127 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ * Author: Josh Haberman <jhaberman@gmail.com>
+ *
+ * upb::stdc::FdWriter is a terminal upb::BytesSink that writes everything it
+ * receives to a POSIX file descriptor.  It is meant to be the output of
+ * upb::pb::Encoder, upb::json::Printer or upb::pb::TextPrinter, all of which
+ * tend to emit many tiny buffers.
+ *
+ * Small writes are copied into a set of large, page-aligned buffers, and the
+ * buffers are only written out (with a single writev(2)) once all of them are
+ * full.  Writes at or above a threshold are not copied at all: they are passed
+ * straight to writev(2) along with whatever is buffered ahead of them.
+ */
+
+#ifndef UPB_STDC_FDWRITER_H_
+#define UPB_STDC_FDWRITER_H_
+
+#include "upb/sink.h"
+
+#ifdef __cplusplus
+namespace upb {
+namespace stdc {
+class FdWriter;
+}  // namespace stdc
+}  // namespace upb
+#endif
+
+UPB_DECLARE_TYPE(upb::stdc::FdWriter, upb_fdwriter);
+
+#define UPB_FDWRITER_DEFAULT_BUFSIZE (64 * 1024)
+#define UPB_FDWRITER_DEFAULT_NUMBUFS 4
+#define UPB_FDWRITER_MAX_NUMBUFS 16
+
+// Counters for tuning.  They start at zero when the writer is created and
+// accumulate over its whole lifetime, across every string written to it.
+typedef struct {
+  uint64_t bytes;         // Bytes written to the fd.
+  uint64_t syscalls;      // Calls to write(2)/writev(2).
+  uint64_t copies;        // PutBuffer() calls that copied into our buffers.
+  uint64_t copied_bytes;  // Total bytes copied by those calls.
+  uint64_t passthrough;   // PutBuffer() calls that were written without copy.
+} upb_fdwriter_stats;
+
+/* upb::stdc::FdWriter ********************************************************/
+
+UPB_DEFINE_CLASS0(upb::stdc::FdWriter,
+ public:
+  // Does not take ownership of "fd"; the caller must close it.  Write errors
+  // are reported on "status", which must outlive the writer.
+  FdWriter(int fd, Status* status);
+  ~FdWriter();
+
+  // Sets the size and number of output buffers and the size at which writes
+  // bypass them.  May only be called before anything has been written.
+  void SetBuffers(size_t size, int buffers, size_t passthrough_threshold);
+
+  // The sink to hand to the encoder/printer.  Buffered data is flushed
+  // automatically when the string ends.
+  BytesSink* input();
+
+  // Writes out any buffered data.  Returns false on error.
+  bool Flush();
+
+  const upb_fdwriter_stats* stats() const;
+
+ private:
+  UPB_DISALLOW_COPY_AND_ASSIGN(FdWriter);
+,
+UPB_DEFINE_STRUCT0(upb_fdwriter, UPB_QUOTE(
+  int fd;
+  upb_status *status;
+
+  upb_byteshandler handler;
+  upb_bytessink input_;
+
+  // Output buffers, each "bufsize" bytes, allocated lazily on first use.
+  // Buffers [0, cur) are full, buffer "cur" holds "len" bytes.
+  char *bufs[UPB_FDWRITER_MAX_NUMBUFS];
+  int nbufs;
+  int cur;
+  size_t bufsize;
+  size_t len;
+
+  // Writes of at least this many bytes are not copied.
+  size_t threshold;
+
+  upb_fdwriter_stats counters;
+)));
+
+UPB_BEGIN_EXTERN_C
+
+void upb_fdwriter_init(upb_fdwriter *w, int fd, upb_status *status);
+void upb_fdwriter_uninit(upb_fdwriter *w);
+void upb_fdwriter_setbuffers(upb_fdwriter *w, size_t size, int buffers,
+                             size_t threshold);
+upb_bytessink *upb_fdwriter_input(upb_fdwriter *w);
+bool upb_fdwriter_flush(upb_fdwriter *w);
+const upb_fdwriter_stats *upb_fdwriter_getstats(const upb_fdwriter *w);
+
+UPB_END_EXTERN_C
+
+#ifdef __cplusplus
+
+namespace upb {
+namespace stdc {
+inline FdWriter::FdWriter(int fd, Status* status) {
+  upb_fdwriter_init(this, fd, status);
+}
+inline FdWriter::~FdWriter() { upb_fdwriter_uninit(this); }
+inline void FdWriter::SetBuffers(size_t size, int buffers,
+                                 size_t passthrough_threshold) {
+  upb_fdwriter_setbuffers(this, size, buffers, passthrough_threshold);
+}
+inline BytesSink* FdWriter::input() { return upb_fdwriter_input(this); }
+inline bool FdWriter::Flush() { return upb_fdwriter_flush(this); }
+inline const upb_fdwriter_stats* FdWriter::stats() const {
+  return upb_fdwriter_getstats(this);
+}
+}  // namespace stdc
+}  // namespace upb
+
+#endif
+
+#endif  /* UPB_STDC_FDWRITER_H_ */
@@ -344,11 +344,13 @@ bool upb_def_freeze(upb_def *const* defs, int n, upb_status *s) {
     upb_enumdef *e = upb_dyncast_enumdef_mutable(defs[i]);
     if (m) {
       upb_inttable_compact(&m->itof);
+      upb_strtable_compact(&m->ntof);
       if (!assign_msg_indices(m, s)) {
         goto err;
       }
     } else if (e) {
       upb_inttable_compact(&e->iton);
+      upb_strtable_compact(&e->ntoi);
     }
   }
 
@@ -20,8 +20,8 @@
 #include "upb/sink.h"
 #include "upb/descriptor/descriptor.upb.h"
 
-static char *upb_strndup(const char *buf, size_t n) {
-  char *ret = malloc(n + 1);
+static char *upb_strndup(upb_alloc *alloc, const char *buf, size_t n) {
+  char *ret = upb_malloc(alloc, n + 1);
   if (!ret) return NULL;
   memcpy(ret, buf, n);
   ret[n] = '\0';
@@ -33,11 +33,12 @@ static char *upb_strndup(const char *buf, size_t n) {
 //   join("Foo.Bar", "Baz") -> "Foo.Bar.Baz"
 //   join("", "Baz") -> "Baz"
 // Caller owns a ref on the returned string.
-static char *upb_join(const char *base, const char *name) {
+static char *upb_join(upb_alloc *alloc, const char *base, const char *name) {
   if (!base || strlen(base) == 0) {
-    return upb_strdup(name);
+    return upb_strndup(alloc, name, strlen(name));
   } else {
-    char *ret = malloc(strlen(base) + strlen(name) + 2);
+    char *ret = upb_malloc(alloc, strlen(base) + strlen(name) + 2);
+    if (!ret) return NULL;
     ret[0] = '\0';
     strcat(ret, base);
     strcat(ret, ".");
@@ -54,21 +55,24 @@ void upb_deflist_init(upb_deflist *l) {
   l->defs = NULL;
   l->len = 0;
   l->owned = true;
+  l->alloc = &upb_alloc_global;
 }
 
 void upb_deflist_uninit(upb_deflist *l) {
   if (l->owned)
     for(size_t i = 0; i < l->len; i++)
       upb_def_unref(l->defs[i], l);
-  free(l->defs);
+  upb_free(l->alloc, l->defs);
 }
 
 bool upb_deflist_push(upb_deflist *l, upb_def *d) {
   if(++l->len >= l->size) {
     size_t new_size = UPB_MAX(l->size, 4);
     new_size *= 2;
-    l->defs = realloc(l->defs, new_size * sizeof(void *));
-    if (!l->defs) return false;
+    upb_def **defs = upb_realloc(l->alloc, l->defs, l->size * sizeof(void *),
+                                 new_size * sizeof(void *));
+    if (!defs) return false;
+    l->defs = defs;
     l->size = new_size;
   }
   l->defs[l->len - 1] = d;
@@ -90,9 +94,9 @@ static upb_def *upb_deflist_last(upb_deflist *l) {
 static void upb_deflist_qualify(upb_deflist *l, char *str, int32_t start) {
   for (uint32_t i = start; i < l->len; i++) {
     upb_def *def = l->defs[i];
-    char *name = upb_join(str, upb_def_fullname(def));
+    char *name = upb_join(l->alloc, str, upb_def_fullname(def));
     upb_def_setfullname(def, name, NULL);
-    free(name);
+    upb_free(l->alloc, name);
   }
 }
 
@@ -107,18 +111,26 @@ void upb_descreader_init(upb_descreader *r, const upb_handlers *handlers,
   r->stack_len = 0;
   r->name = NULL;
   r->default_string = NULL;
+  r->alloc = &upb_alloc_global;
 }
 
 void upb_descreader_uninit(upb_descreader *r) {
-  free(r->name);
+  upb_free(r->alloc, r->name);
   upb_deflist_uninit(&r->defs);
-  free(r->default_string);
+  upb_free(r->alloc, r->default_string);
   while (r->stack_len > 0) {
     upb_descreader_frame *f = &r->stack[--r->stack_len];
-    free(f->name);
+    upb_free(r->alloc, f->name);
   }
 }
 
+void upb_descreader_setalloc(upb_descreader *r, upb_alloc *alloc) {
+  // We can't switch allocators once we've allocated from the old one.
+  assert(!r->defs.defs && !r->name && !r->default_string && r->stack_len == 0);
+  r->alloc = alloc;
+  r->defs.alloc = alloc;
+}
+
 upb_def **upb_descreader_getdefs(upb_descreader *r, void *owner, int *n) {
   *n = r->defs.len;
   upb_deflist_donaterefs(&r->defs, owner);
@@ -151,13 +163,13 @@ void upb_descreader_startcontainer(upb_descreader *r) {
 void upb_descreader_endcontainer(upb_descreader *r) {
   upb_descreader_frame *f = &r->stack[--r->stack_len];
   upb_deflist_qualify(&r->defs, f->name, f->start);
-  free(f->name);
+  upb_free(r->alloc, f->name);
   f->name = NULL;
 }
 
 void upb_descreader_setscopename(upb_descreader *r, char *str) {
   upb_descreader_frame *f = &r->stack[r->stack_len-1];
-  free(f->name);
+  upb_free(r->alloc, f->name);
   f->name = str;
 }
 
@@ -182,7 +194,7 @@ static size_t file_onpackage(void *closure, const void *hd, const char *buf,
   UPB_UNUSED(handle);
   upb_descreader *r = closure;
   // XXX: see comment at the top of the file.
-  upb_descreader_setscopename(r, upb_strndup(buf, n));
+  upb_descreader_setscopename(r, upb_strndup(r->alloc, buf, n));
   return n;
 }
 
@@ -201,8 +213,8 @@ static size_t enumval_onname(void *closure, const void *hd, const char *buf,
   UPB_UNUSED(handle);
   upb_descreader *r = closure;
   // XXX: see comment at the top of the file.
-  free(r->name);
-  r->name = upb_strndup(buf, n);
+  upb_free(r->alloc, r->name);
+  r->name = upb_strndup(r->alloc, buf, n);
   r->saw_name = true;
   return n;
 }
@@ -224,7 +236,7 @@ static bool enumval_endmsg(void *closure, const void *hd, upb_status *status) {
   }
   upb_enumdef *e = upb_downcast_enumdef_mutable(upb_descreader_last(r));
   upb_enumdef_addval(e, r->name, r->number, status);
-  free(r->name);
+  upb_free(r->alloc, r->name);
   r->name = NULL;
   return true;
 }
@@ -259,9 +271,9 @@ static size_t enum_onname(void *closure, const void *hd, const char *buf,
   UPB_UNUSED(handle);
   upb_descreader *r = closure;
   // XXX: see comment at the top of the file.
-  char *fullname = upb_strndup(buf, n);
+  char *fullname = upb_strndup(r->alloc, buf, n);
   upb_def_setfullname(upb_descreader_last(r), fullname, NULL);
-  free(fullname);
+  upb_free(r->alloc, fullname);
   return n;
 }
 
@@ -270,7 +282,7 @@ static bool field_startmsg(void *closure, const void *hd) {
   UPB_UNUSED(hd);
   upb_descreader *r = closure;
   r->f = upb_fielddef_new(&r->defs);
-  free(r->default_string);
+  upb_free(r->alloc, r->default_string);
   r->default_string = NULL;
 
   // fielddefs default to packed, but descriptors default to non-packed.
@@ -283,6 +295,8 @@ static bool field_startmsg(void *closure, const void *hd) {
 static bool parse_default(char *str, upb_fielddef *f) {
   bool success = true;
   char *end;
+  // The strto*() functions only set errno on failure.
+  errno = 0;
   switch (upb_fielddef_type(f)) {
     case UPB_TYPE_INT32: {
       long val = strtol(str, &end, 0);
@@ -416,9 +430,9 @@ static size_t field_onname(void *closure, const void *hd, const char *buf,
   UPB_UNUSED(handle);
   upb_descreader *r = closure;
   // XXX: see comment at the top of the file.
-  char *name = upb_strndup(buf, n);
+  char *name = upb_strndup(r->alloc, buf, n);
   upb_fielddef_setname(r->f, name, NULL);
-  free(name);
+  upb_free(r->alloc, name);
   return n;
 }
 
@@ -428,9 +442,9 @@ static size_t field_ontypename(void *closure, const void *hd, const char *buf,
   UPB_UNUSED(handle);
   upb_descreader *r = closure;
   // XXX: see comment at the top of the file.
-  char *name = upb_strndup(buf, n);
+  char *name = upb_strndup(r->alloc, buf, n);
   upb_fielddef_setsubdefname(r->f, name, NULL);
-  free(name);
+  upb_free(r->alloc, name);
   return n;
 }
 
@@ -440,9 +454,9 @@ static size_t field_onextendee(void *closure, const void *hd, const char *buf,
   UPB_UNUSED(handle);
   upb_descreader *r = closure;
   // XXX: see comment at the top of the file.
-  char *name = upb_strndup(buf, n);
+  char *name = upb_strndup(r->alloc, buf, n);
   upb_fielddef_setcontainingtypename(r->f, name, NULL);
-  free(name);
+  upb_free(r->alloc, name);
   return n;
 }
 
@@ -454,8 +468,8 @@ static size_t field_ondefaultval(void *closure, const void *hd, const char *buf,
   // Have to convert from string to the correct type, but we might not know the
   // type yet, so we save it as a string until the end of the field.
   // XXX: see comment at the top of the file.
-  free(r->default_string);
-  r->default_string = upb_strndup(buf, n);
+  upb_free(r->alloc, r->default_string);
+  r->default_string = upb_strndup(r->alloc, buf, n);
   return n;
 }
 
@@ -487,7 +501,7 @@ static size_t msg_onname(void *closure, const void *hd, const char *buf,
   upb_descreader *r = closure;
   upb_msgdef *m = upb_descreader_top(r);
   // XXX: see comment at the top of the file.
-  char *name = upb_strndup(buf, n);
+  char *name = upb_strndup(r->alloc, buf, n);
   upb_def_setfullname(UPB_UPCAST(m), name, NULL);
   upb_descreader_setscopename(r, name);  // Passes ownership of name.
   return n;
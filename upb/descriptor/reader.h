@@ -33,6 +33,7 @@ typedef struct {
   size_t len;
   size_t size;
   bool owned;
+  upb_alloc *alloc;  // For "defs" (not the defs themselves).
 } upb_deflist;
 
 // We keep a stack of all the messages scopes we are currently in, as well as
@@ -77,6 +78,12 @@ UPB_DEFINE_CLASS0(upb::descriptor::Reader,
   // Resets the reader's state and discards any defs it may have built.
   void Reset();
 
+  // Sets the allocator for the reader's scratch strings and for the array
+  // that GetDefs() returns, for example an Arena that holds all memory for
+  // the current request.  The defs themselves are refcounted and always come
+  // from the heap.  Must be called before anything is read.
+  void SetAllocator(Allocator* alloc);
+
   // The reader's input; this is where descriptor.proto data should be sent.
   Sink* input();
 
@@ -106,6 +113,8 @@ UPB_DEFINE_STRUCT0(upb_descreader,
   char *default_string;
 
   upb_fielddef *f;
+
+  upb_alloc *alloc;
 ));
 
 UPB_BEGIN_EXTERN_C  // {
@@ -115,6 +124,7 @@ void upb_descreader_init(upb_descreader *r, const upb_handlers *handlers,
                          upb_status *status);
 void upb_descreader_uninit(upb_descreader *r);
 void upb_descreader_reset(upb_descreader *r);
+void upb_descreader_setalloc(upb_descreader *r, upb_alloc *alloc);
 upb_sink *upb_descreader_input(upb_descreader *r);
 upb_def **upb_descreader_getdefs(upb_descreader *r, void *owner, int *n);
 const upb_handlers *upb_descreader_newhandlers(const void *owner);
@@ -130,6 +140,9 @@ inline Reader::Reader(const Handlers *h, Status *s) {
 }
 inline Reader::~Reader() { upb_descreader_uninit(this); }
 inline void Reader::Reset() { upb_descreader_reset(this); }
+inline void Reader::SetAllocator(Allocator* alloc) {
+  upb_descreader_setalloc(this, alloc);
+}
 inline Sink* Reader::input() { return upb_descreader_input(this); }
 inline upb::Def** Reader::GetDefs(void* owner, int* n) {
   return upb_descreader_getdefs(this, owner, n);
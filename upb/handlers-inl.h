@@ -1033,6 +1033,9 @@ inline const MessageDef *Handlers::message_def() const {
 inline bool Handlers::AddCleanup(void *p, upb_handlerfree *func) {
   return upb_handlers_addcleanup(this, p, func);
 }
+inline Allocator* Handlers::HandlerDataAllocator() {
+  return upb_handlers_alloc(this);
+}
 inline bool Handlers::SetStartMessageHandler(
     const Handlers::StartMessageHandler &handler) {
   assert(!handler.registered_);
@@ -1082,6 +1085,22 @@ inline bool Handlers::SetStartSubMessageHandler(
   handler.AddCleanup(this);
   return upb_handlers_setstartsubmsg(this, f, handler.handler_, &handler.attr_);
 }
+inline bool Handlers::SetStartSequenceHintHandler(
+    const FieldDef *f, const StartFieldHintHandler &handler) {
+  assert(!handler.registered_);
+  handler.registered_ = true;
+  handler.AddCleanup(this);
+  return upb_handlers_setstartseqhint(this, f, handler.handler_,
+                                      &handler.attr_);
+}
+inline bool Handlers::SetStartSubMessageHintHandler(
+    const FieldDef *f, const StartFieldHintHandler &handler) {
+  assert(!handler.registered_);
+  handler.registered_ = true;
+  handler.AddCleanup(this);
+  return upb_handlers_setstartsubmsghint(this, f, handler.handler_,
+                                         &handler.attr_);
+}
 inline bool Handlers::SetEndSubMessageHandler(const FieldDef *f,
                                               const EndFieldHandler &handler) {
   assert(!handler.registered_);
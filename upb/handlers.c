@@ -32,6 +32,7 @@ static void freehandlers(upb_refcounted *r) {
   }
 
   upb_inttable_uninit(&h->cleanup_);
+  upb_arena_uninit(&h->arena_);
   upb_msgdef_unref(h->msg, h);
   free(h->sub);
   free(h);
@@ -152,6 +153,7 @@ static bool doset(upb_handlers *h, int32_t sel, const upb_fielddef *f,
   upb_handlerattr set_attr = UPB_HANDLERATTR_INITIALIZER;
   if (attr) {
     set_attr = *attr;
+    set_attr.sizehint_ = false;  // Only setstarthint() below may set this.
   }
 
   // Check that the given closure type matches the closure type that has been
@@ -282,6 +284,7 @@ upb_handlers *upb_handlers_new(const upb_msgdef *md, const void *owner) {
   upb_handlers *h = calloc(sizeof(*h) + extra, 1);
   if (!h) return NULL;
 
+  upb_arena_init(&h->arena_);
   h->msg = md;
   upb_msgdef_ref(h->msg, h);
   upb_status_clear(&h->status_);
@@ -353,6 +356,30 @@ SETTER(endseq,      upb_endfield_handlerfunc*,    UPB_HANDLER_ENDSEQ);
 
 #undef SETTER
 
+// Start handlers that take a size hint share the selector with their plain
+// counterparts; the attr records which kind of function is stored there.
+static bool setstarthint(upb_handlers *h, const upb_fielddef *f,
+                         upb_handlertype_t type,
+                         upb_startfieldhint_handlerfunc *func,
+                         upb_handlerattr *attr) {
+  int32_t sel = trygetsel(h, f, type);
+  if (!doset(h, sel, f, type, (upb_func*)func, attr)) return false;
+  h->table[sel].attr.sizehint_ = true;
+  return true;
+}
+
+bool upb_handlers_setstartseqhint(upb_handlers *h, const upb_fielddef *f,
+                                  upb_startfieldhint_handlerfunc *func,
+                                  upb_handlerattr *attr) {
+  return setstarthint(h, f, UPB_HANDLER_STARTSEQ, func, attr);
+}
+
+bool upb_handlers_setstartsubmsghint(upb_handlers *h, const upb_fielddef *f,
+                                     upb_startfieldhint_handlerfunc *func,
+                                     upb_handlerattr *attr) {
+  return setstarthint(h, f, UPB_HANDLER_STARTSUBMSG, func, attr);
+}
+
 bool upb_handlers_setstartmsg(upb_handlers *h, upb_startmsg_handlerfunc *func,
                               upb_handlerattr *attr) {
   return doset(h, UPB_STARTMSG_SELECTOR, NULL, UPB_HANDLER_INT32,
@@ -411,6 +438,11 @@ bool upb_handlers_addcleanup(upb_handlers *h, void *p, upb_handlerfree *func) {
   return true;
 }
 
+upb_alloc *upb_handlers_alloc(upb_handlers *h) {
+  assert(!upb_handlers_isfrozen(h));
+  return upb_arena_alloc(&h->arena_);
+}
+
 
 /* "Static" methods ***********************************************************/
 
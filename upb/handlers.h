@@ -90,6 +90,8 @@ UPB_INLINE upb_func *upb_handlers_gethandler(const upb_handlers *h,
 UPB_INLINE const void *upb_handlerattr_handlerdata(const upb_handlerattr *attr);
 UPB_INLINE const void *upb_handlers_gethandlerdata(const upb_handlers *h,
                                                    upb_selector_t s);
+UPB_INLINE bool upb_handlers_takessizehint(const upb_handlers *h,
+                                           upb_selector_t s);
 
 UPB_INLINE void upb_bufhandle_init(upb_bufhandle *h);
 UPB_INLINE void upb_bufhandle_setobj(upb_bufhandle *h, const void *obj,
@@ -150,15 +152,18 @@ UPB_DEFINE_CLASS0(upb::HandlerAttributes,
  private:
   friend UPB_INLINE const void * ::upb_handlerattr_handlerdata(
       const upb_handlerattr *attr);
+  friend UPB_INLINE bool ::upb_handlers_takessizehint(const upb_handlers *h,
+                                                      upb_selector_t s);
 ,
 UPB_DEFINE_STRUCT0(upb_handlerattr,
   const void *handler_data_;
   const void *closure_type_;
   const void *return_closure_type_;
   bool alwaysok_;
+  bool sizehint_;  // Set internally by the Set*HintHandler() functions.
 ));
 
-#define UPB_HANDLERATTR_INITIALIZER {NULL, NULL, NULL, false}
+#define UPB_HANDLERATTR_INITIALIZER {NULL, NULL, NULL, false, false}
 
 typedef struct {
   upb_func *func;
@@ -240,6 +245,8 @@ UPB_DEFINE_CLASS1(upb::Handlers, upb::RefCounted,
   typedef upb_handlertype_t Type;
 
   typedef Handler<void *(*)(void *, const void *)> StartFieldHandler;
+  typedef Handler<void *(*)(void *, const void *, size_t)>
+      StartFieldHintHandler;
   typedef Handler<bool (*)(void *, const void *)> EndFieldHandler;
   typedef Handler<bool (*)(void *, const void *)> StartMessageHandler;
   typedef Handler<bool (*)(void *, const void *, Status*)> EndMessageHandler;
@@ -311,6 +318,11 @@ UPB_DEFINE_CLASS1(upb::Handlers, upb::RefCounted,
   // been registered, the function returns false and does nothing.
   bool AddCleanup(void *ptr, upb_handlerfree *cleanup);
 
+  // Returns an allocator for handler data.  Memory allocated from it is freed
+  // all at once when these handlers are freed, which is cheaper than a
+  // malloc() plus AddCleanup() per handler.  Only usable before Freeze().
+  Allocator* HandlerDataAllocator();
+
   // Sets the startmsg handler for the message, which is defined as follows:
   //
   //   bool startmsg(MyType* closure) {
@@ -419,6 +431,23 @@ UPB_DEFINE_CLASS1(upb::Handlers, upb::RefCounted,
   // repeated field.
   bool SetStartSequenceHandler(const FieldDef* f, const StartFieldHandler& h);
 
+  // Like SetStartSequenceHandler(), but the handler also receives a hint of
+  // how many bytes of input the sequence occupies, which can be used to
+  // preallocate storage:
+  //
+  //   MySubClosure *startseq(MyClosure* c, const MyHandlerData* d,
+  //                          size_t size_hint) {
+  //     // "size_hint" is the encoded length of the sequence in bytes, or 0
+  //     // if it is not known in advance.  For a packed fixed-width field,
+  //     // size_hint / width is exactly the number of elements.
+  //     return closure;
+  //   }
+  //
+  // Only one of the two may be set for a given field.  Sources that don't
+  // know the size (or don't compute it) always pass 0.
+  bool SetStartSequenceHintHandler(const FieldDef* f,
+                                   const StartFieldHintHandler& h);
+
   // Sets the startsubmsg handler for the given field, which is defined as
   // follows:
   //
@@ -435,6 +464,12 @@ UPB_DEFINE_CLASS1(upb::Handlers, upb::RefCounted,
   // submessage/group field.
   bool SetStartSubMessageHandler(const FieldDef* f, const StartFieldHandler& h);
 
+  // Like SetStartSubMessageHandler(), but the handler also receives the
+  // encoded length of the submessage in bytes, or 0 if it is not known (as is
+  // always the case for groups).  See SetStartSequenceHintHandler().
+  bool SetStartSubMessageHintHandler(const FieldDef* f,
+                                     const StartFieldHintHandler& h);
+
   // Sets the endsubmsg handler for the given field, which is defined as
   // follows:
   //
@@ -502,6 +537,8 @@ UPB_DEFINE_CLASS1(upb::Handlers, upb::RefCounted,
       const upb_handlers *h, upb_selector_t s);
   friend UPB_INLINE const void *::upb_handlers_gethandlerdata(
       const upb_handlers *h, upb_selector_t s);
+  friend UPB_INLINE bool ::upb_handlers_takessizehint(
+      const upb_handlers *h, upb_selector_t s);
 
 ,
 UPB_DEFINE_STRUCT(upb_handlers, upb_refcounted,
@@ -509,6 +546,7 @@ UPB_DEFINE_STRUCT(upb_handlers, upb_refcounted,
   const upb_handlers **sub;
   const void *top_closure_type;
   upb_inttable cleanup_;
+  upb_arena arena_;  // Backs upb_handlers_alloc().
   upb_status status_;  // Used only when mutable.
   upb_handlers_tabent table[1];  // Dynamically-sized field handler array.
 ));
@@ -622,6 +660,8 @@ UPB_BEGIN_EXTERN_C
 typedef bool upb_startmsg_handlerfunc(void *c, const void*);
 typedef bool upb_endmsg_handlerfunc(void *c, const void *, upb_status *status);
 typedef void* upb_startfield_handlerfunc(void *c, const void *hd);
+typedef void* upb_startfieldhint_handlerfunc(void *c, const void *hd,
+                                             size_t size_hint);
 typedef bool upb_endfield_handlerfunc(void *c, const void *hd);
 typedef bool upb_int32_handlerfunc(void *c, const void *hd, int32_t val);
 typedef bool upb_int64_handlerfunc(void *c, const void *hd, int64_t val);
@@ -675,6 +715,7 @@ const upb_status *upb_handlers_status(upb_handlers *h);
 void upb_handlers_clearerr(upb_handlers *h);
 const upb_msgdef *upb_handlers_msgdef(const upb_handlers *h);
 bool upb_handlers_addcleanup(upb_handlers *h, void *p, upb_handlerfree *hfree);
+upb_alloc *upb_handlers_alloc(upb_handlers *h);
 
 bool upb_handlers_setstartmsg(upb_handlers *h, upb_startmsg_handlerfunc *func,
                               upb_handlerattr *attr);
@@ -716,6 +757,12 @@ bool upb_handlers_setstartsubmsg(upb_handlers *h, const upb_fielddef *f,
 bool upb_handlers_setendsubmsg(upb_handlers *h, const upb_fielddef *f,
                                upb_endfield_handlerfunc *func,
                                upb_handlerattr *attr);
+bool upb_handlers_setstartseqhint(upb_handlers *h, const upb_fielddef *f,
+                                  upb_startfieldhint_handlerfunc *func,
+                                  upb_handlerattr *attr);
+bool upb_handlers_setstartsubmsghint(upb_handlers *h, const upb_fielddef *f,
+                                     upb_startfieldhint_handlerfunc *func,
+                                     upb_handlerattr *attr);
 bool upb_handlers_setendseq(upb_handlers *h, const upb_fielddef *f,
                             upb_endfield_handlerfunc *func,
                             upb_handlerattr *attr);
@@ -740,6 +787,14 @@ UPB_INLINE const void *upb_handlers_gethandlerdata(const upb_handlers *h,
   return upb_handlerattr_handlerdata(&h->table[s].attr);
 }
 
+// Returns true if the STARTSEQ or STARTSUBMSG handler for this selector was
+// registered with upb_handlers_setstart{seq,submsg}hint(), in which case it
+// is really a upb_startfieldhint_handlerfunc.
+UPB_INLINE bool upb_handlers_takessizehint(const upb_handlers *h,
+                                           upb_selector_t s) {
+  return h->table[s].attr.sizehint_;
+}
+
 // Handler types for single fields.
 // Right now we only have one for TYPE_BYTES but ones for other types
 // should follow.
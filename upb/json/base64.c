@@ -0,0 +1,233 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * The SSSE3 code follows Wojciech Muła's "Base64 encoding and decoding at
+ * almost the speed of a memory copy" (with Daniel Lemire, 2018), as laid out
+ * in Alfred Klomp's libbase64.
+ */
+
+#include "upb/json/base64.int.h"
+
+#include <stdint.h>
+
+#if defined(__GNUC__) && defined(__SSSE3__)
+#include <tmmintrin.h>
+#define UPB_JSON_BASE64_SSSE3
+#endif
+
+static const char kBase64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// The value of each base64 character, or -1.
+static const signed char kBase64Values[256] = {
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      62/*+*/, -1,      -1,      -1,      63/*/ */,
+  52/*0*/, 53/*1*/, 54/*2*/, 55/*3*/, 56/*4*/, 57/*5*/, 58/*6*/, 59/*7*/,
+  60/*8*/, 61/*9*/, -1,      -1,      -1,      -1,      -1,      -1,
+  -1,       0/*A*/,  1/*B*/,  2/*C*/,  3/*D*/,  4/*E*/,  5/*F*/,  6/*G*/,
+   7/*H*/,  8/*I*/,  9/*J*/, 10/*K*/, 11/*L*/, 12/*M*/, 13/*N*/, 14/*O*/,
+  15/*P*/, 16/*Q*/, 17/*R*/, 18/*S*/, 19/*T*/, 20/*U*/, 21/*V*/, 22/*W*/,
+  23/*X*/, 24/*Y*/, 25/*Z*/, -1,      -1,      -1,      -1,      -1,
+  -1,      26/*a*/, 27/*b*/, 28/*c*/, 29/*d*/, 30/*e*/, 31/*f*/, 32/*g*/,
+  33/*h*/, 34/*i*/, 35/*j*/, 36/*k*/, 37/*l*/, 38/*m*/, 39/*n*/, 40/*o*/,
+  41/*p*/, 42/*q*/, 43/*r*/, 44/*s*/, 45/*t*/, 46/*u*/, 47/*v*/, 48/*w*/,
+  49/*x*/, 50/*y*/, 51/*z*/, -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
+  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1
+};
+
+/* Encoding *******************************************************************/
+
+#ifdef UPB_JSON_BASE64_SSSE3
+
+// Spreads the 12 bytes in the low end of "in" over 16 bytes, one 6-bit value
+// in each.
+static __m128i enc_reshuffle(__m128i in) {
+  // Put the three bytes of each group in each 32-bit lane, in the order that
+  // lets the multiplications below shift each 6-bit value into place.
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                         4, 5, 3, 4, 1, 2, 0, 1));
+  __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+// Maps each 6-bit value to its character, by adding the offset for its range:
+// A-Z, a-z, 0-9, + or /.
+static __m128i enc_translate(__m128i in) {
+  const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+                                        -4, -4, -4, -4, -19, -16, 0, 0);
+  // 0 for A-Z, and one less than the right index for the other ranges...
+  __m128i index = _mm_subs_epu8(in, _mm_set1_epi8(51));
+  // ...which we fix by subtracting -1 for values above 25.
+  index = _mm_sub_epi8(index, _mm_cmpgt_epi8(in, _mm_set1_epi8(25)));
+  return _mm_add_epi8(in, _mm_shuffle_epi8(offsets, index));
+}
+
+#endif
+
+size_t upb_json_base64encode(const char *in, size_t len, char *out) {
+  const unsigned char *from = (const unsigned char*)in;
+  const unsigned char *end = from + len;
+  char *to = out;
+
+#ifdef UPB_JSON_BASE64_SSSE3
+  // Each iteration loads 16 bytes but only consumes 12.
+  for (; end - from >= 16; from += 12, to += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)from);
+    _mm_storeu_si128((__m128i*)to, enc_translate(enc_reshuffle(v)));
+  }
+#endif
+
+  for (; end - from > 2; from += 3, to += 4) {
+    to[0] = kBase64Chars[from[0] >> 2];
+    to[1] = kBase64Chars[((from[0] & 0x3) << 4) | (from[1] >> 4)];
+    to[2] = kBase64Chars[((from[1] & 0xf) << 2) | (from[2] >> 6)];
+    to[3] = kBase64Chars[from[2] & 0x3f];
+  }
+
+  switch (end - from) {
+    case 2:
+      to[0] = kBase64Chars[from[0] >> 2];
+      to[1] = kBase64Chars[((from[0] & 0x3) << 4) | (from[1] >> 4)];
+      to[2] = kBase64Chars[(from[1] & 0xf) << 2];
+      to[3] = '=';
+      to += 4;
+      break;
+    case 1:
+      to[0] = kBase64Chars[from[0] >> 2];
+      to[1] = kBase64Chars[((from[0] & 0x3) << 4)];
+      to[2] = '=';
+      to[3] = '=';
+      to += 4;
+      break;
+  }
+
+  return to - out;
+}
+
+/* Decoding *******************************************************************/
+
+#ifdef UPB_JSON_BASE64_SSSE3
+
+// Converts 16 characters to their 6-bit values.  Returns false if any of them
+// isn't in the base64 alphabet (including '=').
+static bool dec_translate(__m128i *v) {
+  // A character is valid iff the bits we look up for its low and high nibbles
+  // have nothing in common.
+  const __m128i lo_bits = _mm_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i hi_bits = _mm_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  // The offset to add to each character, by high nibble ('/' gets index 1).
+  const __m128i offsets = _mm_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+  __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(*v, 4), mask_2f);
+  __m128i lo_nibbles = _mm_and_si128(*v, mask_2f);
+  __m128i hi = _mm_shuffle_epi8(hi_bits, hi_nibbles);
+  __m128i lo = _mm_shuffle_epi8(lo_bits, lo_nibbles);
+  if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+                                       _mm_setzero_si128()))) {
+    return false;
+  }
+
+  __m128i is_slash = _mm_cmpeq_epi8(*v, mask_2f);
+  __m128i offset =
+      _mm_shuffle_epi8(offsets, _mm_add_epi8(is_slash, hi_nibbles));
+  *v = _mm_add_epi8(*v, offset);
+  return true;
+}
+
+// Packs sixteen 6-bit values into the low 12 bytes.
+static __m128i dec_reshuffle(__m128i in) {
+  // Merge pairs of values into 12 bits, then pairs of those into 24.
+  __m128i pairs = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+  __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  return _mm_shuffle_epi8(groups, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                                14, 13, 12, -1, -1, -1, -1));
+}
+
+#endif
+
+static bool isbase64(unsigned char ch) { return kBase64Values[ch] >= 0; }
+
+upb_json_base64status upb_json_base64decode(const char *in, size_t len,
+                                            char *out, size_t *outlen) {
+  const unsigned char *from = (const unsigned char*)in;
+  const unsigned char *end = from + len;
+  char *to = out;
+
+  if (len % 4 != 0) return UPB_JSON_BASE64_BADLENGTH;
+
+#ifdef UPB_JSON_BASE64_SSSE3
+  // Each iteration stores 16 bytes but only produces 12.  Stopping 24 bytes
+  // from the end keeps the stores inside the output, and leaves any padding
+  // to the loop below.
+  for (; end - from >= 24; from += 16, to += 12) {
+    __m128i v = _mm_loadu_si128((const __m128i*)from);
+    if (!dec_translate(&v)) break;
+    _mm_storeu_si128((__m128i*)to, dec_reshuffle(v));
+  }
+#endif
+
+  for (; from < end; from += 4, to += 3) {
+    // Converting to unsigned first sets the high bit for any -1 (an invalid
+    // character), whatever the shift.
+    uint32_t val = (uint32_t)kBase64Values[from[0]] << 18 |
+                   (uint32_t)kBase64Values[from[1]] << 12 |
+                   (uint32_t)kBase64Values[from[2]] << 6 |
+                   (uint32_t)kBase64Values[from[3]];
+    if (val & 0x80000000) break;
+    to[0] = val >> 16;
+    to[1] = (val >> 8) & 0xff;
+    to[2] = val & 0xff;
+  }
+
+  if (from < end) {
+    // An invalid character, or padding.  Padding is only allowed at the end,
+    // as "xx==" or "xxx=".
+    int i;
+    for (i = 0; i < 4; i++) {
+      if (!isbase64(from[i]) && from[i] != '=') return UPB_JSON_BASE64_BADCHAR;
+    }
+    if (from + 4 != end || !isbase64(from[0]) || !isbase64(from[1]) ||
+        from[3] != '=') {
+      return UPB_JSON_BASE64_BADPADDING;
+    }
+    uint32_t val = kBase64Values[from[0]] << 18 | kBase64Values[from[1]] << 12;
+    *to++ = val >> 16;
+    if (from[2] != '=') {
+      val |= kBase64Values[from[2]] << 6;
+      *to++ = (val >> 8) & 0xff;
+    }
+  }
+
+  *outlen = to - out;
+  return UPB_JSON_BASE64_OK;
+}
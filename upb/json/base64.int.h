@@ -0,0 +1,47 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * Base64 (the regular alphabet with padding, not the "web-safe" one) for JSON
+ * bytes fields, shared by upb::json::Parser, upb::json::Printer and
+ * upb::json::Transcoder.
+ *
+ * Both directions work on whole buffers rather than one group at a time, so
+ * that callers can hand large chunks to their output.  When the compiler
+ * targets SSSE3 they convert 12 bytes <-> 16 characters at a time (using
+ * Wojciech Muła's pshufb-based algorithms); otherwise they use lookup tables.
+ */
+
+#ifndef UPB_JSON_BASE64_H_
+#define UPB_JSON_BASE64_H_
+
+#include <stddef.h>
+
+#include "upb/upb.h"
+
+// The encoded length of "n" bytes.
+#define UPB_JSON_BASE64_ENCLEN(n) (((n) + 2) / 3 * 4)
+
+typedef enum {
+  UPB_JSON_BASE64_OK,
+  UPB_JSON_BASE64_BADLENGTH,   // Not a multiple of 4 characters.
+  UPB_JSON_BASE64_BADCHAR,     // Not in the base64 alphabet.
+  UPB_JSON_BASE64_BADPADDING   // '=' other than at the end of the input.
+} upb_json_base64status;
+
+UPB_BEGIN_EXTERN_C  // {
+
+// Encodes "len" bytes into UPB_JSON_BASE64_ENCLEN(len) characters at "out",
+// padding the last group if "len" isn't a multiple of 3.  To encode a value
+// in pieces, pass multiples of 3 bytes for all but the last piece.
+size_t upb_json_base64encode(const char *in, size_t len, char *out);
+
+// Decodes the "len" characters at "in" into "out", which must have room for
+// len / 4 * 3 bytes, and sets "*outlen" to the number of bytes decoded.
+upb_json_base64status upb_json_base64decode(const char *in, size_t len,
+                                            char *out, size_t *outlen);
+
+UPB_END_EXTERN_C  // }
+
+#endif  // UPB_JSON_BASE64_H_
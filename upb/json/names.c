@@ -0,0 +1,138 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ */
+
+#include "upb/json/names.int.h"
+
+// How many hash seeds we try when building a map.
+#define SEEDS 16
+
+// Writes the lowerCamelCase form of "name" (every underscore dropped and the
+// letter after it capitalized, as protoc does) to "out", which must have room
+// for strlen(name) bytes.  Returns its length.
+static size_t tocamel(const char *name, char *out) {
+  char *p = out;
+  bool upper = false;
+  for (; *name; name++) {
+    char ch = *name;
+    if (ch == '_') {
+      upper = true;
+    } else {
+      if (upper && ch >= 'a' && ch <= 'z') ch += 'A' - 'a';
+      *p++ = ch;
+      upper = false;
+    }
+  }
+  return p - out;
+}
+
+// Returns true if "e" landed outside its home slot.
+static bool insert(upb_json_namemap *map, const upb_json_nameent *e) {
+  size_t home = upb_json_namehash(e->name, e->len, map->seed) >> map->shift;
+  size_t i = home;
+  while (map->slots[i].name) i = (i + 1) & map->mask;
+  map->slots[i] = *e;
+  return i != home;
+}
+
+// Rebuilds the map from scratch with the current seed.  Returns the number of
+// entries outside their home slot.
+static size_t insertall(upb_json_namemap *map, const upb_json_nameent *ents,
+                        size_t n) {
+  memset(map->slots, 0, (map->mask + 1) * sizeof(*map->slots));
+  size_t displaced = 0;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if (insert(map, &ents[i])) displaced++;
+  }
+  return displaced;
+}
+
+bool upb_json_namemap_init(upb_json_namemap *map, const upb_msgdef *m,
+                           upb_alloc *alloc) {
+  size_t nfields = upb_msgdef_numfields(m);
+  size_t camelsize = 0;
+  upb_msg_iter i;
+  for (upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
+    camelsize += strlen(upb_fielddef_name(upb_msg_iter_field(&i)));
+  }
+
+  // Up to two names per field, and we keep the table at most half full.
+  size_t size = 8;
+  int lg2 = 3;
+  while (size < nfields * 4) {
+    size *= 2;
+    lg2++;
+  }
+
+  map->alloc = alloc;
+  map->slots = upb_malloc(alloc, size * sizeof(*map->slots));
+  map->mask = size - 1;
+  map->shift = 64 - lg2;
+  map->seed = 0;
+  map->camelnames = upb_malloc(alloc, camelsize + 1);
+  upb_json_nameent *ents =
+      upb_malloc(alloc, (nfields * 2 + 1) * sizeof(*ents));
+  if (!map->slots || !map->camelnames || !ents) {
+    upb_free(alloc, ents);
+    upb_json_namemap_uninit(map);
+    return false;
+  }
+
+  // Collect the names, using the map itself to weed out lowerCamelCase names
+  // that are taken.  The .proto names go in first so that they win.
+  size_t n = 0;
+  uint32_t index = 0;
+  insertall(map, ents, 0);
+  for (upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i), index++) {
+    upb_json_nameent *e = &ents[n++];
+    e->f = upb_msg_iter_field(&i);
+    e->name = upb_fielddef_name(e->f);
+    e->len = strlen(e->name);
+    e->index = index;
+    insert(map, e);
+  }
+
+  char *camel = map->camelnames;
+  index = 0;
+  for (upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i), index++) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    size_t len = tocamel(upb_fielddef_name(f), camel);
+    if (upb_json_namemap_lookup(map, camel, len)) continue;
+    upb_json_nameent *e = &ents[n++];
+    e->f = f;
+    e->name = camel;
+    e->len = len;
+    e->index = index;
+    insert(map, e);
+    camel += len;
+  }
+
+  // Now look for the seed that leaves the fewest names out of place.
+  uint64_t seed;
+  uint64_t best_seed = 0;
+  size_t best = SIZE_MAX;
+  for (seed = 0; seed < SEEDS; seed++) {
+    map->seed = seed * 0x9e3779b97f4a7c15ULL;
+    size_t displaced = insertall(map, ents, n);
+    if (displaced < best) {
+      best = displaced;
+      best_seed = map->seed;
+      if (displaced == 0) break;
+    }
+  }
+  if (map->seed != best_seed) {
+    map->seed = best_seed;
+    insertall(map, ents, n);
+  }
+
+  upb_free(alloc, ents);
+  return true;
+}
+
+void upb_json_namemap_uninit(upb_json_namemap *map) {
+  upb_free(map->alloc, map->slots);
+  upb_free(map->alloc, map->camelnames);
+}
@@ -0,0 +1,104 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * A map from JSON member names to the fields of one message type, shared by
+ * upb::json::Parser and upb::json::Transcoder.  Each field can be named
+ * either by its name in the .proto file ("foo_bar") or by the lowerCamelCase
+ * name that protoc uses for JSON ("fooBar").
+ *
+ * Looking up a member name is the one thing these parsers do for every
+ * member, so rather than a upb_strtable (a general-purpose hash over the
+ * whole key, then a chain of entries) this is an open-addressed table that
+ * is at most half full, with a hash that reads the key eight bytes at a
+ * time.  When the map is built we try several hash seeds and keep the one
+ * that puts the most names in their home slot -- for all but large
+ * messages, every name -- so a lookup is usually one hash and one
+ * comparison.
+ */
+
+#ifndef UPB_JSON_NAMES_H_
+#define UPB_JSON_NAMES_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "upb/def.h"
+
+typedef struct {
+  const char *name;  // NULL for an empty slot.
+  size_t len;
+  const upb_fielddef *f;
+  uint32_t index;    // Of "f", counting fields in upb_msg_begin() order.
+} upb_json_nameent;
+
+struct upb_json_namemap {
+  upb_json_nameent *slots;
+  size_t mask;
+  int shift;  // 64 - lg2(number of slots).
+  uint64_t seed;
+
+  // Storage for the lowerCamelCase names.
+  char *camelnames;
+
+  // Where "slots" and "camelnames" came from.
+  upb_alloc *alloc;
+};
+
+typedef struct upb_json_namemap upb_json_namemap;
+
+UPB_BEGIN_EXTERN_C  // {
+
+// Builds the map for "m", which must outlive it, with memory from "alloc".
+// Returns false if we ran out of memory.  If two fields have the same name in
+// some form, the name in the .proto file wins over a lowerCamelCase name, and
+// otherwise the field that comes first wins.
+bool upb_json_namemap_init(upb_json_namemap *map, const upb_msgdef *m,
+                           upb_alloc *alloc);
+void upb_json_namemap_uninit(upb_json_namemap *map);
+
+UPB_INLINE uint64_t upb_json_namehash(const char *p, size_t len,
+                                      uint64_t seed) {
+  // Multiplying by an odd constant is invertible, and the top bits of the
+  // product depend on every bit of its input, so the top bits of the result
+  // (which we use to pick a slot) depend on every byte of the key.  The last
+  // load may overlap the one before; mixing in the length makes up for that.
+  const uint64_t k = 0x9e3779b97f4a7c15ULL;
+  uint64_t h = seed ^ (len * k);
+  uint64_t w;
+  if (len > 8) {
+    const char *last = p + len - 8;
+    for (; p < last; p += 8) {
+      memcpy(&w, p, 8);
+      h = (h ^ w) * k;
+    }
+    memcpy(&w, last, 8);
+  } else if (len >= 4) {
+    uint32_t a, b;
+    memcpy(&a, p, 4);
+    memcpy(&b, p + len - 4, 4);
+    w = ((uint64_t)a << 32) | b;
+  } else if (len > 0) {
+    w = ((uint64_t)(uint8_t)p[0] << 16) | ((uint64_t)(uint8_t)p[len / 2] << 8) |
+        (uint8_t)p[len - 1];
+  } else {
+    w = 0;
+  }
+  return (h ^ w) * k;
+}
+
+// Returns the entry for the member name "name", or NULL if there is none.
+UPB_INLINE const upb_json_nameent *upb_json_namemap_lookup(
+    const upb_json_namemap *map, const char *name, size_t len) {
+  size_t i = upb_json_namehash(name, len, map->seed) >> map->shift;
+  for (;; i = (i + 1) & map->mask) {
+    const upb_json_nameent *e = &map->slots[i];
+    if (!e->name) return NULL;
+    if (e->len == len && memcmp(e->name, name, len) == 0) return e;
+  }
+}
+
+UPB_END_EXTERN_C  // }
+
+#endif  // UPB_JSON_NAMES_H_
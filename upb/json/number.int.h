@@ -0,0 +1,60 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * Number formatting and parsing shared by upb::json::Printer,
+ * upb::json::Parser and upb::json::Transcoder, so that they always agree.
+ *
+ * None of the formatting functions use snprintf() or the C locale, and none
+ * allocate: they write into a caller-supplied buffer of at least
+ * UPB_JSON_MAX_NUMBER_LEN bytes and return the number of bytes written (the
+ * result is not NULL-terminated).
+ */
+
+#ifndef UPB_JSON_NUMBER_H_
+#define UPB_JSON_NUMBER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "upb/upb.h"
+
+// Enough for any of the functions below, eg. "-1.2345678901234567e-308".
+#define UPB_JSON_MAX_NUMBER_LEN 32
+
+UPB_BEGIN_EXTERN_C  // {
+
+size_t upb_json_fmtint64(int64_t val, char *buf);
+size_t upb_json_fmtuint64(uint64_t val, char *buf);
+
+// Prints the shortest decimal string that parses back to exactly "val" (as a
+// double or float respectively), laid out like ECMAScript's
+// Number.prototype.toString(): plain notation for 1e-6 <= |val| < 1e21, and
+// otherwise exponential notation like "1e+21" or "1.5e-7".
+//
+// We use Grisu2, which always produces digits that round-trip, and which are
+// the shortest such digits for all but a fraction of a percent of inputs.
+//
+// NaN and the infinities, which JSON can't represent, come out as "nan",
+// "inf" and "-inf", like the snprintf("%g") we used to use.
+size_t upb_json_fmtdouble(double val, char *buf);
+size_t upb_json_fmtfloat(float val, char *buf);
+
+// Parse the JSON number in "buf", which needn't be NULL-terminated, and which
+// the caller has already checked against JSON's number syntax.  They return
+// false if the number doesn't fit in the type; the integer functions also
+// return false if it has a fraction or exponent.
+//
+// The results are exact (correctly rounded, for floating point) and don't
+// depend on the C locale.  Only numbers with more than 19 significant digits,
+// subnormals, overflows and a few near-halfway cases take the slow path
+// through strtod().
+bool upb_json_parseint64(const char *buf, size_t len, int64_t *val);
+bool upb_json_parseuint64(const char *buf, size_t len, uint64_t *val);
+bool upb_json_parsedouble(const char *buf, size_t len, double *val);
+bool upb_json_parsefloat(const char *buf, size_t len, float *val);
+
+UPB_END_EXTERN_C  // }
+
+#endif  // UPB_JSON_NUMBER_H_
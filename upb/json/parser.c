@@ -19,9 +19,7 @@
  * - handling of unicode escape sequences (including high surrogate pairs).
  * - properly check and report errors for unknown fields, stack overflow,
  *   improper array nesting (or lack of nesting).
- * - handling of base64 sequences with padding characters.
  * - handling of push-back (non-success returns from sink functions).
- * - handling of keys/escape-sequences/etc that span input buffers.
  */
 
 #include <stdio.h>
@@ -32,6 +30,10 @@
 #include <errno.h>
 
 #include "upb/json/parser.h"
+#include "upb/json/base64.int.h"
+#include "upb/json/names.int.h"
+#include "upb/json/number.int.h"
+#include "upb/json/scan.int.h"
 
 #define PARSER_CHECK_RETURN(x) if (!(x)) return false
 
@@ -48,28 +50,280 @@ static upb_selector_t parser_getsel(upb_json_parser *p) {
       p, upb_handlers_getprimitivehandlertype(p->top->f));
 }
 
+
+/* Skipping *******************************************************************/
+
+// With SetIgnoreUnknown(), we pass over the value of an unknown member by
+// looking only at the quotes and brackets that delimit it.  This is much less
+// work than parsing it, and never touches the output or our buffers.
+
+// Called on the first character of the value of an unknown member.
+static bool start_skip(upb_json_parser *p, const char *ptr) {
+  switch (*ptr) {
+    case '"': case '{': case '[': case '-': case 't': case 'f': case 'n':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+      break;
+    default:
+      upb_status_seterrmsg(p->status, "Invalid value for unknown member");
+      return false;
+  }
+
+  p->skip_next = false;
+  p->skipping = true;
+  p->skip_depth = 0;
+  p->skip_instring = false;
+  p->skip_escape = false;
+  return true;
+}
+
+// Scans the value we are skipping from "ptr".  Returns where it ends, or "end"
+// if it goes on past this buffer.
+static const char *skip(upb_json_parser *p, const char *ptr,
+                        const char *end) {
+  while (ptr < end) {
+    if (p->skip_escape) {
+      p->skip_escape = false;
+      ptr++;
+    } else if (p->skip_instring) {
+      ptr = upb_json_findquote(ptr, end);
+      if (ptr == end) break;
+      if (*ptr++ == '\\') {
+        p->skip_escape = true;
+      } else {
+        p->skip_instring = false;
+        if (p->skip_depth == 0) goto done;
+      }
+    } else {
+      switch (*ptr) {
+        case '"':
+          p->skip_instring = true;
+          break;
+        case '{':
+        case '[':
+          p->skip_depth++;
+          break;
+        case '}':
+        case ']':
+          // At depth 0 this closes the enclosing object, after a number,
+          // "true", "false" or "null".
+          if (p->skip_depth == 0) goto done;
+          if (--p->skip_depth == 0) {
+            ptr++;
+            goto done;
+          }
+          break;
+        case ',':
+        case ' ': case '\t': case '\n': case '\r': case '\v': case '\f':
+          if (p->skip_depth == 0) goto done;
+          break;
+      }
+      ptr++;
+    }
+  }
+  return end;
+
+done:
+  p->skipping = false;
+  return ptr;
+}
+
+
+/* Buffering ******************************************************************/
+
+// Text that we need in one piece (member names, enum names, base64, numbers
+// and \u escapes) is usually contiguous in the input buffer, so we just point
+// at it.  We only copy it if it spans input buffers or contains escapes.
+
+// What text_begin and capture_begin point to between input buffers: the next
+// buffer resumes them at its start.
+static const char suspended;
+
+static bool growbuf(upb_json_parser *p, char **buf, size_t *size,
+                    size_t need) {
+  if (need <= *size) return true;
+
+  size_t newsize = UPB_MAX(*size, 128);
+  while (newsize < need) newsize *= 2;
+  char *newbuf = upb_realloc(p->alloc, *buf, *size, newsize);
+  if (!newbuf) {
+    upb_status_seterrmsg(p->status, "Out of memory");
+    return false;
+  }
+
+  *buf = newbuf;
+  *size = newsize;
+  return true;
+}
+
+// Appends "len" bytes to the text we are accumulating.  If "can_alias", they
+// are in the input buffer and we can point at them until it ends.
+static bool accumulate_append(upb_json_parser *p, const char *buf, size_t len,
+                              bool can_alias) {
+  if (can_alias && p->accumulated_len == 0) {
+    p->accumulated = buf;
+    p->accumulated_len = len;
+    return true;
+  }
+
+  bool owned = p->accumulated == p->accumulate_buf;
+  size_t need = p->accumulated_len + len;
+  PARSER_CHECK_RETURN(
+      growbuf(p, &p->accumulate_buf, &p->accumulate_size, need));
+  if (!owned && p->accumulated_len > 0) {
+    memcpy(p->accumulate_buf, p->accumulated, p->accumulated_len);
+  }
+  if (len > 0) {
+    memcpy(p->accumulate_buf + p->accumulated_len, buf, len);
+  }
+  p->accumulated = p->accumulate_buf;
+  p->accumulated_len = need;
+  return true;
+}
+
+static void accumulate_clear(upb_json_parser *p) {
+  p->accumulated = NULL;
+  p->accumulated_len = 0;
+}
+
+// Handles a piece of the contents of a string: a run of text or the value of
+// an escape.  String fields get each piece as it comes; for member names,
+// enum names and base64 we need the whole thing, so we accumulate it.
+static bool text_piece(upb_json_parser *p, const char *buf, size_t len,
+                       bool can_alias) {
+  if (len == 0) return true;
+
+  if (p->top->f && upb_fielddef_type(p->top->f) == UPB_TYPE_STRING) {
+    upb_selector_t sel = getsel_for_handlertype(p, UPB_HANDLER_STRING);
+    upb_sink_putstring(&p->top->sink, sel, buf, len, NULL);
+    return true;
+  }
+
+  return accumulate_append(p, buf, len, can_alias);
+}
+
+static bool spill(upb_json_parser *p, const char *begin, const char *end) {
+  size_t len = end - begin;
+  PARSER_CHECK_RETURN(
+      growbuf(p, &p->spill, &p->spill_size, p->spill_len + len));
+  memcpy(p->spill + p->spill_len, begin, len);
+  p->spill_len += len;
+  return true;
+}
+
+static void start_capture(upb_json_parser *p, const char *ptr) {
+  assert(!p->capture_begin);
+  p->capture_begin = ptr;
+  p->spill_len = 0;
+}
+
+// Returns the text from start_capture() up to "ptr".
+static bool end_capture(upb_json_parser *p, const char *ptr,
+                        const char **buf, size_t *len) {
+  if (p->spill_len == 0) {
+    *buf = p->capture_begin;
+    *len = ptr - p->capture_begin;
+  } else {
+    PARSER_CHECK_RETURN(spill(p, p->capture_begin, ptr));
+    *buf = p->spill;
+    *len = p->spill_len;
+  }
+  p->capture_begin = NULL;
+  return true;
+}
+
+// Called at the end of each input buffer: anything we were pointing into it
+// for has to be handled or copied now.
+static bool suspend(upb_json_parser *p, const char *end) {
+  if (p->text_begin) {
+    PARSER_CHECK_RETURN(text_piece(p, p->text_begin, end - p->text_begin,
+                                   true));
+    p->text_begin = &suspended;
+  }
+
+  if (p->capture_begin) {
+    PARSER_CHECK_RETURN(spill(p, p->capture_begin, end));
+    p->capture_begin = &suspended;
+  }
+
+  if (p->accumulated_len > 0 && p->accumulated != p->accumulate_buf) {
+    PARSER_CHECK_RETURN(accumulate_append(p, "", 0, false));
+  }
+
+  return true;
+}
+
+// Called at the start of each input buffer; returns where to start parsing.
+static const char *resume(upb_json_parser *p, const char *buf,
+                          const char *end) {
+  if (p->skipping) {
+    return skip(p, buf, end);
+  }
+
+  if (p->capture_begin == &suspended) {
+    p->capture_begin = buf;
+  }
+
+  if (p->text_begin == &suspended) {
+    // We're in the middle of a run of text, so we can skip to its end.
+    p->text_begin = buf;
+    return upb_json_findquote(buf, end);
+  }
+
+  return buf;
+}
+
+
+/* Parsing ********************************************************************/
+
+static const upb_json_namemap *getnames(upb_json_parser *p,
+                                        const upb_msgdef *m) {
+  upb_value v;
+  if (upb_inttable_lookupptr(&p->namemaps, m, &v)) {
+    return upb_value_getptr(v);
+  }
+
+  upb_json_namemap *names = upb_malloc(p->alloc, sizeof(*names));
+  if (!names || !upb_json_namemap_init(names, m, p->alloc) ||
+      !upb_inttable_insertptr(&p->namemaps, m, upb_value_ptr(names))) {
+    // (If the insert failed, we leak "names" rather than complicate this.)
+    upb_status_seterrmsg(p->status, "Out of memory");
+    return NULL;
+  }
+  upb_msgdef_ref(m, p);
+  return names;
+}
+
 static void start_member(upb_json_parser *p) {
+  UPB_UNUSED(p);
   assert(!p->top->f);
   assert(!p->accumulated);
-  p->accumulated_len = 0;
 }
 
 static bool end_member(upb_json_parser *p) {
-  // TODO(haberman): support keys that span buffers or have escape sequences.
   assert(!p->top->f);
-  assert(p->accumulated);
-  const upb_fielddef *f =
-      upb_msgdef_ntof(p->top->m, p->accumulated, p->accumulated_len);
 
-  if (!f) {
-    // TODO(haberman): Ignore unknown fields if requested/configured to do so.
+  if (!p->top->names) {
+    p->top->names = getnames(p, p->top->m);
+    PARSER_CHECK_RETURN(p->top->names);
+  }
+
+  const upb_json_nameent *e = upb_json_namemap_lookup(
+      p->top->names, p->accumulated, p->accumulated_len);
+
+  if (!e) {
+    if (p->ignore_unknown) {
+      accumulate_clear(p);
+      p->skip_next = true;
+      return true;
+    }
     upb_status_seterrf(p->status, "No such field: %.*s\n",
                        (int)p->accumulated_len, p->accumulated);
     return false;
   }
 
-  p->top->f = f;
-  p->accumulated = NULL;
+  p->top->f = e->f;
+  accumulate_clear(p);
 
   return true;
 }
@@ -78,9 +332,23 @@ static void start_object(upb_json_parser *p) {
   upb_sink_startmsg(&p->top->sink);
 }
 
-static void end_object(upb_json_parser *p) {
+// In streaming mode, after each top-level object we go back to expecting
+// another.
+static bool end_of_record(upb_json_parser *p) {
+  return p->streaming && p->top == p->stack;
+}
+
+static bool end_object(upb_json_parser *p) {
   upb_status status;
   upb_sink_endmsg(&p->top->sink, &status);
+
+  if (end_of_record(p) && p->record_func &&
+      !p->record_func(p->record_closure)) {
+    upb_status_seterrmsg(p->status, "Stopped by record handler");
+    return false;
+  }
+
+  return true;
 }
 
 static bool check_stack(upb_json_parser *p) {
@@ -110,6 +378,7 @@ static bool start_subobject(upb_json_parser *p) {
   upb_sink_startsubmsg(&p->top->sink, sel, &inner->sink);
   inner->m = upb_fielddef_msgsubdef(p->top->f);
   inner->f = NULL;
+  inner->names = NULL;
   p->top = inner;
 
   return true;
@@ -138,6 +407,7 @@ static bool start_array(upb_json_parser *p) {
   upb_sink_startseq(&p->top->sink, sel, &inner->sink);
   inner->m = p->top->m;
   inner->f = p->top->f;
+  inner->names = p->top->names;
   p->top = inner;
 
   return true;
@@ -170,160 +440,54 @@ static void start_text(upb_json_parser *p, const char *ptr) {
   p->text_begin = ptr;
 }
 
-static const signed char b64table[] = {
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      62/*+*/, -1,      -1,      -1,      63/*/ */,
-  52/*0*/, 53/*1*/, 54/*2*/, 55/*3*/, 56/*4*/, 57/*5*/, 58/*6*/, 59/*7*/,
-  60/*8*/, 61/*9*/, -1,      -1,      -1,      -1,      -1,      -1,
-  -1,       0/*A*/,  1/*B*/,  2/*C*/,  3/*D*/,  4/*E*/,  5/*F*/,  6/*G*/,
-  07/*H*/,  8/*I*/,  9/*J*/, 10/*K*/, 11/*L*/, 12/*M*/, 13/*N*/, 14/*O*/,
-  15/*P*/, 16/*Q*/, 17/*R*/, 18/*S*/, 19/*T*/, 20/*U*/, 21/*V*/, 22/*W*/,
-  23/*X*/, 24/*Y*/, 25/*Z*/, -1,      -1,      -1,      -1,      -1,
-  -1,      26/*a*/, 27/*b*/, 28/*c*/, 29/*d*/, 30/*e*/, 31/*f*/, 32/*g*/,
-  33/*h*/, 34/*i*/, 35/*j*/, 36/*k*/, 37/*l*/, 38/*m*/, 39/*n*/, 40/*o*/,
-  41/*p*/, 42/*q*/, 43/*r*/, 44/*s*/, 45/*t*/, 46/*u*/, 47/*v*/, 48/*w*/,
-  49/*x*/, 50/*y*/, 51/*z*/, -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1,
-  -1,      -1,      -1,      -1,      -1,      -1,      -1,      -1
-};
-
-// Returns the table value sign-extended to 32 bits.  Knowing that the upper
-// bits will be 1 for unrecognized characters makes it easier to check for
-// this error condition later (see below).
-int32_t b64lookup(unsigned char ch) { return b64table[ch]; }
-
-// Returns true if the given character is not a valid base64 character or
-// padding.
-bool nonbase64(unsigned char ch) { return b64lookup(ch) == -1 && ch != '='; }
-
 static bool base64_push(upb_json_parser *p, upb_selector_t sel, const char *ptr,
                         size_t len) {
-  const char *limit = ptr + len;
-  for (; ptr < limit; ptr += 4) {
-    if (limit - ptr < 4) {
-      upb_status_seterrf(p->status,
-                         "Base64 input for bytes field not a multiple of 4: %s",
-                         upb_fielddef_name(p->top->f));
-      return false;
+  // Decode in large chunks, so that even a big bytes field only takes a few
+  // putstring calls.
+  char buf[12288];
+  const size_t chunk = sizeof(buf) / 3 * 4;
+
+  do {
+    size_t n = UPB_MIN(len, chunk);
+    size_t decoded;
+    upb_json_base64status status = upb_json_base64decode(ptr, n, buf, &decoded);
+    if (status == UPB_JSON_BASE64_OK && n < len && decoded < n / 4 * 3) {
+      // Padding before the last chunk.
+      status = UPB_JSON_BASE64_BADPADDING;
     }
 
-    uint32_t val = b64lookup(ptr[0]) << 18 |
-                   b64lookup(ptr[1]) << 12 |
-                   b64lookup(ptr[2]) << 6  |
-                   b64lookup(ptr[3]);
-
-    // Test the upper bit; returns true if any of the characters returned -1.
-    if (val & 0x80000000) {
-      goto otherchar;
+    switch (status) {
+      case UPB_JSON_BASE64_OK:
+        break;
+      case UPB_JSON_BASE64_BADLENGTH:
+        upb_status_seterrf(
+            p->status, "Base64 input for bytes field not a multiple of 4: %s",
+            upb_fielddef_name(p->top->f));
+        return false;
+      case UPB_JSON_BASE64_BADCHAR:
+        upb_status_seterrf(p->status,
+                           "Non-base64 characters in bytes field: %s",
+                           upb_fielddef_name(p->top->f));
+        return false;
+      case UPB_JSON_BASE64_BADPADDING:
+        upb_status_seterrf(p->status,
+                           "Incorrect base64 padding for field: %s",
+                           upb_fielddef_name(p->top->f));
+        return false;
     }
 
-    char output[3];
-    output[0] = val >> 16;
-    output[1] = (val >> 8) & 0xff;
-    output[2] = val & 0xff;
-    upb_sink_putstring(&p->top->sink, sel, output, 3, NULL);
-  }
-  return true;
-
-otherchar:
-  if (nonbase64(ptr[0]) || nonbase64(ptr[1]) || nonbase64(ptr[2]) ||
-      nonbase64(ptr[3]) ) {
-    upb_status_seterrf(p->status,
-                       "Non-base64 characters in bytes field: %s",
-                       upb_fielddef_name(p->top->f));
-    return false;
-  } if (ptr[2] == '=') {
-    // Last group contains only two input bytes, one output byte.
-    if (ptr[0] == '=' || ptr[1] == '=' || ptr[3] != '=') {
-      goto badpadding;
-    }
-
-    uint32_t val = b64lookup(ptr[0]) << 18 |
-                   b64lookup(ptr[1]) << 12;
-
-    assert(!(val & 0x80000000));
-    char output = val >> 16;
-    upb_sink_putstring(&p->top->sink, sel, &output, 1, NULL);
-    return true;
-  } else {
-    // Last group contains only three input bytes, two output bytes.
-    if (ptr[0] == '=' || ptr[1] == '=' || ptr[2] == '=') {
-      goto badpadding;
-    }
-
-    uint32_t val = b64lookup(ptr[0]) << 18 |
-                   b64lookup(ptr[1]) << 12 |
-                   b64lookup(ptr[2]) << 6;
-
-    char output[2];
-    output[0] = val >> 16;
-    output[1] = (val >> 8) & 0xff;
-    upb_sink_putstring(&p->top->sink, sel, output, 2, NULL);
-    return true;
-  }
+    upb_sink_putstring(&p->top->sink, sel, buf, decoded, NULL);
+    ptr += n;
+    len -= n;
+  } while (len > 0);
 
-badpadding:
-  upb_status_seterrf(p->status,
-                     "Incorrect base64 padding for field: %s (%.*s)",
-                     upb_fielddef_name(p->top->f),
-                     4, ptr);
-  return false;
+  return true;
 }
 
-static bool end_text(upb_json_parser *p, const char *ptr, bool is_num) {
-  assert(!p->accumulated);  // TODO: handle this case.
-  p->accumulated = p->text_begin;
-  p->accumulated_len = ptr - p->text_begin;
-
-  if (p->top->f && upb_fielddef_isstring(p->top->f)) {
-    // This is a string field (as opposed to a member name).
-    upb_selector_t sel = getsel_for_handlertype(p, UPB_HANDLER_STRING);
-    if (upb_fielddef_type(p->top->f) == UPB_TYPE_BYTES) {
-      PARSER_CHECK_RETURN(base64_push(p, sel, p->accumulated,
-                                      p->accumulated_len));
-    } else {
-      upb_sink_putstring(&p->top->sink, sel, p->accumulated, p->accumulated_len, NULL);
-    }
-    p->accumulated = NULL;
-  } else if (p->top->f &&
-             upb_fielddef_type(p->top->f) == UPB_TYPE_ENUM &&
-             !is_num) {
-
-    // Enum case: resolve enum symbolic name to integer value.
-    const upb_enumdef *enumdef =
-        (const upb_enumdef*)upb_fielddef_subdef(p->top->f);
-
-    int32_t int_val = 0;
-    if (upb_enumdef_ntoi(enumdef, p->accumulated, p->accumulated_len,
-                         &int_val)) {
-      upb_selector_t sel = parser_getsel(p);
-      upb_sink_putint32(&p->top->sink, sel, int_val);
-    } else {
-      upb_status_seterrmsg(p->status, "Enum value name unknown");
-      return false;
-    }
-    p->accumulated = NULL;
-  }
-
-  return true;
+static bool end_text(upb_json_parser *p, const char *ptr) {
+  bool ok = text_piece(p, p->text_begin, ptr - p->text_begin, true);
+  p->text_begin = NULL;
+  return ok;
 }
 
 static bool start_stringval(upb_json_parser *p) {
@@ -339,6 +503,7 @@ static bool start_stringval(upb_json_parser *p) {
     upb_sink_startstr(&p->top->sink, sel, 0, &inner->sink);
     inner->m = p->top->m;
     inner->f = p->top->f;
+    inner->names = p->top->names;
     p->top = inner;
 
     return true;
@@ -355,79 +520,109 @@ static bool start_stringval(upb_json_parser *p) {
 
 }
 
-static void end_stringval(upb_json_parser *p) {
-  if (upb_fielddef_isstring(p->top->f)) {
-    upb_selector_t sel = getsel_for_handlertype(p, UPB_HANDLER_ENDSTR);
-    upb_sink_endstr(&p->top->sink, sel);
-    p->top--;
+static bool end_stringval(upb_json_parser *p) {
+  bool ok = true;
+
+  switch (upb_fielddef_type(p->top->f)) {
+    case UPB_TYPE_BYTES:
+      if (p->accumulated_len > 0) {
+        upb_selector_t sel = getsel_for_handlertype(p, UPB_HANDLER_STRING);
+        ok = base64_push(p, sel, p->accumulated, p->accumulated_len);
+      }
+      // Fall through.
+    case UPB_TYPE_STRING: {
+      upb_selector_t sel = getsel_for_handlertype(p, UPB_HANDLER_ENDSTR);
+      upb_sink_endstr(&p->top->sink, sel);
+      p->top--;
+      break;
+    }
+    case UPB_TYPE_ENUM: {
+      // Resolve enum symbolic name to integer value.
+      const upb_enumdef *enumdef =
+          (const upb_enumdef*)upb_fielddef_subdef(p->top->f);
+
+      int32_t int_val = 0;
+      ok = upb_enumdef_ntoi(enumdef, p->accumulated, p->accumulated_len,
+                            &int_val);
+      if (ok) {
+        upb_selector_t sel = parser_getsel(p);
+        upb_sink_putint32(&p->top->sink, sel, int_val);
+      } else {
+        upb_status_seterrmsg(p->status, "Enum value name unknown");
+      }
+      break;
+    }
+    default:
+      assert(false);
+      break;
   }
+
+  accumulate_clear(p);
+  return ok;
 }
 
 static void start_number(upb_json_parser *p, const char *ptr) {
-  start_text(p, ptr);
-  assert(p->accumulated == NULL);
+  start_capture(p, ptr);
 }
 
-static void end_number(upb_json_parser *p, const char *ptr) {
-  end_text(p, ptr, true);
-  const char *myend = p->accumulated + p->accumulated_len;
-  char *end;
+static bool end_number(upb_json_parser *p, const char *ptr) {
+  const char *buf;
+  size_t len;
+  PARSER_CHECK_RETURN(end_capture(p, ptr, &buf, &len));
+  upb_selector_t sel = parser_getsel(p);
+  bool ok;
 
   switch (upb_fielddef_type(p->top->f)) {
     case UPB_TYPE_ENUM:
     case UPB_TYPE_INT32: {
-      long val = strtol(p->accumulated, &end, 0);
-      if (val > INT32_MAX || val < INT32_MIN || errno == ERANGE || end != myend)
-        assert(false);
-      else
-        upb_sink_putint32(&p->top->sink, parser_getsel(p), val);
+      int64_t val;
+      ok = upb_json_parseint64(buf, len, &val) &&
+           val >= INT32_MIN && val <= INT32_MAX;
+      if (ok) upb_sink_putint32(&p->top->sink, sel, val);
       break;
     }
     case UPB_TYPE_INT64: {
-      long long val = strtoll(p->accumulated, &end, 0);
-      if (val > INT64_MAX || val < INT64_MIN || errno == ERANGE || end != myend)
-        assert(false);
-      else
-        upb_sink_putint64(&p->top->sink, parser_getsel(p), val);
+      int64_t val;
+      ok = upb_json_parseint64(buf, len, &val);
+      if (ok) upb_sink_putint64(&p->top->sink, sel, val);
       break;
     }
     case UPB_TYPE_UINT32: {
-      unsigned long val = strtoul(p->accumulated, &end, 0);
-      if (val > UINT32_MAX || errno == ERANGE || end != myend)
-        assert(false);
-      else
-        upb_sink_putuint32(&p->top->sink, parser_getsel(p), val);
+      uint64_t val;
+      ok = upb_json_parseuint64(buf, len, &val) && val <= UINT32_MAX;
+      if (ok) upb_sink_putuint32(&p->top->sink, sel, val);
       break;
     }
     case UPB_TYPE_UINT64: {
-      unsigned long long val = strtoull(p->accumulated, &end, 0);
-      if (val > UINT64_MAX || errno == ERANGE || end != myend)
-        assert(false);
-      else
-        upb_sink_putuint64(&p->top->sink, parser_getsel(p), val);
+      uint64_t val;
+      ok = upb_json_parseuint64(buf, len, &val);
+      if (ok) upb_sink_putuint64(&p->top->sink, sel, val);
       break;
     }
     case UPB_TYPE_DOUBLE: {
-      double val = strtod(p->accumulated, &end);
-      if (errno == ERANGE || end != myend)
-        assert(false);
-      else
-        upb_sink_putdouble(&p->top->sink, parser_getsel(p), val);
+      double val;
+      ok = upb_json_parsedouble(buf, len, &val);
+      if (ok) upb_sink_putdouble(&p->top->sink, sel, val);
       break;
     }
     case UPB_TYPE_FLOAT: {
-      float val = strtof(p->accumulated, &end);
-      if (errno == ERANGE || end != myend)
-        assert(false);
-      else
-        upb_sink_putfloat(&p->top->sink, parser_getsel(p), val);
+      float val;
+      ok = upb_json_parsefloat(buf, len, &val);
+      if (ok) upb_sink_putfloat(&p->top->sink, sel, val);
       break;
     }
     default:
-      assert(false);
+      upb_status_seterrf(p->status, "Number specified for field: %s",
+                         upb_fielddef_name(p->top->f));
+      return false;
   }
 
-  p->accumulated = NULL;
+  if (!ok) {
+    upb_status_seterrf(p->status, "Invalid number for field %s: %.*s",
+                       upb_fielddef_name(p->top->f), (int)len, buf);
+    return false;
+  }
+  return true;
 }
 
 static char escape_char(char in) {
@@ -446,10 +641,9 @@ static char escape_char(char in) {
   }
 }
 
-static void escape(upb_json_parser *p, const char *ptr) {
+static bool escape(upb_json_parser *p, const char *ptr) {
   char ch = escape_char(*ptr);
-  upb_selector_t sel = getsel_for_handlertype(p, UPB_HANDLER_STRING);
-  upb_sink_putstring(&p->top->sink, sel, &ch, 1, NULL);
+  return text_piece(p, &ch, 1, false);
 }
 
 static uint8_t hexdigit(char ch) {
@@ -464,12 +658,14 @@ static uint8_t hexdigit(char ch) {
 }
 
 static void start_hex(upb_json_parser *p, const char *ptr) {
-  start_text(p, ptr);
+  start_capture(p, ptr);
 }
 
-static void hex(upb_json_parser *p, const char *end) {
-  const char *start = p->text_begin;
-  UPB_ASSERT_VAR(end, end - start == 4);
+static bool hex(upb_json_parser *p, const char *end) {
+  const char *start;
+  size_t len;
+  PARSER_CHECK_RETURN(end_capture(p, end, &start, &len));
+  UPB_ASSERT_VAR(len, len == 4);
   uint16_t codepoint =
       (hexdigit(start[0]) << 12) |
       (hexdigit(start[1]) << 8) |
@@ -497,8 +693,7 @@ static void hex(upb_json_parser *p, const char *end) {
   // TODO(haberman): Handle high surrogates: if codepoint is a high surrogate
   // we have to wait for the next escape to get the full code point).
 
-  upb_selector_t sel = getsel_for_handlertype(p, UPB_HANDLER_STRING);
-  upb_sink_putstring(&p->top->sink, sel, utf8, length, NULL);
+  return text_piece(p, utf8, length, false);
 }
 
 #define CHECK_RETURN_TOP(x) if (!(x)) goto error
@@ -506,11 +701,11 @@ static void hex(upb_json_parser *p, const char *end) {
 // What follows is the Ragel parser itself.  The language is specified in Ragel
 // and the actions call our C functions above.
 
-#line 596 "upb/json/parser.rl"
+#line 808 "upb/json/parser.rl"
 
 
 
-#line 514 "upb/json/parser.c"
+#line 709 "upb/json/parser.c"
 static const char _json_actions[] = {
 	0, 1, 0, 1, 2, 1, 3, 1, 
 	4, 1, 5, 1, 6, 1, 7, 1, 
@@ -663,7 +858,7 @@ static const int json_en_value_machine = 27;
 static const int json_en_main = 1;
 
 
-#line 599 "upb/json/parser.rl"
+#line 811 "upb/json/parser.rl"
 
 size_t parse(void *closure, const void *hd, const char *buf, size_t size,
              const upb_bufhandle *handle) {
@@ -676,11 +871,11 @@ size_t parse(void *closure, const void *hd, const char *buf, size_t size,
   int *stack = parser->parser_stack;
   int top = parser->parser_top;
 
-  const char *p = buf;
   const char *pe = buf + size;
+  const char *p = resume(parser, buf, pe);
 
   
-#line 684 "upb/json/parser.c"
+#line 879 "upb/json/parser.c"
 	{
 	int _klen;
 	unsigned int _trans;
@@ -755,114 +950,124 @@ _match:
 		switch ( *_acts++ )
 		{
 	case 0:
-#line 517 "upb/json/parser.rl"
+#line 712 "upb/json/parser.rl"
 	{ p--; {cs = stack[--top]; goto _again;} }
 	break;
 	case 1:
-#line 518 "upb/json/parser.rl"
+#line 713 "upb/json/parser.rl"
 	{ p--; {stack[top++] = cs; cs = 10; goto _again;} }
 	break;
 	case 2:
-#line 522 "upb/json/parser.rl"
-	{ start_text(parser, p); }
+#line 719 "upb/json/parser.rl"
+	{ start_text(parser, p); {p = (( upb_json_findquote(p + 1, pe)))-1;} }
 	break;
 	case 3:
-#line 523 "upb/json/parser.rl"
-	{ CHECK_RETURN_TOP(end_text(parser, p, false)); }
+#line 720 "upb/json/parser.rl"
+	{ CHECK_RETURN_TOP(end_text(parser, p)); }
 	break;
 	case 4:
-#line 529 "upb/json/parser.rl"
+#line 726 "upb/json/parser.rl"
 	{ start_hex(parser, p); }
 	break;
 	case 5:
-#line 530 "upb/json/parser.rl"
-	{ hex(parser, p); }
+#line 727 "upb/json/parser.rl"
+	{ CHECK_RETURN_TOP(hex(parser, p)); }
 	break;
 	case 6:
-#line 536 "upb/json/parser.rl"
-	{ escape(parser, p); }
+#line 733 "upb/json/parser.rl"
+	{ CHECK_RETURN_TOP(escape(parser, p)); }
 	break;
 	case 7:
-#line 539 "upb/json/parser.rl"
+#line 736 "upb/json/parser.rl"
 	{ {cs = stack[--top]; goto _again;} }
 	break;
 	case 8:
-#line 540 "upb/json/parser.rl"
+#line 737 "upb/json/parser.rl"
 	{ {stack[top++] = cs; cs = 19; goto _again;} }
 	break;
 	case 9:
-#line 542 "upb/json/parser.rl"
-	{ p--; {stack[top++] = cs; cs = 27; goto _again;} }
+#line 743 "upb/json/parser.rl"
+	{
+        if (parser->skip_next) {
+          CHECK_RETURN_TOP(start_skip(parser, p));
+          {p = (( skip(parser, p, pe)))-1;}
+        } else {
+          p--; {stack[top++] = cs; cs = 27; goto _again;}
+        }
+      }
 	break;
 	case 10:
-#line 547 "upb/json/parser.rl"
+#line 756 "upb/json/parser.rl"
 	{ start_member(parser); }
 	break;
 	case 11:
-#line 548 "upb/json/parser.rl"
+#line 757 "upb/json/parser.rl"
 	{ CHECK_RETURN_TOP(end_member(parser)); }
 	break;
 	case 12:
-#line 551 "upb/json/parser.rl"
+#line 760 "upb/json/parser.rl"
 	{ clear_member(parser); }
 	break;
 	case 13:
-#line 557 "upb/json/parser.rl"
+#line 766 "upb/json/parser.rl"
 	{ start_object(parser); }
 	break;
 	case 14:
-#line 560 "upb/json/parser.rl"
-	{ end_object(parser); }
+#line 769 "upb/json/parser.rl"
+	{
+        CHECK_RETURN_TOP(end_object(parser));
+        if (end_of_record(parser)) cs = 1;
+      }
 	break;
 	case 15:
-#line 566 "upb/json/parser.rl"
+#line 778 "upb/json/parser.rl"
 	{ CHECK_RETURN_TOP(start_array(parser)); }
 	break;
 	case 16:
-#line 570 "upb/json/parser.rl"
+#line 782 "upb/json/parser.rl"
 	{ end_array(parser); }
 	break;
 	case 17:
-#line 575 "upb/json/parser.rl"
+#line 787 "upb/json/parser.rl"
 	{ start_number(parser, p); }
 	break;
 	case 18:
-#line 576 "upb/json/parser.rl"
-	{ end_number(parser, p); }
+#line 788 "upb/json/parser.rl"
+	{ CHECK_RETURN_TOP(end_number(parser, p)); }
 	break;
 	case 19:
-#line 578 "upb/json/parser.rl"
+#line 790 "upb/json/parser.rl"
 	{ CHECK_RETURN_TOP(start_stringval(parser)); }
 	break;
 	case 20:
-#line 579 "upb/json/parser.rl"
-	{ end_stringval(parser); }
+#line 791 "upb/json/parser.rl"
+	{ CHECK_RETURN_TOP(end_stringval(parser)); }
 	break;
 	case 21:
-#line 581 "upb/json/parser.rl"
+#line 793 "upb/json/parser.rl"
 	{ CHECK_RETURN_TOP(parser_putbool(parser, true)); }
 	break;
 	case 22:
-#line 583 "upb/json/parser.rl"
+#line 795 "upb/json/parser.rl"
 	{ CHECK_RETURN_TOP(parser_putbool(parser, false)); }
 	break;
 	case 23:
-#line 585 "upb/json/parser.rl"
+#line 797 "upb/json/parser.rl"
 	{ /* null value */ }
 	break;
 	case 24:
-#line 587 "upb/json/parser.rl"
+#line 799 "upb/json/parser.rl"
 	{ CHECK_RETURN_TOP(start_subobject(parser)); }
 	break;
 	case 25:
-#line 588 "upb/json/parser.rl"
+#line 800 "upb/json/parser.rl"
 	{ end_subobject(parser); }
 	break;
 	case 26:
-#line 593 "upb/json/parser.rl"
+#line 805 "upb/json/parser.rl"
 	{ p--; {cs = stack[--top]; goto _again;} }
 	break;
-#line 866 "upb/json/parser.c"
+#line 1071 "upb/json/parser.c"
 		}
 	}
 
@@ -875,10 +1080,12 @@ _again:
 	_out: {}
 	}
 
-#line 615 "upb/json/parser.rl"
+#line 827 "upb/json/parser.rl"
 
   if (p != pe) {
     upb_status_seterrf(parser->status, "Parse error at %s\n", p);
+  } else {
+    CHECK_RETURN_TOP(suspend(parser, pe));
   }
 
 error:
@@ -902,10 +1109,32 @@ void upb_json_parser_init(upb_json_parser *p, upb_status *status) {
   upb_byteshandler_setendstr(&p->input_handler_, end, NULL);
   upb_bytessink_reset(&p->input_, &p->input_handler_, p);
   p->status = status;
+  p->alloc = &upb_alloc_global;
+  p->streaming = false;
+  p->record_func = NULL;
+  p->record_closure = NULL;
+  p->ignore_unknown = false;
+  p->spill = NULL;
+  p->spill_size = 0;
+  p->accumulate_buf = NULL;
+  p->accumulate_size = 0;
+  upb_inttable_init(&p->namemaps, UPB_CTYPE_PTR);
 }
 
 void upb_json_parser_uninit(upb_json_parser *p) {
   upb_byteshandler_uninit(&p->input_handler_);
+  upb_free(p->alloc, p->spill);
+  upb_free(p->alloc, p->accumulate_buf);
+
+  upb_inttable_iter i;
+  upb_inttable_begin(&i, &p->namemaps);
+  for (; !upb_inttable_done(&i); upb_inttable_next(&i)) {
+    upb_json_namemap *names = upb_value_getptr(upb_inttable_iter_value(&i));
+    upb_json_namemap_uninit(names);
+    upb_free(p->alloc, names);
+    upb_msgdef_unref((const upb_msgdef*)upb_inttable_iter_key(&i), p);
+  }
+  upb_inttable_uninit(&p->namemaps);
 }
 
 void upb_json_parser_reset(upb_json_parser *p) {
@@ -916,27 +1145,52 @@ void upb_json_parser_reset(upb_json_parser *p) {
   int top;
   // Emit Ragel initialization of the parser.
   
-#line 920 "upb/json/parser.c"
+#line 1149 "upb/json/parser.c"
 	{
 	cs = json_start;
 	top = 0;
 	}
 
-#line 655 "upb/json/parser.rl"
+#line 891 "upb/json/parser.rl"
   p->current_state = cs;
   p->parser_top = top;
   p->text_begin = NULL;
-  p->accumulated = NULL;
-  p->accumulated_len = 0;
+  p->capture_begin = NULL;
+  p->spill_len = 0;
+  accumulate_clear(p);
+  p->skip_next = false;
+  p->skipping = false;
 }
 
 void upb_json_parser_resetoutput(upb_json_parser *p, upb_sink *sink) {
   upb_json_parser_reset(p);
   upb_sink_reset(&p->top->sink, sink->handlers, sink->closure);
   p->top->m = upb_handlers_msgdef(sink->handlers);
-  p->accumulated = NULL;
+  p->top->names = NULL;
 }
 
 upb_bytessink *upb_json_parser_input(upb_json_parser *p) {
   return &p->input_;
 }
+
+void upb_json_parser_setstreaming(upb_json_parser *p, bool streaming) {
+  p->streaming = streaming;
+}
+
+void upb_json_parser_setrecordhandler(upb_json_parser *p,
+                                      upb_json_recordfunc *func,
+                                      void *closure) {
+  p->record_func = func;
+  p->record_closure = closure;
+}
+
+void upb_json_parser_setignoreunknown(upb_json_parser *p, bool ignore) {
+  p->ignore_unknown = ignore;
+}
+
+void upb_json_parser_setalloc(upb_json_parser *p, upb_alloc *alloc) {
+  // We can't switch allocators once we've allocated from the old one.
+  assert(!p->spill && !p->accumulate_buf &&
+         upb_inttable_count(&p->namemaps) == 0);
+  p->alloc = alloc;
+}
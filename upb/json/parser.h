@@ -23,12 +23,17 @@ class Parser;
 
 UPB_DECLARE_TYPE(upb::json::Parser, upb_json_parser);
 
+struct upb_json_namemap;
+
 // Internal-only struct used by the parser.
 typedef struct {
  UPB_PRIVATE_FOR_CPP
   upb_sink sink;
   const upb_msgdef *m;
   const upb_fielddef *f;
+
+  // The member names of "m", or NULL if we haven't needed them yet.
+  const struct upb_json_namemap *names;
 } upb_jsonparser_frame;
 
 
@@ -36,6 +41,10 @@ typedef struct {
 
 #define UPB_JSON_MAX_DEPTH 64
 
+// In streaming mode, called after each top-level object has been sent to the
+// output.  Returning false stops the parse with an error.
+typedef bool upb_json_recordfunc(void *closure);
+
 // Parses an incoming BytesStream, pushing the results to the destination sink.
 UPB_DEFINE_CLASS0(upb::json::Parser,
  public:
@@ -52,6 +61,28 @@ UPB_DEFINE_CLASS0(upb::json::Parser,
 
   // The input to the printer.
   BytesSink* input();
+
+  // By default the input is a single JSON object.  In streaming mode it is any
+  // number of them, one after another and optionally separated by whitespace
+  // (eg. newline-delimited JSON), and each is sent to the output as a message
+  // of its own, without a Reset() in between.  Objects may span input buffers
+  // like anything else.
+  void SetStreaming(bool streaming);
+
+  // In streaming mode, "func" is called with "closure" after each object.
+  typedef upb_json_recordfunc RecordFunc;
+  void SetRecordHandler(RecordFunc* func, void* closure);
+
+  // By default a member that isn't a field of its message is an error.  With
+  // this set, such members (and everything in their values) are skipped
+  // without any calls to the output.  Skipped values are only checked for
+  // balanced brackets and quotes, not parsed.
+  void SetIgnoreUnknown(bool ignore);
+
+  // Sets the allocator for the parser's buffers and name maps, for example an
+  // Arena that holds all memory for the current request.  Must be called
+  // before anything is parsed.
+  void SetAllocator(Allocator* alloc);
 ,
 UPB_DEFINE_STRUCT0(upb_json_parser,
   upb_byteshandler input_handler_;
@@ -63,21 +94,54 @@ UPB_DEFINE_STRUCT0(upb_json_parser,
   upb_jsonparser_frame *limit;
 
   upb_status *status;
+  upb_alloc *alloc;
+
+  // See SetStreaming() and SetRecordHandler().
+  bool streaming;
+  upb_json_recordfunc *record_func;
+  void *record_closure;
+
+  // See SetIgnoreUnknown().
+  bool ignore_unknown;
+
+  // Whether the next value is that of an unknown member; whether we are
+  // skipping such a value, and if so how many arrays and objects we are
+  // inside, and whether we are in a string or just past a backslash in one.
+  // These carry over between input buffers.
+  bool skip_next;
+  bool skipping;
+  int skip_depth;
+  bool skip_instring;
+  bool skip_escape;
 
   // Ragel's internal parsing stack for the parsing state machine.
   int current_state;
   int parser_stack[UPB_JSON_MAX_DEPTH];
   int parser_top;
 
-  // A pointer to the beginning of whatever text we are currently parsing.
+  // A pointer to the beginning of the run of string text we are currently
+  // parsing, if any.
   const char *text_begin;
 
-  // We have to accumulate text for member names, integers, unicode escapes, and
-  // base64 partial results.
+  // A pointer to the beginning of the number or \u escape we are currently
+  // parsing, if any.  If it started in an earlier input buffer, the part from
+  // earlier buffers is in "spill".
+  const char *capture_begin;
+  char *spill;
+  size_t spill_len;
+  size_t spill_size;
+
+  // We have to accumulate text for member names, enum names and base64.  This
+  // points into the input buffer when it can, and otherwise (when the text
+  // spans input buffers or contains escapes) into "accumulate_buf".
   const char *accumulated;
   size_t accumulated_len;
-  // TODO: add members and code for allocating a buffer when necessary (when the
-  // member spans input buffers or contains escapes).
+  char *accumulate_buf;
+  size_t accumulate_size;
+
+  // upb_msgdef* -> upb_json_namemap*, built the first time we parse a member
+  // of that type and kept until the parser is destroyed.
+  upb_inttable namemaps;
 ));
 
 UPB_BEGIN_EXTERN_C
@@ -87,6 +151,12 @@ void upb_json_parser_uninit(upb_json_parser *p);
 void upb_json_parser_reset(upb_json_parser *p);
 void upb_json_parser_resetoutput(upb_json_parser *p, upb_sink *output);
 upb_bytessink *upb_json_parser_input(upb_json_parser *p);
+void upb_json_parser_setstreaming(upb_json_parser *p, bool streaming);
+void upb_json_parser_setrecordhandler(upb_json_parser *p,
+                                      upb_json_recordfunc *func,
+                                      void *closure);
+void upb_json_parser_setignoreunknown(upb_json_parser *p, bool ignore);
+void upb_json_parser_setalloc(upb_json_parser *p, upb_alloc *alloc);
 
 UPB_END_EXTERN_C
 
@@ -103,6 +173,18 @@ inline void Parser::ResetOutput(Sink* output) {
 inline BytesSink* Parser::input() {
   return upb_json_parser_input(this);
 }
+inline void Parser::SetStreaming(bool streaming) {
+  upb_json_parser_setstreaming(this, streaming);
+}
+inline void Parser::SetRecordHandler(RecordFunc* func, void* closure) {
+  upb_json_parser_setrecordhandler(this, func, closure);
+}
+inline void Parser::SetIgnoreUnknown(bool ignore) {
+  upb_json_parser_setignoreunknown(this, ignore);
+}
+inline void Parser::SetAllocator(Allocator* alloc) {
+  upb_json_parser_setalloc(this, alloc);
+}
 }  // namespace json
 }  // namespace upb
 
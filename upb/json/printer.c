@@ -3,9 +3,6 @@
  *
  * Copyright (c) 2014 Google Inc.  See LICENSE for details.
  * Author: Josh Haberman <jhaberman@gmail.com>
- *
- * This currently uses snprintf() to format primitives, and could be optimized
- * further.
  */
 
 #include "upb/json/printer.h"
@@ -15,29 +12,60 @@
 #include <string.h>
 #include <stdint.h>
 
+#include "upb/json/base64.int.h"
+#include "upb/json/number.int.h"
+#include "upb/json/scan.int.h"
+
 // StringPiece; a pointer plus a length.
 typedef struct {
   const char *ptr;
   size_t len;
 } strpc;
 
-strpc *newstrpc(upb_handlers *h, const upb_fielddef *f) {
-  strpc *ret = malloc(sizeof(*ret));
-  ret->ptr = upb_fielddef_name(f);
-  ret->len = strlen(ret->ptr);
-  upb_handlers_addcleanup(h, ret, free);
-  return ret;
-}
+// The size of the buffer that output collects in before we pass it to the
+// sink.
+#define BUFSIZE 16384
 
 // ------------ JSON string printing: values, maps, arrays --------------------
 
-static void print_data(
-    upb_json_printer *p, const char *buf, unsigned int len) {
+static void putbuf(upb_json_printer *p, const char *buf, size_t len) {
   // TODO: Will need to change if we support pushback from the sink.
   size_t n = upb_bytessink_putbuf(p->output_, p->subc_, buf, len, NULL);
   UPB_ASSERT_VAR(n, n == len);
 }
 
+// Allocates the output buffer when we first start a document rather than in
+// upb_json_printer_init(), so that SetAllocator() can still take effect.  If
+// this fails, print_data() writes straight to the sink.
+static void allocbuf(upb_json_printer *p) {
+  p->buf_ = upb_malloc(p->alloc, BUFSIZE);
+  p->ptr_ = p->buf_;
+  p->end_ = p->buf_ ? p->buf_ + BUFSIZE : NULL;
+}
+
+// Passes the output collected so far to the sink.  We do this when the buffer
+// fills up and at the end of the top-level message.
+static void flush(upb_json_printer *p) {
+  if (p->ptr_ != p->buf_) {
+    putbuf(p, p->buf_, p->ptr_ - p->buf_);
+    p->ptr_ = p->buf_;
+  }
+}
+
+static void print_data(
+    upb_json_printer *p, const char *buf, unsigned int len) {
+  if (len > (size_t)(p->end_ - p->ptr_)) {
+    flush(p);
+    if (len > (size_t)(p->end_ - p->ptr_)) {
+      // Too big to be worth copying.
+      putbuf(p, buf, len);
+      return;
+    }
+  }
+  memcpy(p->ptr_, buf, len);
+  p->ptr_ += len;
+}
+
 static void print_comma(upb_json_printer *p) {
   if (!p->first_elem_[p->depth_]) {
     print_data(p, ",", 1);
@@ -47,16 +75,7 @@ static void print_comma(upb_json_printer *p) {
 
 // Helpers that print properly formatted elements to the JSON output stream.
 
-// Used for escaping control chars in strings.
-static const char kControlCharLimit = 0x20;
-
-static inline bool is_json_escaped(char c) {
-  // See RFC 4627.
-  unsigned char uc = (unsigned char)c;
-  return uc < kControlCharLimit || uc == '"' || uc == '\\';
-}
-
-static inline char* json_nice_escape(char c) {
+static const char *json_nice_escape(char c) {
   switch (c) {
     case '"':  return "\\\"";
     case '\\': return "\\\\";
@@ -69,109 +88,104 @@ static inline char* json_nice_escape(char c) {
   }
 }
 
+// Writes the escape sequence for "c", which upb_json_findescape() stopped at,
+// to "buf" and returns its length: a "nice" escape, like \n, if one exists for
+// this character, or else a \uXXXX-style escape.
+static size_t fmt_escape(unsigned char c, char *buf) {
+  const char *escape = json_nice_escape(c);
+  if (escape) {
+    memcpy(buf, escape, 2);
+    return 2;
+  }
+
+  memcpy(buf, "\\u00", 4);
+  buf[4] = "0123456789abcdef"[c >> 4];
+  buf[5] = "0123456789abcdef"[c & 0xf];
+  return 6;
+}
+
 // Write a properly escaped string chunk. The surrounding quotes are *not*
 // printed; this is so that the caller has the option of emitting the string
 // content in chunks.
 static void putstring(upb_json_printer *p, const char *buf, unsigned int len) {
-  const char* unescaped_run = NULL;
-  for (unsigned int i = 0; i < len; i++) {
-    char c = buf[i];
-    // Handle escaping.
-    if (is_json_escaped(c)) {
-      // Use a "nice" escape, like \n, if one exists for this character.
-      const char* escape = json_nice_escape(c);
-      // If we don't have a specific 'nice' escape code, use a \uXXXX-style
-      // escape.
-      char escape_buf[8];
-      if (!escape) {
-        unsigned char byte = (unsigned char)c;
-        snprintf(escape_buf, sizeof(escape_buf), "\\u%04x", (int)byte);
-        escape = escape_buf;
-      }
-
-      // N.B. that we assume that the input encoding is equal to the output
-      // encoding (both UTF-8 for  now), so for chars >= 0x20 and != \, ", we
-      // can simply pass the bytes through.
-
-      // If there's a current run of unescaped chars, print that run first.
-      if (unescaped_run) {
-        print_data(p, unescaped_run, &buf[i] - unescaped_run);
-        unescaped_run = NULL;
-      }
-      // Then print the escape code.
-      print_data(p, escape, strlen(escape));
-    } else {
-      // Add to the current unescaped run of characters.
-      if (unescaped_run == NULL) {
-        unescaped_run = &buf[i];
-      }
+  const char *end = buf + len;
+  while (buf < end) {
+    // N.B. that we assume that the input encoding is equal to the output
+    // encoding (both UTF-8 for  now), so for chars >= 0x20 and != \, ", we
+    // can simply pass the bytes through, a whole run at a time.
+    const char *run_end = upb_json_findescape(buf, end);
+    if (run_end != buf) {
+      print_data(p, buf, run_end - buf);
+      buf = run_end;
+      if (buf == end) break;
     }
-  }
 
-  // If the string ended in a run of unescaped characters, print that last run.
-  if (unescaped_run) {
-    print_data(p, unescaped_run, &buf[len] - unescaped_run);
+    char escape[6];
+    print_data(p, escape, fmt_escape(*buf, escape));
+    buf++;
   }
 }
 
-#define CHKLENGTH(x) if (!(x)) return -1;
-
-// Helpers that format floating point values according to our custom formats.
-// Right now we use %.8g and %.17g for float/double, respectively, to match
-// proto2::util::JsonFormat's defaults.  May want to change this later.
-
-static size_t fmt_double(double val, char* buf, size_t length) {
-  size_t n = snprintf(buf, length, "%.17g", val);
-  CHKLENGTH(n > 0 && n < length);
-  return n;
-}
-
-static size_t fmt_float(float val, char* buf, size_t length) {
-  size_t n = snprintf(buf, length, "%.8g", val);
-  CHKLENGTH(n > 0 && n < length);
-  return n;
-}
+// Numbers are formatted by upb/json/number.int.h, which prints floating point
+// values with the fewest digits that read back as the same float or double.
 
-static size_t fmt_bool(bool val, char* buf, size_t length) {
-  size_t n = snprintf(buf, length, "%s", (val ? "true" : "false"));
-  CHKLENGTH(n > 0 && n < length);
-  return n;
+static size_t fmt_bool(bool val, char* buf) {
+  if (val) {
+    memcpy(buf, "true", 4);
+    return 4;
+  } else {
+    memcpy(buf, "false", 5);
+    return 5;
+  }
 }
 
-static size_t fmt_int64(long val, char* buf, size_t length) {
-  size_t n = snprintf(buf, length, "%ld", val);
-  CHKLENGTH(n > 0 && n < length);
-  return n;
-}
+// Returns the member key for field "f", fully rendered (quoted, escaped, and
+// with the colon) and with a leading comma, which putkey() skips for the
+// first member of an object.
+strpc *newstrpc(upb_handlers *h, const upb_fielddef *f) {
+  const char *name = upb_fielddef_name(f);
+  const char *end = name + strlen(name);
+  strpc *ret = upb_malloc(upb_handlers_alloc(h), sizeof(*ret));
+  // Room for every byte to become a \uXXXX escape.
+  char *buf = upb_malloc(upb_handlers_alloc(h), (end - name) * 6 + 4);
+  char *ptr = buf;
+
+  *ptr++ = ',';
+  *ptr++ = '"';
+  while (name < end) {
+    const char *run_end = upb_json_findescape(name, end);
+    memcpy(ptr, name, run_end - name);
+    ptr += run_end - name;
+    name = run_end;
+    if (name < end) ptr += fmt_escape(*name++, ptr);
+  }
+  *ptr++ = '"';
+  *ptr++ = ':';
 
-static size_t fmt_uint64(unsigned long long val, char* buf, size_t length) {
-  size_t n = snprintf(buf, length, "%llu", val);
-  CHKLENGTH(n > 0 && n < length);
-  return n;
+  ret->ptr = buf;
+  ret->len = ptr - buf;
+  return ret;
 }
 
-// Print a map key given a field name. Called by scalar field handlers and by
-// startseq for repeated fields.
+// Print a map key given a field name, as rendered by newstrpc(). Called by
+// scalar field handlers and by startseq for repeated fields.
 static bool putkey(void *closure, const void *handler_data) {
   upb_json_printer *p = closure;
   const strpc *key = handler_data;
-  print_comma(p);
-  print_data(p, "\"", 1);
-  putstring(p, key->ptr, key->len);
-  print_data(p, "\":", 2);
+  size_t skip = p->first_elem_[p->depth_] ? 1 : 0;
+  p->first_elem_[p->depth_] = false;
+  print_data(p, key->ptr + skip, key->len - skip);
   return true;
 }
 
-#define CHKFMT(val) if ((val) == -1) return false;
 #define CHK(val)    if (!(val)) return false;
 
 #define TYPE_HANDLERS(type, fmt_func)                                        \
   static bool put##type(void *closure, const void *handler_data, type val) { \
     upb_json_printer *p = closure;                                           \
     UPB_UNUSED(handler_data);                                                \
-    char data[64];                                                           \
-    size_t length = fmt_func(val, data, sizeof(data));                       \
-    CHKFMT(length);                                                          \
+    char data[UPB_JSON_MAX_NUMBER_LEN];                                      \
+    size_t length = fmt_func(val, data);                                     \
     print_data(p, data, length);                                             \
     return true;                                                             \
   }                                                                          \
@@ -189,13 +203,13 @@ static bool putkey(void *closure, const void *handler_data) {
     return true;                                                             \
   }
 
-TYPE_HANDLERS(double,   fmt_double);
-TYPE_HANDLERS(float,    fmt_float);
+TYPE_HANDLERS(double,   upb_json_fmtdouble);
+TYPE_HANDLERS(float,    upb_json_fmtfloat);
 TYPE_HANDLERS(bool,     fmt_bool);
-TYPE_HANDLERS(int32_t,  fmt_int64);
-TYPE_HANDLERS(uint32_t, fmt_int64);
-TYPE_HANDLERS(int64_t,  fmt_int64);
-TYPE_HANDLERS(uint64_t, fmt_uint64);
+TYPE_HANDLERS(int32_t,  upb_json_fmtint64);
+TYPE_HANDLERS(uint32_t, upb_json_fmtuint64);
+TYPE_HANDLERS(int64_t,  upb_json_fmtint64);
+TYPE_HANDLERS(uint64_t, upb_json_fmtuint64);
 
 #undef TYPE_HANDLERS
 
@@ -255,6 +269,7 @@ static bool startmap(void *closure, const void *handler_data) {
   UPB_UNUSED(handler_data);
   upb_json_printer *p = closure;
   if (p->depth_++ == 0) {
+    if (!p->buf_) allocbuf(p);
     upb_bytessink_start(p->output_, 0, &p->subc_);
   }
   p->first_elem_[p->depth_] = true;
@@ -266,10 +281,11 @@ static bool endmap(void *closure, const void *handler_data, upb_status *s) {
   UPB_UNUSED(handler_data);
   UPB_UNUSED(s);
   upb_json_printer *p = closure;
+  print_data(p, "}", 1);
   if (--p->depth_ == 0) {
+    flush(p);
     upb_bytessink_end(p->output_);
   }
-  print_data(p, "}", 1);
   return true;
 }
 
@@ -300,60 +316,36 @@ static size_t putstr(void *closure, const void *handler_data, const char *str,
 }
 
 // This has to Base64 encode the bytes, because JSON has no "bytes" type.
+// Base64-encodes a piece of a bytes field.  Bytes that don't make up a whole
+// group of three wait in b64_pending_ for the next piece or the end.
 static size_t putbytes(void *closure, const void *handler_data, const char *str,
                        size_t len, const upb_bufhandle *handle) {
   UPB_UNUSED(handler_data);
   UPB_UNUSED(handle);
   upb_json_printer *p = closure;
+  size_t ret = len;
+  char data[16384];
 
-  // This is the regular base64, not the "web-safe" version.
-  static const char base64[] =
-      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-  // Base64-encode.
-  char data[16000];
-  const char *limit = data + sizeof(data);
-  const unsigned char *from = (const unsigned char*)str;
-  char *to = data;
-  size_t remaining = len;
-  while (remaining > 2) {
-    // TODO(haberman): handle encoded lengths > sizeof(data)
-    UPB_ASSERT_VAR(limit, (limit - to) >= 4);
-
-    to[0] = base64[from[0] >> 2];
-    to[1] = base64[((from[0] & 0x3) << 4) | (from[1] >> 4)];
-    to[2] = base64[((from[1] & 0xf) << 2) | (from[2] >> 6)];
-    to[3] = base64[from[2] & 0x3f];
-
-    remaining -= 3;
-    to += 4;
-    from += 3;
+  if (p->b64_npending_ > 0) {
+    while (p->b64_npending_ < 3 && len > 0) {
+      p->b64_pending_[p->b64_npending_++] = *str++;
+      len--;
+    }
+    if (p->b64_npending_ < 3) return ret;
+    print_data(p, data, upb_json_base64encode(p->b64_pending_, 3, data));
+    p->b64_npending_ = 0;
   }
 
-  switch (remaining) {
-    case 2:
-      to[0] = base64[from[0] >> 2];
-      to[1] = base64[((from[0] & 0x3) << 4) | (from[1] >> 4)];
-      to[2] = base64[(from[1] & 0xf) << 2];
-      to[3] = '=';
-      to += 4;
-      from += 2;
-      break;
-    case 1:
-      to[0] = base64[from[0] >> 2];
-      to[1] = base64[((from[0] & 0x3) << 4)];
-      to[2] = '=';
-      to[3] = '=';
-      to += 4;
-      from += 1;
-      break;
+  while (len >= 3) {
+    size_t n = UPB_MIN(len / 3 * 3, sizeof(data) / 4 * 3);
+    print_data(p, data, upb_json_base64encode(str, n, data));
+    str += n;
+    len -= n;
   }
 
-  size_t bytes = to - data;
-  print_data(p, "\"", 1);
-  putstring(p, data, bytes);
-  print_data(p, "\"", 1);
-  return len;
+  memcpy(p->b64_pending_, str, len);
+  p->b64_npending_ = len;
+  return ret;
 }
 
 static void *scalar_startstr(void *closure, const void *handler_data,
@@ -404,21 +396,17 @@ static bool repeated_endstr(void *closure, const void *handler_data) {
   return true;
 }
 
-static size_t scalar_bytes(void *closure, const void *handler_data,
-                           const char *str, size_t len,
-                           const upb_bufhandle *handle) {
-  CHK(putkey(closure, handler_data));
-  CHK(putbytes(closure, handler_data, str, len, handle));
-  return len;
-}
-
-static size_t repeated_bytes(void *closure, const void *handler_data,
-                             const char *str, size_t len,
-                             const upb_bufhandle *handle) {
+static bool bytes_endstr(void *closure, const void *handler_data) {
+  UPB_UNUSED(handler_data);
   upb_json_printer *p = closure;
-  print_comma(p);
-  CHK(putbytes(closure, handler_data, str, len, handle));
-  return len;
+  if (p->b64_npending_ > 0) {
+    char data[4];
+    print_data(p, data,
+               upb_json_base64encode(p->b64_pending_, p->b64_npending_, data));
+    p->b64_npending_ = 0;
+  }
+  print_data(p, "\"", 1);
+  return true;
 }
 
 void printer_sethandlers(const void *closure, upb_handlers *h) {
@@ -462,10 +450,10 @@ void printer_sethandlers(const void *closure, upb_handlers *h) {
         // For now, we always emit symbolic names for enums. We may want an
         // option later to control this behavior, but we will wait for a real
         // need first.
-        EnumHandlerData *hd = malloc(sizeof(EnumHandlerData));
+        EnumHandlerData *hd =
+            upb_malloc(upb_handlers_alloc(h), sizeof(EnumHandlerData));
         hd->enumdef = (const upb_enumdef *)upb_fielddef_subdef(f);
         hd->keyname = newstrpc(h, f);
-        upb_handlers_addcleanup(h, hd, free);
         upb_handlerattr enum_attr = UPB_HANDLERATTR_INITIALIZER;
         upb_handlerattr_sethandlerdata(&enum_attr, hd);
 
@@ -490,13 +478,13 @@ void printer_sethandlers(const void *closure, upb_handlers *h) {
         }
         break;
       case UPB_TYPE_BYTES:
-        // XXX: this doesn't support strings that span buffers yet. The base64
-        // encoder will need to be made resumable for this to work properly.
         if (upb_fielddef_isseq(f)) {
-          upb_handlers_setstring(h, f, repeated_bytes, &empty_attr);
+          upb_handlers_setstartstr(h, f, repeated_startstr, &empty_attr);
         } else {
-          upb_handlers_setstring(h, f, scalar_bytes, &name_attr);
+          upb_handlers_setstartstr(h, f, scalar_startstr, &name_attr);
         }
+        upb_handlers_setstring(h, f, putbytes, &empty_attr);
+        upb_handlers_setendstr(h, f, bytes_endstr, &empty_attr);
         break;
       case UPB_TYPE_MESSAGE:
         if (upb_fielddef_isseq(f)) {
@@ -519,15 +507,28 @@ void printer_sethandlers(const void *closure, upb_handlers *h) {
 void upb_json_printer_init(upb_json_printer *p, const upb_handlers *h) {
   p->output_ = NULL;
   p->depth_ = 0;
+  p->b64_npending_ = 0;
+  p->alloc = &upb_alloc_global;
+  p->buf_ = NULL;
+  p->ptr_ = NULL;
+  p->end_ = NULL;
   upb_sink_reset(&p->input_, h, p);
 }
 
 void upb_json_printer_uninit(upb_json_printer *p) {
-  UPB_UNUSED(p);
+  upb_free(p->alloc, p->buf_);
+}
+
+void upb_json_printer_setalloc(upb_json_printer *p, upb_alloc *alloc) {
+  // We can't switch allocators once we've allocated from the old one.
+  assert(!p->buf_);
+  p->alloc = alloc;
 }
 
 void upb_json_printer_reset(upb_json_printer *p) {
   p->depth_ = 0;
+  p->b64_npending_ = 0;
+  p->ptr_ = p->buf_;
 }
 
 void upb_json_printer_resetoutput(upb_json_printer *p, upb_bytessink *output) {
@@ -40,6 +40,11 @@ UPB_DEFINE_CLASS0(upb::json::Printer,
   // Reset().
   void ResetOutput(BytesSink* output);
 
+  // Sets the allocator for the printer's output buffer, for example an Arena
+  // that holds all memory for the current request.  Must be called before
+  // anything is printed.
+  void SetAllocator(Allocator* alloc);
+
   // The input to the printer.
   Sink* input();
 
@@ -52,6 +57,14 @@ UPB_DEFINE_STRUCT0(upb_json_printer,
   void *subc_;
   upb_bytessink *output_;
 
+  // Output that we haven't passed to "output_" yet.  Passing every quote and
+  // comma to the sink separately would cost more than formatting them.  The
+  // buffer comes from "alloc" when we first print something.
+  upb_alloc *alloc;
+  char *buf_;
+  char *ptr_;
+  char *end_;
+
   // We track the depth so that we know when to emit startstr/endstr on the
   // output.
   int depth_;
@@ -64,6 +77,11 @@ UPB_DEFINE_STRUCT0(upb_json_printer,
   // repeated fields and messages (maps), and the worst case is a
   // message->repeated field->submessage->repeated field->... nesting.
   bool first_elem_[UPB_MAX_HANDLER_DEPTH * 2];
+
+  // The last few bytes of a bytes field that we haven't base64-encoded yet,
+  // because they don't make up a whole group of three.
+  char b64_pending_[3];
+  int b64_npending_;
 ));
 
 UPB_BEGIN_EXTERN_C  // {
@@ -74,6 +92,7 @@ void upb_json_printer_init(upb_json_printer *p, const upb_handlers *h);
 void upb_json_printer_uninit(upb_json_printer *p);
 void upb_json_printer_reset(upb_json_printer *p);
 void upb_json_printer_resetoutput(upb_json_printer *p, upb_bytessink *output);
+void upb_json_printer_setalloc(upb_json_printer *p, upb_alloc *alloc);
 upb_sink *upb_json_printer_input(upb_json_printer *p);
 const upb_handlers *upb_json_printer_newhandlers(const upb_msgdef *md,
                                                  const void *owner);
@@ -92,6 +111,9 @@ inline void Printer::Reset() { upb_json_printer_reset(this); }
 inline void Printer::ResetOutput(BytesSink* output) {
   upb_json_printer_resetoutput(this, output);
 }
+inline void Printer::SetAllocator(Allocator* alloc) {
+  upb_json_printer_setalloc(this, alloc);
+}
 inline Sink* Printer::input() { return upb_json_printer_input(this); }
 inline reffed_ptr<const Handlers> Printer::NewHandlers(
     const upb::MessageDef *md) {
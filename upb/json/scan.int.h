@@ -0,0 +1,100 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * Scanning of JSON string contents, shared by upb::json::Parser,
+ * upb::json::Printer and upb::json::Transcoder.
+ *
+ * Almost all of a typical string is plain text that is copied through as-is,
+ * so rather than looking at one byte at a time we look at 16 (SSE2) or 32
+ * (AVX2) at once when the compiler targets those instruction sets, and fall
+ * back to a byte loop otherwise and for the tail.  Loads never go past "end".
+ */
+
+#ifndef UPB_JSON_SCAN_H_
+#define UPB_JSON_SCAN_H_
+
+#include <stddef.h>
+
+#include "upb/upb.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define UPB_JSON_SSE2
+#endif
+
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#define UPB_JSON_AVX2
+#endif
+
+// Returns a pointer to the first '"' or '\\' in [p, end), or "end" if there
+// is none: the end of the run of bytes that a parser can take verbatim.
+UPB_INLINE const char *upb_json_findquote(const char *p, const char *end) {
+#ifdef UPB_JSON_AVX2
+  const __m256i quote32 = _mm256_set1_epi8('"');
+  const __m256i backslash32 = _mm256_set1_epi8('\\');
+  for (; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    unsigned mask = _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32),
+                        _mm256_cmpeq_epi8(v, backslash32)));
+    if (mask) return p + __builtin_ctz(mask);
+  }
+#endif
+#ifdef UPB_JSON_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    unsigned mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+    if (mask) return p + __builtin_ctz(mask);
+  }
+#endif
+  while (p < end && *p != '"' && *p != '\\') p++;
+  return p;
+}
+
+// Returns a pointer to the first byte in [p, end) that must be escaped in a
+// JSON string ('"', '\\' or a control character), or "end" if there is none.
+UPB_INLINE const char *upb_json_findescape(const char *p, const char *end) {
+  // There's no unsigned byte comparison, but c <= 0x1f iff max(c, 0x1f) is
+  // 0x1f.
+#ifdef UPB_JSON_AVX2
+  const __m256i quote32 = _mm256_set1_epi8('"');
+  const __m256i backslash32 = _mm256_set1_epi8('\\');
+  const __m256i control32 = _mm256_set1_epi8(0x1f);
+  for (; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i ctl = _mm256_cmpeq_epi8(_mm256_max_epu8(v, control32), control32);
+    unsigned mask = _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote32),
+                                        _mm256_cmpeq_epi8(v, backslash32)),
+                        ctl));
+    if (mask) return p + __builtin_ctz(mask);
+  }
+#endif
+#ifdef UPB_JSON_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1f);
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i ctl = _mm_cmpeq_epi8(_mm_max_epu8(v, control), control);
+    unsigned mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                  _mm_cmpeq_epi8(v, backslash)),
+                     ctl));
+    if (mask) return p + __builtin_ctz(mask);
+  }
+#endif
+  for (; p < end; p++) {
+    unsigned char c = *p;
+    if (c < 0x20 || c == '"' || c == '\\') break;
+  }
+  return p;
+}
+
+#endif  // UPB_JSON_SCAN_H_
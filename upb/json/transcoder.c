@@ -0,0 +1,1275 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * The output must match upb::pb::Decoder -> upb::json::Printer exactly, so a
+ * few of the decoder's quirks are reproduced here: consecutive non-packed
+ * elements of a repeated field share one JSON array, but every packed run
+ * gets an array of its own; 32-bit varints are truncated rather than
+ * rejected; and fields with an unexpected wire type are skipped like unknown
+ * fields.
+ *
+ * Likewise JSON -> protobuf must match upb::json::Parser ->
+ * upb::pb::Encoder: negative int32 and enum values are encoded as 32-bit
+ * varints, and arrays of primitives are packed only if the field says so.
+ * Where the parser would assert (eg. on a number that doesn't fit its field)
+ * we return an error instead.
+ */
+
+#include "upb/json/transcoder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "upb/json/base64.int.h"
+#include "upb/json/names.int.h"
+#include "upb/json/number.int.h"
+#include "upb/json/scan.int.h"
+#include "upb/pb/varint.int.h"
+
+/* upb::json::TranscoderMethod ************************************************/
+
+typedef struct {
+  const upb_fielddef *def;
+  uint32_t number;
+  uint8_t type;  // upb_descriptortype_t
+  bool repeated;
+
+  // The wire type we expect for the field, and whether it may also arrive
+  // packed (as UPB_WIRE_TYPE_DELIMITED).
+  uint8_t wiretype;
+  bool packable;
+
+  // Whether arrays are written as a packed field.
+  bool packed;
+
+  // Pre-rendered key, with a leading comma: ,"name":
+  // Print from key + 1 for the first field of a message.
+  char *key;
+  size_t keylen;
+
+  // Pre-encoded tags.  "tag" has the field's native wire type; "tag2" is the
+  // packed (UPB_WIRE_TYPE_DELIMITED) tag for packed fields and the
+  // UPB_WIRE_TYPE_END_GROUP tag for groups.
+  char tag[5], tag2[5];
+  uint8_t taglen, tag2len;
+
+  const upb_json_transcodermethod *sub;
+  const upb_enumdef *enumdef;
+} tfield;
+
+struct upb_json_transcodermethod {
+  tfield *fields;
+  size_t nfields;
+
+  // Index into "fields" by field number, for numbers below "densesize".
+  // Entries for numbers without a field are -1.  Larger numbers are looked
+  // up in "sparse" instead.
+  int32_t *dense;
+  uint32_t densesize;
+  upb_inttable sparse;
+
+  // Maps JSON member names to fields; the index of each is its index in
+  // "fields".
+  upb_json_namemap names;
+};
+
+// Field numbers below this are always looked up in the dense array.
+#define DENSE_MIN 64
+
+static uint8_t wiretype(upb_descriptortype_t type) {
+  switch (type) {
+    case UPB_DESCRIPTOR_TYPE_DOUBLE:
+    case UPB_DESCRIPTOR_TYPE_FIXED64:
+    case UPB_DESCRIPTOR_TYPE_SFIXED64:
+      return UPB_WIRE_TYPE_64BIT;
+    case UPB_DESCRIPTOR_TYPE_FLOAT:
+    case UPB_DESCRIPTOR_TYPE_FIXED32:
+    case UPB_DESCRIPTOR_TYPE_SFIXED32:
+      return UPB_WIRE_TYPE_32BIT;
+    case UPB_DESCRIPTOR_TYPE_STRING:
+    case UPB_DESCRIPTOR_TYPE_BYTES:
+    case UPB_DESCRIPTOR_TYPE_MESSAGE:
+      return UPB_WIRE_TYPE_DELIMITED;
+    case UPB_DESCRIPTOR_TYPE_GROUP:
+      return UPB_WIRE_TYPE_START_GROUP;
+    default:
+      return UPB_WIRE_TYPE_VARINT;
+  }
+}
+
+static void freemethod(upb_json_transcodermethod *m) {
+  size_t i;
+  for (i = 0; i < m->nfields; i++) {
+    free(m->fields[i].key);
+  }
+  free(m->fields);
+  free(m->dense);
+  upb_inttable_uninit(&m->sparse);
+  upb_json_namemap_uninit(&m->names);
+  free(m);
+}
+
+// Compiles "md" and any submessages that aren't in the cache yet into
+// "added", which maps upb_msgdef* -> upb_json_transcodermethod* like the
+// cache does.  Returns NULL if we run out of memory; the caller then frees
+// everything in "added".
+static const upb_json_transcodermethod *compile(upb_json_transcodercache *c,
+                                                const upb_msgdef *md,
+                                                upb_inttable *added) {
+  upb_value v;
+  if (upb_inttable_lookupptr(&c->methods, md, &v) ||
+      upb_inttable_lookupptr(added, md, &v)) {
+    return upb_value_getptr(v);
+  }
+
+  upb_json_transcodermethod *m = malloc(sizeof(*m));
+  if (!m) return NULL;
+  if (!upb_inttable_init(&m->sparse, UPB_CTYPE_INT32)) {
+    free(m);
+    return NULL;
+  }
+  if (!upb_json_namemap_init(&m->names, md, &upb_alloc_global)) {
+    upb_inttable_uninit(&m->sparse);
+    free(m);
+    return NULL;
+  }
+  // m->nfields counts the fields built so far, which are the ones that
+  // freemethod() has to free.  One extra, so that a message without fields
+  // isn't a malloc(0).
+  size_t nfields = upb_msgdef_numfields(md);
+  m->nfields = 0;
+  m->fields = malloc((nfields + 1) * sizeof(tfield));
+  m->dense = NULL;
+
+  // Added before compiling the fields, so recursive types find it.
+  if (!m->fields || !upb_inttable_insertptr(added, md, upb_value_ptr(m))) {
+    freemethod(m);
+    return NULL;
+  }
+
+  uint32_t maxdense = DENSE_MIN;
+  upb_msg_iter i;
+  for (upb_msg_begin(&i, md); !upb_msg_done(&i); upb_msg_next(&i)) {
+    const upb_fielddef *fd = upb_msg_iter_field(&i);
+    const char *name = upb_fielddef_name(fd);
+    size_t namelen = strlen(name);
+    tfield *f = &m->fields[m->nfields];
+
+    f->keylen = namelen + 4;
+    f->key = malloc(f->keylen + 1);
+    if (!f->key) return NULL;
+    m->nfields++;
+    sprintf(f->key, ",\"%s\":", name);
+
+    f->def = fd;
+    f->number = upb_fielddef_number(fd);
+    f->type = upb_fielddef_descriptortype(fd);
+    f->repeated = upb_fielddef_isseq(fd);
+    f->wiretype = wiretype(f->type);
+    f->packable = f->repeated && upb_fielddef_isprimitive(fd);
+    f->packed = f->packable && upb_fielddef_packed(fd);
+
+    uint8_t wt2 = f->type == UPB_DESCRIPTOR_TYPE_GROUP ?
+        UPB_WIRE_TYPE_END_GROUP : UPB_WIRE_TYPE_DELIMITED;
+    f->taglen = upb_vencode64((f->number << 3) | f->wiretype, f->tag);
+    f->tag2len = upb_vencode64((f->number << 3) | wt2, f->tag2);
+    f->sub = NULL;
+    if (upb_fielddef_issubmsg(fd) &&
+        !(f->sub = compile(c, upb_fielddef_msgsubdef(fd), added))) {
+      return NULL;
+    }
+    f->enumdef = upb_fielddef_type(fd) == UPB_TYPE_ENUM ?
+        upb_fielddef_enumsubdef(fd) : NULL;
+
+    // Keep the dense array at most about twice as big as the number of
+    // fields.
+    if (f->number < nfields * 2 && f->number >= maxdense) {
+      maxdense = f->number + 1;
+    }
+  }
+
+  m->densesize = maxdense;
+  m->dense = malloc(maxdense * sizeof(int32_t));
+  if (!m->dense) return NULL;
+  uint32_t n;
+  for (n = 0; n < maxdense; n++) m->dense[n] = -1;
+  for (n = 0; n < m->nfields; n++) {
+    uint32_t number = m->fields[n].number;
+    if (number < maxdense) {
+      m->dense[number] = n;
+    } else if (!upb_inttable_insert(&m->sparse, number, upb_value_int32(n))) {
+      return NULL;
+    }
+  }
+
+  return m;
+}
+
+static const tfield *findfield(const upb_json_transcodermethod *m,
+                               uint32_t number) {
+  if (number < m->densesize) {
+    int32_t n = m->dense[number];
+    return n < 0 ? NULL : &m->fields[n];
+  } else {
+    upb_value v;
+    return upb_inttable_lookup(&m->sparse, number, &v) ?
+        &m->fields[upb_value_getint32(v)] : NULL;
+  }
+}
+
+
+/* upb::json::TranscoderCache *************************************************/
+
+void upb_json_transcodercache_init(upb_json_transcodercache *c) {
+  upb_inttable_init(&c->methods, UPB_CTYPE_PTR);
+}
+
+void upb_json_transcodercache_uninit(upb_json_transcodercache *c) {
+  upb_inttable_iter i;
+  upb_inttable_begin(&i, &c->methods);
+  for (; !upb_inttable_done(&i); upb_inttable_next(&i)) {
+    freemethod(upb_value_getptr(upb_inttable_iter_value(&i)));
+    upb_msgdef_unref((const upb_msgdef*)upb_inttable_iter_key(&i), c);
+  }
+  upb_inttable_uninit(&c->methods);
+}
+
+const upb_json_transcodermethod *upb_json_transcodercache_getmethod(
+    upb_json_transcodercache *c, const upb_msgdef *md, upb_status *status) {
+  upb_value v;
+  if (upb_inttable_lookupptr(&c->methods, md, &v)) {
+    return upb_value_getptr(v);
+  }
+
+  upb_inttable added;
+  const upb_json_transcodermethod *ret = NULL;
+  if (upb_inttable_init(&added, UPB_CTYPE_PTR)) {
+    ret = compile(c, md, &added);
+  }
+
+  // The new methods only go into the cache once all of them are complete.
+  upb_inttable_iter i;
+  upb_inttable_begin(&i, &added);
+  for (; ret && !upb_inttable_done(&i); upb_inttable_next(&i)) {
+    if (!upb_inttable_insert(&c->methods, upb_inttable_iter_key(&i),
+                             upb_inttable_iter_value(&i))) {
+      ret = NULL;
+    }
+  }
+
+  upb_inttable_begin(&i, &added);
+  for (; !upb_inttable_done(&i); upb_inttable_next(&i)) {
+    if (ret) {
+      upb_msgdef_ref((const upb_msgdef*)upb_inttable_iter_key(&i), c);
+    } else {
+      upb_inttable_remove(&c->methods, upb_inttable_iter_key(&i), NULL);
+      freemethod(upb_value_getptr(upb_inttable_iter_value(&i)));
+    }
+  }
+  upb_inttable_uninit(&added);
+
+  if (!ret) upb_status_seterrmsg(status, "Out of memory.");
+  return ret;
+}
+
+
+/* Output *********************************************************************/
+
+// Makes room for at least "bytes" more bytes at t->ptr.
+static bool reserve(upb_json_transcoder *t, size_t bytes) {
+  if ((size_t)(t->limit - t->ptr) >= bytes) return true;
+
+  size_t used = t->ptr - t->buf;
+  size_t size = t->limit - t->buf;
+  size_t newsize = size ? size : 256;
+  while (newsize - used < bytes) newsize *= 2;
+  char *buf = upb_realloc(t->alloc, t->buf, size, newsize);
+  if (!buf) {
+    upb_status_seterrmsg(t->status, "Out of memory.");
+    return false;
+  }
+  t->buf = buf;
+  t->ptr = buf + used;
+  t->limit = buf + newsize;
+  return true;
+}
+
+static bool putbytes(upb_json_transcoder *t, const char *data, size_t len) {
+  if (!reserve(t, len)) return false;
+  memcpy(t->ptr, data, len);
+  t->ptr += len;
+  return true;
+}
+
+// Like the printer, we pass bytes >= 0x20 through untouched, since the input
+// and output are both UTF-8.
+static bool putescaped(upb_json_transcoder *t, const char *str, size_t len) {
+  // Worst case, every byte becomes a six-byte \uXXXX escape.
+  if (!reserve(t, len * 6)) return false;
+  char *out = t->ptr;
+  const char *end = str + len;
+  for (; str < end; str++) {
+    const char *run_end = upb_json_findescape(str, end);
+    memcpy(out, str, run_end - str);
+    out += run_end - str;
+    str = run_end;
+    if (str == end) break;
+
+    unsigned char c = *str;
+    *out++ = '\\';
+    switch (c) {
+      case '"':  *out++ = '"'; break;
+      case '\\': *out++ = '\\'; break;
+      case '\b': *out++ = 'b'; break;
+      case '\f': *out++ = 'f'; break;
+      case '\n': *out++ = 'n'; break;
+      case '\r': *out++ = 'r'; break;
+      case '\t': *out++ = 't'; break;
+      default:
+        memcpy(out, "u00", 3);
+        out[3] = "0123456789abcdef"[c >> 4];
+        out[4] = "0123456789abcdef"[c & 0xf];
+        out += 5;
+        break;
+    }
+  }
+  t->ptr = out;
+  return true;
+}
+
+static bool putquoted(upb_json_transcoder *t, const char *str, size_t len) {
+  return putbytes(t, "\"", 1) && putescaped(t, str, len) &&
+         putbytes(t, "\"", 1);
+}
+
+static bool putbase64(upb_json_transcoder *t, const char *str, size_t len) {
+  if (!reserve(t, UPB_JSON_BASE64_ENCLEN(len) + 2)) return false;
+  char *to = t->ptr;
+  *to++ = '"';
+  to += upb_json_base64encode(str, len, to);
+  *to++ = '"';
+  t->ptr = to;
+  return true;
+}
+
+// The number formatting is shared with the printer, so that we produce the
+// same text.
+
+static bool putuint64(upb_json_transcoder *t, uint64_t val) {
+  if (!reserve(t, UPB_JSON_MAX_NUMBER_LEN)) return false;
+  t->ptr += upb_json_fmtuint64(val, t->ptr);
+  return true;
+}
+
+static bool putint64(upb_json_transcoder *t, int64_t val) {
+  if (!reserve(t, UPB_JSON_MAX_NUMBER_LEN)) return false;
+  t->ptr += upb_json_fmtint64(val, t->ptr);
+  return true;
+}
+
+static bool putdouble(upb_json_transcoder *t, double val) {
+  if (!reserve(t, UPB_JSON_MAX_NUMBER_LEN)) return false;
+  t->ptr += upb_json_fmtdouble(val, t->ptr);
+  return true;
+}
+
+static bool putfloat(upb_json_transcoder *t, float val) {
+  if (!reserve(t, UPB_JSON_MAX_NUMBER_LEN)) return false;
+  t->ptr += upb_json_fmtfloat(val, t->ptr);
+  return true;
+}
+
+
+/* Input **********************************************************************/
+
+typedef struct {
+  const char *ptr, *end;
+} input;
+
+static bool unexpected_eof(upb_json_transcoder *t) {
+  upb_status_seterrmsg(t->status, "Unexpected EOF.");
+  return false;
+}
+
+static bool getvarint(upb_json_transcoder *t, input *in, uint64_t *val) {
+  const char *p = in->ptr;
+  // Fast path for the most common case.
+  if (p < in->end && (*p & 0x80) == 0) {
+    *val = (uint8_t)*p;
+    in->ptr = p + 1;
+    return true;
+  }
+
+  uint64_t ret = 0;
+  int bitpos;
+  for (bitpos = 0; bitpos < 70; bitpos += 7, p++) {
+    if (p == in->end) return unexpected_eof(t);
+    ret |= (uint64_t)(*p & 0x7f) << bitpos;
+    if ((*p & 0x80) == 0) {
+      *val = ret;
+      in->ptr = p + 1;
+      return true;
+    }
+  }
+  upb_status_seterrmsg(t->status, "Unterminated varint.");
+  return false;
+}
+
+static bool getfixed(upb_json_transcoder *t, input *in, void *val,
+                     size_t bytes) {
+  if ((size_t)(in->end - in->ptr) < bytes) return unexpected_eof(t);
+  // TODO(haberman): byte-swap for big endian.
+  memcpy(val, in->ptr, bytes);
+  in->ptr += bytes;
+  return true;
+}
+
+// Returns the delimited region that starts at in->ptr in "sub" and advances
+// past it.
+static bool getdelimited(upb_json_transcoder *t, input *in, input *sub) {
+  uint64_t len;
+  if (!getvarint(t, in, &len)) return false;
+  if (len > (uint64_t)(in->end - in->ptr)) return unexpected_eof(t);
+  sub->ptr = in->ptr;
+  sub->end = in->ptr + len;
+  in->ptr = sub->end;
+  return true;
+}
+
+static bool skipgroup(upb_json_transcoder *t, input *in, uint32_t fieldnum,
+                      int depth);
+
+static bool skipfield(upb_json_transcoder *t, input *in, uint32_t fieldnum,
+                      uint8_t wt, int depth) {
+  uint64_t u64;
+  input sub;
+  switch (wt) {
+    case UPB_WIRE_TYPE_VARINT: return getvarint(t, in, &u64);
+    case UPB_WIRE_TYPE_64BIT: return getfixed(t, in, &u64, 8);
+    case UPB_WIRE_TYPE_32BIT: return getfixed(t, in, &u64, 4);
+    case UPB_WIRE_TYPE_DELIMITED: return getdelimited(t, in, &sub);
+    case UPB_WIRE_TYPE_START_GROUP:
+      return skipgroup(t, in, fieldnum, depth + 1);
+    default:
+      upb_status_seterrmsg(t->status, "Invalid wire type.");
+      return false;
+  }
+}
+
+static bool skipgroup(upb_json_transcoder *t, input *in, uint32_t fieldnum,
+                      int depth) {
+  if (depth > UPB_MAX_HANDLER_DEPTH) {
+    upb_status_seterrmsg(t->status, "Nesting too deep.");
+    return false;
+  }
+  while (in->ptr < in->end) {
+    uint64_t tag;
+    if (!getvarint(t, in, &tag)) return false;
+    uint8_t wt = tag & 7;
+    if (wt == UPB_WIRE_TYPE_END_GROUP) {
+      if ((tag >> 3) == fieldnum) return true;
+      break;
+    }
+    if (!skipfield(t, in, tag >> 3, wt, depth)) return false;
+  }
+  upb_status_seterrmsg(t->status, "Unterminated group.");
+  return false;
+}
+
+
+/* Protobuf -> JSON ***********************************************************/
+
+static bool pbtojson_msg(upb_json_transcoder *t,
+                         const upb_json_transcodermethod *m, input *in,
+                         int32_t groupnum, int depth);
+
+// Reads one value of non-repeated or unpacked field "f" and prints it.
+static bool pbtojson_val(upb_json_transcoder *t, const tfield *f, input *in,
+                         int depth) {
+  uint64_t u64;
+  uint32_t u32;
+  input sub;
+
+  switch (f->type) {
+    case UPB_DESCRIPTOR_TYPE_DOUBLE: {
+      double d;
+      return getfixed(t, in, &d, 8) && putdouble(t, d);
+    }
+    case UPB_DESCRIPTOR_TYPE_FLOAT: {
+      float fl;
+      return getfixed(t, in, &fl, 4) && putfloat(t, fl);
+    }
+    case UPB_DESCRIPTOR_TYPE_INT64:
+      return getvarint(t, in, &u64) && putint64(t, (int64_t)u64);
+    case UPB_DESCRIPTOR_TYPE_UINT64:
+      return getvarint(t, in, &u64) && putuint64(t, u64);
+    case UPB_DESCRIPTOR_TYPE_INT32:
+      return getvarint(t, in, &u64) && putint64(t, (int32_t)u64);
+    case UPB_DESCRIPTOR_TYPE_UINT32:
+      return getvarint(t, in, &u64) && putuint64(t, (uint32_t)u64);
+    case UPB_DESCRIPTOR_TYPE_FIXED64:
+      return getfixed(t, in, &u64, 8) && putuint64(t, u64);
+    case UPB_DESCRIPTOR_TYPE_FIXED32:
+      return getfixed(t, in, &u32, 4) && putuint64(t, u32);
+    case UPB_DESCRIPTOR_TYPE_SFIXED64:
+      return getfixed(t, in, &u64, 8) && putint64(t, (int64_t)u64);
+    case UPB_DESCRIPTOR_TYPE_SFIXED32:
+      return getfixed(t, in, &u32, 4) && putint64(t, (int32_t)u32);
+    case UPB_DESCRIPTOR_TYPE_SINT64:
+      return getvarint(t, in, &u64) &&
+             putint64(t, (int64_t)(u64 >> 1) ^ -(int64_t)(u64 & 1));
+    case UPB_DESCRIPTOR_TYPE_SINT32:
+      if (!getvarint(t, in, &u64)) return false;
+      u32 = (uint32_t)u64;
+      return putint64(t, (int32_t)(u32 >> 1) ^ -(int32_t)(u32 & 1));
+    case UPB_DESCRIPTOR_TYPE_BOOL:
+      if (!getvarint(t, in, &u64)) return false;
+      return u64 ? putbytes(t, "true", 4) : putbytes(t, "false", 5);
+    case UPB_DESCRIPTOR_TYPE_ENUM: {
+      if (!getvarint(t, in, &u64)) return false;
+      const char *name = upb_enumdef_iton(f->enumdef, (int32_t)u64);
+      return name ? putquoted(t, name, strlen(name))
+                  : putint64(t, (int32_t)u64);
+    }
+    case UPB_DESCRIPTOR_TYPE_STRING:
+      return getdelimited(t, in, &sub) &&
+             putquoted(t, sub.ptr, sub.end - sub.ptr);
+    case UPB_DESCRIPTOR_TYPE_BYTES:
+      return getdelimited(t, in, &sub) &&
+             putbase64(t, sub.ptr, sub.end - sub.ptr);
+    case UPB_DESCRIPTOR_TYPE_MESSAGE:
+      return getdelimited(t, in, &sub) &&
+             pbtojson_msg(t, f->sub, &sub, -1, depth + 1);
+    case UPB_DESCRIPTOR_TYPE_GROUP:
+      return pbtojson_msg(t, f->sub, in, f->number, depth + 1);
+  }
+  return false;
+}
+
+// Prints the message in "in".  For groups, "groupnum" is the field number of
+// the group and we stop after its END_GROUP tag; otherwise it is -1 and we
+// stop at the end of the input.
+static bool pbtojson_msg(upb_json_transcoder *t,
+                         const upb_json_transcodermethod *m, input *in,
+                         int32_t groupnum, int depth) {
+  if (depth > UPB_MAX_HANDLER_DEPTH) {
+    upb_status_seterrmsg(t->status, "Nesting too deep.");
+    return false;
+  }
+  if (!putbytes(t, "{", 1)) return false;
+
+  // The repeated field whose array is open, if any.
+  const tfield *open = NULL;
+  bool first = true;
+
+  while (true) {
+    if (in->ptr == in->end) {
+      if (groupnum >= 0) {
+        upb_status_seterrmsg(t->status, "Unterminated group.");
+        return false;
+      }
+      break;
+    }
+
+    uint64_t tag;
+    if (!getvarint(t, in, &tag)) return false;
+    uint32_t fieldnum = tag >> 3;
+    uint8_t wt = tag & 7;
+
+    if (wt == UPB_WIRE_TYPE_END_GROUP) {
+      if ((int64_t)fieldnum != groupnum) {
+        upb_status_seterrmsg(t->status, "Unmatched END_GROUP tag.");
+        return false;
+      }
+      break;
+    }
+
+    const tfield *f = findfield(m, fieldnum);
+    bool packed = f && f->packable && wt == UPB_WIRE_TYPE_DELIMITED;
+
+    if (open && (f != open || packed)) {
+      if (!putbytes(t, "]", 1)) return false;
+      open = NULL;
+    }
+
+    if (!f || (!packed && wt != f->wiretype)) {
+      if (!skipfield(t, in, fieldnum, wt, depth)) return false;
+      continue;
+    }
+
+    if (f != open) {
+      // Start a new key.
+      if (!putbytes(t, first ? f->key + 1 : f->key,
+                    first ? f->keylen - 1 : f->keylen)) {
+        return false;
+      }
+      first = false;
+      if (f->repeated) {
+        if (!putbytes(t, "[", 1)) return false;
+        if (!packed) open = f;
+      }
+    } else if (!putbytes(t, ",", 1)) {
+      return false;
+    }
+
+    if (packed) {
+      input sub;
+      if (!getdelimited(t, in, &sub)) return false;
+      bool firstval = true;
+      while (sub.ptr < sub.end) {
+        if (!firstval && !putbytes(t, ",", 1)) return false;
+        if (!pbtojson_val(t, f, &sub, depth)) return false;
+        firstval = false;
+      }
+      if (!putbytes(t, "]", 1)) return false;
+    } else if (!pbtojson_val(t, f, in, depth)) {
+      return false;
+    }
+  }
+
+  if (open && !putbytes(t, "]", 1)) return false;
+  return putbytes(t, "}", 1);
+}
+
+
+/* JSON -> Protobuf ***********************************************************/
+
+// Room left for a length that isn't known yet; enough for any uint32_t.
+#define LENBYTES 5
+
+static bool parseerror(upb_json_transcoder *t, const input *in) {
+  if (in->ptr == in->end) {
+    upb_status_seterrmsg(t->status, "Unexpected end of JSON input.");
+  } else {
+    int n = UPB_MIN(in->end - in->ptr, 20);
+    upb_status_seterrf(t->status, "Parse error at: %.*s", n, in->ptr);
+  }
+  return false;
+}
+
+static void skipws(input *in) {
+  while (in->ptr < in->end) {
+    switch (*in->ptr) {
+      case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+        in->ptr++;
+        break;
+      default:
+        return;
+    }
+  }
+}
+
+// Skips whitespace, then returns the next character without consuming it,
+// or 0 at the end of the input.
+static char peek(input *in) {
+  skipws(in);
+  return in->ptr < in->end ? *in->ptr : 0;
+}
+
+static bool consume(upb_json_transcoder *t, input *in, char ch) {
+  if (peek(in) != ch) return parseerror(t, in);
+  in->ptr++;
+  return true;
+}
+
+static bool literal(upb_json_transcoder *t, input *in, const char *str,
+                    size_t len) {
+  if ((size_t)(in->end - in->ptr) < len || memcmp(in->ptr, str, len) != 0) {
+    return parseerror(t, in);
+  }
+  in->ptr += len;
+  return true;
+}
+
+static bool putvarint(upb_json_transcoder *t, uint64_t val) {
+  if (!reserve(t, UPB_PB_VARINT_MAX_LEN)) return false;
+  t->ptr += upb_vencode64(val, t->ptr);
+  return true;
+}
+
+// Leaves room for a length and records a fixup for it.  Returns the index of
+// the fixup in "fixup" and the current value of t->shrink in "shrink"; pass
+// both to endlen() at the end of the delimited data.
+static bool startlen(upb_json_transcoder *t, size_t *fixup, size_t *shrink) {
+  if (!reserve(t, LENBYTES)) return false;
+  if (t->nfixups == t->fixupsize) {
+    size_t size = t->fixupsize ? t->fixupsize * 2 : 16;
+    void *fixups = upb_realloc(t->alloc, t->fixups,
+                               t->fixupsize * sizeof(*t->fixups),
+                               size * sizeof(*t->fixups));
+    if (!fixups) {
+      upb_status_seterrmsg(t->status, "Out of memory.");
+      return false;
+    }
+    t->fixups = fixups;
+    t->fixupsize = size;
+  }
+  *fixup = t->nfixups++;
+  *shrink = t->shrink;
+  t->fixups[*fixup].ofs = t->ptr - t->buf;
+  t->ptr += LENBYTES;
+  return true;
+}
+
+static bool endlen(upb_json_transcoder *t, size_t fixup, size_t shrink) {
+  upb_json_transcoder_fixup *f = &t->fixups[fixup];
+  // The inner fixups will shrink the data by (t->shrink - shrink) bytes.
+  size_t len = t->ptr - t->buf - f->ofs - LENBYTES - (t->shrink - shrink);
+  if (len > UINT32_MAX) {
+    upb_status_seterrmsg(t->status, "Submessage too long.");
+    return false;
+  }
+  f->len = len;
+  t->shrink += LENBYTES - upb_varint_size(len);
+  return true;
+}
+
+// Replaces every length placeholder with its varint, closing the gaps, in a
+// single pass over the output.
+static void applyfixups(upb_json_transcoder *t) {
+  char *from = t->buf;
+  char *to = t->buf;
+  size_t i;
+  for (i = 0; i < t->nfixups; i++) {
+    char *placeholder = t->buf + t->fixups[i].ofs;
+    size_t n = placeholder - from;
+    memmove(to, from, n);
+    to += n;
+    to += upb_vencode64(t->fixups[i].len, to);
+    from = placeholder + LENBYTES;
+  }
+  size_t n = t->ptr - from;
+  memmove(to, from, n);
+  t->ptr = to + n;
+}
+
+static bool hexdigit(char ch, uint32_t *val) {
+  if (ch >= '0' && ch <= '9') {
+    *val = (*val << 4) | (ch - '0');
+  } else if (ch >= 'a' && ch <= 'f') {
+    *val = (*val << 4) | (ch - 'a' + 10);
+  } else if (ch >= 'A' && ch <= 'F') {
+    *val = (*val << 4) | (ch - 'A' + 10);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Decodes the rest of a JSON string, whose opening quote has already been
+// consumed, to t->ptr.  Escapes are handled like the parser does: \uXXXX
+// becomes UTF-8 and surrogate pairs are not combined.
+static bool getstring(upb_json_transcoder *t, input *in) {
+  while (true) {
+    const char *run = in->ptr;
+    in->ptr = upb_json_findquote(in->ptr, in->end);
+    if (!putbytes(t, run, in->ptr - run)) return false;
+    if (in->ptr == in->end) return parseerror(t, in);
+    if (*in->ptr++ == '"') return true;
+
+    // An escape sequence.
+    if (in->ptr == in->end) return parseerror(t, in);
+    char ch;
+    switch (*in->ptr++) {
+      case '"': ch = '"'; break;
+      case '\\': ch = '\\'; break;
+      case '/': ch = '/'; break;
+      case 'b': ch = '\b'; break;
+      case 'f': ch = '\f'; break;
+      case 'n': ch = '\n'; break;
+      case 'r': ch = '\r'; break;
+      case 't': ch = '\t'; break;
+      case 'u': {
+        uint32_t cp = 0;
+        if (in->end - in->ptr < 4 ||
+            !hexdigit(in->ptr[0], &cp) || !hexdigit(in->ptr[1], &cp) ||
+            !hexdigit(in->ptr[2], &cp) || !hexdigit(in->ptr[3], &cp)) {
+          return parseerror(t, in);
+        }
+        in->ptr += 4;
+        char utf8[3];
+        size_t len;
+        if (cp <= 0x7f) {
+          utf8[0] = cp;
+          len = 1;
+        } else if (cp <= 0x7ff) {
+          utf8[0] = 0xc0 | (cp >> 6);
+          utf8[1] = 0x80 | (cp & 0x3f);
+          len = 2;
+        } else {
+          utf8[0] = 0xe0 | (cp >> 12);
+          utf8[1] = 0x80 | ((cp >> 6) & 0x3f);
+          utf8[2] = 0x80 | (cp & 0x3f);
+          len = 3;
+        }
+        if (!putbytes(t, utf8, len)) return false;
+        continue;
+      }
+      default:
+        in->ptr--;
+        return parseerror(t, in);
+    }
+    if (!putbytes(t, &ch, 1)) return false;
+  }
+}
+
+// Parses the member name at in->ptr (an opening quote) and looks it up.
+static bool getkey(upb_json_transcoder *t, const upb_json_transcodermethod *m,
+                   input *in, const tfield **f) {
+  if (peek(in) != '"') return parseerror(t, in);
+  const char *key = ++in->ptr;
+  in->ptr = upb_json_findquote(in->ptr, in->end);
+  if (in->ptr == in->end) return parseerror(t, in);
+
+  size_t len;
+  size_t spill = t->ptr - t->buf;
+  if (*in->ptr == '"') {
+    len = in->ptr++ - key;
+  } else {
+    // The key has escapes: decode it into the output buffer, past the end of
+    // what we have written, and look it up from there.
+    in->ptr = key;
+    if (!getstring(t, in)) return false;
+    key = t->buf + spill;
+    len = t->ptr - key;
+  }
+
+  const upb_json_nameent *e = upb_json_namemap_lookup(&m->names, key, len);
+  if (!e) {
+    upb_status_seterrf(t->status, "No such field: %.*s", (int)len, key);
+  }
+  t->ptr = t->buf + spill;
+  if (!e) return false;
+  *f = &m->fields[e->index];
+  return true;
+}
+
+// Parses a number for field "f" and returns the bits to encode for it.
+static bool getnumber(upb_json_transcoder *t, const tfield *f, input *in,
+                      uint64_t *bits) {
+  // Check the syntax first: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  const char *start = in->ptr;
+  const char *p = start;
+  const char *end = in->end;
+  if (p < end && *p == '-') p++;
+  if (p < end && *p == '0') {
+    p++;
+  } else if (p < end && *p >= '1' && *p <= '9') {
+    while (p < end && *p >= '0' && *p <= '9') p++;
+  } else {
+    return parseerror(t, in);
+  }
+  if (p < end && *p == '.') {
+    const char *digits = ++p;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+    if (p == digits) return parseerror(t, in);
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    if (p < end && (*p == '+' || *p == '-')) p++;
+    const char *digits = p;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+    if (p == digits) return parseerror(t, in);
+  }
+
+  const char *buf = start;
+  size_t len = p - start;
+  in->ptr = p;
+
+  bool ok;
+  switch (f->type) {
+    case UPB_DESCRIPTOR_TYPE_INT32:
+    case UPB_DESCRIPTOR_TYPE_ENUM:
+    case UPB_DESCRIPTOR_TYPE_SINT32:
+    case UPB_DESCRIPTOR_TYPE_SFIXED32: {
+      int64_t val = 0;
+      ok = upb_json_parseint64(buf, len, &val) &&
+           val >= INT32_MIN && val <= INT32_MAX;
+      *bits = f->type == UPB_DESCRIPTOR_TYPE_SINT32 ?
+          upb_zzenc_32(val) : (uint32_t)val;
+      break;
+    }
+    case UPB_DESCRIPTOR_TYPE_INT64:
+    case UPB_DESCRIPTOR_TYPE_SINT64:
+    case UPB_DESCRIPTOR_TYPE_SFIXED64: {
+      int64_t val = 0;
+      ok = upb_json_parseint64(buf, len, &val);
+      *bits = f->type == UPB_DESCRIPTOR_TYPE_SINT64 ?
+          upb_zzenc_64(val) : (uint64_t)val;
+      break;
+    }
+    case UPB_DESCRIPTOR_TYPE_UINT32:
+    case UPB_DESCRIPTOR_TYPE_FIXED32:
+      ok = upb_json_parseuint64(buf, len, bits) && *bits <= UINT32_MAX;
+      break;
+    case UPB_DESCRIPTOR_TYPE_UINT64:
+    case UPB_DESCRIPTOR_TYPE_FIXED64:
+      ok = upb_json_parseuint64(buf, len, bits);
+      break;
+    case UPB_DESCRIPTOR_TYPE_DOUBLE: {
+      double val = 0;
+      ok = upb_json_parsedouble(buf, len, &val);
+      memcpy(bits, &val, sizeof(val));
+      break;
+    }
+    case UPB_DESCRIPTOR_TYPE_FLOAT: {
+      float val = 0;
+      uint32_t u32;
+      ok = upb_json_parsefloat(buf, len, &val);
+      memcpy(&u32, &val, sizeof(val));
+      *bits = u32;
+      break;
+    }
+    default:
+      upb_status_seterrf(t->status, "Number specified for field: %s",
+                         upb_fielddef_name(f->def));
+      return false;
+  }
+
+  if (!ok) {
+    upb_status_seterrf(t->status, "Invalid number for field %s: %.*s",
+                       upb_fielddef_name(f->def), (int)len, buf);
+    return false;
+  }
+  return true;
+}
+
+// Parses a number, boolean or enum name for primitive field "f" and returns
+// the bits to encode for it.
+static bool getscalar(upb_json_transcoder *t, const tfield *f, input *in,
+                      uint64_t *bits) {
+  switch (peek(in)) {
+    case 't':
+    case 'f': {
+      if (f->type != UPB_DESCRIPTOR_TYPE_BOOL) {
+        upb_status_seterrf(t->status,
+                           "Boolean value specified for non-bool field: %s",
+                           upb_fielddef_name(f->def));
+        return false;
+      }
+      bool val = *in->ptr == 't';
+      *bits = val;
+      return val ? literal(t, in, "true", 4) : literal(t, in, "false", 5);
+    }
+    case '"': {
+      if (f->type != UPB_DESCRIPTOR_TYPE_ENUM) {
+        upb_status_seterrf(t->status,
+                           "String specified for non-string/non-enum field: %s",
+                           upb_fielddef_name(f->def));
+        return false;
+      }
+      in->ptr++;
+      size_t spill = t->ptr - t->buf;
+      if (!getstring(t, in)) return false;
+      int32_t val;
+      bool found = upb_enumdef_ntoi(f->enumdef, t->buf + spill,
+                                    t->ptr - t->buf - spill, &val);
+      t->ptr = t->buf + spill;
+      if (!found) {
+        upb_status_seterrmsg(t->status, "Enum value name unknown");
+        return false;
+      }
+      *bits = (uint32_t)val;
+      return true;
+    }
+    case '{':
+      upb_status_seterrf(t->status,
+                         "Object specified for non-message/group field: %s",
+                         upb_fielddef_name(f->def));
+      return false;
+    default:
+      return getnumber(t, f, in, bits);
+  }
+}
+
+static bool putscalar(upb_json_transcoder *t, const tfield *f, uint64_t bits) {
+  switch (f->wiretype) {
+    case UPB_WIRE_TYPE_64BIT:
+      // TODO(haberman): byte-swap for big endian.
+      return putbytes(t, (const char*)&bits, 8);
+    case UPB_WIRE_TYPE_32BIT: {
+      uint32_t u32 = bits;
+      return putbytes(t, (const char*)&u32, 4);
+    }
+    default:
+      return putvarint(t, bits);
+  }
+}
+
+// Decodes the "len" characters of base64 at "start" and writes them as a
+// length-delimited value.
+static bool putbase64text(upb_json_transcoder *t, const tfield *f,
+                          const char *start, size_t len) {
+  upb_json_base64status status = UPB_JSON_BASE64_BADLENGTH;
+  if (len % 4 == 0) {
+    // Write the length we expect, and check it afterwards.
+    size_t pad = 0;
+    if (len > 0 && start[len - 1] == '=') pad++;
+    if (len > 1 && start[len - 2] == '=') pad++;
+    size_t outlen = len / 4 * 3 - pad;
+    if (!putvarint(t, outlen) || !reserve(t, len / 4 * 3)) return false;
+
+    size_t decoded;
+    status = upb_json_base64decode(start, len, t->ptr, &decoded);
+    if (status == UPB_JSON_BASE64_OK) {
+      UPB_ASSERT_VAR(outlen, decoded == outlen);
+      t->ptr += decoded;
+      return true;
+    }
+  }
+
+  upb_status_seterrf(
+      t->status,
+      status == UPB_JSON_BASE64_BADLENGTH ?
+          "Base64 input for bytes field not a multiple of 4: %s" :
+      status == UPB_JSON_BASE64_BADCHAR ?
+          "Non-base64 characters in bytes field: %s" :
+          "Incorrect base64 padding for field: %s",
+      upb_fielddef_name(f->def));
+  return false;
+}
+
+// Decodes the base64 string at in->ptr (after the opening quote) and writes
+// it as a length-delimited value.
+static bool putbase64bytes(upb_json_transcoder *t, const tfield *f,
+                           input *in) {
+  const char *start = in->ptr;
+  const char *p = upb_json_findquote(start, in->end);
+  if (p == in->end) return parseerror(t, in);
+  if (*p == '"') {
+    in->ptr = p + 1;
+    return putbase64text(t, f, start, p - start);
+  }
+
+  // Escapes in base64 are rare (some encoders write "\/"), so we just decode
+  // the string past the end of our output and take a copy of it.
+  size_t spill = t->ptr - t->buf;
+  if (!getstring(t, in)) return false;
+  size_t len = t->ptr - t->buf - spill;
+  char *text = upb_malloc(t->alloc, len);
+  if (!text) {
+    upb_status_seterrmsg(t->status, "Out of memory.");
+    return false;
+  }
+  memcpy(text, t->buf + spill, len);
+  t->ptr = t->buf + spill;
+  bool ok = putbase64text(t, f, text, len);
+  upb_free(t->alloc, text);
+  return ok;
+}
+
+// Writes a string field, whose opening quote has been consumed.  Strings
+// without escapes are copied straight through; the others go through the
+// fixup path, since we only learn their length by decoding them.
+static bool putstringfield(upb_json_transcoder *t, input *in) {
+  const char *p = upb_json_findquote(in->ptr, in->end);
+  if (p < in->end && *p == '"') {
+    size_t len = p - in->ptr;
+    if (!putvarint(t, len) || !putbytes(t, in->ptr, len)) return false;
+    in->ptr = p + 1;
+    return true;
+  }
+
+  size_t fixup, shrink;
+  return startlen(t, &fixup, &shrink) && getstring(t, in) &&
+         endlen(t, fixup, shrink);
+}
+
+static bool jsontopb_msg(upb_json_transcoder *t,
+                         const upb_json_transcodermethod *m, input *in,
+                         int depth);
+
+// Writes the value at in->ptr, with its tag, as a single (non-packed)
+// occurrence of "f".
+static bool jsontopb_val(upb_json_transcoder *t, const tfield *f, input *in,
+                         int depth) {
+  char ch = peek(in);
+  size_t fixup, shrink;
+  uint64_t bits;
+
+  switch (f->type) {
+    case UPB_DESCRIPTOR_TYPE_STRING:
+    case UPB_DESCRIPTOR_TYPE_BYTES:
+      if (ch != '"') {
+        upb_status_seterrf(t->status, "Expected a string for field: %s",
+                           upb_fielddef_name(f->def));
+        return false;
+      }
+      in->ptr++;
+      if (!putbytes(t, f->tag, f->taglen)) return false;
+      return f->type == UPB_DESCRIPTOR_TYPE_STRING ?
+          putstringfield(t, in) : putbase64bytes(t, f, in);
+    case UPB_DESCRIPTOR_TYPE_MESSAGE:
+    case UPB_DESCRIPTOR_TYPE_GROUP:
+      if (ch != '{') {
+        upb_status_seterrf(t->status, "Expected an object for field: %s",
+                           upb_fielddef_name(f->def));
+        return false;
+      }
+      if (f->type == UPB_DESCRIPTOR_TYPE_GROUP) {
+        return putbytes(t, f->tag, f->taglen) &&
+               jsontopb_msg(t, f->sub, in, depth + 1) &&
+               putbytes(t, f->tag2, f->tag2len);
+      }
+      return putbytes(t, f->tag, f->taglen) &&
+             startlen(t, &fixup, &shrink) &&
+             jsontopb_msg(t, f->sub, in, depth + 1) &&
+             endlen(t, fixup, shrink);
+    default:
+      return getscalar(t, f, in, &bits) &&
+             putbytes(t, f->tag, f->taglen) &&
+             putscalar(t, f, bits);
+  }
+}
+
+static bool jsontopb_array(upb_json_transcoder *t, const tfield *f, input *in,
+                           int depth) {
+  size_t fixup, shrink;
+  in->ptr++;  // '['
+  if (f->packed &&
+      !(putbytes(t, f->tag2, f->tag2len) && startlen(t, &fixup, &shrink))) {
+    return false;
+  }
+
+  if (peek(in) == ']') {
+    in->ptr++;
+  } else {
+    while (true) {
+      char ch = peek(in);
+      if (ch == 'n') {
+        if (!literal(t, in, "null", 4)) return false;
+      } else if (ch == '[') {
+        upb_status_seterrf(t->status, "Nested arrays in field: %s",
+                           upb_fielddef_name(f->def));
+        return false;
+      } else if (f->packed) {
+        uint64_t bits;
+        if (!getscalar(t, f, in, &bits) || !putscalar(t, f, bits)) {
+          return false;
+        }
+      } else if (!jsontopb_val(t, f, in, depth)) {
+        return false;
+      }
+
+      if (peek(in) != ',') break;
+      in->ptr++;
+    }
+    if (!consume(t, in, ']')) return false;
+  }
+
+  return !f->packed || endlen(t, fixup, shrink);
+}
+
+// Writes the JSON object at in->ptr as message "m".
+static bool jsontopb_msg(upb_json_transcoder *t,
+                         const upb_json_transcodermethod *m, input *in,
+                         int depth) {
+  if (depth > UPB_MAX_HANDLER_DEPTH) {
+    upb_status_seterrmsg(t->status, "Nesting too deep.");
+    return false;
+  }
+  if (!consume(t, in, '{')) return false;
+  if (peek(in) == '}') {
+    in->ptr++;
+    return true;
+  }
+
+  while (true) {
+    const tfield *f;
+    if (!getkey(t, m, in, &f) || !consume(t, in, ':')) return false;
+
+    switch (peek(in)) {
+      case 'n':
+        if (!literal(t, in, "null", 4)) return false;
+        break;
+      case '[':
+        if (!f->repeated) {
+          upb_status_seterrf(t->status,
+                             "Array specified for non-repeated field: %s",
+                             upb_fielddef_name(f->def));
+          return false;
+        }
+        if (!jsontopb_array(t, f, in, depth)) return false;
+        break;
+      default:
+        if (!jsontopb_val(t, f, in, depth)) return false;
+        break;
+    }
+
+    if (peek(in) != ',') break;
+    in->ptr++;
+  }
+
+  return consume(t, in, '}');
+}
+
+
+/* upb::json::Transcoder ******************************************************/
+
+void upb_json_transcoder_init(upb_json_transcoder *t) {
+  t->status = NULL;
+  t->alloc = &upb_alloc_global;
+  t->buf = NULL;
+  t->ptr = NULL;
+  t->limit = NULL;
+  t->fixups = NULL;
+  t->nfixups = 0;
+  t->fixupsize = 0;
+  t->shrink = 0;
+}
+
+void upb_json_transcoder_uninit(upb_json_transcoder *t) {
+  upb_free(t->alloc, t->buf);
+  upb_free(t->alloc, t->fixups);
+}
+
+void upb_json_transcoder_setalloc(upb_json_transcoder *t, upb_alloc *alloc) {
+  // We can't switch allocators once we've allocated from the old one.
+  assert(!t->buf && !t->fixups);
+  t->alloc = alloc;
+}
+
+// Writes out everything we have buffered as a single string.
+static bool flush(upb_json_transcoder *t, upb_bytessink *output) {
+  size_t len = t->ptr - t->buf;
+  void *subc;
+  if (!upb_bytessink_start(output, len, &subc) ||
+      upb_bytessink_putbuf(output, subc, t->buf, len, NULL) != len ||
+      !upb_bytessink_end(output)) {
+    upb_status_seterrmsg(t->status, "Output refused the data.");
+    return false;
+  }
+  return true;
+}
+
+bool upb_json_transcoder_pbtojson(upb_json_transcoder *t,
+                                  const upb_json_transcodermethod *m,
+                                  const char *buf, size_t len,
+                                  upb_bytessink *output, upb_status *status) {
+  input in;
+  in.ptr = buf;
+  in.end = buf + len;
+  t->status = status;
+  t->ptr = t->buf;
+  return pbtojson_msg(t, m, &in, -1, 0) && flush(t, output);
+}
+
+bool upb_json_transcoder_jsontopb(upb_json_transcoder *t,
+                                  const upb_json_transcodermethod *m,
+                                  const char *buf, size_t len,
+                                  upb_bytessink *output, upb_status *status) {
+  input in;
+  in.ptr = buf;
+  in.end = buf + len;
+  t->status = status;
+  t->ptr = t->buf;
+  t->nfixups = 0;
+  t->shrink = 0;
+  if (!jsontopb_msg(t, m, &in, 0)) return false;
+  if (peek(&in) != 0) return parseerror(t, &in);
+  applyfixups(t);
+  return flush(t, output);
+}
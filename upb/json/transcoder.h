@@ -0,0 +1,174 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * upb::json::Transcoder converts between the protobuf binary format and JSON
+ * directly, without going through handlers.
+ *
+ * Decoding into upb::json::Printer (or parsing into upb::pb::Encoder) costs a
+ * handler call, a sink frame and a closure dispatch for every field.  The
+ * transcoder instead compiles each MessageDef once into a TranscoderMethod
+ * (field lookup by number and by name, field names pre-rendered as quoted
+ * JSON keys, pre-encoded tags) and then converts a whole message in a single
+ * pass into its own output buffer, which is handed to the output in a single
+ * PutBuffer().
+ *
+ * The output is the same as what upb::pb::Decoder -> upb::json::Printer, or
+ * upb::json::Parser -> upb::pb::Encoder, produces for the same input.
+ */
+
+#ifndef UPB_JSON_TRANSCODER_H_
+#define UPB_JSON_TRANSCODER_H_
+
+#include "upb/sink.h"
+
+#ifdef __cplusplus
+namespace upb {
+namespace json {
+class Transcoder;
+class TranscoderCache;
+class TranscoderMethod;
+}  // namespace json
+}  // namespace upb
+#endif
+
+UPB_DECLARE_TYPE(upb::json::Transcoder, upb_json_transcoder);
+UPB_DECLARE_TYPE(upb::json::TranscoderCache, upb_json_transcodercache);
+UPB_DECLARE_TYPE(upb::json::TranscoderMethod, upb_json_transcodermethod);
+
+/* upb::json::TranscoderCache *************************************************/
+
+// Compiles and owns the TranscoderMethods for a set of MessageDefs.  Like a
+// upb::pb::CodeCache, it should be long-lived.  It is not thread-safe, but the
+// methods it returns may be used from any number of threads.
+UPB_DEFINE_CLASS0(upb::json::TranscoderCache,
+ public:
+  TranscoderCache();
+  ~TranscoderCache();
+
+  // Returns the method for transcoding messages of type "md", compiling it
+  // (and the methods for all of its submessages) if necessary.  Returns NULL
+  // and sets "status" if we run out of memory.
+  //
+  // The method is owned by the cache and lives as long as it does.
+  const TranscoderMethod* GetTranscoderMethod(const MessageDef* md,
+                                              Status* status);
+
+ private:
+  UPB_DISALLOW_COPY_AND_ASSIGN(TranscoderCache);
+,
+UPB_DEFINE_STRUCT0(upb_json_transcodercache,
+  // Maps upb_msgdef* -> upb_json_transcodermethod*.  The cache holds a ref on
+  // every upb_msgdef in it.
+  upb_inttable methods;
+));
+
+/* upb::json::Transcoder ******************************************************/
+
+// When converting JSON to protobuf, the length of a submessage, packed field
+// or escaped string is only known once we reach its end, so we leave room
+// for the largest possible length and record a fixup for it.
+typedef struct {
+ UPB_PRIVATE_FOR_CPP
+  size_t ofs;    // Offset of the length placeholder in the output buffer.
+  uint32_t len;  // The length, once known.
+} upb_json_transcoder_fixup;
+
+// Holds the output buffer; reusing a Transcoder is cheaper than creating a new
+// one for every message.
+UPB_DEFINE_CLASS0(upb::json::Transcoder,
+ public:
+  Transcoder();
+  ~Transcoder();
+
+  // Sets the allocator for the transcoder's buffers, for example an Arena
+  // that holds all memory for the current request.  Must be called before
+  // anything is transcoded.
+  void SetAllocator(Allocator* alloc);
+
+  // Converts the protobuf binary data in "buf" to JSON and writes it to
+  // "output".  Returns false and sets "status" if the input is malformed or
+  // nested too deeply.
+  bool ProtobufToJson(const TranscoderMethod* method, const char* buf,
+                      size_t len, BytesSink* output, Status* status);
+
+  // Converts the JSON document in "buf" to protobuf binary data and writes it
+  // to "output".  Returns false and sets "status" if the input is malformed,
+  // nested too deeply, or doesn't match the message type.
+  bool JsonToProtobuf(const TranscoderMethod* method, const char* buf,
+                      size_t len, BytesSink* output, Status* status);
+
+ private:
+  UPB_DISALLOW_COPY_AND_ASSIGN(Transcoder);
+,
+UPB_DEFINE_STRUCT0(upb_json_transcoder, UPB_QUOTE(
+  upb_status *status;
+  upb_alloc *alloc;
+
+  // The output buffer, and our current write position in it.
+  char *buf, *ptr, *limit;
+
+  // JSON -> protobuf only: the length fixups in the output buffer, in order,
+  // and how many bytes the lengths known so far will save once written out.
+  upb_json_transcoder_fixup *fixups;
+  size_t nfixups, fixupsize;
+  size_t shrink;
+)));
+
+UPB_BEGIN_EXTERN_C  // {
+
+void upb_json_transcodercache_init(upb_json_transcodercache *c);
+void upb_json_transcodercache_uninit(upb_json_transcodercache *c);
+const upb_json_transcodermethod *upb_json_transcodercache_getmethod(
+    upb_json_transcodercache *c, const upb_msgdef *md, upb_status *status);
+
+void upb_json_transcoder_init(upb_json_transcoder *t);
+void upb_json_transcoder_uninit(upb_json_transcoder *t);
+void upb_json_transcoder_setalloc(upb_json_transcoder *t, upb_alloc *alloc);
+bool upb_json_transcoder_pbtojson(upb_json_transcoder *t,
+                                  const upb_json_transcodermethod *m,
+                                  const char *buf, size_t len,
+                                  upb_bytessink *output, upb_status *status);
+bool upb_json_transcoder_jsontopb(upb_json_transcoder *t,
+                                  const upb_json_transcodermethod *m,
+                                  const char *buf, size_t len,
+                                  upb_bytessink *output, upb_status *status);
+
+UPB_END_EXTERN_C  // }
+
+#ifdef __cplusplus
+
+namespace upb {
+namespace json {
+inline TranscoderCache::TranscoderCache() {
+  upb_json_transcodercache_init(this);
+}
+inline TranscoderCache::~TranscoderCache() {
+  upb_json_transcodercache_uninit(this);
+}
+inline const TranscoderMethod* TranscoderCache::GetTranscoderMethod(
+    const MessageDef* md, Status* status) {
+  return upb_json_transcodercache_getmethod(this, md, status);
+}
+inline Transcoder::Transcoder() { upb_json_transcoder_init(this); }
+inline Transcoder::~Transcoder() { upb_json_transcoder_uninit(this); }
+inline void Transcoder::SetAllocator(Allocator* alloc) {
+  upb_json_transcoder_setalloc(this, alloc);
+}
+inline bool Transcoder::ProtobufToJson(const TranscoderMethod* method,
+                                       const char* buf, size_t len,
+                                       BytesSink* output, Status* status) {
+  return upb_json_transcoder_pbtojson(this, method, buf, len, output, status);
+}
+inline bool Transcoder::JsonToProtobuf(const TranscoderMethod* method,
+                                       const char* buf, size_t len,
+                                       BytesSink* output, Status* status) {
+  return upb_json_transcoder_jsontopb(this, method, buf, len, output, status);
+}
+}  // namespace json
+}  // namespace upb
+
+#endif
+
+#endif  // UPB_JSON_TRANSCODER_H_
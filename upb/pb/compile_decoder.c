@@ -23,6 +23,10 @@
 #include <stdio.h>
 #endif
 
+#if defined(UPB_USE_JIT_X64) && !defined(UPB_THREAD_UNSAFE)
+#include <pthread.h>
+#endif
+
 #define MAXLABEL 5
 #define EMPTYLABEL -1
 
@@ -62,9 +66,16 @@ mgroup *newgroup(const void *owner) {
 
 /* upb_pbdecodermethod ********************************************************/
 
+#ifdef UPB_USE_JIT_X64
+static void tier_unref(upb_pbdecoder_tier *t);
+#endif
+
 static void freemethod(upb_refcounted *r) {
   upb_pbdecodermethod *method = (upb_pbdecodermethod*)r;
   upb_byteshandler_uninit(&method->input_handler_);
+#ifdef UPB_USE_JIT_X64
+  if (method->tier_) tier_unref(method->tier_);
+#endif
 
   if (method->dest_handlers_) {
     upb_handlers_unref(method->dest_handlers_, method);
@@ -97,6 +108,10 @@ static upb_pbdecodermethod *newmethod(const upb_handlers *dest_handlers,
   ret->dest_handlers_ = dest_handlers;
   ret->is_native_ = false;  // If we JIT, it will update this later.
   upb_inttable_init(&ret->dispatch, UPB_CTYPE_UINT64);
+  memset(&ret->stats_, 0, sizeof(ret->stats_));
+#ifdef UPB_USE_JIT_X64
+  ret->tier_ = NULL;
+#endif
 
   if (ret->dest_handlers_) {
     upb_handlers_ref(ret->dest_handlers_, ret);
@@ -134,9 +149,21 @@ const upb_byteshandler *upb_pbdecodermethod_inputhandler(
 }
 
 bool upb_pbdecodermethod_isnative(const upb_pbdecodermethod *m) {
+#ifdef UPB_USE_JIT_X64
+  if (m->tier_ && __atomic_load_n(&m->tier_->jit, __ATOMIC_ACQUIRE)) {
+    return true;
+  }
+#endif
   return m->is_native_;
 }
 
+void upb_pbdecodermethod_getstats(const upb_pbdecodermethod *m,
+                                  upb_pbdecoder_stats *stats) {
+  // Decoders on other threads may be adding to these as we read them, so the
+  // snapshot is not necessarily consistent across counters.
+  *stats = m->stats_;
+}
+
 const upb_pbdecodermethod *upb_pbdecodermethod_new(
     const upb_pbdecodermethodopts *opts, const void *owner) {
   upb_pbcodecache cache;
@@ -541,6 +568,9 @@ static void dispatchtarget(compiler *c, upb_pbdecodermethod *method,
   }
 }
 
+// Pushes the frame for a submessage or group.  This (or the push of a
+// sequence's frame) must immediately precede the OP_STARTSUBMSG/OP_STARTSEQ,
+// since the decoder looks at the previous op to compute the size hint.
 static void putpush(compiler *c, const upb_fielddef *f) {
   if (upb_fielddef_descriptortype(f) == UPB_DESCRIPTOR_TYPE_MESSAGE) {
     putop(c, OP_PUSHLENDELIM);
@@ -848,11 +878,11 @@ static void set_bytecode_handlers(mgroup *g) {
 
 #ifdef UPB_USE_JIT_X64
 
-static void sethandlers(mgroup *g, bool allowjit) {
+static void sethandlers(mgroup *g, bool allowjit, uint32_t jitdebug) {
   g->jit_code = NULL;
   if (allowjit) {
     // Compile byte-code into machine code, create handlers.
-    upb_pbdecoder_jit(g);
+    upb_pbdecoder_jit(g, jitdebug);
   } else {
     set_bytecode_handlers(g);
   }
@@ -860,9 +890,10 @@ static void sethandlers(mgroup *g, bool allowjit) {
 
 #else  // UPB_USE_JIT_X64
 
-static void sethandlers(mgroup *g, bool allowjit) {
+static void sethandlers(mgroup *g, bool allowjit, uint32_t jitdebug) {
   // No JIT compiled in; use bytecode handlers unconditionally.
   UPB_UNUSED(allowjit);
+  UPB_UNUSED(jitdebug);
   set_bytecode_handlers(g);
 }
 
@@ -871,8 +902,8 @@ static void sethandlers(mgroup *g, bool allowjit) {
 
 // TODO(haberman): allow this to be constructed for an arbitrary set of dest
 // handlers and other mgroups (but verify we have a transitive closure).
-const mgroup *mgroup_new(const upb_handlers *dest, bool allowjit, bool lazy,
-                         const void *owner) {
+const mgroup *mgroup_new(const upb_handlers *dest, bool allowjit,
+                         uint32_t jitdebug, bool lazy, const void *owner) {
   UPB_UNUSED(allowjit);
   assert(upb_handlers_isfrozen(dest));
 
@@ -900,16 +931,129 @@ const mgroup *mgroup_new(const upb_handlers *dest, bool allowjit, bool lazy,
   fclose(f);
 #endif
 
-  sethandlers(g, allowjit);
+  sethandlers(g, allowjit, jitdebug);
   return g;
 }
 
 
+/* Tiered compilation *********************************************************/
+
+#ifdef UPB_USE_JIT_X64
+
+#ifdef UPB_THREAD_UNSAFE
+static uint64_t atomic_add(uint64_t *a, uint64_t n) { return *a += n; }
+static bool atomic_dec(uint32_t *a) { return --(*a) == 0; }
+static bool atomic_claim(uint32_t *a) { return (*a)++ == 0; }
+#else
+static uint64_t atomic_add(uint64_t *a, uint64_t n) {
+  return __sync_add_and_fetch(a, n);
+}
+static bool atomic_dec(uint32_t *a) { return __sync_sub_and_fetch(a, 1) == 0; }
+static bool atomic_claim(uint32_t *a) {
+  return __sync_bool_compare_and_swap(a, 0, 1);
+}
+#endif
+
+static void tier_unref(upb_pbdecoder_tier *t) {
+  if (!atomic_dec(&t->refcount)) return;
+  if (t->jit_group) upb_refcounted_unref(UPB_UPCAST(t->jit_group), t);
+  upb_handlers_unref(t->handlers, t);
+  free(t);
+}
+
+// Builds a JIT-compiled group for the same handlers as the bytecode method,
+// and publishes its method.  The group is private to this tier, so this is
+// safe to do on any thread.
+static void tier_compile(upb_pbdecoder_tier *t) {
+  const mgroup *g = mgroup_new(t->handlers, true, t->jitdebug, t->lazy, t);
+  upb_value v;
+  bool ok = upb_inttable_lookupptr(&g->methods, t->handlers, &v);
+  UPB_ASSERT_VAR(ok, ok);
+  t->jit_group = g;
+  __atomic_store_n(&t->jit, upb_value_getptr(v), __ATOMIC_RELEASE);
+}
+
+#ifndef UPB_THREAD_UNSAFE
+static void *tier_thread(void *closure) {
+  upb_pbdecoder_tier *t = closure;
+  tier_compile(t);
+  tier_unref(t);
+  return NULL;
+}
+
+// Starts compiling on a new thread, which takes a ref on "t".
+static bool tier_compileasync(upb_pbdecoder_tier *t) {
+  pthread_t thread;
+  __sync_fetch_and_add(&t->refcount, 1);
+  if (pthread_create(&thread, NULL, &tier_thread, t) != 0) {
+    atomic_dec(&t->refcount);
+    return false;
+  }
+  pthread_detach(thread);
+  return true;
+}
+#endif
+
+const upb_pbdecodermethod *upb_pbdecoder_tierup(const upb_pbdecodermethod *m) {
+  upb_pbdecoder_tier *t = m->tier_;
+  const upb_pbdecodermethod *jit = __atomic_load_n(&t->jit, __ATOMIC_ACQUIRE);
+  if (jit || t->compiling) return jit;
+
+  uint64_t calls = atomic_add(&t->calls, 1);
+  if (calls < t->calls_threshold && t->bytes < t->bytes_threshold) {
+    return NULL;
+  }
+
+  // Hot; the first decoder to notice gets to compile.
+  if (!atomic_claim(&t->compiling)) return NULL;
+#ifndef UPB_THREAD_UNSAFE
+  // If we can't start a thread, we just compile here instead.
+  if (t->background && tier_compileasync(t)) return NULL;
+#endif
+  tier_compile(t);
+  return t->jit;
+}
+
+// Puts method "m" (fresh from a bytecode-only mgroup_new()) under tiered
+// compilation.
+static void settiered(const upb_pbcodecache *c, upb_pbdecodermethod *m,
+                      bool lazy) {
+  upb_pbdecoder_tier *t = malloc(sizeof(*t));
+  if (!t) return;  // Just stays on bytecode.
+  t->refcount = 1;
+  t->calls = 0;
+  t->bytes = 0;
+  t->calls_threshold = c->tier_calls_;
+  t->bytes_threshold = c->tier_bytes_;
+  t->handlers = m->dest_handlers_;
+  upb_handlers_ref(t->handlers, t);
+  t->lazy = lazy;
+  t->jitdebug = c->jit_debug_;
+  t->background = c->background_compile_;
+  t->compiling = 0;
+  t->jit_group = NULL;
+  t->jit = NULL;
+  m->tier_ = t;
+
+  upb_byteshandler *h = &m->input_handler_;
+  upb_byteshandler_setstartstr(h, upb_pbdecoder_starttiered, m);
+  upb_byteshandler_setstring(h, upb_pbdecoder_decodetiered, NULL);
+  upb_byteshandler_setendstr(h, upb_pbdecoder_endtiered, m);
+}
+
+#endif  // UPB_USE_JIT_X64
+
+
 /* upb_pbcodecache ************************************************************/
 
 void upb_pbcodecache_init(upb_pbcodecache *c) {
   upb_inttable_init(&c->groups, UPB_CTYPE_CONSTPTR);
   c->allow_jit_ = true;
+  c->jit_debug_ = 0;
+  c->tiered_ = false;
+  c->background_compile_ = false;
+  c->tier_calls_ = UPB_PBDECODER_TIER_CALLS;
+  c->tier_bytes_ = UPB_PBDECODER_TIER_BYTES;
 }
 
 void upb_pbcodecache_uninit(upb_pbcodecache *c) {
@@ -933,16 +1077,64 @@ bool upb_pbcodecache_setallowjit(upb_pbcodecache *c, bool allow) {
   return true;
 }
 
+uint32_t upb_pbcodecache_jitdebug(const upb_pbcodecache *c) {
+  return c->jit_debug_;
+}
+
+bool upb_pbcodecache_setjitdebug(upb_pbcodecache *c, uint32_t flags) {
+  if (upb_inttable_count(&c->groups) > 0)
+    return false;
+  c->jit_debug_ = flags;
+  return true;
+}
+
+bool upb_pbcodecache_tiered(const upb_pbcodecache *c) {
+  return c->tiered_;
+}
+
+bool upb_pbcodecache_settiered(upb_pbcodecache *c, bool tiered) {
+  if (upb_inttable_count(&c->groups) > 0)
+    return false;
+  c->tiered_ = tiered;
+  return true;
+}
+
+bool upb_pbcodecache_settierthresholds(upb_pbcodecache *c, uint64_t calls,
+                                       uint64_t bytes) {
+  if (upb_inttable_count(&c->groups) > 0)
+    return false;
+  c->tier_calls_ = calls;
+  c->tier_bytes_ = bytes;
+  return true;
+}
+
+bool upb_pbcodecache_setbackgroundcompile(upb_pbcodecache *c,
+                                          bool background) {
+  if (upb_inttable_count(&c->groups) > 0)
+    return false;
+  c->background_compile_ = background;
+  return true;
+}
+
 const upb_pbdecodermethod *upb_pbcodecache_getdecodermethod(
     upb_pbcodecache *c, const upb_pbdecodermethodopts *opts) {
+  // Under tiered compilation we start with bytecode and JIT later.
+  bool tiered = c->allow_jit_ && c->tiered_;
+
   // Right now we build a new DecoderMethod every time.
   // TODO(haberman): properly cache methods by their true key.
-  const mgroup *g = mgroup_new(opts->handlers, c->allow_jit_, opts->lazy, c);
+  const mgroup *g = mgroup_new(opts->handlers, c->allow_jit_ && !tiered,
+                               c->jit_debug_, opts->lazy, c);
   upb_inttable_push(&c->groups, upb_value_constptr(g));
 
   upb_value v;
   bool ok = upb_inttable_lookupptr(&g->methods, opts->handlers, &v);
   UPB_ASSERT_VAR(ok, ok);
+#ifdef UPB_USE_JIT_X64
+  if (tiered) settiered(c, upb_value_getptr(v), opts->lazy);
+#else
+  UPB_UNUSED(tiered);
+#endif
   return upb_value_getptr(v);
 }
 
@@ -9,8 +9,19 @@
 
 #include <dlfcn.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <elf.h>
+#include <fcntl.h>
+#ifndef UPB_THREAD_UNSAFE
+#include <pthread.h>
+#endif
+#include <sys/syscall.h>
+#include <time.h>
+#endif
 #include "upb/pb/decoder.h"
 #include "upb/pb/decoder.int.h"
 #include "upb/pb/varint.int.h"
@@ -39,9 +50,9 @@
 //    the JIT executes assembly for a particular bytecode.  Sample output:
 //
 //    X.enterjit bytes=18
-//    buf_ofs=1 data_rem=17 delim_rem=-2 X.0x6.OP_PARSE_DOUBLE
-//    buf_ofs=9 data_rem=9 delim_rem=-10 X.0x7.OP_CHECKDELIM
-//    buf_ofs=9 data_rem=9 delim_rem=-10 X.0x8.OP_TAG1
+//    buf_ofs=1 data_rem=17 delim_rem=-2 X.DecoderTest.0x6.OP_PARSE_DOUBLE
+//    buf_ofs=9 data_rem=9 delim_rem=-10 X.DecoderTest.0x7.OP_CHECKDELIM
+//    buf_ofs=9 data_rem=9 delim_rem=-10 X.DecoderTest.0x8.OP_TAG1
 //    X.0x3.dispatch.DecoderTest
 //    X.parse_unknown
 //    X.0x3.dispatch.DecoderTest
@@ -51,12 +62,17 @@
 //    This output should roughly correspond to the output that the bytecode
 //    interpreter emits when compiled with UPB_DUMP_BYTECODE (modulo some
 //    extra JIT-specific output).
+//
+// For profiling, or for debugging without a compiler at hand, it is usually
+// simpler to use CodeCache::set_jit_debug() instead (see upb_jitdebug in
+// decoder.h).  That leaves the code where it is and describes it to perf
+// and/or GDB using the same labels.
 
 // These defines are necessary for DynASM codegen.
 // See dynasm/dasm_proto.h for more info.
-#define Dst_DECL jitcompiler *jc
-#define Dst_REF (jc->dynasm)
-#define Dst (jc)
+#define Dst_DECL dasm_State **dasm
+#define Dst_REF (*dasm)
+#define Dst (&jc->dynasm)
 
 // In debug mode, make DynASM do internal checks (must be defined before any
 // dasm header is included.
@@ -99,11 +115,13 @@ typedef struct {
   int lastlabelofs;
 #endif
 
-#ifdef UPB_JIT_LOAD_SO
-  // For marking labels that should go into the generated code.
+  // UPB_JITDEBUG_* flags from the CodeCache.
+  uint32_t debugflags;
+
+  // For marking labels that should go into the generated code.  Only
+  // populated when UPB_JIT_LOAD_SO is defined or debugflags is nonzero.
   // Maps pclabel -> char* label (string is owned by the table).
   upb_inttable asmlabels;
-#endif
 
   // The total number of pclabels currently defined.
   // Note that this contains both jmptargets and asmlabels, which both use
@@ -121,56 +139,51 @@ static void asmlabel(jitcompiler *jc, const char *fmt, ...);
 static int pcofs(jitcompiler* jc);
 static int alloc_pclabel(jitcompiler *jc);
 
-#ifdef UPB_JIT_LOAD_SO
 static char *upb_vasprintf(const char *fmt, va_list ap);
 static char *upb_asprintf(const char *fmt, ...);
-#endif
 
+// This also defines the DynASM runtime for compile_encoder_x64.c, which must
+// use the same Dst_DECL and Dst_REF.
 #include "dynasm/dasm_proto.h"
 #include "dynasm/dasm_x86.h"
 #include "upb/pb/compile_decoder_x64.h"
 
-static jitcompiler *newjitcompiler(mgroup *group) {
+static jitcompiler *newjitcompiler(mgroup *group, uint32_t debugflags) {
   jitcompiler *jc = malloc(sizeof(jitcompiler));
   jc->group = group;
+  jc->debugflags = debugflags;
   jc->pclabel_count = 0;
   upb_inttable_init(&jc->jmptargets, UPB_CTYPE_UINT32);
 #ifndef NDEBUG
   jc->lastlabelofs = -1;
   upb_inttable_init(&jc->jmpdefined, UPB_CTYPE_BOOL);
 #endif
-#ifdef UPB_JIT_LOAD_SO
   upb_inttable_init(&jc->asmlabels, UPB_CTYPE_PTR);
-#endif
   jc->globals = malloc(UPB_JIT_GLOBAL__MAX * sizeof(*jc->globals));
 
-  dasm_init(jc, 1);
-  dasm_setupglobal(jc, jc->globals, UPB_JIT_GLOBAL__MAX);
-  dasm_setup(jc, upb_jit_actionlist);
+  dasm_init(Dst, 1);
+  dasm_setupglobal(Dst, jc->globals, UPB_JIT_GLOBAL__MAX);
+  dasm_setup(Dst, upb_jit_actionlist);
 
   return jc;
 }
 
 static void freejitcompiler(jitcompiler *jc) {
-#ifdef UPB_JIT_LOAD_SO
   upb_inttable_iter i;
   upb_inttable_begin(&i, &jc->asmlabels);
   for (; !upb_inttable_done(&i); upb_inttable_next(&i)) {
     free(upb_value_getptr(upb_inttable_iter_value(&i)));
   }
   upb_inttable_uninit(&jc->asmlabels);
-#endif
 #ifndef NDEBUG
   upb_inttable_uninit(&jc->jmpdefined);
 #endif
   upb_inttable_uninit(&jc->jmptargets);
-  dasm_free(jc);
+  dasm_free(Dst);
   free(jc->globals);
   free(jc);
 }
 
-#ifdef UPB_JIT_LOAD_SO
-
 // Like sprintf except allocates the string, which is returned and owned by the
 // caller.
 //
@@ -199,11 +212,9 @@ static char *upb_asprintf(const char *fmt, ...) {
   return ret;
 }
 
-#endif
-
 static int alloc_pclabel(jitcompiler *jc) {
   int newpc = jc->pclabel_count++;
-  dasm_growpc(jc, jc->pclabel_count);
+  dasm_growpc(Dst, jc->pclabel_count);
   return newpc;
 }
 
@@ -265,7 +276,7 @@ static int machine_code_ofs(jitcompiler *jc, const void *key) {
   int pclabel = getjmptarget(jc, key);
   // Despite its name, this function takes a pclabel and returns the
   // corresponding machine code offset.
-  return dasm_getpclabel(jc, pclabel);
+  return dasm_getpclabel(Dst, pclabel);
 }
 
 // Returns a machine code offset corresponding to the given method-relative
@@ -369,7 +380,7 @@ static void load_so(jitcompiler *jc) {
   upb_inttable_begin(&i, &jc->asmlabels);
   for (; !upb_inttable_done(&i); upb_inttable_next(&i)) {
     upb_inttable_insert(&mclabels,
-                        dasm_getpclabel(jc, upb_inttable_iter_key(&i)),
+                        dasm_getpclabel(Dst, upb_inttable_iter_key(&i)),
                         upb_inttable_iter_value(&i));
   }
 
@@ -449,24 +460,401 @@ static void load_so(jitcompiler *jc) {
 
 #endif
 
-void upb_pbdecoder_jit(mgroup *group) {
+#ifdef __linux__
+
+/* Profiler and debugger support **********************************************/
+
+// These make JIT-compiled code visible to tools that would otherwise only see
+// an anonymous executable mapping.  See upb_jitdebug in decoder.h.
+
+typedef struct {
+  size_t ofs;
+  size_t size;
+  const char *name;
+} jitsym;
+
+static int cmpsym(const void *a, const void *b) {
+  size_t ofs_a = ((const jitsym*)a)->ofs;
+  size_t ofs_b = ((const jitsym*)b)->ofs;
+  return ofs_a < ofs_b ? -1 : (ofs_a > ofs_b);
+}
+
+// Returns the asmlabels as a sorted array of symbols that together cover all
+// of the generated code; the caller owns the array, but the names are owned
+// by jc.  Code with no label in front of it (all of it, if the codegen was
+// built without labels) is attributed to a symbol named "code".
+static jitsym *getsyms(jitcompiler *jc, size_t *n) {
+  size_t max = upb_inttable_count(&jc->asmlabels) + 1;
+  jitsym *syms = malloc(max * sizeof(*syms));
+  if (!syms) return NULL;
+
+  upb_inttable_iter i;
+  size_t count = 1;
+  syms[0].ofs = 0;
+  syms[0].name = "code";
+  upb_inttable_begin(&i, &jc->asmlabels);
+  for (; !upb_inttable_done(&i); upb_inttable_next(&i)) {
+    syms[count].ofs = dasm_getpclabel(Dst, upb_inttable_iter_key(&i));
+    syms[count].name = upb_value_getptr(upb_inttable_iter_value(&i));
+    count++;
+  }
+  qsort(syms + 1, count - 1, sizeof(*syms), cmpsym);
+
+  // Drop the placeholder if a label starts at offset 0.
+  if (count > 1 && syms[1].ofs == 0) {
+    memmove(syms, syms + 1, (count - 1) * sizeof(*syms));
+    count--;
+  }
+
+  size_t j;
+  for (j = 0; j < count; j++) {
+    size_t end = (j + 1 < count) ? syms[j + 1].ofs : jc->group->jit_size;
+    syms[j].size = end - syms[j].ofs;
+  }
+
+  *n = count;
+  return syms;
+}
+
+// Protects the process-wide state below: the jitdump file and GDB's list of
+// registered code.  Contention is limited to code generation and teardown.
+#ifdef UPB_THREAD_UNSAFE
+
+static void lock(void) {}
+static void unlock(void) {}
+
+#else
+
+static pthread_mutex_t debuglock = PTHREAD_MUTEX_INITIALIZER;
+static void lock(void) { pthread_mutex_lock(&debuglock); }
+static void unlock(void) { pthread_mutex_unlock(&debuglock); }
+
+#endif
+
+// perf map: a text file of "START SIZE NAME" lines that "perf report" reads
+// at analysis time.  It has to outlive the process, so we never remove it.
+static void writeperfmap(const char *code, const jitsym *syms, size_t n) {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+  FILE *f = fopen(path, "a");
+  if (!f) return;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    fprintf(f, "%lx %lx upb:%s\n", (unsigned long)(code + syms[i].ofs),
+            (unsigned long)syms[i].size, syms[i].name);
+  }
+  fclose(f);
+}
+
+// jitdump: a binary log of code loads, which "perf inject --jit" merges into
+// a perf.data file.  The format is described in perf's
+// Documentation/jitdump-specification.txt.
+#define JITDUMP_MAGIC 0x4A695444
+#define JITDUMP_VERSION 1
+#define JIT_CODE_LOAD 0
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t total_size;
+  uint32_t elf_mach;
+  uint32_t pad1;
+  uint32_t pid;
+  uint64_t timestamp;
+  uint64_t flags;
+} jitdump_header;
+
+typedef struct {
+  uint32_t id;
+  uint32_t total_size;
+  uint64_t timestamp;
+  uint32_t pid;
+  uint32_t tid;
+  uint64_t vma;
+  uint64_t code_addr;
+  uint64_t code_size;
+  uint64_t code_index;
+  // Followed by the NULL-terminated name and the code itself.
+} jitdump_codeload;
+
+static FILE *jitdump;
+static uint64_t jitdump_index;
+
+// Must match the clock perf uses; run "perf record -k mono".
+static uint64_t jitdump_timestamp(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Opens the jitdump file if it isn't already.  perf only notices the file if
+// the process maps it executable, so we do that and leave it mapped.
+static bool openjitdump(void) {
+  if (jitdump) return true;
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/jit-%d.dump", (int)getpid());
+  int fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0666);
+  if (fd < 0) return false;
+  void *marker = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC,
+                      MAP_PRIVATE, fd, 0);
+  if (marker == MAP_FAILED || (jitdump = fdopen(fd, "wb")) == NULL) {
+    if (marker != MAP_FAILED) munmap(marker, sysconf(_SC_PAGESIZE));
+    close(fd);
+    return false;
+  }
+
+  jitdump_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = JITDUMP_MAGIC;
+  hdr.version = JITDUMP_VERSION;
+  hdr.total_size = sizeof(hdr);
+  hdr.elf_mach = EM_X86_64;
+  hdr.pid = getpid();
+  hdr.timestamp = jitdump_timestamp();
+  fwrite(&hdr, sizeof(hdr), 1, jitdump);
+  return true;
+}
+
+static void writejitdump(const char *code, const jitsym *syms, size_t n) {
+  if (!openjitdump()) return;
+
+  size_t i;
+  for (i = 0; i < n; i++) {
+    char *name = upb_asprintf("upb:%s", syms[i].name);
+    size_t namelen = strlen(name) + 1;
+    jitdump_codeload rec;
+    rec.id = JIT_CODE_LOAD;
+    rec.total_size = sizeof(rec) + namelen + syms[i].size;
+    rec.timestamp = jitdump_timestamp();
+    rec.pid = getpid();
+    rec.tid = syscall(SYS_gettid);
+    rec.vma = (uintptr_t)(code + syms[i].ofs);
+    rec.code_addr = rec.vma;
+    rec.code_size = syms[i].size;
+    rec.code_index = jitdump_index++;
+    fwrite(&rec, sizeof(rec), 1, jitdump);
+    fwrite(name, namelen, 1, jitdump);
+    fwrite(code + syms[i].ofs, syms[i].size, 1, jitdump);
+    free(name);
+  }
+  fflush(jitdump);
+}
+
+// GDB's JIT interface: GDB sets a breakpoint in __jit_debug_register_code()
+// and, when it's hit, reads an in-memory object file describing the new code
+// from __jit_debug_descriptor.  Both are weak so that we share them with any
+// other JIT in the process.  See "JIT Compilation Interface" in the GDB
+// manual.
+typedef enum {
+  JIT_NOACTION = 0,
+  JIT_REGISTER_FN,
+  JIT_UNREGISTER_FN
+} jit_actions_t;
+
+struct jit_code_entry {
+  struct jit_code_entry *next_entry;
+  struct jit_code_entry *prev_entry;
+  const char *symfile_addr;
+  uint64_t symfile_size;
+};
+
+struct jit_descriptor {
+  uint32_t version;
+  uint32_t action_flag;
+  struct jit_code_entry *relevant_entry;
+  struct jit_code_entry *first_entry;
+};
+
+void __attribute__((weak, noinline)) __jit_debug_register_code() {
+  __asm__ __volatile__("" ::: "memory");
+}
+
+struct jit_descriptor __attribute__((weak)) __jit_debug_descriptor = {
+  1, JIT_NOACTION, NULL, NULL
+};
+
+// The object file we give GDB is a minimal relocatable ELF file in the style
+// of LuaJIT's lj_gdbjit.c: a .text section that occupies no space in the file
+// but is "loaded" at the address of our code, and a symbol table for it.
+enum {
+  SECT_NULL,
+  SECT_TEXT,
+  SECT_SHSTRTAB,
+  SECT_STRTAB,
+  SECT_SYMTAB,
+  SECT__MAX
+};
+
+static const char shstrtab[] = "\0.text\0.shstrtab\0.strtab\0.symtab";
+
+// Returns a jit_code_entry followed by the ELF image it points to, in a single
+// allocation.
+static struct jit_code_entry *newgdbentry(const char *code, size_t size,
+                                          const jitsym *syms, size_t n) {
+  size_t strtab_size = 1;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    strtab_size += strlen("X.") + strlen(syms[i].name) + 1;
+  }
+
+  // Layout: ELF header, section headers, .shstrtab, .strtab, .symtab.
+  size_t shdr_ofs = sizeof(Elf64_Ehdr);
+  size_t shstrtab_ofs = shdr_ofs + SECT__MAX * sizeof(Elf64_Shdr);
+  size_t strtab_ofs = shstrtab_ofs + sizeof(shstrtab);
+  size_t symtab_ofs = (strtab_ofs + strtab_size + 7) & ~(size_t)7;
+  size_t elf_size = symtab_ofs + (n + 1) * sizeof(Elf64_Sym);
+
+  struct jit_code_entry *entry = calloc(1, sizeof(*entry) + elf_size);
+  if (!entry) return NULL;
+  char *elf = (char*)(entry + 1);
+  entry->symfile_addr = elf;
+  entry->symfile_size = elf_size;
+
+  Elf64_Ehdr *ehdr = (Elf64_Ehdr*)elf;
+  memcpy(ehdr->e_ident, ELFMAG, SELFMAG);
+  ehdr->e_ident[EI_CLASS] = ELFCLASS64;
+  ehdr->e_ident[EI_DATA] = ELFDATA2LSB;
+  ehdr->e_ident[EI_VERSION] = EV_CURRENT;
+  ehdr->e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  ehdr->e_type = ET_REL;
+  ehdr->e_machine = EM_X86_64;
+  ehdr->e_version = EV_CURRENT;
+  ehdr->e_shoff = shdr_ofs;
+  ehdr->e_ehsize = sizeof(Elf64_Ehdr);
+  ehdr->e_shentsize = sizeof(Elf64_Shdr);
+  ehdr->e_shnum = SECT__MAX;
+  ehdr->e_shstrndx = SECT_SHSTRTAB;
+
+  Elf64_Shdr *shdr = (Elf64_Shdr*)(elf + shdr_ofs);
+  shdr[SECT_TEXT].sh_name = 1;
+  shdr[SECT_TEXT].sh_type = SHT_NOBITS;
+  shdr[SECT_TEXT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+  shdr[SECT_TEXT].sh_addr = (uintptr_t)code;
+  shdr[SECT_TEXT].sh_size = size;
+  shdr[SECT_TEXT].sh_addralign = 16;
+
+  shdr[SECT_SHSTRTAB].sh_name = 7;
+  shdr[SECT_SHSTRTAB].sh_type = SHT_STRTAB;
+  shdr[SECT_SHSTRTAB].sh_offset = shstrtab_ofs;
+  shdr[SECT_SHSTRTAB].sh_size = sizeof(shstrtab);
+  shdr[SECT_SHSTRTAB].sh_addralign = 1;
+  memcpy(elf + shstrtab_ofs, shstrtab, sizeof(shstrtab));
+
+  shdr[SECT_STRTAB].sh_name = 17;
+  shdr[SECT_STRTAB].sh_type = SHT_STRTAB;
+  shdr[SECT_STRTAB].sh_offset = strtab_ofs;
+  shdr[SECT_STRTAB].sh_size = strtab_size;
+  shdr[SECT_STRTAB].sh_addralign = 1;
+
+  shdr[SECT_SYMTAB].sh_name = 25;
+  shdr[SECT_SYMTAB].sh_type = SHT_SYMTAB;
+  shdr[SECT_SYMTAB].sh_offset = symtab_ofs;
+  shdr[SECT_SYMTAB].sh_size = (n + 1) * sizeof(Elf64_Sym);
+  shdr[SECT_SYMTAB].sh_link = SECT_STRTAB;
+  shdr[SECT_SYMTAB].sh_info = 1;  // Index of the first non-local symbol.
+  shdr[SECT_SYMTAB].sh_addralign = 8;
+  shdr[SECT_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+
+  // Symbol 0 and string 0 are reserved (and left zeroed).  Names get the same
+  // "X." prefix as with UPB_JIT_LOAD_SO, so the same GDB scripts work.
+  char *str = elf + strtab_ofs + 1;
+  Elf64_Sym *sym = (Elf64_Sym*)(elf + symtab_ofs) + 1;
+  for (i = 0; i < n; i++, sym++) {
+    sym->st_name = str - (elf + strtab_ofs);
+    sym->st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+    sym->st_shndx = SECT_TEXT;
+    sym->st_value = syms[i].ofs;
+    sym->st_size = syms[i].size;
+    str += sprintf(str, "X.%s", syms[i].name) + 1;
+  }
+
+  return entry;
+}
+
+static void registergdb(mgroup *group, const jitsym *syms, size_t n) {
+  struct jit_code_entry *entry = newgdbentry(
+      (const char*)group->jit_code, group->jit_size, syms, n);
+  if (!entry) return;
+  group->debug_info = (char*)entry;
+
+  lock();
+  entry->next_entry = __jit_debug_descriptor.first_entry;
+  if (entry->next_entry) entry->next_entry->prev_entry = entry;
+  __jit_debug_descriptor.first_entry = entry;
+  __jit_debug_descriptor.relevant_entry = entry;
+  __jit_debug_descriptor.action_flag = JIT_REGISTER_FN;
+  __jit_debug_register_code();
+  unlock();
+}
+
+static void unregistergdb(mgroup *group) {
+  struct jit_code_entry *entry = (struct jit_code_entry*)group->debug_info;
+  if (!entry) return;
+
+  lock();
+  if (entry->prev_entry) {
+    entry->prev_entry->next_entry = entry->next_entry;
+  } else {
+    __jit_debug_descriptor.first_entry = entry->next_entry;
+  }
+  if (entry->next_entry) entry->next_entry->prev_entry = entry->prev_entry;
+  __jit_debug_descriptor.relevant_entry = entry;
+  __jit_debug_descriptor.action_flag = JIT_UNREGISTER_FN;
+  __jit_debug_register_code();
+  unlock();
+}
+
+// Describes the freshly generated code to whichever tools were requested.
+static void emitdebuginfo(jitcompiler *jc) {
+  // Code loaded from a .so is already visible to everything.
+  if (!jc->debugflags || jc->group->dl) return;
+
+  size_t n;
+  jitsym *syms = getsyms(jc, &n);
+  if (!syms) return;
+  const char *code = (const char*)jc->group->jit_code;
+
+  lock();
+  if (jc->debugflags & UPB_JITDEBUG_PERFMAP) writeperfmap(code, syms, n);
+  if (jc->debugflags & UPB_JITDEBUG_JITDUMP) writejitdump(code, syms, n);
+  unlock();
+
+  // Takes the lock itself, since it has to call into GDB while holding it.
+  if (jc->debugflags & UPB_JITDEBUG_GDB) registergdb(jc->group, syms, n);
+
+  free(syms);
+}
+
+#else  // __linux__
+
+static void emitdebuginfo(jitcompiler *jc) { UPB_UNUSED(jc); }
+static void unregistergdb(mgroup *group) { UPB_UNUSED(group); }
+
+#endif  // __linux__
+
+void upb_pbdecoder_jit(mgroup *group, uint32_t debugflags) {
   group->debug_info = NULL;
   group->dl = NULL;
 
   assert(group->bytecode);
-  jitcompiler *jc = newjitcompiler(group);
+  jitcompiler *jc = newjitcompiler(group, debugflags);
   emit_static_asm(jc);
   jitbytecode(jc);
 
-  int dasm_status = dasm_link(jc, &jc->group->jit_size);
+  int dasm_status = dasm_link(Dst, &jc->group->jit_size);
   if (dasm_status != DASM_S_OK) {
     fprintf(stderr, "DynASM error; returned status: 0x%08x\n", dasm_status);
     abort();
   }
 
   char *jit_code = mmap(NULL, jc->group->jit_size, PROT_READ | PROT_WRITE,
-                        MAP_ANONYMOUS | MAP_PRIVATE, 0, 0);
-  dasm_encode(jc, jit_code);
+                        MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  if (jit_code == MAP_FAILED) {
+    fprintf(stderr, "upb: couldn't map memory for JIT code\n");
+    abort();
+  }
+  dasm_encode(Dst, jit_code);
   mprotect(jit_code, jc->group->jit_size, PROT_EXEC | PROT_READ);
   jc->group->jit_code = (upb_string_handlerfunc *)jit_code;
 
@@ -474,6 +862,7 @@ void upb_pbdecoder_jit(mgroup *group) {
   load_so(jc);
 #endif
 
+  emitdebuginfo(jc);
   patchdispatch(jc);
 
   freejitcompiler(jc);
@@ -485,6 +874,7 @@ void upb_pbdecoder_jit(mgroup *group) {
 
 void upb_pbdecoder_freejit(mgroup *group) {
   if (!group->jit_code) return;
+  unregistergdb(group);
   if (group->dl) {
 #ifdef UPB_JIT_LOAD_SO
     dlclose(group->dl);
@@ -21,112 +21,117 @@
 //|
 //|.arch x64
 //|.actionlist upb_jit_actionlist
-static const unsigned char upb_jit_actionlist[2162] = {
-  249,255,248,10,248,1,85,65,87,65,86,65,85,65,84,83,72,137,252,243,73,137,
-  252,255,72,184,237,237,65,84,73,137,228,72,129,228,239,252,255,208,76,137,
-  228,65,92,133,192,15,137,244,247,73,137,167,233,72,137,216,77,139,183,233,
-  73,139,159,233,77,139,167,233,77,139,174,233,73,139,174,233,73,43,175,233,
-  73,3,175,233,73,139,151,233,72,133,210,15,133,244,248,252,255,208,73,139,
-  135,233,73,199,135,233,0,0,0,0,248,1,255,91,65,92,65,93,65,94,65,95,93,195,
-  248,2,73,141,183,233,72,41,212,72,137,231,72,184,237,237,65,84,73,137,228,
-  72,129,228,239,252,255,208,76,137,228,65,92,195,255,248,11,73,141,191,233,
-  72,137,230,73,139,151,233,72,41,226,73,137,151,233,137,195,72,184,237,237,
-  65,84,73,137,228,72,129,228,239,252,255,208,76,137,228,65,92,137,216,73,139,
-  167,233,91,65,92,65,93,65,94,65,95,93,195,255,248,12,73,57,159,233,15,132,
-  244,247,73,137,159,233,248,1,77,137,183,233,73,137,159,233,77,137,167,233,
-  73,137,175,233,73,43,175,233,73,3,175,233,73,137,174,233,77,137,174,233,76,
-  137,252,255,72,184,237,237,65,84,73,137,228,72,129,228,239,252,255,208,76,
-  137,228,65,92,252,233,244,11,255,248,13,248,1,77,137,174,233,73,137,159,233,
-  255,76,57,227,15,132,244,253,255,76,137,225,72,41,217,72,131,252,249,1,15,
-  130,244,253,255,15,182,19,132,210,15,137,244,254,248,7,232,244,14,248,8,72,
-  131,195,1,72,137,252,233,72,41,217,72,41,209,15,130,244,15,73,137,142,233,
-  73,129,198,239,72,137,221,72,1,213,77,59,183,233,15,132,244,249,65,199,134,
-  233,0,0,0,0,72,133,201,15,132,244,248,77,139,167,233,72,57,252,235,15,135,
-  244,248,76,57,229,15,135,244,248,255,73,137,252,236,248,2,195,248,3,73,139,
-  159,233,76,137,252,255,255,72,190,237,237,255,190,237,255,49,252,246,255,
-  72,184,237,237,65,84,73,137,228,72,129,228,239,252,255,208,76,137,228,65,
-  92,232,244,12,252,233,244,1,255,248,16,72,131,252,236,16,72,137,188,253,36,
-  233,248,1,72,199,4,36,0,0,0,0,76,137,252,255,72,137,230,73,137,159,233,77,
+static const unsigned char upb_jit_actionlist[2272] = {
+  249,255,248,10,248,1,85,65,87,65,86,65,85,65,84,83,72,131,252,236,8,72,137,
+  252,243,73,137,252,255,72,184,237,237,252,255,208,133,192,15,137,244,247,
+  73,137,167,233,72,137,216,77,139,183,233,73,139,159,233,77,139,167,233,77,
+  139,174,233,73,139,174,233,73,43,175,233,73,3,175,233,73,139,151,233,72,133,
+  210,15,133,244,248,252,255,208,73,139,135,233,73,199,135,233,0,0,0,0,248,
+  1,255,72,131,196,8,91,65,92,65,93,65,94,65,95,93,195,248,2,73,141,183,233,
+  72,41,212,72,137,231,72,131,252,236,8,72,184,237,237,252,255,208,72,131,196,
+  8,195,255,248,11,73,141,191,233,72,137,230,73,139,151,233,72,41,226,73,137,
+  151,233,137,195,72,131,252,236,8,72,184,237,237,252,255,208,137,216,73,139,
+  167,233,72,131,196,8,91,65,92,65,93,65,94,65,95,93,195,255,248,12,73,57,159,
+  233,15,132,244,247,73,137,159,233,248,1,77,137,183,233,73,137,159,233,77,
+  137,167,233,73,137,175,233,73,43,175,233,73,3,175,233,73,137,174,233,77,137,
+  174,233,76,137,252,255,72,131,252,236,8,72,184,237,237,252,255,208,72,131,
+  196,8,252,233,244,11,255,248,13,72,131,252,236,8,248,1,77,137,174,233,73,
+  137,159,233,255,76,57,227,15,132,244,253,255,76,137,225,72,41,217,72,131,
+  252,249,1,15,130,244,253,255,15,182,19,132,210,15,137,244,254,248,7,232,244,
+  14,248,8,72,131,195,1,72,137,252,233,72,41,217,72,41,209,15,130,244,15,73,
+  137,142,233,73,129,198,239,72,137,221,72,1,213,77,59,183,233,15,132,244,249,
+  65,199,134,233,0,0,0,0,72,133,201,15,132,244,248,77,139,167,233,72,57,252,
+  235,15,135,244,248,76,57,229,15,135,244,248,255,73,137,252,236,248,2,72,131,
+  196,8,195,248,3,73,139,159,233,76,137,252,255,255,72,190,237,237,255,190,
+  237,255,49,252,246,255,72,184,237,237,252,255,208,232,244,12,252,233,244,
+  1,255,248,16,72,131,252,236,16,72,137,188,253,36,233,248,1,72,199,4,36,0,
+  0,0,0,76,137,252,255,72,137,230,73,137,159,233,77,137,183,233,73,137,159,
+  233,77,137,167,233,73,137,175,233,73,43,175,233,73,3,175,233,73,137,174,233,
+  77,137,174,233,252,255,148,253,36,233,77,139,183,233,73,139,159,233,77,139,
+  167,233,77,139,174,233,73,139,174,233,73,43,175,233,73,3,175,233,255,133,
+  192,15,137,244,248,72,139,20,36,252,242,15,16,4,36,72,131,196,16,195,248,
+  2,232,244,11,252,233,244,1,255,248,17,76,137,252,255,137,214,15,182,209,77,
   137,183,233,73,137,159,233,77,137,167,233,73,137,175,233,73,43,175,233,73,
-  3,175,233,73,137,174,233,77,137,174,233,252,255,148,253,36,233,77,139,183,
-  233,73,139,159,233,77,139,167,233,77,139,174,233,73,139,174,233,73,43,175,
-  233,73,3,175,233,255,133,192,15,137,244,248,72,139,20,36,252,242,15,16,4,
-  36,72,131,196,16,195,248,2,232,244,11,252,233,244,1,255,248,17,76,137,252,
-  255,137,214,15,182,209,77,137,183,233,73,137,159,233,77,137,167,233,73,137,
-  175,233,73,43,175,233,73,3,175,233,73,137,174,233,77,137,174,233,72,184,237,
-  237,65,84,73,137,228,72,129,228,239,252,255,208,76,137,228,65,92,77,139,183,
-  233,73,139,159,233,77,139,167,233,77,139,174,233,73,139,174,233,73,43,175,
-  233,73,3,175,233,129,252,248,239,255,15,133,244,247,195,248,1,129,252,248,
-  239,15,132,244,247,232,244,11,248,1,49,192,195,255,248,18,248,19,72,191,237,
-  237,232,244,16,72,131,252,235,4,73,137,159,233,195,255,248,20,248,21,72,191,
-  237,237,232,244,16,72,131,252,235,8,73,137,159,233,195,255,248,22,248,23,
-  255,76,57,227,15,132,244,247,255,76,137,225,72,41,217,72,131,252,249,16,15,
-  130,244,247,255,252,243,15,111,3,102,15,215,192,252,247,208,15,188,192,60,
-  10,15,131,244,24,72,1,195,195,248,1,72,141,139,233,72,137,216,76,57,225,73,
-  15,71,204,248,2,72,57,200,15,132,244,24,252,246,0,128,15,132,244,249,72,131,
-  192,1,252,233,244,2,248,3,72,137,195,195,255,248,25,72,131,252,236,16,248,
-  1,72,57,252,235,15,133,244,248,72,131,196,16,49,192,195,248,2,76,137,252,
-  255,72,137,230,77,137,183,233,73,137,159,233,77,137,167,233,73,137,175,233,
-  73,43,175,233,73,3,175,233,73,137,174,233,77,137,174,233,72,184,237,237,65,
-  84,73,137,228,72,129,228,239,252,255,208,76,137,228,65,92,77,139,183,233,
-  73,139,159,233,77,139,167,233,77,139,174,233,255,73,139,174,233,73,43,175,
-  233,73,3,175,233,131,252,248,0,15,141,244,249,139,20,36,72,131,196,16,195,
-  248,3,232,244,11,252,233,244,1,255,248,14,248,26,255,76,57,227,15,132,244,
-  24,255,76,137,225,72,41,217,72,131,252,249,10,15,130,244,24,255,72,137,223,
-  72,184,237,237,65,84,73,137,228,72,129,228,239,252,255,208,76,137,228,65,
-  92,72,133,192,15,132,244,24,72,137,195,72,131,252,235,1,73,137,159,233,195,
-  255,248,24,72,191,237,237,232,244,16,72,131,252,235,1,73,137,159,233,195,
-  255,248,27,72,131,252,236,8,72,137,52,36,248,1,76,137,252,255,77,137,183,
-  233,73,137,159,233,77,137,167,233,73,137,175,233,73,43,175,233,73,3,175,233,
-  73,137,174,233,77,137,174,233,73,137,159,233,72,184,237,237,65,84,73,137,
-  228,72,129,228,239,252,255,208,76,137,228,65,92,77,139,183,233,73,139,159,
-  233,77,139,167,233,77,139,174,233,73,139,174,233,73,43,175,233,255,73,3,175,
-  233,131,252,248,0,15,141,244,248,72,131,196,8,195,248,2,232,244,11,72,139,
-  52,36,72,57,252,235,15,133,244,1,184,237,72,131,196,8,195,255,248,28,81,82,
-  72,131,252,236,16,72,137,252,247,72,137,214,72,137,226,72,184,237,237,65,
-  84,73,137,228,72,129,228,239,252,255,208,76,137,228,65,92,72,131,196,16,90,
-  89,132,192,15,132,244,248,72,139,68,36,224,195,248,2,72,49,192,72,252,247,
-  208,195,255,76,57,227,15,133,244,249,255,76,137,225,72,41,217,72,129,252,
-  249,239,15,131,244,249,255,248,2,255,232,244,14,255,232,244,26,255,232,244,
-  19,255,232,244,21,255,252,233,244,250,255,248,3,255,139,19,255,72,139,19,
-  255,252,243,15,16,3,255,252,242,15,16,3,255,15,182,19,132,210,15,136,244,
-  2,255,248,4,255,137,208,209,252,234,131,224,1,252,247,216,49,194,255,72,137,
-  208,72,209,252,234,72,131,224,1,72,252,247,216,72,49,194,255,72,133,210,15,
-  149,210,255,73,137,149,233,255,65,137,149,233,255,252,242,65,15,17,133,233,
-  255,252,243,65,15,17,133,233,255,65,136,149,233,255,65,128,141,233,235,255,
-  76,137,252,239,255,72,184,237,237,65,84,73,137,228,72,129,228,239,252,255,
-  208,76,137,228,65,92,255,132,192,15,133,244,251,232,244,12,252,233,244,1,
-  248,5,255,72,129,195,239,255,232,244,22,255,232,244,23,255,232,244,18,255,
-  232,244,20,255,252,246,3,128,15,133,244,2,255,249,248,1,255,76,57,227,15,
-  132,244,252,255,76,137,225,72,41,217,72,131,252,249,2,15,130,244,252,255,
-  15,182,19,132,210,15,137,244,253,15,182,139,233,132,201,15,136,244,252,193,
-  225,7,131,226,127,9,202,72,131,195,2,252,233,244,254,248,6,232,244,25,133,
-  192,15,133,244,254,195,248,7,72,131,195,1,248,8,137,209,193,252,234,3,128,
-  225,7,255,248,2,129,252,250,239,255,15,131,244,253,255,15,131,244,251,255,
-  72,184,237,237,72,139,4,208,255,72,139,4,213,237,255,248,3,56,200,255,15,
-  133,244,252,255,15,133,244,251,255,72,193,232,16,72,141,21,244,250,249,248,
-  4,72,1,208,195,248,5,232,244,17,133,192,15,132,244,1,72,141,5,244,255,195,
-  255,248,6,56,204,15,133,244,5,72,129,194,239,255,252,233,244,28,255,248,7,
-  255,232,244,28,252,233,244,3,255,76,57,227,15,133,244,247,255,76,137,225,
-  72,41,217,72,129,252,249,239,15,131,244,247,255,232,244,27,129,252,248,239,
-  15,132,244,249,129,252,248,239,15,132,245,252,233,244,251,255,128,59,235,
-  255,102,129,59,238,255,102,129,59,238,15,133,244,248,128,187,233,235,248,
-  2,255,129,59,239,255,129,59,239,15,133,244,249,128,187,233,235,255,15,132,
-  244,250,248,3,255,232,245,72,133,192,15,132,245,252,255,224,255,252,233,245,
-  255,248,4,72,129,195,239,248,5,255,248,1,76,137,252,239,255,132,192,15,133,
-  244,248,232,244,12,252,233,244,1,248,2,255,144,255,248,9,255,73,139,151,233,
-  72,184,237,237,65,84,73,137,228,72,129,228,239,252,255,208,76,137,228,65,
-  92,255,249,249,72,131,252,236,8,255,72,137,252,234,72,41,218,255,72,133,192,
-  15,133,244,248,232,244,12,252,233,244,1,248,2,255,73,137,197,255,72,57,252,
-  235,15,132,244,250,248,1,76,57,227,15,133,244,248,232,244,12,252,233,244,
-  1,248,2,255,72,137,218,76,137,225,72,41,217,77,139,135,233,72,184,237,237,
-  65,84,73,137,228,72,129,228,239,252,255,208,76,137,228,65,92,72,1,195,255,
-  76,57,227,15,132,244,249,232,244,29,248,3,255,76,137,227,255,72,57,252,235,
-  15,133,244,1,248,4,255,77,137,174,233,73,199,134,233,0,0,0,0,73,129,198,239,
-  77,59,183,233,15,132,244,15,65,199,134,233,237,255,232,244,13,255,73,129,
-  252,238,239,77,139,174,233,255,77,139,167,233,73,3,174,233,73,59,175,233,
-  15,130,244,247,76,57,229,15,135,244,247,73,137,252,236,248,1,255,72,57,221,
-  15,132,245,255,232,245,255,248,9,72,131,196,8,195,255
+  3,175,233,73,137,174,233,77,137,174,233,72,184,237,237,252,255,208,77,139,
+  183,233,73,139,159,233,77,139,167,233,77,139,174,233,73,139,174,233,73,43,
+  175,233,73,3,175,233,129,252,248,239,15,133,244,247,255,195,248,1,129,252,
+  248,239,15,132,244,247,232,244,11,248,1,49,192,195,255,248,18,248,19,72,191,
+  237,237,232,244,16,72,131,252,235,4,73,137,159,233,195,255,248,20,248,21,
+  72,191,237,237,232,244,16,72,131,252,235,8,73,137,159,233,195,255,248,22,
+  248,23,255,76,57,227,15,132,244,247,255,76,137,225,72,41,217,72,131,252,249,
+  16,15,130,244,247,255,252,243,15,111,3,102,15,215,192,252,247,208,15,188,
+  192,60,10,15,131,244,24,72,1,195,195,248,1,72,141,139,233,72,137,216,76,57,
+  225,73,15,71,204,248,2,72,57,200,15,132,244,24,252,246,0,128,15,132,244,249,
+  72,131,192,1,252,233,244,2,248,3,72,137,195,195,255,248,25,72,131,252,236,
+  16,248,1,72,57,252,235,15,133,244,248,72,131,196,16,49,192,195,248,2,76,137,
+  252,255,72,137,230,77,137,183,233,73,137,159,233,77,137,167,233,73,137,175,
+  233,73,43,175,233,73,3,175,233,73,137,174,233,77,137,174,233,72,184,237,237,
+  252,255,208,77,139,183,233,73,139,159,233,77,139,167,233,77,139,174,233,73,
+  139,174,233,255,73,43,175,233,73,3,175,233,131,252,248,0,15,141,244,249,139,
+  20,36,72,131,196,16,195,248,3,232,244,11,252,233,244,1,255,248,14,248,26,
+  255,76,57,227,15,132,244,24,255,76,137,225,72,41,217,72,131,252,249,10,15,
+  130,244,24,255,72,137,223,72,131,252,236,8,72,184,237,237,252,255,208,72,
+  131,196,8,72,133,192,15,132,244,24,72,137,195,72,131,252,235,1,73,137,159,
+  233,195,255,248,24,72,191,237,237,232,244,16,72,131,252,235,1,73,137,159,
+  233,195,255,248,27,72,131,252,236,8,72,137,52,36,248,1,76,137,252,255,77,
+  137,183,233,73,137,159,233,77,137,167,233,73,137,175,233,73,43,175,233,73,
+  3,175,233,73,137,174,233,77,137,174,233,73,137,159,233,72,184,237,237,252,
+  255,208,77,139,183,233,73,139,159,233,77,139,167,233,77,139,174,233,73,139,
+  174,233,73,43,175,233,73,3,175,233,255,131,252,248,0,15,141,244,248,72,131,
+  196,8,195,248,2,232,244,11,72,139,52,36,72,57,252,235,15,133,244,1,184,237,
+  72,131,196,8,195,255,248,28,81,82,72,131,252,236,16,72,137,252,247,72,137,
+  214,72,137,226,72,184,237,237,252,255,208,72,131,196,16,90,89,132,192,15,
+  132,244,248,72,139,68,36,224,195,248,2,72,49,192,72,252,247,208,195,255,76,
+  137,252,239,255,72,184,237,237,252,255,208,255,132,192,15,133,244,251,232,
+  244,12,252,233,244,1,248,5,255,248,1,73,139,133,233,72,133,192,15,133,244,
+  249,73,139,141,233,72,133,201,15,132,244,248,72,139,129,233,72,141,144,233,
+  72,59,145,233,15,135,244,248,72,137,145,233,72,129,129,233,239,73,137,133,
+  233,255,49,210,255,72,137,144,233,255,72,137,199,49,252,246,72,199,194,237,
+  72,184,237,237,252,255,208,255,73,139,141,233,72,137,136,233,255,252,233,
+  244,249,248,2,76,137,252,239,255,72,184,237,237,252,255,208,72,133,192,15,
+  133,244,249,232,244,12,252,233,244,1,248,3,255,65,128,141,233,235,255,76,
+  57,227,15,133,244,249,255,76,137,225,72,41,217,72,129,252,249,239,15,131,
+  244,249,255,248,2,255,232,244,14,255,232,244,26,255,232,244,19,255,232,244,
+  21,255,252,233,244,250,255,139,19,255,72,139,19,255,252,243,15,16,3,255,252,
+  242,15,16,3,255,15,182,19,132,210,15,136,244,2,255,248,4,255,137,208,209,
+  252,234,131,224,1,252,247,216,49,194,255,72,137,208,72,209,252,234,72,131,
+  224,1,72,252,247,216,72,49,194,255,72,133,210,15,149,210,255,73,139,133,233,
+  73,59,133,233,15,131,244,252,73,139,141,233,255,72,137,20,193,255,137,20,
+  129,255,252,242,15,17,4,193,255,252,243,15,17,4,129,255,136,20,1,255,73,131,
+  133,233,1,252,233,244,253,248,6,255,248,7,255,73,137,149,233,255,65,137,149,
+  233,255,252,242,65,15,17,133,233,255,252,243,65,15,17,133,233,255,65,136,
+  149,233,255,73,131,135,233,1,255,72,129,195,239,255,232,244,22,255,232,244,
+  23,255,232,244,18,255,232,244,20,255,252,246,3,128,15,133,244,2,255,249,248,
+  1,255,76,57,227,15,132,244,252,255,76,137,225,72,41,217,72,131,252,249,2,
+  15,130,244,252,255,15,182,19,132,210,15,137,244,253,15,182,139,233,132,201,
+  15,136,244,252,193,225,7,131,226,127,9,202,72,131,195,2,252,233,244,254,248,
+  6,232,244,25,133,192,15,133,244,254,195,248,7,72,131,195,1,248,8,255,137,
+  209,193,252,234,3,128,225,7,255,248,2,129,252,250,239,255,15,131,244,253,
+  255,15,131,244,251,255,72,184,237,237,72,139,4,208,255,72,139,4,213,237,255,
+  248,3,56,200,255,15,133,244,252,255,15,133,244,251,255,72,193,232,16,72,141,
+  21,244,250,249,248,4,72,1,208,195,248,5,232,244,17,133,192,15,132,244,1,72,
+  141,5,244,255,195,255,248,6,56,204,15,133,244,5,72,129,194,239,255,232,244,
+  28,195,255,232,244,28,252,233,244,3,255,76,57,227,15,133,244,247,255,76,137,
+  225,72,41,217,72,129,252,249,239,15,131,244,247,255,232,244,27,129,252,248,
+  239,15,132,244,249,129,252,248,239,15,132,245,252,233,244,251,255,128,59,
+  235,255,102,129,59,238,255,102,129,59,238,15,133,244,248,128,187,233,235,
+  248,2,255,129,59,239,255,129,59,239,15,133,244,249,128,187,233,235,255,15,
+  132,244,250,248,3,255,232,245,72,133,192,15,132,245,252,255,224,255,252,233,
+  245,255,248,4,72,129,195,239,248,5,255,248,1,76,137,252,239,255,132,192,15,
+  133,244,248,232,244,12,252,233,244,1,248,2,255,144,255,248,9,255,73,139,151,
+  233,72,184,237,237,252,255,208,255,249,249,72,131,252,236,8,255,73,199,133,
+  233,0,0,0,0,73,199,133,233,0,0,0,0,255,73,137,197,255,72,49,210,255,72,137,
+  252,234,72,41,218,255,72,133,192,15,133,244,248,232,244,12,252,233,244,1,
+  248,2,255,72,57,252,235,15,132,244,250,248,1,76,57,227,15,133,244,248,232,
+  244,12,252,233,244,1,248,2,255,73,131,189,233,0,15,133,244,251,73,137,157,
+  233,76,137,224,72,41,216,73,137,133,233,76,137,227,252,233,244,252,248,5,
+  255,72,137,218,76,137,225,72,41,217,77,139,135,233,72,184,237,237,252,255,
+  208,72,1,195,255,76,57,227,15,132,244,249,232,244,29,248,3,255,76,137,227,
+  255,72,57,252,235,15,133,244,1,248,4,255,77,137,174,233,73,199,134,233,0,
+  0,0,0,73,129,198,239,77,59,183,233,15,132,244,15,65,199,134,233,237,255,232,
+  244,13,255,73,129,252,238,239,77,139,174,233,255,77,139,167,233,73,3,174,
+  233,73,59,175,233,15,130,244,247,76,57,229,15,135,244,247,73,137,252,236,
+  248,1,255,72,57,221,15,132,245,255,232,245,255,248,9,72,131,196,8,195,255
 };
 
 # 12 "upb/pb/compile_decoder_x64.dasc"
@@ -234,21 +239,19 @@ static const char *const upb_jit_globalnames[] = {
 //|  add  DELIMEND, DECODER->buf
 //|.endmacro
 //|
-//| // Calls an external C function at address "addr".
-//|.macro callp, addr
-//|    mov64  rax, (uintptr_t)addr
+//| // Stack alignment.  The x86-64 ABI requires rsp to be 16-byte aligned at
+//| // every call to C.  Rather than realigning around each call, we keep the
+//| // alignment of the JIT's own frames static: ->enterjit pads its frame so
+//| // that method bodies (after their "sub rsp, 8" prologue) always run with an
+//| // aligned stack.  So any routine that is called from a method body is
+//| // entered with rsp == 8 (mod 16), just like a C function.  Each of the
+//| // static routines below notes how it is entered and pads its own frame as
+//| // needed before calling out.
 //|
-//|    // Stack must be 16-byte aligned (x86-64 ABI requires this).
-//|    //
-//|    // OPT: possibly remove this by statically ensuring correct alignment.
-//|    //
-//|    // OPT: use "call rel32" where possible.
-//|    push   r12
-//|    mov    r12, rsp
-//|    and    rsp, 0xfffffffffffffff0UL   // Align stack.
-//|    call   rax
-//|    mov    rsp, r12
-//|    pop    r12
+//| // Calls an external C function at address "addr"; rsp must be aligned.
+//|.macro callp, addr
+//|  mov64  rax, (uintptr_t)addr
+//|  call   rax
 //|.endmacro
 //|
 //|.macro ld64, val
@@ -309,6 +312,13 @@ static const char *const upb_jit_globalnames[] = {
 //|8:
 //|  add     PTR, 1
 //|.endmacro
+//|
+//| // Bumps one of the upb_pbdecoder_stats counters, like UPB_DECODER_STAT().
+//|.macro stat, name
+//||#ifdef UPB_DECODER_STATS
+//|  add     qword DECODER->stats_.name, 1
+//||#endif
+//|.endmacro
 
 #define DECODE_EOF -3
 
@@ -318,8 +328,8 @@ static upb_func *gethandler(const upb_handlers *h, upb_selector_t sel) {
 
 // Defines an "assembly label" for the current code generation offset.
 // This label exists *purely* for debugging purposes: it is emitted into
-// the .so, and printed as part of JIT debugging output when UPB_JIT_LOAD_SO is
-// defined.
+// the .so when UPB_JIT_LOAD_SO is defined, and into the symbols we give to
+// profilers and debuggers when the CodeCache has jit_debug() flags set.
 //
 // We would define this in the .c file except that it conditionally defines a
 // pclabel.
@@ -331,9 +341,9 @@ static void asmlabel(jitcompiler *jc, const char *fmt, ...) {
 #endif
 
 #ifndef UPB_JIT_LOAD_SO
-  UPB_UNUSED(jc);
-  UPB_UNUSED(fmt);
-#else
+  if (!jc->debugflags) return;
+#endif
+
   va_list args;
   va_start(args, fmt);
   char *str = upb_vasprintf(fmt, args);
@@ -343,13 +353,12 @@ static void asmlabel(jitcompiler *jc, const char *fmt, ...) {
   // Normally we would prefer to allocate this inline with the codegen,
   // ie.
   //   |=>asmlabel(...)
-  // But since we do this conditionally, only when UPB_JIT_LOAD_SO is defined,
-  // we do it here instead.
+  // But since we do this conditionally, only when debugging, we do it here
+  // instead.
   //|=>pclabel:
   dasm_put(Dst, 0, pclabel);
-# 176 "upb/pb/compile_decoder_x64.dasc"
+# 181 "upb/pb/compile_decoder_x64.dasc"
   upb_inttable_insert(&jc->asmlabels, pclabel, upb_value_ptr(str));
-#endif
 }
 
 // Should only be called when the associated handler is known to exist.
@@ -386,6 +395,7 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  push  r13
   //|  push  r12
   //|  push  rbx
+  //|  sub   rsp, 8  // Align stack for method bodies (see above).
   //|
   //|  mov   rbx, ARG2_64  // Preserve JIT method.
   //|
@@ -407,9 +417,10 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  mov   rax, DECODER->size_param
   //|  mov   qword DECODER->call_len, 0
   //|1:
+  //|  add   rsp, 8
+  dasm_put(Dst, 2, (unsigned int)((uintptr_t)upb_pbdecoder_resume), (unsigned int)(((uintptr_t)upb_pbdecoder_resume)>>32), Dt2(->saved_rsp), Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure), Dt1(->end_ofs), Dt2(->bufstart_ofs), Dt2(->buf), Dt2(->call_len), Dt2(->size_param), Dt2(->call_len));
+# 241 "upb/pb/compile_decoder_x64.dasc"
   //|  pop   rbx
-  dasm_put(Dst, 2, (unsigned int)((uintptr_t)upb_pbdecoder_resume), (unsigned int)(((uintptr_t)upb_pbdecoder_resume)>>32), 0xfffffffffffffff0UL, Dt2(->saved_rsp), Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure), Dt1(->end_ofs), Dt2(->bufstart_ofs), Dt2(->buf), Dt2(->call_len), Dt2(->size_param), Dt2(->call_len));
-# 236 "upb/pb/compile_decoder_x64.dasc"
   //|  pop   r12
   //|  pop   r13
   //|  pop   r14
@@ -418,19 +429,23 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  ret
   //|
   //|2:
-  //|  // Resume decoder.
+  //|  // Resume decoder.  The saved stack was taken in ->exitjit, so rsp is
+  //|  // 8 (mod 16) once it is restored.
   //|  lea   ARG2_64, DECODER->callstack
   //|  sub   rsp, ARG3_64
   //|  mov   ARG1_64, rsp
+  //|  sub   rsp, 8
   //|  callp memcpy  // Restore stack.
+  //|  add   rsp, 8
   //|  ret  // Return to resumed function (not ->enterjit caller).
   //|
   //| // Other code can call this to suspend the JIT.
   //| // To the calling code, it will appear that the function returns when
   //| // the JIT resumes, and more buffer space will be available.
   //| // Args: eax=the value that decode() should return.
-  dasm_put(Dst, 115, Dt2(->callstack), (unsigned int)((uintptr_t)memcpy), (unsigned int)(((uintptr_t)memcpy)>>32), 0xfffffffffffffff0UL);
-# 255 "upb/pb/compile_decoder_x64.dasc"
+  //| // Always entered with rsp == 8 (mod 16).
+  dasm_put(Dst, 106, Dt2(->callstack), (unsigned int)((uintptr_t)memcpy), (unsigned int)(((uintptr_t)memcpy)>>32));
+# 265 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "exitjit");
   //|->exitjit:
   //|  // Save the stack into DECODER->callstack.
@@ -440,12 +455,14 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  sub   ARG3_64, rsp
   //|  mov   DECODER->call_len, ARG3_64  // Preserve len for next resume.
   //|  mov   ebx, eax  // Preserve return value across memcpy.
+  //|  sub   rsp, 8
   //|  callp memcpy    // Copy stack into decoder.
   //|  mov   eax, ebx  // This will be our return value.
   //|
   //|  // Must NOT do this before the memcpy(), otherwise memcpy() will
   //|  // clobber the stack we are trying to save!
   //|  mov   rsp, DECODER->saved_rsp
+  //|  add   rsp, 8
   //|  pop   rbx
   //|  pop   r12
   //|  pop   r13
@@ -457,8 +474,8 @@ static void emit_static_asm(jitcompiler *jc) {
   //| // Like suspend() in the C decoder, except that the function appears
   //| // (from the caller's perspective) not to return until the decoder is
   //| // resumed.
-  dasm_put(Dst, 161, Dt2(->callstack), Dt2(->saved_rsp), Dt2(->call_len), (unsigned int)((uintptr_t)memcpy), (unsigned int)(((uintptr_t)memcpy)>>32), 0xfffffffffffffff0UL, Dt2(->saved_rsp));
-# 281 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 151, Dt2(->callstack), Dt2(->saved_rsp), Dt2(->call_len), (unsigned int)((uintptr_t)memcpy), (unsigned int)(((uintptr_t)memcpy)>>32), Dt2(->saved_rsp));
+# 293 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "suspend");
   //|->suspend:
   //|  cmp   DECODER->ptr, PTR
@@ -467,24 +484,27 @@ static void emit_static_asm(jitcompiler *jc) {
   //|1:
   //|  commit_regs
   //|  mov   rdi, DECODER
+  //|  sub   rsp, 8
   //|  callp upb_pbdecoder_suspend
+  //|  add   rsp, 8
   //|  jmp   ->exitjit
   //|
-  dasm_put(Dst, 222, Dt2(->ptr), Dt2(->checkpoint), Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), (unsigned int)((uintptr_t)upb_pbdecoder_suspend), (unsigned int)(((uintptr_t)upb_pbdecoder_suspend)>>32), 0xfffffffffffffff0UL);
-# 292 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 207, Dt2(->ptr), Dt2(->checkpoint), Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), (unsigned int)((uintptr_t)upb_pbdecoder_suspend), (unsigned int)(((uintptr_t)upb_pbdecoder_suspend)>>32));
+# 306 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "pushlendelim");
   //|->pushlendelim:
+  //|  sub   rsp, 8  // So that ->decodev32_fallback is entered as usual.
   //|1:
   //|  mov   FRAME->sink.closure, CLOSURE
   //|  mov   DECODER->checkpoint, PTR
   //|  dv32
-  dasm_put(Dst, 300, Dt1(->sink.closure), Dt2(->checkpoint));
+  dasm_put(Dst, 280, Dt1(->sink.closure), Dt2(->checkpoint));
    if (1 == 1) {
-  dasm_put(Dst, 313);
+  dasm_put(Dst, 298);
    } else {
-  dasm_put(Dst, 321);
+  dasm_put(Dst, 306);
    }
-# 298 "upb/pb/compile_decoder_x64.dasc"
+# 313 "upb/pb/compile_decoder_x64.dasc"
   //|  mov   rcx, DELIMEND
   //|  sub   rcx, PTR
   //|  sub   rcx, rdx
@@ -504,9 +524,10 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  cmp   DELIMEND, DATAEND
   //|  ja    >2
   //|  mov   DATAEND, DELIMEND  // If DELIMEND >= PTR && DELIMEND < DATAEND
-  dasm_put(Dst, 337, Dt1(->end_ofs), sizeof(upb_pbdecoder_frame), Dt2(->limit), Dt1(->groupnum), Dt2(->end));
-# 317 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 322, Dt1(->end_ofs), sizeof(upb_pbdecoder_frame), Dt2(->limit), Dt1(->groupnum), Dt2(->end));
+# 332 "upb/pb/compile_decoder_x64.dasc"
   //|2:
+  //|  add   rsp, 8
   //|  ret
   //|3:
   //|  // Error -- call seterr.
@@ -514,26 +535,28 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  // Prepare seterr args.
   //|  mov   ARG1_64, DECODER
   //|  ld64  kPbDecoderStackOverflow
-  dasm_put(Dst, 428, Dt2(->checkpoint));
+  dasm_put(Dst, 413, Dt2(->checkpoint));
    {
    uintptr_t v = (uintptr_t)kPbDecoderStackOverflow;
    if (v > 0xffffffff) {
-  dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
+  dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
    } else if (v) {
-  dasm_put(Dst, 451, v);
+  dasm_put(Dst, 440, v);
    } else {
-  dasm_put(Dst, 454);
+  dasm_put(Dst, 443);
    }
    }
-# 325 "upb/pb/compile_decoder_x64.dasc"
+# 341 "upb/pb/compile_decoder_x64.dasc"
   //|  callp upb_pbdecoder_seterr
   //|  call  ->suspend
   //|  jmp   <1
   //|
   //| // For getting a value that spans a buffer seam.  Falls back to C.
   //| // Args: rdi=C decoding function (prototype: int f(upb_pbdecoder*, void*))
-  dasm_put(Dst, 458, (unsigned int)((uintptr_t)upb_pbdecoder_seterr), (unsigned int)(((uintptr_t)upb_pbdecoder_seterr)>>32), 0xfffffffffffffff0UL);
-# 331 "upb/pb/compile_decoder_x64.dasc"
+  //| // Always called from a routine that was itself called from a method body,
+  //| // so rsp is aligned on entry.
+  dasm_put(Dst, 447, (unsigned int)((uintptr_t)upb_pbdecoder_seterr), (unsigned int)(((uintptr_t)upb_pbdecoder_seterr)>>32));
+# 349 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "getvalue_slow");
   //|->getvalue_slow:
   //|  sub   rsp, 16         // Stack is [8-byte value, 8-byte func pointer]
@@ -547,8 +570,8 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  call  aword [rsp + 8]
   //|  load_regs
   //|  test  eax, eax
-  dasm_put(Dst, 487, 8, Dt2(->checkpoint), Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), 8, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure), Dt1(->end_ofs), Dt2(->bufstart_ofs), Dt2(->buf));
-# 344 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 462, 8, Dt2(->checkpoint), Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), 8, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure), Dt1(->end_ofs), Dt2(->bufstart_ofs), Dt2(->buf));
+# 362 "upb/pb/compile_decoder_x64.dasc"
   //|  jns   >2
   //|  // Success; return parsed data (in rdx AND xmm0).
   //|  mov   rdx, [rsp]
@@ -559,10 +582,11 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  call  ->exitjit   // Return eax from decode function.
   //|  jmp   <1
   //|
-  dasm_put(Dst, 588);
-# 354 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 563);
+# 372 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "parse_unknown");
   //| // Args: edx=fieldnum, cl=wire type
+  //| // Called from dispatch code, so rsp is aligned on entry.
   //|->parse_unknown:
   //|  // OPT: handle directly instead of kicking to C.
   //|  // Check for ENDGROUP.
@@ -574,9 +598,9 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  load_regs
   //|  cmp     eax, DECODE_ENDGROUP
   //|  jne     >1
-  dasm_put(Dst, 619, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), (unsigned int)((uintptr_t)upb_pbdecoder_skipunknown), (unsigned int)(((uintptr_t)upb_pbdecoder_skipunknown)>>32), 0xfffffffffffffff0UL, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure), Dt1(->end_ofs), Dt2(->bufstart_ofs), Dt2(->buf), DECODE_ENDGROUP);
-# 367 "upb/pb/compile_decoder_x64.dasc"
   //|  ret     // Return eax=DECODE_ENDGROUP, not zero
+  dasm_put(Dst, 594, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), (unsigned int)((uintptr_t)upb_pbdecoder_skipunknown), (unsigned int)(((uintptr_t)upb_pbdecoder_skipunknown)>>32), Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure), Dt1(->end_ofs), Dt2(->bufstart_ofs), Dt2(->buf), DECODE_ENDGROUP);
+# 387 "upb/pb/compile_decoder_x64.dasc"
   //|1:
   //|  cmp     eax, DECODE_OK
   //|  je      >1
@@ -594,8 +618,8 @@ static void emit_static_asm(jitcompiler *jc) {
   //| // re-join the fast path which will add fast_path_bytes after the callback
   //| // completes.  We also set DECODER->ptr to this value which is a signal to
   //| // ->suspend that DECODER->checkpoint is up to date.
-  dasm_put(Dst, 716, DECODE_OK);
-# 385 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 681, DECODE_OK);
+# 404 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "skip_decode_f32_fallback");
   //|->skipf32_fallback:
   //|->decodef32_fallback:
@@ -605,8 +629,8 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  mov      DECODER->ptr, PTR
   //|  ret
   //|
-  dasm_put(Dst, 740, (unsigned int)((uintptr_t)upb_pbdecoder_decode_f32), (unsigned int)(((uintptr_t)upb_pbdecoder_decode_f32)>>32), Dt2(->ptr));
-# 394 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 701, (unsigned int)((uintptr_t)upb_pbdecoder_decode_f32), (unsigned int)(((uintptr_t)upb_pbdecoder_decode_f32)>>32), Dt2(->ptr));
+# 413 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "skip_decode_f64_fallback");
   //|->skipf64_fallback:
   //|->decodef64_fallback:
@@ -617,19 +641,19 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  ret
   //|
   //| // Called for varint >= 1 byte.
-  dasm_put(Dst, 762, (unsigned int)((uintptr_t)upb_pbdecoder_decode_f64), (unsigned int)(((uintptr_t)upb_pbdecoder_decode_f64)>>32), Dt2(->ptr));
-# 404 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 723, (unsigned int)((uintptr_t)upb_pbdecoder_decode_f64), (unsigned int)(((uintptr_t)upb_pbdecoder_decode_f64)>>32), Dt2(->ptr));
+# 423 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "skip_decode_v32_fallback");
   //|->skipv32_fallback:
   //|->skipv64_fallback:
   //|  chkeob   16, >1
-  dasm_put(Dst, 784);
+  dasm_put(Dst, 745);
    if (16 == 1) {
-  dasm_put(Dst, 789);
+  dasm_put(Dst, 750);
    } else {
-  dasm_put(Dst, 797);
+  dasm_put(Dst, 758);
    }
-# 408 "upb/pb/compile_decoder_x64.dasc"
+# 427 "upb/pb/compile_decoder_x64.dasc"
   //|  // With at least 16 bytes left, we can do a branch-less SSE version.
   //|  movdqu   xmm0, [PTR]
   //|  pmovmskb eax, xmm0   // bits 0-15 are continuation bits, 16-31 are 0.
@@ -658,8 +682,9 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  ret
   //|
   //| // Returns tag in edx
-  dasm_put(Dst, 813, 10);
-# 436 "upb/pb/compile_decoder_x64.dasc"
+  //| // Called from dispatch code, so rsp is aligned on entry.
+  dasm_put(Dst, 774, 10);
+# 456 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "decode_unknown_tag_fallback");
   //|->decode_unknown_tag_fallback:
   //|  sub   rsp, 16
@@ -676,8 +701,8 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  commit_regs
   //|  callp upb_pbdecoder_decode_varint_slow
   //|  load_regs
-  dasm_put(Dst, 886, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), (unsigned int)((uintptr_t)upb_pbdecoder_decode_varint_slow), (unsigned int)(((uintptr_t)upb_pbdecoder_decode_varint_slow)>>32), 0xfffffffffffffff0UL, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure));
-# 452 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 847, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), (unsigned int)((uintptr_t)upb_pbdecoder_decode_varint_slow), (unsigned int)(((uintptr_t)upb_pbdecoder_decode_varint_slow)>>32), Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure), Dt1(->end_ofs));
+# 472 "upb/pb/compile_decoder_x64.dasc"
   //|  cmp   eax, 0
   //|  jge   >3
   //|  mov   edx, [rsp]   // Success; return parsed data.
@@ -688,22 +713,24 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  jmp   <1
   //|
   //| // Called for varint >= 1 byte.
-  dasm_put(Dst, 989, Dt1(->end_ofs), Dt2(->bufstart_ofs), Dt2(->buf));
-# 462 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 940, Dt2(->bufstart_ofs), Dt2(->buf));
+# 482 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "decode_v32_v64_fallback");
   //|->decodev32_fallback:
   //|->decodev64_fallback:
   //|  chkeob   10, ->decode_varint_slow
-  dasm_put(Dst, 1027);
+  dasm_put(Dst, 974);
    if (10 == 1) {
-  dasm_put(Dst, 1032);
+  dasm_put(Dst, 979);
    } else {
-  dasm_put(Dst, 1040);
+  dasm_put(Dst, 987);
    }
-# 466 "upb/pb/compile_decoder_x64.dasc"
+# 486 "upb/pb/compile_decoder_x64.dasc"
   //|  // OPT: do something faster than just calling the C version.
   //|  mov      rdi, PTR
+  //|  sub      rsp, 8
   //|  callp    upb_vdecode_fast
+  //|  add      rsp, 8
   //|  test     rax, rax
   //|  je       ->decode_varint_slow  // Unterminated varint.
   //|  mov      PTR, rax
@@ -711,8 +738,8 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  mov      DECODER->ptr, PTR
   //|  ret
   //|
-  dasm_put(Dst, 1056, (unsigned int)((uintptr_t)upb_vdecode_fast), (unsigned int)(((uintptr_t)upb_vdecode_fast)>>32), 0xfffffffffffffff0UL, Dt2(->ptr));
-# 476 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1003, (unsigned int)((uintptr_t)upb_vdecode_fast), (unsigned int)(((uintptr_t)upb_vdecode_fast)>>32), Dt2(->ptr));
+# 498 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "decode_varint_slow");
   //|->decode_varint_slow:
   //|  // Slow path: end of buffer or error (varint length >= 10).
@@ -723,8 +750,8 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  ret
   //|
   //| // Args: rsi=expected tag, return=rax (DECODE_{OK,MISMATCH})
-  dasm_put(Dst, 1101, (unsigned int)((uintptr_t)upb_pbdecoder_decode_varint_slow), (unsigned int)(((uintptr_t)upb_pbdecoder_decode_varint_slow)>>32), Dt2(->ptr));
-# 486 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1043, (unsigned int)((uintptr_t)upb_pbdecoder_decode_varint_slow), (unsigned int)(((uintptr_t)upb_pbdecoder_decode_varint_slow)>>32), Dt2(->ptr));
+# 508 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "checktag_fallback");
   //|->checktag_fallback:
   //|  sub      rsp, 8
@@ -735,9 +762,9 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  mov      DECODER->checkpoint, PTR
   //|  callp    upb_pbdecoder_checktag_slow
   //|  load_regs
-  dasm_put(Dst, 1121, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), Dt2(->checkpoint), (unsigned int)((uintptr_t)upb_pbdecoder_checktag_slow), (unsigned int)(((uintptr_t)upb_pbdecoder_checktag_slow)>>32), 0xfffffffffffffff0UL, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure), Dt1(->end_ofs), Dt2(->bufstart_ofs));
-# 496 "upb/pb/compile_decoder_x64.dasc"
   //|  cmp      eax, 0
+  dasm_put(Dst, 1063, Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt2(->delim_end), Dt2(->buf), Dt2(->bufstart_ofs), Dt1(->end_ofs), Dt1(->sink.closure), Dt2(->checkpoint), (unsigned int)((uintptr_t)upb_pbdecoder_checktag_slow), (unsigned int)(((uintptr_t)upb_pbdecoder_checktag_slow)>>32), Dt2(->top), Dt2(->ptr), Dt2(->data_end), Dt1(->sink.closure), Dt1(->end_ofs), Dt2(->bufstart_ofs), Dt2(->buf));
+# 519 "upb/pb/compile_decoder_x64.dasc"
   //|  jge      >2
   //|  add      rsp, 8
   //|  ret
@@ -752,9 +779,10 @@ static void emit_static_asm(jitcompiler *jc) {
   //|
   //| // Args: rsi=upb_inttable, rdx=key, return=rax (-1 if not found).
   //| // Preserves: rcx, rdx
+  //| // Called from dispatch code, so rsp is aligned on entry.
   //| // OPT: Could write this in assembly if it's a hotspot.
-  dasm_put(Dst, 1220, Dt2(->buf), DECODE_EOF);
-# 512 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1152, DECODE_EOF);
+# 535 "upb/pb/compile_decoder_x64.dasc"
   asmlabel(jc, "hashlookup");
   //|->hashlookup:
   //|  push   rcx
@@ -775,8 +803,119 @@ static void emit_static_asm(jitcompiler *jc) {
   //|  xor    rax, rax
   //|  not    rax
   //|  ret
-  dasm_put(Dst, 1262, (unsigned int)((uintptr_t)upb_inttable_lookup), (unsigned int)(((uintptr_t)upb_inttable_lookup)>>32), 0xfffffffffffffff0UL);
-# 532 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1190, (unsigned int)((uintptr_t)upb_inttable_lookup), (unsigned int)(((uintptr_t)upb_inttable_lookup)>>32));
+# 555 "upb/pb/compile_decoder_x64.dasc"
+}
+
+// Calls the value handler for a primitive; the value must already be in
+// edx/rdx/xmm0.  On failure we suspend and then retry from local label 1,
+// which must re-decode the value.
+static void jitcallvalue(jitcompiler *jc, const upb_handlers *h,
+                         upb_selector_t sel, upb_func *handler) {
+  //|  mov    ARG1_64, CLOSURE
+  //|  load_handler_data h, sel
+  dasm_put(Dst, 1245);
+   {
+   uintptr_t v = (uintptr_t)upb_handlers_gethandlerdata(h, sel);
+   if (v > 0xffffffff) {
+  dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
+   } else if (v) {
+  dasm_put(Dst, 440, v);
+   } else {
+  dasm_put(Dst, 443);
+   }
+   }
+# 564 "upb/pb/compile_decoder_x64.dasc"
+  //|  callp  handler
+  dasm_put(Dst, 1250, (unsigned int)((uintptr_t)handler), (unsigned int)(((uintptr_t)handler)>>32));
+# 565 "upb/pb/compile_decoder_x64.dasc"
+  if (!alwaysok(h, sel)) {
+    //|  test   al, al
+    //|  jnz    >5
+    //|  call   ->suspend
+    //|  jmp    <1
+    //|5:
+    dasm_put(Dst, 1258);
+# 571 "upb/pb/compile_decoder_x64.dasc"
+  }
+}
+
+// Emits inline code for upb_shim_setsubmsg(): reuses the child if the pointer
+// is already set, otherwise bump-allocates and zeroes it straight from the
+// arena, falling back to the shim's handler when the current block is full.
+// Leaves the child in rax.
+static void jitsubmsgshim(jitcompiler *jc, const upb_handlers *h,
+                          upb_selector_t sel, const upb_shim_data *data) {
+  size_t size = UPB_ARENA_ALIGN_UP(data->size);
+  upb_func *start = gethandler(h, sel);
+  //|1:
+  //|  mov   rax, [CLOSURE + data->offset]
+  //|  test  rax, rax
+  //|  jnz   >3
+  //|  mov   rcx, [CLOSURE + data->arena_offset]
+  //|  test  rcx, rcx
+  //|  jz    >2
+  //|  mov   rax, [rcx + offsetof(upb_arena, ptr)]
+  //|  lea   rdx, [rax + size]
+  //|  cmp   rdx, [rcx + offsetof(upb_arena, end)]
+  //|  ja    >2
+  //|  mov   [rcx + offsetof(upb_arena, ptr)], rdx
+  //|  add   qword [rcx + offsetof(upb_arena, bytes_allocated)], size
+  //|  mov   [CLOSURE + data->offset], rax
+  dasm_put(Dst, 1274, data->offset, data->arena_offset, offsetof(upb_arena, ptr), size, offsetof(upb_arena, end), offsetof(upb_arena, ptr), offsetof(upb_arena, bytes_allocated), size, data->offset);
+# 596 "upb/pb/compile_decoder_x64.dasc"
+  if (size <= 16 * 8) {
+    size_t i;
+    //|  xor   edx, edx
+    dasm_put(Dst, 1328);
+# 599 "upb/pb/compile_decoder_x64.dasc"
+    for (i = 0; i < size; i += 8) {
+      //|  mov   [rax + i], rdx
+      dasm_put(Dst, 1331, i);
+# 601 "upb/pb/compile_decoder_x64.dasc"
+    }
+  } else {
+    //|  mov   ARG1_64, rax
+    //|  xor   ARG2_32, ARG2_32
+    //|  mov   ARG3_64, size
+    //|  callp memset  // Returns the child.
+    dasm_put(Dst, 1336, size, (unsigned int)((uintptr_t)memset), (unsigned int)(((uintptr_t)memset)>>32));
+# 607 "upb/pb/compile_decoder_x64.dasc"
+  }
+  if (data->child_arena_offset >= 0) {
+    //|  mov   rcx, [CLOSURE + data->arena_offset]
+    //|  mov   [rax + data->child_arena_offset], rcx
+    dasm_put(Dst, 1354, data->arena_offset, data->child_arena_offset);
+# 611 "upb/pb/compile_decoder_x64.dasc"
+  }
+  //|  jmp   >3
+  //|2:
+  //|  mov   ARG1_64, CLOSURE
+  //|  load_handler_data h, sel
+  dasm_put(Dst, 1363);
+   {
+   uintptr_t v = (uintptr_t)upb_handlers_gethandlerdata(h, sel);
+   if (v > 0xffffffff) {
+  dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
+   } else if (v) {
+  dasm_put(Dst, 440, v);
+   } else {
+  dasm_put(Dst, 443);
+   }
+   }
+# 616 "upb/pb/compile_decoder_x64.dasc"
+  //|  callp start
+  //|  test  rax, rax
+  //|  jnz   >3
+  //|  call  ->suspend
+  //|  jmp   <1
+  //|3:
+  //|  sethas CLOSURE, data->hasbit
+  dasm_put(Dst, 1374, (unsigned int)((uintptr_t)start), (unsigned int)(((uintptr_t)start)>>32));
+   if (data->hasbit >= 0) {
+  dasm_put(Dst, 1398, ((uint32_t)data->hasbit / 8), (1 << ((uint32_t)data->hasbit % 8)));
+   }
+# 623 "upb/pb/compile_decoder_x64.dasc"
 }
 
 static void jitprimitive(jitcompiler *jc, opcode op,
@@ -793,85 +932,85 @@ static void jitprimitive(jitcompiler *jc, opcode op,
   if (handler) {
     //|1:
     //|  chkneob  fastbytes, >3
-    dasm_put(Dst, 112);
+    dasm_put(Dst, 103);
      if (fastbytes == 1) {
-    dasm_put(Dst, 1331);
+    dasm_put(Dst, 1404);
      } else {
-    dasm_put(Dst, 1339, fastbytes);
+    dasm_put(Dst, 1412, fastbytes);
      }
-# 548 "upb/pb/compile_decoder_x64.dasc"
+# 639 "upb/pb/compile_decoder_x64.dasc"
     //|2:
-    dasm_put(Dst, 1355);
-# 549 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1428);
+# 640 "upb/pb/compile_decoder_x64.dasc"
     switch (type) {
     case V32:
       //|  call   ->decodev32_fallback
-      dasm_put(Dst, 1358);
-# 552 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1431);
+# 643 "upb/pb/compile_decoder_x64.dasc"
       break;
     case V64:
       //|  call   ->decodev64_fallback
-      dasm_put(Dst, 1362);
-# 555 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1435);
+# 646 "upb/pb/compile_decoder_x64.dasc"
       break;
     case F32:
       //|  call   ->decodef32_fallback
-      dasm_put(Dst, 1366);
-# 558 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1439);
+# 649 "upb/pb/compile_decoder_x64.dasc"
       break;
     case F64:
       //|  call   ->decodef64_fallback
-      dasm_put(Dst, 1370);
-# 561 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1443);
+# 652 "upb/pb/compile_decoder_x64.dasc"
       break;
     case X: break;
     }
     //|  jmp    >4
-    dasm_put(Dst, 1374);
-# 565 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1447);
+# 656 "upb/pb/compile_decoder_x64.dasc"
 
     // Fast path decode; for when check_bytes bytes are available.
     //|3:
-    dasm_put(Dst, 1379);
-# 568 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1395);
+# 659 "upb/pb/compile_decoder_x64.dasc"
     switch (op) {
     case OP_PARSE_SFIXED32:
     case OP_PARSE_FIXED32:
       //|  mov    edx, dword [PTR]
-      dasm_put(Dst, 1382);
-# 572 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1452);
+# 663 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_PARSE_SFIXED64:
     case OP_PARSE_FIXED64:
       //|  mov    rdx, qword [PTR]
-      dasm_put(Dst, 1385);
-# 576 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1455);
+# 667 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_PARSE_FLOAT:
       //|  movss  xmm0, dword [PTR]
-      dasm_put(Dst, 1389);
-# 579 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1459);
+# 670 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_PARSE_DOUBLE:
       //|  movsd  xmm0, qword [PTR]
-      dasm_put(Dst, 1395);
-# 582 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1465);
+# 673 "upb/pb/compile_decoder_x64.dasc"
       break;
     default:
       // Inline one byte of varint decoding.
       //|  movzx  edx, byte [PTR]
       //|  test   dl, dl
       //|  js     <2   // Fallback to slow path for >1 byte varint.
-      dasm_put(Dst, 1401);
-# 588 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1471);
+# 679 "upb/pb/compile_decoder_x64.dasc"
       break;
     }
 
     // Second-stage decode; used for both fast and slow paths
     // (only needed for a few types).
     //|4:
-    dasm_put(Dst, 1411);
-# 594 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1481);
+# 685 "upb/pb/compile_decoder_x64.dasc"
     switch (op) {
     case OP_PARSE_SINT32:
       // 32-bit zig-zag decode.
@@ -880,8 +1019,8 @@ static void jitprimitive(jitcompiler *jc, opcode op,
       //|  and    eax, 1
       //|  neg    eax
       //|  xor    edx, eax
-      dasm_put(Dst, 1414);
-# 602 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1484);
+# 693 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_PARSE_SINT64:
       // 64-bit zig-zag decode.
@@ -890,14 +1029,14 @@ static void jitprimitive(jitcompiler *jc, opcode op,
       //|  and    rax, 1
       //|  neg    rax
       //|  xor    rdx, rax
-      dasm_put(Dst, 1428);
-# 610 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1498);
+# 701 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_PARSE_BOOL:
       //|  test   rdx, rdx
       //|  setne  dl
-      dasm_put(Dst, 1447);
-# 614 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1517);
+# 705 "upb/pb/compile_decoder_x64.dasc"
       break;
     default: break;
     }
@@ -905,129 +1044,167 @@ static void jitprimitive(jitcompiler *jc, opcode op,
     // Call callback (or specialize if we can).
     upb_fieldtype_t type;
     const upb_shim_data *data = upb_shim_getdata(h, sel, &type);
-    if (data) {
+    const upb_shim_data *arr = upb_shim_getarray(h, sel, &type);
+    if (arr) {
+      // Append inline while the array has room; otherwise call the shim's
+      // handler, which grows it.  The value is already in edx/rdx/xmm0,
+      // which is where the handler's third argument goes.
+      //|  mov   rax, [CLOSURE + arr->offset + offsetof(upb_shim_array, len)]
+      //|  cmp   rax, [CLOSURE + arr->offset + offsetof(upb_shim_array, size)]
+      //|  jae   >6
+      //|  mov   rcx, [CLOSURE + arr->offset + offsetof(upb_shim_array, data)]
+      dasm_put(Dst, 1524, arr->offset + offsetof(upb_shim_array, len), arr->offset + offsetof(upb_shim_array, size), arr->offset + offsetof(upb_shim_array, data));
+# 721 "upb/pb/compile_decoder_x64.dasc"
+      switch (type) {
+        case UPB_TYPE_INT64:
+        case UPB_TYPE_UINT64:
+          //|  mov   [rcx + rax * 8], rdx
+          dasm_put(Dst, 1541);
+# 725 "upb/pb/compile_decoder_x64.dasc"
+          break;
+        case UPB_TYPE_INT32:
+        case UPB_TYPE_UINT32:
+        case UPB_TYPE_ENUM:
+          //|  mov   [rcx + rax * 4], edx
+          dasm_put(Dst, 1546);
+# 730 "upb/pb/compile_decoder_x64.dasc"
+          break;
+        case UPB_TYPE_DOUBLE:
+          //|  movsd  qword [rcx + rax * 8], XMMARG1
+          dasm_put(Dst, 1550);
+# 733 "upb/pb/compile_decoder_x64.dasc"
+          break;
+        case UPB_TYPE_FLOAT:
+          //|  movss  dword [rcx + rax * 4], XMMARG1
+          dasm_put(Dst, 1557);
+# 736 "upb/pb/compile_decoder_x64.dasc"
+          break;
+        case UPB_TYPE_BOOL:
+          //|  mov   [rcx + rax], dl
+          dasm_put(Dst, 1564);
+# 739 "upb/pb/compile_decoder_x64.dasc"
+          break;
+        default:
+          assert(false); break;
+      }
+      //|  add   qword [CLOSURE + arr->offset + offsetof(upb_shim_array, len)], 1
+      //|  jmp   >7
+      //|6:
+      dasm_put(Dst, 1568, arr->offset + offsetof(upb_shim_array, len));
+# 746 "upb/pb/compile_decoder_x64.dasc"
+      jitcallvalue(jc, h, sel, handler);
+      //|7:
+      dasm_put(Dst, 1580);
+# 748 "upb/pb/compile_decoder_x64.dasc"
+    } else if (data) {
       switch (type) {
         case UPB_TYPE_INT64:
         case UPB_TYPE_UINT64:
           //|  mov   [CLOSURE + data->offset], rdx
-          dasm_put(Dst, 1454, data->offset);
-# 626 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 1583, data->offset);
+# 753 "upb/pb/compile_decoder_x64.dasc"
           break;
         case UPB_TYPE_INT32:
         case UPB_TYPE_UINT32:
         case UPB_TYPE_ENUM:
           //|  mov   [CLOSURE + data->offset], edx
-          dasm_put(Dst, 1459, data->offset);
-# 631 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 1588, data->offset);
+# 758 "upb/pb/compile_decoder_x64.dasc"
           break;
         case UPB_TYPE_DOUBLE:
           //|  movsd  qword [CLOSURE + data->offset], XMMARG1
-          dasm_put(Dst, 1464, data->offset);
-# 634 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 1593, data->offset);
+# 761 "upb/pb/compile_decoder_x64.dasc"
           break;
         case UPB_TYPE_FLOAT:
           //|  movss  dword [CLOSURE + data->offset], XMMARG1
-          dasm_put(Dst, 1472, data->offset);
-# 637 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 1601, data->offset);
+# 764 "upb/pb/compile_decoder_x64.dasc"
           break;
         case UPB_TYPE_BOOL:
           //|  mov   [CLOSURE + data->offset], dl
-          dasm_put(Dst, 1480, data->offset);
-# 640 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 1609, data->offset);
+# 767 "upb/pb/compile_decoder_x64.dasc"
           break;
         case UPB_TYPE_STRING:
         case UPB_TYPE_BYTES:
         case UPB_TYPE_MESSAGE:
+          // Handled by the string and submessage shims instead.
           assert(false); break;
       }
       //|  sethas CLOSURE, data->hasbit
        if (data->hasbit >= 0) {
-      dasm_put(Dst, 1485, ((uint32_t)data->hasbit / 8), (1 << ((uint32_t)data->hasbit % 8)));
+      dasm_put(Dst, 1398, ((uint32_t)data->hasbit / 8), (1 << ((uint32_t)data->hasbit % 8)));
        }
-# 647 "upb/pb/compile_decoder_x64.dasc"
+# 775 "upb/pb/compile_decoder_x64.dasc"
     } else if (handler) {
-      //|  mov    ARG1_64, CLOSURE
-      //|  load_handler_data h, sel
-      dasm_put(Dst, 1491);
-       {
-       uintptr_t v = (uintptr_t)upb_handlers_gethandlerdata(h, sel);
-       if (v > 0xffffffff) {
-      dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
-       } else if (v) {
-      dasm_put(Dst, 451, v);
-       } else {
-      dasm_put(Dst, 454);
-       }
-       }
-# 650 "upb/pb/compile_decoder_x64.dasc"
-      //|  callp  handler
-      dasm_put(Dst, 1496, (unsigned int)((uintptr_t)handler), (unsigned int)(((uintptr_t)handler)>>32), 0xfffffffffffffff0UL);
-# 651 "upb/pb/compile_decoder_x64.dasc"
-      if (!alwaysok(h, sel)) {
-        //|  test   al, al
-        //|  jnz    >5
-        //|  call   ->suspend
-        //|  jmp    <1
-        //|5:
-        dasm_put(Dst, 1518);
-# 657 "upb/pb/compile_decoder_x64.dasc"
-      }
+      jitcallvalue(jc, h, sel, handler);
     }
 
     // We do this last so that the checkpoint is not advanced past the user's
     // data until the callback has returned success.
+    //|  stat   fields
+    #ifdef UPB_DECODER_STATS
+    dasm_put(Dst, 1614, Dt2(->stats_.fields));
+    #endif
+# 782 "upb/pb/compile_decoder_x64.dasc"
     //|  add    PTR, fastbytes
-    dasm_put(Dst, 1534, fastbytes);
-# 663 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1620, fastbytes);
+# 783 "upb/pb/compile_decoder_x64.dasc"
   } else {
     // No handler registered for this value, just skip it.
     //|  chkneob  fastbytes, >3
      if (fastbytes == 1) {
-    dasm_put(Dst, 1331);
+    dasm_put(Dst, 1404);
      } else {
-    dasm_put(Dst, 1339, fastbytes);
+    dasm_put(Dst, 1412, fastbytes);
      }
-# 666 "upb/pb/compile_decoder_x64.dasc"
+# 786 "upb/pb/compile_decoder_x64.dasc"
     //|2:
-    dasm_put(Dst, 1355);
-# 667 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1428);
+# 787 "upb/pb/compile_decoder_x64.dasc"
     switch (type) {
     case V32:
       //|  call   ->skipv32_fallback
-      dasm_put(Dst, 1539);
-# 670 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1625);
+# 790 "upb/pb/compile_decoder_x64.dasc"
       break;
     case V64:
       //|  call   ->skipv64_fallback
-      dasm_put(Dst, 1543);
-# 673 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1629);
+# 793 "upb/pb/compile_decoder_x64.dasc"
       break;
     case F32:
       //|  call   ->skipf32_fallback
-      dasm_put(Dst, 1547);
-# 676 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1633);
+# 796 "upb/pb/compile_decoder_x64.dasc"
       break;
     case F64:
       //|  call   ->skipf64_fallback
-      dasm_put(Dst, 1551);
-# 679 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1637);
+# 799 "upb/pb/compile_decoder_x64.dasc"
       break;
     case X: break;
     }
 
     // Fast-path skip.
     //|3:
-    dasm_put(Dst, 1379);
-# 685 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1395);
+# 805 "upb/pb/compile_decoder_x64.dasc"
     if (type == V32 || type == V64) {
       //|  test   byte [PTR], 0x80
       //|  jnz    <2
-      dasm_put(Dst, 1555);
-# 688 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1641);
+# 808 "upb/pb/compile_decoder_x64.dasc"
     }
+    //|  stat   fields
+    #ifdef UPB_DECODER_STATS
+    dasm_put(Dst, 1614, Dt2(->stats_.fields));
+    #endif
+# 810 "upb/pb/compile_decoder_x64.dasc"
     //|  add    PTR, fastbytes
-    dasm_put(Dst, 1534, fastbytes);
-# 690 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1620, fastbytes);
+# 811 "upb/pb/compile_decoder_x64.dasc"
   }
 }
 
@@ -1047,18 +1224,18 @@ static void jitdispatch(jitcompiler *jc,
 
   //|=>define_jmptarget(jc, &method->dispatch):
   //|1:
-  dasm_put(Dst, 1564, define_jmptarget(jc, &method->dispatch));
-# 709 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1650, define_jmptarget(jc, &method->dispatch));
+# 830 "upb/pb/compile_decoder_x64.dasc"
   // Decode the field tag.
   //|  mov     aword DECODER->checkpoint, PTR
   //|  chkeob  2, >6
-  dasm_put(Dst, 308, Dt2(->checkpoint));
+  dasm_put(Dst, 293, Dt2(->checkpoint));
    if (2 == 1) {
-  dasm_put(Dst, 1568);
+  dasm_put(Dst, 1654);
    } else {
-  dasm_put(Dst, 1576);
+  dasm_put(Dst, 1662);
    }
-# 712 "upb/pb/compile_decoder_x64.dasc"
+# 833 "upb/pb/compile_decoder_x64.dasc"
   //|  movzx   edx, byte [PTR]
   //|  test    dl, dl
   //|  jns     >7    // Jump if first byte has no continuation bit.
@@ -1079,52 +1256,58 @@ static void jitdispatch(jitcompiler *jc,
   //|7:
   //|  add     PTR, 1
   //|8:
+  //|  stat    dispatch_fallbacks
+  dasm_put(Dst, 1678, 1);
+  #ifdef UPB_DECODER_STATS
+  dasm_put(Dst, 1614, Dt2(->stats_.dispatch_fallbacks));
+  #endif
+# 854 "upb/pb/compile_decoder_x64.dasc"
   //|  mov     ecx, edx
   //|  shr     edx, 3
   //|  and     cl, 7
-  dasm_put(Dst, 1592, 1);
-# 735 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1734);
+# 857 "upb/pb/compile_decoder_x64.dasc"
 
   // See comment attached to upb_pbdecodermethod.dispatch for layout of the
   // dispatch table.
   //|2:
   //|  cmp     edx, dispatch->array_size
-  dasm_put(Dst, 1657, dispatch->array_size);
-# 740 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1744, dispatch->array_size);
+# 862 "upb/pb/compile_decoder_x64.dasc"
   if (has_hash_entries) {
     //|  jae     >7
-    dasm_put(Dst, 1664);
-# 742 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1751);
+# 864 "upb/pb/compile_decoder_x64.dasc"
   } else {
     //|  jae     >5
-    dasm_put(Dst, 1669);
-# 744 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1756);
+# 866 "upb/pb/compile_decoder_x64.dasc"
   }
   //|  // OPT: Compact the lookup arr into 32-bit entries.
   if ((uintptr_t)dispatch->array > 0x7fffffff) {
     //|  mov64 rax, (uintptr_t)dispatch->array
     //|  mov   rax, qword [rax + rdx * 8]
-    dasm_put(Dst, 1674, (unsigned int)((uintptr_t)dispatch->array), (unsigned int)(((uintptr_t)dispatch->array)>>32));
-# 749 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1761, (unsigned int)((uintptr_t)dispatch->array), (unsigned int)(((uintptr_t)dispatch->array)>>32));
+# 871 "upb/pb/compile_decoder_x64.dasc"
   } else {
     //|  mov   rax, qword [rdx * 8 + dispatch->array]
-    dasm_put(Dst, 1683, dispatch->array);
-# 751 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1770, dispatch->array);
+# 873 "upb/pb/compile_decoder_x64.dasc"
   }
   //|3:
   //|  // We take advantage of the fact that non-present entries are stored
   //|  // as -1, which will result in wire types that will never match.
   //|  cmp  al, cl
-  dasm_put(Dst, 1689);
-# 756 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1776);
+# 878 "upb/pb/compile_decoder_x64.dasc"
   if (has_multi_wiretype) {
     //|  jne  >6
-    dasm_put(Dst, 1694);
-# 758 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1781);
+# 880 "upb/pb/compile_decoder_x64.dasc"
   } else {
     //|  jne  >5
-    dasm_put(Dst, 1699);
-# 760 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1786);
+# 882 "upb/pb/compile_decoder_x64.dasc"
   }
   //|  shr  rax, 16
   //|
@@ -1149,8 +1332,8 @@ static void jitdispatch(jitcompiler *jc,
   //|  jz   <1
   //|  lea  rax, [>9]  // ENDGROUP; Load address of OP_ENDMSG.
   //|  ret
-  dasm_put(Dst, 1704, define_jmptarget(jc, dispatch->array));
-# 784 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1791, define_jmptarget(jc, dispatch->array));
+# 906 "upb/pb/compile_decoder_x64.dasc"
 
   if (has_multi_wiretype) {
     //|6:
@@ -1160,46 +1343,49 @@ static void jitdispatch(jitcompiler *jc,
     //|  // Secondary wire type is a match, look up fn + UPB_MAX_FIELDNUMBER.
     //|  add   rdx, UPB_MAX_FIELDNUMBER
     //|  // This key will never be in the array part, so do a hash lookup.
-    dasm_put(Dst, 1738, UPB_MAX_FIELDNUMBER);
-# 793 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1825, UPB_MAX_FIELDNUMBER);
+# 915 "upb/pb/compile_decoder_x64.dasc"
     assert(has_hash_entries);
     //|  ld64  dispatch
      {
      uintptr_t v = (uintptr_t)dispatch;
      if (v > 0xffffffff) {
-    dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
+    dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
      } else if (v) {
-    dasm_put(Dst, 451, v);
+    dasm_put(Dst, 440, v);
      } else {
-    dasm_put(Dst, 454);
+    dasm_put(Dst, 443);
      }
      }
-# 795 "upb/pb/compile_decoder_x64.dasc"
-    //|  jmp   ->hashlookup  // Tail call.
-    dasm_put(Dst, 1751);
-# 796 "upb/pb/compile_decoder_x64.dasc"
+# 917 "upb/pb/compile_decoder_x64.dasc"
+    //|  // Not a tail call, so that ->hashlookup is always entered with the
+    //|  // same stack alignment.
+    //|  call  ->hashlookup
+    //|  ret
+    dasm_put(Dst, 1838);
+# 921 "upb/pb/compile_decoder_x64.dasc"
   }
 
   if (has_hash_entries) {
     //|7:
     //|  // Hash table lookup.
     //|  ld64   dispatch
-    dasm_put(Dst, 1756);
+    dasm_put(Dst, 1580);
      {
      uintptr_t v = (uintptr_t)dispatch;
      if (v > 0xffffffff) {
-    dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
+    dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
      } else if (v) {
-    dasm_put(Dst, 451, v);
+    dasm_put(Dst, 440, v);
      } else {
-    dasm_put(Dst, 454);
+    dasm_put(Dst, 443);
      }
      }
-# 802 "upb/pb/compile_decoder_x64.dasc"
+# 927 "upb/pb/compile_decoder_x64.dasc"
     //|  call   ->hashlookup
     //|  jmp    <3
-    dasm_put(Dst, 1759);
-# 804 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1843);
+# 929 "upb/pb/compile_decoder_x64.dasc"
   }
 }
 
@@ -1221,11 +1407,11 @@ static void jittag(jitcompiler *jc, uint64_t tag, int n, int ofs,
 
   //|  chkneob n, >1
    if (n == 1) {
-  dasm_put(Dst, 1767);
+  dasm_put(Dst, 1851);
    } else {
-  dasm_put(Dst, 1775, n);
+  dasm_put(Dst, 1859, n);
    }
-# 824 "upb/pb/compile_decoder_x64.dasc"
+# 949 "upb/pb/compile_decoder_x64.dasc"
 
   //|  // OPT: this is way too much fallback code to put here.
   //|  // Reduce and/or move to a separate section to make better icache usage.
@@ -1233,36 +1419,36 @@ static void jittag(jitcompiler *jc, uint64_t tag, int n, int ofs,
    {
    uintptr_t v = (uintptr_t)tag;
    if (v > 0xffffffff) {
-  dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
+  dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
    } else if (v) {
-  dasm_put(Dst, 451, v);
+  dasm_put(Dst, 440, v);
    } else {
-  dasm_put(Dst, 454);
+  dasm_put(Dst, 443);
    }
    }
-# 828 "upb/pb/compile_decoder_x64.dasc"
+# 953 "upb/pb/compile_decoder_x64.dasc"
   //|  call  ->checktag_fallback
   //|  cmp   eax, DECODE_MISMATCH
   //|  je    >3
   //|  cmp   eax, DECODE_EOF
   //|  je     =>jmptarget(jc, delimend)
   //|  jmp   >5
-  dasm_put(Dst, 1791, DECODE_MISMATCH, DECODE_EOF, jmptarget(jc, delimend));
-# 834 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1875, DECODE_MISMATCH, DECODE_EOF, jmptarget(jc, delimend));
+# 959 "upb/pb/compile_decoder_x64.dasc"
 
   //|1:
-  dasm_put(Dst, 112);
-# 836 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 103);
+# 961 "upb/pb/compile_decoder_x64.dasc"
   switch (n) {
   case 1:
     //|  cmp  byte [PTR], tag
-    dasm_put(Dst, 1814, tag);
-# 839 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1898, tag);
+# 964 "upb/pb/compile_decoder_x64.dasc"
     break;
   case 2:
     //|  cmp  word [PTR], tag
-    dasm_put(Dst, 1818, tag);
-# 842 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1902, tag);
+# 967 "upb/pb/compile_decoder_x64.dasc"
     break;
   case 3:
     //|   // OPT: Slightly more efficient code, but depends on an extra byte.
@@ -1273,48 +1459,53 @@ static void jittag(jitcompiler *jc, uint64_t tag, int n, int ofs,
     //|   jne  >2
     //|   cmp  byte [PTR + 2], (tag >> 16)
     //|2:
-    dasm_put(Dst, 1823, (tag & 0xffff), 2, (tag >> 16));
-# 852 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1907, (tag & 0xffff), 2, (tag >> 16));
+# 977 "upb/pb/compile_decoder_x64.dasc"
     break;
   case 4:
     //|   cmp  dword [PTR], tag
-    dasm_put(Dst, 1838, tag);
-# 855 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1922, tag);
+# 980 "upb/pb/compile_decoder_x64.dasc"
     break;
   case 5:
     //|   cmp  dword [PTR], (tag & 0xffffffff)
     //|   jne  >3
     //|   cmp  byte  [PTR + 4], (tag >> 32)
-    dasm_put(Dst, 1842, (tag & 0xffffffff), 4, (tag >> 32));
-# 860 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1926, (tag & 0xffffffff), 4, (tag >> 32));
+# 985 "upb/pb/compile_decoder_x64.dasc"
   }
   //|  je    >4
   //|3:
-  dasm_put(Dst, 1854);
-# 863 "upb/pb/compile_decoder_x64.dasc"
+  //|  stat  tag_mispredicts
+  dasm_put(Dst, 1938);
+  #ifdef UPB_DECODER_STATS
+  dasm_put(Dst, 1614, Dt2(->stats_.tag_mispredicts));
+  #endif
+# 989 "upb/pb/compile_decoder_x64.dasc"
   if (ofs == 0) {
     //|  call   =>jmptarget(jc, &method->dispatch)
     //|  test   rax, rax
     //|  jz     =>jmptarget(jc, delimend)
     //|  jmp    rax
-    dasm_put(Dst, 1861, jmptarget(jc, &method->dispatch), jmptarget(jc, delimend));
-# 868 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1945, jmptarget(jc, &method->dispatch), jmptarget(jc, delimend));
+# 994 "upb/pb/compile_decoder_x64.dasc"
   } else {
     //|  jmp    =>jmptarget(jc, jc->pc + ofs)
-    dasm_put(Dst, 1873, jmptarget(jc, jc->pc + ofs));
-# 870 "upb/pb/compile_decoder_x64.dasc"
+    dasm_put(Dst, 1957, jmptarget(jc, jc->pc + ofs));
+# 996 "upb/pb/compile_decoder_x64.dasc"
   }
   //|4:
   //|  add    PTR, n
   //|5:
-  dasm_put(Dst, 1877, n);
-# 874 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1961, n);
+# 1000 "upb/pb/compile_decoder_x64.dasc"
 }
 
 // Compile the bytecode to x64.
 static void jitbytecode(jitcompiler *jc) {
   upb_pbdecodermethod *method = NULL;
   const upb_handlers *h = NULL;
+  const char *msgname = "";
   for (jc->pc = jc->group->bytecode; jc->pc < jc->group->bytecode_end; ) {
     int32_t instr = *jc->pc;
     opcode op = instr & 0xff;
@@ -1324,14 +1515,15 @@ static void jitbytecode(jitcompiler *jc) {
     if (op != OP_SETDISPATCH) {
       // Skipped for SETDISPATCH because it defines its own asmlabel for the
       // dispatch code it emits.
-      asmlabel(jc, "0x%lx.%s", pcofs(jc), upb_pbdecoder_getopname(op));
+      asmlabel(jc, "%s.0x%lx.%s", msgname, pcofs(jc),
+               upb_pbdecoder_getopname(op));
 
       // Skipped for SETDISPATCH because it should point at the function
       // prologue, not the dispatch function that is emitted first.
       // TODO: optimize this to only define pclabels that are actually used.
       //|=>define_jmptarget(jc, jc->pc):
       dasm_put(Dst, 0, define_jmptarget(jc, jc->pc));
-# 895 "upb/pb/compile_decoder_x64.dasc"
+# 1023 "upb/pb/compile_decoder_x64.dasc"
     }
 
     jc->pc++;
@@ -1344,62 +1536,62 @@ static void jitbytecode(jitcompiler *jc) {
         //|1:
         //|  mov   ARG1_64, CLOSURE
         //|  load_handler_data h, UPB_STARTMSG_SELECTOR
-        dasm_put(Dst, 1886);
+        dasm_put(Dst, 1970);
          {
          uintptr_t v = (uintptr_t)upb_handlers_gethandlerdata(h, UPB_STARTMSG_SELECTOR);
          if (v > 0xffffffff) {
-        dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
+        dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
          } else if (v) {
-        dasm_put(Dst, 451, v);
+        dasm_put(Dst, 440, v);
          } else {
-        dasm_put(Dst, 454);
+        dasm_put(Dst, 443);
          }
          }
-# 907 "upb/pb/compile_decoder_x64.dasc"
+# 1035 "upb/pb/compile_decoder_x64.dasc"
         //|  callp startmsg
-        dasm_put(Dst, 1496, (unsigned int)((uintptr_t)startmsg), (unsigned int)(((uintptr_t)startmsg)>>32), 0xfffffffffffffff0UL);
-# 908 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 1250, (unsigned int)((uintptr_t)startmsg), (unsigned int)(((uintptr_t)startmsg)>>32));
+# 1036 "upb/pb/compile_decoder_x64.dasc"
         if (!alwaysok(h, UPB_STARTMSG_SELECTOR)) {
           //|  test  al, al
           //|  jnz   >2
           //|  call  ->suspend
           //|  jmp   <1
           //|2:
-          dasm_put(Dst, 1893);
-# 914 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 1977);
+# 1042 "upb/pb/compile_decoder_x64.dasc"
         }
       } else {
         //| nop
-        dasm_put(Dst, 1909);
-# 917 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 1993);
+# 1045 "upb/pb/compile_decoder_x64.dasc"
       }
       break;
     }
     case OP_ENDMSG: {
       upb_func *endmsg = gethandler(h, UPB_ENDMSG_SELECTOR);
       //|9:
-      dasm_put(Dst, 1911);
-# 923 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1995);
+# 1051 "upb/pb/compile_decoder_x64.dasc"
       if (endmsg) {
         // bool endmsg(void *closure, const void *hd, upb_status *status)
         //|  mov   ARG1_64, CLOSURE
         //|  load_handler_data h, UPB_ENDMSG_SELECTOR
-        dasm_put(Dst, 1491);
+        dasm_put(Dst, 1245);
          {
          uintptr_t v = (uintptr_t)upb_handlers_gethandlerdata(h, UPB_ENDMSG_SELECTOR);
          if (v > 0xffffffff) {
-        dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
+        dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
          } else if (v) {
-        dasm_put(Dst, 451, v);
+        dasm_put(Dst, 440, v);
          } else {
-        dasm_put(Dst, 454);
+        dasm_put(Dst, 443);
          }
          }
-# 927 "upb/pb/compile_decoder_x64.dasc"
+# 1055 "upb/pb/compile_decoder_x64.dasc"
         //|  mov   ARG3_64, DECODER->status
         //|  callp endmsg
-        dasm_put(Dst, 1914, Dt2(->status), (unsigned int)((uintptr_t)endmsg), (unsigned int)(((uintptr_t)endmsg)>>32), 0xfffffffffffffff0UL);
-# 929 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 1998, Dt2(->status), (unsigned int)((uintptr_t)endmsg), (unsigned int)(((uintptr_t)endmsg)>>32));
+# 1057 "upb/pb/compile_decoder_x64.dasc"
       }
       break;
     }
@@ -1419,7 +1611,7 @@ static void jitbytecode(jitcompiler *jc) {
       // case instead of parsing it field by field.  We should also do the skip
       // in the containing message's code.
       h = method->dest_handlers_;
-      const char *msgname = upb_msgdef_fullname(upb_handlers_msgdef(h));
+      msgname = upb_msgdef_fullname(upb_handlers_msgdef(h));
 
       // Emit dispatch code for new method.
       asmlabel(jc, "0x%lx.dispatch.%s", pcofs(jc), msgname);
@@ -1430,8 +1622,8 @@ static void jitbytecode(jitcompiler *jc) {
       //|=>define_jmptarget(jc, op_pc):
       //|=>define_jmptarget(jc, method):
       //|  sub   rsp, 8
-      dasm_put(Dst, 1940, define_jmptarget(jc, op_pc), define_jmptarget(jc, method));
-# 959 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2010, define_jmptarget(jc, op_pc), define_jmptarget(jc, method));
+# 1087 "upb/pb/compile_decoder_x64.dasc"
 
       break;
     }
@@ -1454,51 +1646,113 @@ static void jitbytecode(jitcompiler *jc) {
     case OP_STARTSUBMSG:
     case OP_STARTSTR: {
       upb_func *start = gethandler(h, arg);
-      if (start) {
+      upb_fieldtype_t type;
+      const upb_shim_data *data;
+      // The shims are only looked up if there is a handler, since "h" may be
+      // NULL.
+      if (start && op == OP_STARTSTR &&
+          (data = upb_shim_getstrview(h, arg))) {
+        // Clear the string view; the closure stays the same.
+        size_t ofs = data->offset;
+        //|  sethas CLOSURE, data->hasbit
+         if (data->hasbit >= 0) {
+        dasm_put(Dst, 1398, ((uint32_t)data->hasbit / 8), (1 << ((uint32_t)data->hasbit % 8)));
+         }
+# 1118 "upb/pb/compile_decoder_x64.dasc"
+        //|  mov   qword [CLOSURE + ofs + offsetof(upb_shim_strview, data)], 0
+        //|  mov   qword [CLOSURE + ofs + offsetof(upb_shim_strview, size)], 0
+        dasm_put(Dst, 2018, ofs + offsetof(upb_shim_strview, data), ofs + offsetof(upb_shim_strview, size));
+# 1120 "upb/pb/compile_decoder_x64.dasc"
+      } else if (start && op == OP_STARTSEQ &&
+                 (data = upb_shim_getarray(h, arg, &type)) &&
+                 data->wiresize == 0) {
+        // Varint arrays can't reserve from the size hint, so all the start
+        // handler would do is set the hasbit.  Fixed-width arrays take the
+        // call below, which passes the hint.
+        //|  sethas CLOSURE, data->hasbit
+         if (data->hasbit >= 0) {
+        dasm_put(Dst, 1398, ((uint32_t)data->hasbit / 8), (1 << ((uint32_t)data->hasbit % 8)));
+         }
+# 1127 "upb/pb/compile_decoder_x64.dasc"
+        if (data->hasbit < 0) {
+          // TODO: nop is only required because of asmlabel().
+          //|  nop
+          dasm_put(Dst, 1993);
+# 1130 "upb/pb/compile_decoder_x64.dasc"
+        }
+      } else if (start && op == OP_STARTSUBMSG &&
+                 (data = upb_shim_getsubmsg(h, arg))) {
+        jitsubmsgshim(jc, h, arg, data);
+        //|  mov   CLOSURE, rax
+        dasm_put(Dst, 2035);
+# 1135 "upb/pb/compile_decoder_x64.dasc"
+      } else if (start) {
         // void *startseq(void *closure, const void *hd)
         // void *startsubmsg(void *closure, const void *hd)
         // void *startstr(void *closure, const void *hd, size_t size_hint)
+        //
+        // The seq/submsg variants registered with a size hint also take
+        // "size_hint", which we only know when their frame was pushed by
+        // pushlendelim (see sizehint() in decoder.c); otherwise it is 0.
+        bool hint = op == OP_STARTSTR;
+        bool lendelim = *(jc->pc - 2) == OP_PUSHLENDELIM;
         //|1:
         //|  mov   ARG1_64, CLOSURE
         //|  load_handler_data h, arg
-        dasm_put(Dst, 1886);
+        dasm_put(Dst, 1970);
          {
          uintptr_t v = (uintptr_t)upb_handlers_gethandlerdata(h, arg);
          if (v > 0xffffffff) {
-        dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
+        dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
          } else if (v) {
-        dasm_put(Dst, 451, v);
+        dasm_put(Dst, 440, v);
          } else {
-        dasm_put(Dst, 454);
+        dasm_put(Dst, 443);
          }
          }
-# 988 "upb/pb/compile_decoder_x64.dasc"
-        if (op == OP_STARTSTR) {
+# 1148 "upb/pb/compile_decoder_x64.dasc"
+        if (op != OP_STARTSTR && upb_handlers_takessizehint(h, arg)) {
+          if (lendelim) {
+            hint = true;
+          } else {
+            //|  xor    ARG3_64, ARG3_64
+            dasm_put(Dst, 2039);
+# 1153 "upb/pb/compile_decoder_x64.dasc"
+          }
+        }
+        if (hint) {
           //|  mov    ARG3_64, DELIMEND
           //|  sub    ARG3_64, PTR
-          dasm_put(Dst, 1948);
-# 991 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 2043);
+# 1158 "upb/pb/compile_decoder_x64.dasc"
         }
         //|  callp start
-        dasm_put(Dst, 1496, (unsigned int)((uintptr_t)start), (unsigned int)(((uintptr_t)start)>>32), 0xfffffffffffffff0UL);
-# 993 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 1250, (unsigned int)((uintptr_t)start), (unsigned int)(((uintptr_t)start)>>32));
+# 1160 "upb/pb/compile_decoder_x64.dasc"
         if (!alwaysok(h, arg)) {
           //|  test  rax, rax
           //|  jnz   >2
           //|  call  ->suspend
           //|  jmp   <1
           //|2:
-          dasm_put(Dst, 1956);
-# 999 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 2051);
+# 1166 "upb/pb/compile_decoder_x64.dasc"
         }
         //|  mov   CLOSURE, rax
-        dasm_put(Dst, 1973);
-# 1001 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 2035);
+# 1168 "upb/pb/compile_decoder_x64.dasc"
       } else {
         // TODO: nop is only required because of asmlabel().
         //|  nop
-        dasm_put(Dst, 1909);
-# 1004 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 1993);
+# 1171 "upb/pb/compile_decoder_x64.dasc"
+      }
+      if (op != OP_STARTSEQ) {
+        //|  stat  fields
+        #ifdef UPB_DECODER_STATS
+        dasm_put(Dst, 1614, Dt2(->stats_.fields));
+        #endif
+# 1174 "upb/pb/compile_decoder_x64.dasc"
       }
       break;
     }
@@ -1513,35 +1767,35 @@ static void jitbytecode(jitcompiler *jc) {
         //|1:
         //|  mov   ARG1_64, CLOSURE
         //|  load_handler_data h, arg
-        dasm_put(Dst, 1886);
+        dasm_put(Dst, 1970);
          {
          uintptr_t v = (uintptr_t)upb_handlers_gethandlerdata(h, arg);
          if (v > 0xffffffff) {
-        dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
+        dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
          } else if (v) {
-        dasm_put(Dst, 451, v);
+        dasm_put(Dst, 440, v);
          } else {
-        dasm_put(Dst, 454);
+        dasm_put(Dst, 443);
          }
          }
-# 1018 "upb/pb/compile_decoder_x64.dasc"
+# 1188 "upb/pb/compile_decoder_x64.dasc"
         //|  callp end
-        dasm_put(Dst, 1496, (unsigned int)((uintptr_t)end), (unsigned int)(((uintptr_t)end)>>32), 0xfffffffffffffff0UL);
-# 1019 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 1250, (unsigned int)((uintptr_t)end), (unsigned int)(((uintptr_t)end)>>32));
+# 1189 "upb/pb/compile_decoder_x64.dasc"
         if (!alwaysok(h, arg)) {
           //|  test  al, al
           //|  jnz   >2
           //|  call  ->suspend
           //|  jmp   <1
           //|2:
-          dasm_put(Dst, 1893);
-# 1025 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 1977);
+# 1195 "upb/pb/compile_decoder_x64.dasc"
         }
       } else {
         // TODO: nop is only required because of asmlabel().
         //|  nop
-        dasm_put(Dst, 1909);
-# 1029 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 1993);
+# 1199 "upb/pb/compile_decoder_x64.dasc"
       }
       break;
     }
@@ -1555,50 +1809,72 @@ static void jitbytecode(jitcompiler *jc) {
       //|  call  ->suspend
       //|  jmp   <1
       //|2:
-      dasm_put(Dst, 1977);
-# 1042 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2068);
+# 1212 "upb/pb/compile_decoder_x64.dasc"
+      const upb_shim_data *view = str ? upb_shim_getstrview(h, arg) : NULL;
+      if (view) {
+        // Alias the input if this is the string's first piece, which is the
+        // common case.  Further pieces go to the shim's handler.
+        size_t ofs = view->offset;
+        //|  cmp   qword [CLOSURE + ofs + offsetof(upb_shim_strview, size)], 0
+        //|  jne   >5
+        //|  mov   [CLOSURE + ofs + offsetof(upb_shim_strview, data)], PTR
+        //|  mov   rax, DATAEND
+        //|  sub   rax, PTR
+        //|  mov   [CLOSURE + ofs + offsetof(upb_shim_strview, size)], rax
+        //|  mov   PTR, DATAEND
+        //|  jmp   >6
+        //|5:
+        dasm_put(Dst, 2095, ofs + offsetof(upb_shim_strview, size), ofs + offsetof(upb_shim_strview, data), ofs + offsetof(upb_shim_strview, size));
+# 1226 "upb/pb/compile_decoder_x64.dasc"
+      }
       if (str) {
         // size_t str(void *closure, const void *hd, const char *str, size_t n)
         //|  mov   ARG1_64, CLOSURE
         //|  load_handler_data h, arg
-        dasm_put(Dst, 1491);
+        dasm_put(Dst, 1245);
          {
          uintptr_t v = (uintptr_t)upb_handlers_gethandlerdata(h, arg);
          if (v > 0xffffffff) {
-        dasm_put(Dst, 446, (unsigned int)(v), (unsigned int)((v)>>32));
+        dasm_put(Dst, 435, (unsigned int)(v), (unsigned int)((v)>>32));
          } else if (v) {
-        dasm_put(Dst, 451, v);
+        dasm_put(Dst, 440, v);
          } else {
-        dasm_put(Dst, 454);
+        dasm_put(Dst, 443);
          }
          }
-# 1046 "upb/pb/compile_decoder_x64.dasc"
+# 1231 "upb/pb/compile_decoder_x64.dasc"
         //|  mov   ARG3_64, PTR
         //|  mov   ARG4_64, DATAEND
         //|  sub   ARG4_64, PTR
         //|  mov   ARG5_64, qword DECODER->handle
         //|  callp str
         //|  add   PTR, rax
-        dasm_put(Dst, 2004, Dt2(->handle), (unsigned int)((uintptr_t)str), (unsigned int)(((uintptr_t)str)>>32), 0xfffffffffffffff0UL);
-# 1052 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 2128, Dt2(->handle), (unsigned int)((uintptr_t)str), (unsigned int)(((uintptr_t)str)>>32));
+# 1237 "upb/pb/compile_decoder_x64.dasc"
         if (!alwaysok(h, arg)) {
           //|  cmp   PTR, DATAEND
           //|  je    >3
           //|  call  ->strret_fallback
           //|3:
-          dasm_put(Dst, 2042);
-# 1057 "upb/pb/compile_decoder_x64.dasc"
+          dasm_put(Dst, 2152);
+# 1242 "upb/pb/compile_decoder_x64.dasc"
         }
       } else {
         //|  mov   PTR, DATAEND
-        dasm_put(Dst, 2055);
-# 1060 "upb/pb/compile_decoder_x64.dasc"
+        dasm_put(Dst, 2165);
+# 1245 "upb/pb/compile_decoder_x64.dasc"
+      }
+      if (view) {
+        //|6:
+        dasm_put(Dst, 1577);
+# 1248 "upb/pb/compile_decoder_x64.dasc"
       }
       //|  cmp   PTR, DELIMEND
       //|  jne   <1
       //|4:
-      dasm_put(Dst, 2059);
-# 1064 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2169);
+# 1252 "upb/pb/compile_decoder_x64.dasc"
       break;
     }
     case OP_PUSHTAGDELIM:
@@ -1613,19 +1889,19 @@ static void jitbytecode(jitcompiler *jc) {
       //|  cmp   FRAME, DECODER->limit
       //|  je    ->err
       //|  mov   dword FRAME->groupnum, arg
-      dasm_put(Dst, 2070, Dt1(->sink.closure), Dt1(->end_ofs), sizeof(upb_pbdecoder_frame), Dt2(->limit), Dt1(->groupnum), arg);
-# 1078 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2180, Dt1(->sink.closure), Dt1(->end_ofs), sizeof(upb_pbdecoder_frame), Dt2(->limit), Dt1(->groupnum), arg);
+# 1266 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_PUSHLENDELIM:
       //|  call  ->pushlendelim
-      dasm_put(Dst, 2100);
-# 1081 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2210);
+# 1269 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_POP:
       //|  sub   FRAME, sizeof(upb_pbdecoder_frame)
       //|  mov   CLOSURE, FRAME->sink.closure
-      dasm_put(Dst, 2104, sizeof(upb_pbdecoder_frame), Dt1(->sink.closure));
-# 1085 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2214, sizeof(upb_pbdecoder_frame), Dt1(->sink.closure));
+# 1273 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_SETDELIM:
       // OPT: experiment with testing vs old offset to optimize away.
@@ -1637,36 +1913,36 @@ static void jitbytecode(jitcompiler *jc) {
       //|  ja    >1   // OPT: try cmov.
       //|  mov   DATAEND, DELIMEND
       //|1:
-      dasm_put(Dst, 2114, Dt2(->end), Dt1(->end_ofs), Dt2(->buf));
-# 1096 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2224, Dt2(->end), Dt1(->end_ofs), Dt2(->buf));
+# 1284 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_SETBIGGROUPNUM:
       //|  mov   dword FRAME->groupnum, *jc->pc++
-      dasm_put(Dst, 2094, Dt1(->groupnum), *jc->pc++);
-# 1099 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2204, Dt1(->groupnum), *jc->pc++);
+# 1287 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_CHECKDELIM:
       //|  cmp  DELIMEND, PTR
       //|  je   =>jmptarget(jc, jc->pc + longofs)
-      dasm_put(Dst, 2144, jmptarget(jc, jc->pc + longofs));
-# 1103 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2254, jmptarget(jc, jc->pc + longofs));
+# 1291 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_CALL:
       //|  call =>jmptarget(jc, jc->pc + longofs)
-      dasm_put(Dst, 2151, jmptarget(jc, jc->pc + longofs));
-# 1106 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2261, jmptarget(jc, jc->pc + longofs));
+# 1294 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_BRANCH:
       //|  jmp  =>jmptarget(jc, jc->pc + longofs);
-      dasm_put(Dst, 1873, jmptarget(jc, jc->pc + longofs));
-# 1109 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 1957, jmptarget(jc, jc->pc + longofs));
+# 1297 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_RET:
       //|9:
       //|  add  rsp, 8
       //|  ret
-      dasm_put(Dst, 2154);
-# 1114 "upb/pb/compile_decoder_x64.dasc"
+      dasm_put(Dst, 2264);
+# 1302 "upb/pb/compile_decoder_x64.dasc"
       break;
     case OP_TAG1:
       jittag(jc, (arg >> 8) & 0xff, 1, (int8_t)arg, method);
@@ -1687,6 +1963,6 @@ static void jitbytecode(jitcompiler *jc) {
 
   asmlabel(jc, "eof");
   //|  nop
-  dasm_put(Dst, 1909);
-# 1134 "upb/pb/compile_decoder_x64.dasc"
+  dasm_put(Dst, 1993);
+# 1322 "upb/pb/compile_decoder_x64.dasc"
 }
@@ -0,0 +1,81 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * Driver code for the x64 JIT of SerializerMethods.  Unlike the decoder's JIT
+ * (compile_decoder_x64.c) there is no bytecode to translate and no code
+ * shared between methods, so each method simply gets its own mapping.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "upb/pb/encoder.int.h"
+#include "upb/pb/varint.int.h"
+#include "upb/shim/shim.h"
+
+// These defines are necessary for DynASM codegen.
+// See dynasm/dasm_proto.h for more info.
+#define Dst_DECL dasm_State **dasm
+#define Dst_REF (*dasm)
+#define Dst (&jc->dynasm)
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+typedef struct {
+  // This pointer is allocated by dasm_init() and freed by dasm_free().
+  struct dasm_State *dynasm;
+
+  // Used by DynASM to store globals.
+  void **globals;
+} jitcompiler;
+
+// The DynASM runtime itself is compiled into compile_decoder_x64.c, which
+// uses the same Dst_DECL and Dst_REF.
+#include "dynasm/dasm_proto.h"
+#include "upb/pb/compile_encoder_x64.h"
+
+void upb_pb_serializermethod_jit(upb_pb_serializermethod *m) {
+  jitcompiler jc_storage;
+  jitcompiler *jc = &jc_storage;
+  jc->globals = malloc(UPB_SJIT_GLOBAL__MAX * sizeof(*jc->globals));
+  if (!jc->globals) return;  // Stay interpreted.
+
+  dasm_init(Dst, 1);
+  dasm_setupglobal(Dst, jc->globals, UPB_SJIT_GLOBAL__MAX);
+  dasm_setup(Dst, upb_sjit_actionlist);
+
+  emit(jc, m);
+
+  size_t size;
+  int dasm_status = dasm_link(Dst, &size);
+  UPB_ASSERT_VAR(dasm_status, dasm_status == DASM_S_OK);
+
+  char *code = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  if (code == MAP_FAILED) goto done;  // Stay interpreted.
+
+  // dasm_encode() fills in the globals with their addresses in "code".
+  dasm_encode(Dst, code);
+  if (mprotect(code, size, PROT_EXEC | PROT_READ) != 0) {
+    munmap(code, size);
+    goto done;
+  }
+
+  m->jit_code = code;
+  m->jit_size = size;
+  m->jit_measure = (upb_pb_jitmeasure*)jc->globals[UPB_SJIT_GLOBAL_measure];
+  m->jit_write = (upb_pb_jitwrite*)jc->globals[UPB_SJIT_GLOBAL_write];
+
+done:
+  dasm_free(Dst);
+  free(jc->globals);
+}
+
+void upb_pb_serializermethod_freejit(upb_pb_serializermethod *m) {
+  if (m->jit_code) munmap(m->jit_code, m->jit_size);
+}
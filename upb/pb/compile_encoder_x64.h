@@ -0,0 +1,633 @@
+/*
+** This file has been pre-processed with DynASM.
+** http://luajit.org/dynasm.html
+** DynASM version 1.3.0, DynASM x64 version 1.3.0
+** DO NOT EDIT! The original file is in "upb/pb/compile_encoder_x64.dasc".
+*/
+
+#if DASM_VERSION != 10300
+#error "Version mismatch between DynASM and included encoding engine"
+#endif
+
+# 1 "upb/pb/compile_encoder_x64.dasc"
+//|//
+//|// upb - a minimalist implementation of protocol buffers.
+//|//
+//|// Copyright (c) 2014 Google Inc.  See LICENSE for details.
+//|//
+//|// JIT compiler for upb_pb_serializer on x86-64.  Generates machine code for
+//|// the two passes of a SerializerMethod from its list of sfields (see
+//|// encoder.int.h).  Scalars and strings are inlined; arrays and submessages
+//|// call back into the same per-field code that the interpreter uses.
+//|
+//|.arch x64
+//|.actionlist upb_sjit_actionlist
+static const unsigned char upb_sjit_actionlist[491] = {
+  65,198,69,0,235,255,102,65,199,69,0,236,255,102,65,199,69,0,236,65,198,133,
+  233,235,255,65,199,69,0,237,255,65,199,69,0,237,65,198,133,233,235,255,73,
+  129,197,239,255,248,10,255,83,65,84,65,85,65,86,65,87,72,131,252,236,16,73,
+  137,252,252,72,137,252,243,65,137,213,73,137,207,77,49,252,246,255,252,246,
+  131,233,235,255,72,139,131,233,72,133,192,255,139,131,233,141,12,0,193,252,
+  248,31,49,200,255,139,131,233,255,72,99,131,233,255,72,139,131,233,255,72,
+  141,12,0,72,193,252,248,63,72,49,200,255,15,182,131,233,255,15,132,244,249,
+  255,73,129,198,239,255,73,129,198,239,72,137,193,72,131,201,1,72,15,189,201,
+  107,201,9,131,193,73,193,252,233,6,73,1,206,255,248,3,255,15,132,244,249,
+  72,139,131,233,77,141,180,253,6,233,72,137,193,72,131,201,1,72,15,189,201,
+  107,201,9,131,193,73,193,252,233,6,73,1,206,248,3,255,76,137,52,36,76,137,
+  231,72,190,237,237,72,137,218,68,137,252,233,73,137,224,72,184,237,237,252,
+  255,208,132,192,15,132,244,255,76,139,52,36,255,77,137,55,184,1,0,0,0,252,
+  233,244,254,248,9,49,192,248,8,72,131,196,16,65,95,65,94,65,93,65,92,91,195,
+  255,248,11,255,83,65,84,65,85,73,137,252,252,72,137,252,243,73,137,213,255,
+  139,131,233,65,137,69,0,73,131,197,4,255,72,139,131,233,73,137,69,0,73,131,
+  197,8,255,248,1,72,131,252,248,127,15,134,244,248,137,193,128,201,128,65,
+  136,77,0,73,131,197,1,72,193,232,7,252,233,244,1,248,2,65,136,69,0,73,131,
+  197,1,255,72,139,131,233,248,1,72,131,252,248,127,15,134,244,248,137,193,
+  128,201,128,65,136,77,0,73,131,197,1,72,193,232,7,252,233,244,1,248,2,65,
+  136,69,0,73,131,197,1,76,137,252,239,72,139,179,233,72,139,147,233,73,1,213,
+  72,184,237,237,252,255,208,248,3,255,76,137,231,72,190,237,237,72,137,218,
+  76,137,252,233,72,184,237,237,252,255,208,73,137,197,255,76,137,232,65,93,
+  65,92,91,195,255
+};
+
+# 13 "upb/pb/compile_encoder_x64.dasc"
+//|.globals UPB_SJIT_GLOBAL_
+enum {
+  UPB_SJIT_GLOBAL_measure,
+  UPB_SJIT_GLOBAL_write,
+  UPB_SJIT_GLOBAL__MAX
+};
+# 14 "upb/pb/compile_encoder_x64.dasc"
+//|
+//|// Calling conventions.  Note -- this will need to be changed for
+//|// Windows, which uses a different calling convention!
+//|.define ARG1_64,   rdi
+//|.define ARG2_64,   rsi
+//|.define ARG3_64,   rdx
+//|.define ARG4_32,   ecx
+//|.define ARG4_64,   rcx
+//|.define ARG5_64,   r8
+//|
+//|// Register allocation; the same in both passes except where noted.  These
+//|// are all callee-save, so they survive calls to C.
+//|.define STATE,     r12   // upb_pb_measurestate* or upb_pb_writestate*.
+//|.define MSG,       rbx   // The struct being serialized.
+//|.define DEPTH,     r13d  // measure(): nesting depth of MSG.
+//|.define TOTAL,     r14   // measure(): bytes measured so far.
+//|.define SIZEPTR,   r15   // measure(): where the total goes at the end.
+//|.define OUT,       r13   // write(): where the next byte goes.
+//|
+//| // Calls an external C function at address "addr"; rsp must be aligned.
+//|.macro callp, addr
+//|  mov64  rax, (uintptr_t)addr
+//|  call   rax
+//|.endmacro
+//|
+//| // Sets ZF if "f" is not set in MSG.  Only for scalars and strings, which
+//| // are either tested by hasbit or by their value.  Clobbers rax.
+//|.macro chkset, f
+//|| if (f->hasbit >= 0) {
+//|  test   byte [MSG + ((uint32_t)f->hasbit / 8)], (1 << ((uint32_t)f->hasbit % 8))
+//|| } else if (f->kind == SFIELD_STRING) {
+//|  mov    rax, [MSG + f->offset + offsetof(upb_shim_strview, size)]
+//|  test   rax, rax
+//|| } else {
+//|  ldval  f
+//|  test   rax, rax
+//|| }
+//|.endmacro
+//|
+//| // Loads the value of scalar "f" into rax as it goes on the wire, like
+//| // wireval() in encoder.c.  Clobbers rcx.
+//|.macro ldval, f
+//|| switch (f->ctype) {
+//|| case UPB_TYPE_INT32:
+//|| case UPB_TYPE_ENUM:
+//||   if (f->type == UPB_DESCRIPTOR_TYPE_SINT32) {
+//|  mov    eax, dword [MSG + f->offset]
+//|  lea    ecx, [rax + rax]
+//|  sar    eax, 31
+//|  xor    eax, ecx
+//||   } else if (f->type == UPB_DESCRIPTOR_TYPE_SFIXED32) {
+//|  mov    eax, dword [MSG + f->offset]
+//||   } else {
+//|  movsxd rax, dword [MSG + f->offset]
+//||   }
+//||   break;
+//|| case UPB_TYPE_INT64:
+//|  mov    rax, qword [MSG + f->offset]
+//||   if (f->type == UPB_DESCRIPTOR_TYPE_SINT64) {
+//|  lea    rcx, [rax + rax]
+//|  sar    rax, 63
+//|  xor    rax, rcx
+//||   }
+//||   break;
+//|| case UPB_TYPE_UINT32:
+//|| case UPB_TYPE_FLOAT:
+//|  mov    eax, dword [MSG + f->offset]
+//||   break;
+//|| case UPB_TYPE_UINT64:
+//|| case UPB_TYPE_DOUBLE:
+//|  mov    rax, qword [MSG + f->offset]
+//||   break;
+//|| case UPB_TYPE_BOOL:
+//|  movzx  eax, byte [MSG + f->offset]
+//||   break;
+//|| default:
+//||   assert(false);
+//|| }
+//|.endmacro
+//|
+//| // Adds upb_varint_size(rax) to TOTAL: the varint has one byte for every 7
+//| // significant bits, and (bits * 9 + 73) / 64 computes that for 1..64 bits
+//| // without a division.  Clobbers rcx.
+//|.macro addvarintsize
+//|  mov    rcx, rax
+//|  or     rcx, 1
+//|  bsr    rcx, rcx
+//|  imul   ecx, ecx, 9
+//|  add    ecx, 73
+//|  shr    ecx, 6
+//|  add    TOTAL, rcx
+//|.endmacro
+//|
+//| // Writes the varint in rax at OUT.  Clobbers rax and rcx.
+//|.macro putvarint
+//|1:
+//|  cmp    rax, 0x7f
+//|  jbe    >2
+//|  mov    ecx, eax
+//|  or     cl, 0x80
+//|  mov    byte [OUT], cl
+//|  add    OUT, 1
+//|  shr    rax, 7
+//|  jmp    <1
+//|2:
+//|  mov    byte [OUT], al
+//|  add    OUT, 1
+//|.endmacro
+
+// Returns "len" bytes of "tag" as a little-endian integer.
+static uint32_t tagbytes(const char *tag, size_t len) {
+  uint32_t ret = 0;
+  memcpy(&ret, tag, len);
+  return ret;
+}
+
+// Writes the "len" (1 to 5) bytes of "tag" at OUT with immediate stores.  We
+// can't store more bytes than that, since the tag may be the last thing in
+// the buffer.
+static void puttag(jitcompiler *jc, const char *tag, size_t len) {
+  uint32_t lo = tagbytes(tag, len < 4 ? len : 4);
+  switch (len) {
+    case 1:
+      //|  mov    byte [OUT], lo
+      dasm_put(Dst, 0, lo);
+# 138 "upb/pb/compile_encoder_x64.dasc"
+      break;
+    case 2:
+      //|  mov    word [OUT], lo
+      dasm_put(Dst, 6, lo);
+# 141 "upb/pb/compile_encoder_x64.dasc"
+      break;
+    case 3:
+      //|  mov    word [OUT], (lo & 0xffff)
+      //|  mov    byte [OUT + 2], (lo >> 16)
+      dasm_put(Dst, 13, (lo & 0xffff), 2, (lo >> 16));
+# 145 "upb/pb/compile_encoder_x64.dasc"
+      break;
+    case 4:
+      //|  mov    dword [OUT], lo
+      dasm_put(Dst, 25, lo);
+# 148 "upb/pb/compile_encoder_x64.dasc"
+      break;
+    case 5:
+      //|  mov    dword [OUT], lo
+      //|  mov    byte [OUT + 4], (uint8_t)tag[4]
+      dasm_put(Dst, 31, lo, 4, (uint8_t)tag[4]);
+# 152 "upb/pb/compile_encoder_x64.dasc"
+      break;
+    default:
+      assert(false);
+  }
+  //|  add    OUT, len
+  dasm_put(Dst, 42, len);
+# 157 "upb/pb/compile_encoder_x64.dasc"
+}
+
+// Returns 4 or 8 for fixed-width types, 0 for varints.
+static size_t jit_fixedsize(const sfield *f) {
+  switch (upb_pb_native_wire_types[f->type]) {
+    case UPB_WIRE_TYPE_32BIT: return 4;
+    case UPB_WIRE_TYPE_64BIT: return 8;
+    default: return 0;
+  }
+}
+
+// bool measure(upb_pb_measurestate *ms, const char *msg, int depth,
+//              size_t *size);
+static void emit_measure(jitcompiler *jc, const upb_pb_serializermethod *m) {
+  //|->measure:
+  dasm_put(Dst, 47);
+# 172 "upb/pb/compile_encoder_x64.dasc"
+  // Five pushes after the return address leave rsp aligned, and [rsp] is
+  // where we keep TOTAL while calling C.
+  //|  push   rbx
+  //|  push   r12
+  //|  push   r13
+  //|  push   r14
+  //|  push   r15
+  //|  sub    rsp, 16
+  //|  mov    STATE, ARG1_64
+  //|  mov    MSG, ARG2_64
+  //|  mov    DEPTH, edx
+  //|  mov    SIZEPTR, ARG4_64
+  //|  xor    TOTAL, TOTAL
+  dasm_put(Dst, 50);
+# 185 "upb/pb/compile_encoder_x64.dasc"
+
+  const sfield *f;
+  for (f = m->fields; f < m->fields + m->nfields; f++) {
+    switch (f->kind) {
+      case SFIELD_SCALAR: {
+        size_t fixed = jit_fixedsize(f);
+        //|  chkset f
+         if (f->hasbit >= 0) {
+        dasm_put(Dst, 83, ((uint32_t)f->hasbit / 8), (1 << ((uint32_t)f->hasbit % 8)));
+         } else if (f->kind == SFIELD_STRING) {
+        dasm_put(Dst, 89, f->offset + offsetof(upb_shim_strview, size));
+         } else {
+         switch (f->ctype) {
+         case UPB_TYPE_INT32:
+         case UPB_TYPE_ENUM:
+           if (f->type == UPB_DESCRIPTOR_TYPE_SINT32) {
+        dasm_put(Dst, 97, f->offset);
+           } else if (f->type == UPB_DESCRIPTOR_TYPE_SFIXED32) {
+        dasm_put(Dst, 110, f->offset);
+           } else {
+        dasm_put(Dst, 114, f->offset);
+           }
+           break;
+         case UPB_TYPE_INT64:
+        dasm_put(Dst, 119, f->offset);
+           if (f->type == UPB_DESCRIPTOR_TYPE_SINT64) {
+        dasm_put(Dst, 124);
+           }
+           break;
+         case UPB_TYPE_UINT32:
+         case UPB_TYPE_FLOAT:
+        dasm_put(Dst, 110, f->offset);
+           break;
+         case UPB_TYPE_UINT64:
+         case UPB_TYPE_DOUBLE:
+        dasm_put(Dst, 119, f->offset);
+           break;
+         case UPB_TYPE_BOOL:
+        dasm_put(Dst, 137, f->offset);
+           break;
+         default:
+           assert(false);
+         }
+        dasm_put(Dst, 93);
+         }
+# 192 "upb/pb/compile_encoder_x64.dasc"
+        //|  jz     >3
+        dasm_put(Dst, 142);
+# 193 "upb/pb/compile_encoder_x64.dasc"
+        if (fixed) {
+          //|  add    TOTAL, (f->taglen + fixed)
+          dasm_put(Dst, 147, (f->taglen + fixed));
+# 195 "upb/pb/compile_encoder_x64.dasc"
+        } else {
+          if (f->hasbit >= 0) {
+            //|  ldval  f
+             switch (f->ctype) {
+             case UPB_TYPE_INT32:
+             case UPB_TYPE_ENUM:
+               if (f->type == UPB_DESCRIPTOR_TYPE_SINT32) {
+            dasm_put(Dst, 97, f->offset);
+               } else if (f->type == UPB_DESCRIPTOR_TYPE_SFIXED32) {
+            dasm_put(Dst, 110, f->offset);
+               } else {
+            dasm_put(Dst, 114, f->offset);
+               }
+               break;
+             case UPB_TYPE_INT64:
+            dasm_put(Dst, 119, f->offset);
+               if (f->type == UPB_DESCRIPTOR_TYPE_SINT64) {
+            dasm_put(Dst, 124);
+               }
+               break;
+             case UPB_TYPE_UINT32:
+             case UPB_TYPE_FLOAT:
+            dasm_put(Dst, 110, f->offset);
+               break;
+             case UPB_TYPE_UINT64:
+             case UPB_TYPE_DOUBLE:
+            dasm_put(Dst, 119, f->offset);
+               break;
+             case UPB_TYPE_BOOL:
+            dasm_put(Dst, 137, f->offset);
+               break;
+             default:
+               assert(false);
+             }
+# 198 "upb/pb/compile_encoder_x64.dasc"
+          }
+          //|  add    TOTAL, f->taglen
+          //|  addvarintsize
+          dasm_put(Dst, 152, f->taglen);
+# 201 "upb/pb/compile_encoder_x64.dasc"
+        }
+        //|3:
+        dasm_put(Dst, 181);
+# 203 "upb/pb/compile_encoder_x64.dasc"
+        break;
+      }
+      case SFIELD_STRING:
+        //|  chkset f
+         if (f->hasbit >= 0) {
+        dasm_put(Dst, 83, ((uint32_t)f->hasbit / 8), (1 << ((uint32_t)f->hasbit % 8)));
+         } else if (f->kind == SFIELD_STRING) {
+        dasm_put(Dst, 89, f->offset + offsetof(upb_shim_strview, size));
+         } else {
+         switch (f->ctype) {
+         case UPB_TYPE_INT32:
+         case UPB_TYPE_ENUM:
+           if (f->type == UPB_DESCRIPTOR_TYPE_SINT32) {
+        dasm_put(Dst, 97, f->offset);
+           } else if (f->type == UPB_DESCRIPTOR_TYPE_SFIXED32) {
+        dasm_put(Dst, 110, f->offset);
+           } else {
+        dasm_put(Dst, 114, f->offset);
+           }
+           break;
+         case UPB_TYPE_INT64:
+        dasm_put(Dst, 119, f->offset);
+           if (f->type == UPB_DESCRIPTOR_TYPE_SINT64) {
+        dasm_put(Dst, 124);
+           }
+           break;
+         case UPB_TYPE_UINT32:
+         case UPB_TYPE_FLOAT:
+        dasm_put(Dst, 110, f->offset);
+           break;
+         case UPB_TYPE_UINT64:
+         case UPB_TYPE_DOUBLE:
+        dasm_put(Dst, 119, f->offset);
+           break;
+         case UPB_TYPE_BOOL:
+        dasm_put(Dst, 137, f->offset);
+           break;
+         default:
+           assert(false);
+         }
+        dasm_put(Dst, 93);
+         }
+# 207 "upb/pb/compile_encoder_x64.dasc"
+        //|  jz     >3
+        //|  mov    rax, [MSG + f->offset + offsetof(upb_shim_strview, size)]
+        //|  lea    TOTAL, [TOTAL + rax + f->taglen]
+        //|  addvarintsize
+        //|3:
+        dasm_put(Dst, 184, f->offset + offsetof(upb_shim_strview, size), f->taglen);
+# 212 "upb/pb/compile_encoder_x64.dasc"
+        break;
+      case SFIELD_ARRAY:
+      case SFIELD_SUBMSG:
+        //|  mov    [rsp], TOTAL
+        //|  mov    ARG1_64, STATE
+        //|  mov64  ARG2_64, (uintptr_t)f
+        //|  mov    ARG3_64, MSG
+        //|  mov    ARG4_32, DEPTH
+        //|  mov    ARG5_64, rsp
+        //|  callp  upb_pb_serializer_measurefield
+        //|  test   al, al
+        //|  jz     >9
+        //|  mov    TOTAL, [rsp]
+        dasm_put(Dst, 225, (unsigned int)((uintptr_t)f), (unsigned int)(((uintptr_t)f)>>32), (unsigned int)((uintptr_t)upb_pb_serializer_measurefield), (unsigned int)(((uintptr_t)upb_pb_serializer_measurefield)>>32));
+# 225 "upb/pb/compile_encoder_x64.dasc"
+        break;
+    }
+  }
+
+  //|  mov    [SIZEPTR], TOTAL
+  //|  mov    eax, 1
+  //|  jmp    >8
+  //|9:
+  //|  xor    eax, eax
+  //|8:
+  //|  add    rsp, 16
+  //|  pop    r15
+  //|  pop    r14
+  //|  pop    r13
+  //|  pop    r12
+  //|  pop    rbx
+  //|  ret
+  dasm_put(Dst, 264);
+# 242 "upb/pb/compile_encoder_x64.dasc"
+}
+
+// char *write(upb_pb_writestate *ws, const char *msg, char *out);
+static void emit_write(jitcompiler *jc, const upb_pb_serializermethod *m) {
+  //|->write:
+  dasm_put(Dst, 297);
+# 247 "upb/pb/compile_encoder_x64.dasc"
+  // Three pushes after the return address leave rsp aligned.
+  //|  push   rbx
+  //|  push   r12
+  //|  push   r13
+  //|  mov    STATE, ARG1_64
+  //|  mov    MSG, ARG2_64
+  //|  mov    OUT, ARG3_64
+  dasm_put(Dst, 300);
+# 254 "upb/pb/compile_encoder_x64.dasc"
+
+  const sfield *f;
+  for (f = m->fields; f < m->fields + m->nfields; f++) {
+    switch (f->kind) {
+      case SFIELD_SCALAR: {
+        size_t fixed = jit_fixedsize(f);
+        //|  chkset f
+         if (f->hasbit >= 0) {
+        dasm_put(Dst, 83, ((uint32_t)f->hasbit / 8), (1 << ((uint32_t)f->hasbit % 8)));
+         } else if (f->kind == SFIELD_STRING) {
+        dasm_put(Dst, 89, f->offset + offsetof(upb_shim_strview, size));
+         } else {
+         switch (f->ctype) {
+         case UPB_TYPE_INT32:
+         case UPB_TYPE_ENUM:
+           if (f->type == UPB_DESCRIPTOR_TYPE_SINT32) {
+        dasm_put(Dst, 97, f->offset);
+           } else if (f->type == UPB_DESCRIPTOR_TYPE_SFIXED32) {
+        dasm_put(Dst, 110, f->offset);
+           } else {
+        dasm_put(Dst, 114, f->offset);
+           }
+           break;
+         case UPB_TYPE_INT64:
+        dasm_put(Dst, 119, f->offset);
+           if (f->type == UPB_DESCRIPTOR_TYPE_SINT64) {
+        dasm_put(Dst, 124);
+           }
+           break;
+         case UPB_TYPE_UINT32:
+         case UPB_TYPE_FLOAT:
+        dasm_put(Dst, 110, f->offset);
+           break;
+         case UPB_TYPE_UINT64:
+         case UPB_TYPE_DOUBLE:
+        dasm_put(Dst, 119, f->offset);
+           break;
+         case UPB_TYPE_BOOL:
+        dasm_put(Dst, 137, f->offset);
+           break;
+         default:
+           assert(false);
+         }
+        dasm_put(Dst, 93);
+         }
+# 261 "upb/pb/compile_encoder_x64.dasc"
+        //|  jz     >3
+        dasm_put(Dst, 142);
+# 262 "upb/pb/compile_encoder_x64.dasc"
+        puttag(jc, f->tag, f->taglen);
+        if (fixed == 4) {
+          //|  mov    eax, dword [MSG + f->offset]
+          //|  mov    dword [OUT], eax
+          //|  add    OUT, 4
+          dasm_put(Dst, 317, f->offset);
+# 267 "upb/pb/compile_encoder_x64.dasc"
+        } else if (fixed == 8) {
+          //|  mov    rax, qword [MSG + f->offset]
+          //|  mov    qword [OUT], rax
+          //|  add    OUT, 8
+          dasm_put(Dst, 329, f->offset);
+# 271 "upb/pb/compile_encoder_x64.dasc"
+        } else {
+          if (f->hasbit >= 0) {
+            //|  ldval  f
+             switch (f->ctype) {
+             case UPB_TYPE_INT32:
+             case UPB_TYPE_ENUM:
+               if (f->type == UPB_DESCRIPTOR_TYPE_SINT32) {
+            dasm_put(Dst, 97, f->offset);
+               } else if (f->type == UPB_DESCRIPTOR_TYPE_SFIXED32) {
+            dasm_put(Dst, 110, f->offset);
+               } else {
+            dasm_put(Dst, 114, f->offset);
+               }
+               break;
+             case UPB_TYPE_INT64:
+            dasm_put(Dst, 119, f->offset);
+               if (f->type == UPB_DESCRIPTOR_TYPE_SINT64) {
+            dasm_put(Dst, 124);
+               }
+               break;
+             case UPB_TYPE_UINT32:
+             case UPB_TYPE_FLOAT:
+            dasm_put(Dst, 110, f->offset);
+               break;
+             case UPB_TYPE_UINT64:
+             case UPB_TYPE_DOUBLE:
+            dasm_put(Dst, 119, f->offset);
+               break;
+             case UPB_TYPE_BOOL:
+            dasm_put(Dst, 137, f->offset);
+               break;
+             default:
+               assert(false);
+             }
+# 274 "upb/pb/compile_encoder_x64.dasc"
+          }
+          //|  putvarint
+          dasm_put(Dst, 342);
+# 276 "upb/pb/compile_encoder_x64.dasc"
+        }
+        //|3:
+        dasm_put(Dst, 181);
+# 278 "upb/pb/compile_encoder_x64.dasc"
+        break;
+      }
+      case SFIELD_STRING:
+        //|  chkset f
+         if (f->hasbit >= 0) {
+        dasm_put(Dst, 83, ((uint32_t)f->hasbit / 8), (1 << ((uint32_t)f->hasbit % 8)));
+         } else if (f->kind == SFIELD_STRING) {
+        dasm_put(Dst, 89, f->offset + offsetof(upb_shim_strview, size));
+         } else {
+         switch (f->ctype) {
+         case UPB_TYPE_INT32:
+         case UPB_TYPE_ENUM:
+           if (f->type == UPB_DESCRIPTOR_TYPE_SINT32) {
+        dasm_put(Dst, 97, f->offset);
+           } else if (f->type == UPB_DESCRIPTOR_TYPE_SFIXED32) {
+        dasm_put(Dst, 110, f->offset);
+           } else {
+        dasm_put(Dst, 114, f->offset);
+           }
+           break;
+         case UPB_TYPE_INT64:
+        dasm_put(Dst, 119, f->offset);
+           if (f->type == UPB_DESCRIPTOR_TYPE_SINT64) {
+        dasm_put(Dst, 124);
+           }
+           break;
+         case UPB_TYPE_UINT32:
+         case UPB_TYPE_FLOAT:
+        dasm_put(Dst, 110, f->offset);
+           break;
+         case UPB_TYPE_UINT64:
+         case UPB_TYPE_DOUBLE:
+        dasm_put(Dst, 119, f->offset);
+           break;
+         case UPB_TYPE_BOOL:
+        dasm_put(Dst, 137, f->offset);
+           break;
+         default:
+           assert(false);
+         }
+        dasm_put(Dst, 93);
+         }
+# 282 "upb/pb/compile_encoder_x64.dasc"
+        //|  jz     >3
+        dasm_put(Dst, 142);
+# 283 "upb/pb/compile_encoder_x64.dasc"
+        puttag(jc, f->tag, f->taglen);
+        //|  mov    rax, [MSG + f->offset + offsetof(upb_shim_strview, size)]
+        //|  putvarint
+        //|  mov    ARG1_64, OUT
+        //|  mov    ARG2_64, [MSG + f->offset + offsetof(upb_shim_strview, data)]
+        //|  mov    ARG3_64, [MSG + f->offset + offsetof(upb_shim_strview, size)]
+        //|  add    OUT, ARG3_64
+        //|  callp  memcpy
+        //|3:
+        dasm_put(Dst, 385, f->offset + offsetof(upb_shim_strview, size), f->offset + offsetof(upb_shim_strview, data), f->offset + offsetof(upb_shim_strview, size), (unsigned int)((uintptr_t)memcpy), (unsigned int)(((uintptr_t)memcpy)>>32));
+# 292 "upb/pb/compile_encoder_x64.dasc"
+        break;
+      case SFIELD_ARRAY:
+      case SFIELD_SUBMSG:
+        //|  mov    ARG1_64, STATE
+        //|  mov64  ARG2_64, (uintptr_t)f
+        //|  mov    ARG3_64, MSG
+        //|  mov    ARG4_64, OUT
+        //|  callp  upb_pb_serializer_writefield
+        //|  mov    OUT, rax
+        dasm_put(Dst, 456, (unsigned int)((uintptr_t)f), (unsigned int)(((uintptr_t)f)>>32), (unsigned int)((uintptr_t)upb_pb_serializer_writefield), (unsigned int)(((uintptr_t)upb_pb_serializer_writefield)>>32));
+# 301 "upb/pb/compile_encoder_x64.dasc"
+        break;
+    }
+  }
+
+  //|  mov    rax, OUT
+  //|  pop    r13
+  //|  pop    r12
+  //|  pop    rbx
+  //|  ret
+  dasm_put(Dst, 481);
+# 310 "upb/pb/compile_encoder_x64.dasc"
+}
+
+static void emit(jitcompiler *jc, const upb_pb_serializermethod *m) {
+  emit_measure(jc, m);
+  emit_write(jc, m);
+}
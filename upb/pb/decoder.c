@@ -22,14 +22,11 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include "upb/pb/decoder.int.h"
 #include "upb/pb/varint.int.h"
 
-#ifdef UPB_DUMP_BYTECODE
-#include <stdio.h>
-#endif
-
 #define CHECK_SUSPEND(x) if (!(x)) return upb_pbdecoder_suspend(d);
 
 // Error messages that are shared between the bytecode and JIT decoders.
@@ -158,6 +155,8 @@ static void checkpoint(upb_pbdecoder *d) {
 int32_t upb_pbdecoder_resume(upb_pbdecoder *d, void *p, const char *buf,
                              size_t size, const upb_bufhandle *handle) {
   UPB_UNUSED(p);  // Useless; just for the benefit of the JIT.
+  UPB_DECODER_STAT(d, resumes, 1);
+  UPB_DECODER_STAT(d, bytes, size);
   d->buf_param = buf;
   d->size_param = size;
   d->handle = handle;
@@ -178,6 +177,7 @@ int32_t upb_pbdecoder_resume(upb_pbdecoder *d, void *p, const char *buf,
 // Suspends the decoder at the last checkpoint, without saving any residual
 // bytes.  If there are any unconsumed bytes, returns a short byte count.
 size_t upb_pbdecoder_suspend(upb_pbdecoder *d) {
+  UPB_DECODER_STAT(d, suspends, 1);
   d->pc = d->last;
   if (d->checkpoint == d->residual) {
     // Checkpoint was in residual buf; no user bytes were consumed.
@@ -201,6 +201,8 @@ size_t upb_pbdecoder_suspend(upb_pbdecoder *d) {
 static size_t suspend_save(upb_pbdecoder *d) {
   // We hit end-of-buffer before we could parse a full value.
   // Save any unconsumed bytes (if any) to the residual buffer.
+  UPB_DECODER_STAT(d, suspends, 1);
+  UPB_DECODER_STAT(d, residual_saves, 1);
   d->pc = d->last;
 
   if (d->checkpoint == d->residual) {
@@ -212,6 +214,7 @@ static size_t suspend_save(upb_pbdecoder *d) {
     }
     memcpy(d->residual_end, d->buf_param, d->size_param);
     d->residual_end += d->size_param;
+    UPB_DECODER_STAT(d, residual_bytes, d->size_param);
   } else {
     // Checkpoint was in user buf; old residual bytes not needed.
     assert(!in_residual_buf(d, d->checkpoint));
@@ -220,6 +223,7 @@ static size_t suspend_save(upb_pbdecoder *d) {
     assert(save <= sizeof(d->residual));
     memcpy(d->residual, d->ptr, save);
     d->residual_end = d->residual + save;
+    UPB_DECODER_STAT(d, residual_bytes, save);
     d->bufstart_ofs = offset(d);
   }
 
@@ -469,6 +473,10 @@ have_tag:
       return upb_pbdecoder_suspend(d);
     }
 
+    if (wire_type != UPB_WIRE_TYPE_END_GROUP) {
+      UPB_DECODER_STAT(d, unknown_fields, 1);
+    }
+
     // TODO: deliver to unknown field callback.
     switch (wire_type) {
       case UPB_WIRE_TYPE_32BIT:
@@ -563,6 +571,7 @@ static int32_t dispatch(upb_pbdecoder *d) {
   CHECK_RETURN(decode_v32(d, &tag));
   uint8_t wire_type = tag & 0x7;
   uint32_t fieldnum = tag >> 3;
+  UPB_DECODER_STAT(d, dispatch_fallbacks, 1);
 
   // Lookup tag.  Because of packed/non-packed compatibility, we have to
   // check the wire type against two possibilities.
@@ -602,6 +611,18 @@ upb_pbdecoder_frame *outer_frame(upb_pbdecoder *d) {
 }
 
 
+// Returns the size hint for the OP_STARTSEQ/OP_STARTSUBMSG being executed.
+// The compiler always emits these right after the op that pushes their frame,
+// so if that op was OP_PUSHLENDELIM (which has no argument, so its word can't
+// be confused with the operand of OP_SETBIGGROUPNUM) we know exactly how long
+// the field is.  Groups and non-packed sequences are tag-delimited, so their
+// length is unknown and we return 0.
+static size_t sizehint(const upb_pbdecoder *d) {
+  if (d->pc[-2] != OP_PUSHLENDELIM) return 0;
+  return d->top->end_ofs - offset(d);
+}
+
+
 /* The main decoding loop *****************************************************/
 
 // The main decoder VM function.  Uses traditional bytecode dispatch loop with a
@@ -624,6 +645,7 @@ size_t upb_pbdecoder_decode(void *closure, const void *hd, const char *buf,
   VMCASE(OP_PARSE_ ## type, { \
     ctype val; \
     CHECK_RETURN(decode_ ## wt(d, &val)); \
+    UPB_DECODER_STAT(d, fields, 1); \
     upb_sink_put ## name(&d->top->sink, arg, (convfunc)(val)); \
   })
 
@@ -677,14 +699,17 @@ size_t upb_pbdecoder_decode(void *closure, const void *hd, const char *buf,
       )
       VMCASE(OP_STARTSEQ,
         upb_pbdecoder_frame *outer = outer_frame(d);
-        CHECK_SUSPEND(upb_sink_startseq(&outer->sink, arg, &d->top->sink));
+        CHECK_SUSPEND(upb_sink_startseqhint(&outer->sink, arg, sizehint(d),
+                                            &d->top->sink));
       )
       VMCASE(OP_ENDSEQ,
         CHECK_SUSPEND(upb_sink_endseq(&d->top->sink, arg));
       )
       VMCASE(OP_STARTSUBMSG,
         upb_pbdecoder_frame *outer = outer_frame(d);
-        CHECK_SUSPEND(upb_sink_startsubmsg(&outer->sink, arg, &d->top->sink));
+        CHECK_SUSPEND(upb_sink_startsubmsghint(&outer->sink, arg, sizehint(d),
+                                               &d->top->sink));
+        UPB_DECODER_STAT(d, fields, 1);
       )
       VMCASE(OP_ENDSUBMSG,
         CHECK_SUSPEND(upb_sink_endsubmsg(&d->top->sink, arg));
@@ -693,6 +718,7 @@ size_t upb_pbdecoder_decode(void *closure, const void *hd, const char *buf,
         uint32_t len = d->top->end_ofs - offset(d);
         upb_pbdecoder_frame *outer = outer_frame(d);
         CHECK_SUSPEND(upb_sink_startstr(&outer->sink, arg, len, &d->top->sink));
+        UPB_DECODER_STAT(d, fields, 1);
         if (len == 0) {
           d->pc++;  // Skip OP_STRING.
         }
@@ -767,6 +793,7 @@ size_t upb_pbdecoder_decode(void *closure, const void *hd, const char *buf,
         } else {
           int8_t shortofs;
          badtag:
+          UPB_DECODER_STAT(d, tag_mispredicts, 1);
           shortofs = arg;
           if (shortofs == LABEL_DISPATCH) {
             CHECK_RETURN(dispatch(d));
@@ -808,6 +835,30 @@ size_t upb_pbdecoder_decode(void *closure, const void *hd, const char *buf,
   }
 }
 
+// Adds whatever we have counted since the last call to our method's totals.
+// Methods may be shared by decoders on different threads.
+static void flushstats(upb_pbdecoder *d) {
+#ifdef UPB_DECODER_STATS
+  // Every member of upb_pbdecoder_stats is a uint64_t.
+  uint64_t *total = (uint64_t*)&((upb_pbdecodermethod*)d->method_)->stats_;
+  uint64_t *counted = (uint64_t*)&d->stats_;
+  uint64_t *flushed = (uint64_t*)&d->flushed_stats_;
+  size_t i;
+  for (i = 0; i < sizeof(upb_pbdecoder_stats) / sizeof(uint64_t); i++) {
+    uint64_t delta = counted[i] - flushed[i];
+    if (delta == 0) continue;
+#ifdef UPB_THREAD_UNSAFE
+    total[i] += delta;
+#else
+    __sync_fetch_and_add(&total[i], delta);
+#endif
+    flushed[i] = counted[i];
+  }
+#else
+  UPB_UNUSED(d);
+#endif
+}
+
 void *upb_pbdecoder_startbc(void *closure, const void *pc, size_t size_hint) {
   upb_pbdecoder *d = closure;
   UPB_UNUSED(size_hint);
@@ -867,6 +918,8 @@ bool upb_pbdecoder_end(void *closure, const void *handler_data) {
   }
 #endif
 
+  flushstats(d);
+
   if (d->call_len != 0) {
     seterr(d, "Unexpected EOF");
     return false;
@@ -875,17 +928,69 @@ bool upb_pbdecoder_end(void *closure, const void *handler_data) {
   return true;
 }
 
+#ifdef UPB_USE_JIT_X64
+// Input handlers for methods under tiered compilation.  The choice between
+// bytecode and machine code is made when the stream starts, and every call
+// after that goes to the same code, via d->running_.
+
+void *upb_pbdecoder_starttiered(void *closure, const void *hd,
+                                size_t size_hint) {
+  upb_pbdecoder *d = closure;
+  const upb_pbdecodermethod *method = hd;
+  const upb_pbdecodermethod *jit = upb_pbdecoder_tierup(method);
+  if (jit) {
+    d->running_ = jit;
+    return upb_pbdecoder_startjit(closure, NULL, size_hint);
+  } else {
+    d->running_ = method;
+    return upb_pbdecoder_startbc(closure, method->code_base.ptr, size_hint);
+  }
+}
+
+size_t upb_pbdecoder_decodetiered(void *closure, const void *hd,
+                                  const char *buf, size_t size,
+                                  const upb_bufhandle *handle) {
+  UPB_UNUSED(hd);
+  upb_pbdecoder *d = closure;
+  const upb_pbdecodermethod *method = d->running_;
+  const mgroup *group = (const mgroup*)method->group;
+  if (group->jit_code) {
+    return group->jit_code(closure, method->code_base.ptr, buf, size, handle);
+  } else {
+    return upb_pbdecoder_decode(closure, group, buf, size, handle);
+  }
+}
+
+bool upb_pbdecoder_endtiered(void *closure, const void *hd) {
+  upb_pbdecoder *d = closure;
+  const upb_pbdecodermethod *method = hd;
+  uint64_t *bytes = &method->tier_->bytes;
+#ifdef UPB_THREAD_UNSAFE
+  *bytes += offset(d);
+#else
+  __sync_fetch_and_add(bytes, offset(d));
+#endif
+  return upb_pbdecoder_end(closure, d->running_);
+}
+#endif
+
 void upb_pbdecoder_init(upb_pbdecoder *d, const upb_pbdecodermethod *m,
                         upb_status *s) {
   d->limit = &d->stack[UPB_DECODER_MAX_NESTING];
   upb_bytessink_reset(&d->input_, &m->input_handler_, d);
   d->method_ = m;
+#ifdef UPB_USE_JIT_X64
+  d->running_ = m;
+#endif
   d->callstack[0] = &halt;
   d->status = s;
+  memset(&d->stats_, 0, sizeof(d->stats_));
+  memset(&d->flushed_stats_, 0, sizeof(d->flushed_stats_));
   upb_pbdecoder_reset(d);
 }
 
 void upb_pbdecoder_reset(upb_pbdecoder *d) {
+  flushstats(d);
   d->top = d->stack;
   d->top->end_ofs = UINT64_MAX;
   d->top->groupnum = 0;
@@ -904,7 +1009,32 @@ uint64_t upb_pbdecoder_bytesparsed(const upb_pbdecoder *d) {
 // Not currently required, but to support outgrowing the static stack we need
 // this.
 void upb_pbdecoder_uninit(upb_pbdecoder *d) {
-  UPB_UNUSED(d);
+  flushstats(d);
+}
+
+const upb_pbdecoder_stats *upb_pbdecoder_getstats(const upb_pbdecoder *d) {
+  return &d->stats_;
+}
+
+bool upb_pbdecoder_hasstats(void) {
+#ifdef UPB_DECODER_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+size_t upb_pbdecoder_printstats(const upb_pbdecoder_stats *s, char *buf,
+                                size_t len) {
+  return snprintf(buf, len,
+                  "bytes=%" PRIu64 " fields=%" PRIu64
+                  " dispatch_fallbacks=%" PRIu64 " tag_mispredicts=%" PRIu64
+                  " suspends=%" PRIu64 " resumes=%" PRIu64
+                  " residual_saves=%" PRIu64 " residual_bytes=%" PRIu64
+                  " unknown_fields=%" PRIu64,
+                  s->bytes, s->fields, s->dispatch_fallbacks,
+                  s->tag_mispredicts, s->suspends, s->resumes,
+                  s->residual_saves, s->residual_bytes, s->unknown_fields);
 }
 
 const upb_pbdecodermethod *upb_pbdecoder_method(const upb_pbdecoder *d) {
@@ -37,6 +37,9 @@ UPB_DECLARE_TYPE(upb::pb::Decoder, upb_pbdecoder);
 UPB_DECLARE_TYPE(upb::pb::DecoderMethod, upb_pbdecodermethod);
 UPB_DECLARE_TYPE(upb::pb::DecoderMethodOptions, upb_pbdecodermethodopts);
 
+// Internal; see decoder.int.h.
+struct upb_pbdecoder_tier;
+
 // The maximum that any submessages can be nested.  Matches proto2's limit.
 // This specifies the size of the decoder's statically-sized array and therefore
 // setting it high will cause the upb::pb::Decoder object to be larger.
@@ -47,6 +50,31 @@ UPB_DECLARE_TYPE(upb::pb::DecoderMethodOptions, upb_pbdecodermethodopts);
 // the ability to set a custom memory allocation function.
 #define UPB_DECODER_MAX_NESTING 64
 
+// Counters for finding out where decoding time goes.  These are only updated
+// if upb was compiled with -DUPB_DECODER_STATS; otherwise the code to update
+// them isn't even compiled in, and they always read as zero.
+//
+// The JIT keeps the same counters as the interpreter, but it doesn't always
+// check for the expected tag at the same points, so tag_mispredicts can differ
+// between the two for the same input.
+//
+// A value that straddles two buffers may be parsed again after the decoder
+// resumes, so counts can be slightly high when input arrives in small pieces.
+typedef struct {
+  uint64_t bytes;               // Bytes of input passed to the decoder.
+  uint64_t fields;              // Values decoded; each array element counts.
+  uint64_t dispatch_fallbacks;  // Tags that were looked up in the dispatch
+                                // table because they weren't the expected one.
+  uint64_t tag_mispredicts;     // Checks for the expected next tag that failed.
+  uint64_t suspends;            // Times the decoder stopped to wait for more
+                                // input (or because a handler asked it to).
+  uint64_t resumes;             // Calls into the decoder with a new buffer.
+  uint64_t residual_saves;      // Times a partial value was saved to be
+                                // completed by the next buffer...
+  uint64_t residual_bytes;      // ...and the number of bytes that were saved.
+  uint64_t unknown_fields;      // Unknown fields that were skipped.
+} upb_pbdecoder_stats;
+
 // Internal-only struct used by the decoder.
 typedef struct {
  UPB_PRIVATE_FOR_CPP
@@ -110,9 +138,16 @@ UPB_DEFINE_CLASS1(upb::pb::DecoderMethod, upb::RefCounted,
   // The input handlers for this decoder method.
   const BytesHandler* input_handler() const;
 
-  // Whether this method is native.
+  // Whether this method is native.  Under tiered compilation this becomes true
+  // once the method has been JIT-compiled.
   bool is_native() const;
 
+  // Copies the totals of the counters of all decoders that have used this
+  // method into "stats".  A decoder adds its counters to these totals when it
+  // reaches the end of a stream, is reset, or is destroyed.  See
+  // upb_pbdecoder_stats.
+  void GetStats(upb_pbdecoder_stats* stats) const;
+
   // Convenience method for generating a DecoderMethod without explicitly
   // creating a CodeCache.
   static reffed_ptr<const DecoderMethod> New(const DecoderMethodOptions& opts);
@@ -150,6 +185,17 @@ UPB_DEFINE_STRUCT(upb_pbdecodermethod, upb_refcounted,
   // field number that wasn't the one we were expecting to see.  See
   // decoder.int.h for the layout of this table.
   upb_inttable dispatch;
+
+  // Totals of the decoders' counters.  Updated atomically by decoders, even
+  // though the method is otherwise immutable once created.
+  upb_pbdecoder_stats stats_;
+
+#ifdef UPB_USE_JIT_X64
+  // If this method runs bytecode until it is hot enough to be JIT-compiled,
+  // its counters and (once compiled) its JIT-compiled counterpart.  See
+  // CodeCache::set_tiered().
+  struct upb_pbdecoder_tier *tier_;
+#endif
 ));
 
 // A Decoder receives binary protobuf data on its input sink and pushes the
@@ -190,6 +236,13 @@ UPB_DEFINE_CLASS0(upb::pb::Decoder,
   // The sink on which this decoder receives input.
   BytesSink* input();
 
+  // This decoder's counters, accumulated since it was created.  See
+  // upb_pbdecoder_stats.
+  const upb_pbdecoder_stats* stats() const;
+
+  // Whether upb was compiled with counters enabled.
+  static bool HasStats();
+
  private:
   UPB_DISALLOW_COPY_AND_ASSIGN(Decoder);
 ,
@@ -237,6 +290,11 @@ UPB_DEFINE_STRUCT0(upb_pbdecoder, UPB_QUOTE(
 
   upb_status *status;
 
+  // Our counters, and the part of them that has been added to method_'s
+  // totals already.
+  upb_pbdecoder_stats stats_;
+  upb_pbdecoder_stats flushed_stats_;
+
   // Our internal stack.
   upb_pbdecoder_frame *top, *limit;
   upb_pbdecoder_frame stack[UPB_DECODER_MAX_NESTING];
@@ -247,8 +305,38 @@ UPB_DEFINE_STRUCT0(upb_pbdecoder, UPB_QUOTE(
 #else
   const uint32_t *callstack[UPB_DECODER_MAX_NESTING];
 #endif
+
+#ifdef UPB_USE_JIT_X64
+  // Under tiered compilation, the method whose code is running the current
+  // stream: method_ itself, or its JIT-compiled counterpart if it had one when
+  // the stream started.  Streams never switch code midway.
+  const upb_pbdecodermethod *running_;
+#endif
 )));
 
+// Flags for CodeCache::set_jit_debug(), which make JIT-compiled code visible
+// to profilers and debuggers.  Symbols are named after the message and the
+// bytecode instruction they implement, like
+// "upb:DecoderTest.0x1a.OP_PARSE_INT32" (GDB gets the "X." prefix that
+// UPB_JIT_LOAD_SO uses instead).  These are only supported on Linux.
+typedef enum {
+  // Appends symbols to /tmp/perf-<pid>.map, which "perf report" reads.
+  UPB_JITDEBUG_PERFMAP = 1,
+
+  // Appends code load records to /tmp/jit-<pid>.dump, for
+  // "perf record -k mono" followed by "perf inject --jit".
+  UPB_JITDEBUG_JITDUMP = 2,
+
+  // Registers the code with GDB's JIT interface (__jit_debug_register_code).
+  UPB_JITDEBUG_GDB = 4
+} upb_jitdebug;
+
+// Default thresholds for CodeCache::set_tier_thresholds().  Compiling costs
+// roughly as much as interpreting a few hundred KB, so methods that never
+// parse that much are better off staying on bytecode.
+#define UPB_PBDECODER_TIER_CALLS 1000
+#define UPB_PBDECODER_TIER_BYTES (1024 * 1024)
+
 // A class for caching protobuf processing code, whether bytecode for the
 // interpreted decoder or machine code for the JIT.
 //
@@ -271,6 +359,30 @@ UPB_DEFINE_CLASS0(upb::pb::CodeCache,
   // any code generation, otherwise returns false and does nothing.
   bool set_allow_jit(bool allow);
 
+  // A set of UPB_JITDEBUG_* flags; defaults to 0.  Like set_allow_jit(), this
+  // may only be changed prior to any code generation.  Has no effect on code
+  // that is not JIT-compiled.
+  uint32_t jit_debug() const;
+  bool set_jit_debug(uint32_t flags);
+
+  // Tiered compilation; defaults to false.  Rather than JIT-compiling every
+  // method up front, methods start out running bytecode and are JIT-compiled
+  // once they are hot: once they have been started "calls" times or have
+  // parsed "bytes" bytes in total, whichever comes first.  Streams that are
+  // already running when that happens finish on bytecode.
+  //
+  // If background compilation is enabled, the method is compiled on a new
+  // thread while decoding continues on bytecode.  Otherwise the decoder that
+  // makes the method hot compiles it before it starts parsing.
+  //
+  // Like set_allow_jit(), these may only be changed prior to any code
+  // generation.  They have no effect unless the JIT is compiled in and
+  // allowed.
+  bool tiered() const;
+  bool set_tiered(bool tiered);
+  bool set_tier_thresholds(uint64_t calls, uint64_t bytes);
+  bool set_background_compile(bool background);
+
   // Returns a DecoderMethod that can push data to the given handlers.
   // If a suitable method already exists, it will be returned from the cache.
   //
@@ -289,6 +401,13 @@ UPB_DEFINE_CLASS0(upb::pb::CodeCache,
 ,
 UPB_DEFINE_STRUCT0(upb_pbcodecache,
   bool allow_jit_;
+  uint32_t jit_debug_;
+
+  // Tiered compilation options.
+  bool tiered_;
+  bool background_compile_;
+  uint64_t tier_calls_;
+  uint64_t tier_bytes_;
 
   // Array of mgroups.
   upb_inttable groups;
@@ -304,6 +423,13 @@ const upb_pbdecodermethod *upb_pbdecoder_method(const upb_pbdecoder *d);
 bool upb_pbdecoder_resetoutput(upb_pbdecoder *d, upb_sink *sink);
 upb_bytessink *upb_pbdecoder_input(upb_pbdecoder *d);
 uint64_t upb_pbdecoder_bytesparsed(const upb_pbdecoder *d);
+const upb_pbdecoder_stats *upb_pbdecoder_getstats(const upb_pbdecoder *d);
+bool upb_pbdecoder_hasstats(void);
+
+// Formats "s" into "buf" as a single line of "name=value" pairs, for
+// benchmarks and logs.  Returns the length of the full line like snprintf().
+size_t upb_pbdecoder_printstats(const upb_pbdecoder_stats *s, char *buf,
+                                size_t len);
 
 void upb_pbdecodermethodopts_init(upb_pbdecodermethodopts *opts,
                                   const upb_handlers *h);
@@ -320,6 +446,8 @@ const upb_handlers *upb_pbdecodermethod_desthandlers(
 const upb_byteshandler *upb_pbdecodermethod_inputhandler(
     const upb_pbdecodermethod *m);
 bool upb_pbdecodermethod_isnative(const upb_pbdecodermethod *m);
+void upb_pbdecodermethod_getstats(const upb_pbdecodermethod *m,
+                                  upb_pbdecoder_stats *stats);
 const upb_pbdecodermethod *upb_pbdecodermethod_new(
     const upb_pbdecodermethodopts *opts, const void *owner);
 
@@ -327,6 +455,13 @@ void upb_pbcodecache_init(upb_pbcodecache *c);
 void upb_pbcodecache_uninit(upb_pbcodecache *c);
 bool upb_pbcodecache_allowjit(const upb_pbcodecache *c);
 bool upb_pbcodecache_setallowjit(upb_pbcodecache *c, bool allow);
+uint32_t upb_pbcodecache_jitdebug(const upb_pbcodecache *c);
+bool upb_pbcodecache_setjitdebug(upb_pbcodecache *c, uint32_t flags);
+bool upb_pbcodecache_tiered(const upb_pbcodecache *c);
+bool upb_pbcodecache_settiered(upb_pbcodecache *c, bool tiered);
+bool upb_pbcodecache_settierthresholds(upb_pbcodecache *c, uint64_t calls,
+                                       uint64_t bytes);
+bool upb_pbcodecache_setbackgroundcompile(upb_pbcodecache *c, bool background);
 const upb_pbdecodermethod *upb_pbcodecache_getdecodermethod(
     upb_pbcodecache *c, const upb_pbdecodermethodopts *opts);
 
@@ -359,6 +494,13 @@ inline bool Decoder::ResetOutput(Sink* sink) {
 inline BytesSink* Decoder::input() {
   return upb_pbdecoder_input(this);
 }
+inline const upb_pbdecoder_stats* Decoder::stats() const {
+  return upb_pbdecoder_getstats(this);
+}
+// static
+inline bool Decoder::HasStats() {
+  return upb_pbdecoder_hasstats();
+}
 
 inline DecoderMethodOptions::DecoderMethodOptions(const Handlers* h) {
   upb_pbdecodermethodopts_init(this, h);
@@ -388,6 +530,9 @@ inline const BytesHandler* DecoderMethod::input_handler() const {
 inline bool DecoderMethod::is_native() const {
   return upb_pbdecodermethod_isnative(this);
 }
+inline void DecoderMethod::GetStats(upb_pbdecoder_stats* stats) const {
+  upb_pbdecodermethod_getstats(this, stats);
+}
 // static
 inline reffed_ptr<const DecoderMethod> DecoderMethod::New(
     const DecoderMethodOptions &opts) {
@@ -407,6 +552,24 @@ inline bool CodeCache::allow_jit() const {
 inline bool CodeCache::set_allow_jit(bool allow) {
   return upb_pbcodecache_setallowjit(this, allow);
 }
+inline uint32_t CodeCache::jit_debug() const {
+  return upb_pbcodecache_jitdebug(this);
+}
+inline bool CodeCache::set_jit_debug(uint32_t flags) {
+  return upb_pbcodecache_setjitdebug(this, flags);
+}
+inline bool CodeCache::tiered() const {
+  return upb_pbcodecache_tiered(this);
+}
+inline bool CodeCache::set_tiered(bool tiered) {
+  return upb_pbcodecache_settiered(this, tiered);
+}
+inline bool CodeCache::set_tier_thresholds(uint64_t calls, uint64_t bytes) {
+  return upb_pbcodecache_settierthresholds(this, calls, bytes);
+}
+inline bool CodeCache::set_background_compile(bool background) {
+  return upb_pbcodecache_setbackgroundcompile(this, background);
+}
 inline const DecoderMethod *CodeCache::GetDecoderMethod(
     const DecoderMethodOptions& opts) {
   return upb_pbcodecache_getdecodermethod(this, &opts);
@@ -105,17 +105,68 @@ typedef struct {
   upb_string_handlerfunc *jit_code;
   // The size of the jit_code (required to munmap()).
   size_t jit_size;
+  // In-memory ELF image registered with GDB, if any (see upb_jitdebug).
   char *debug_info;
   void *dl;
 #endif
 } mgroup;
 
+#ifdef UPB_USE_JIT_X64
+// Tiered compilation state for a method that starts out running bytecode (see
+// CodeCache::set_tiered()).  It is shared by the method and by the thread
+// compiling it, if any, which each own a ref; so a method can be freed while
+// its JIT-compiled counterpart is still being built.
+typedef struct upb_pbdecoder_tier {
+  uint32_t refcount;
+
+  // Streams started and bytes parsed so far, and the thresholds at which we
+  // compile.  Updated by decoders on any thread, so only approximate.
+  uint64_t calls;
+  uint64_t bytes;
+  uint64_t calls_threshold;
+  uint64_t bytes_threshold;
+
+  // What to compile, and how.  We own a ref on the handlers.
+  const upb_handlers *handlers;
+  bool lazy;
+  uint32_t jitdebug;
+  bool background;
+
+  // Set by whoever gets to compile the method.
+  uint32_t compiling;
+
+  // The JIT-compiled method and its group (on which we own a ref), published
+  // once compilation is complete.
+  const mgroup *jit_group;
+  const upb_pbdecodermethod *jit;
+} upb_pbdecoder_tier;
+
+// Returns the JIT-compiled counterpart of "m" if it has one, first counting
+// the start of a stream and, if that makes the method hot, compiling it.
+const upb_pbdecodermethod *upb_pbdecoder_tierup(const upb_pbdecodermethod *m);
+#endif
+
+// Increments a decoder counter; see upb_pbdecoder_stats.
+#ifdef UPB_DECODER_STATS
+#define UPB_DECODER_STAT(d, name, n) ((d)->stats_.name += (n))
+#else
+#define UPB_DECODER_STAT(d, name, n) ((void)0)
+#endif
+
 // Decoder entry points; used as handlers.
 void *upb_pbdecoder_startbc(void *closure, const void *pc, size_t size_hint);
 void *upb_pbdecoder_startjit(void *closure, const void *hd, size_t size_hint);
 size_t upb_pbdecoder_decode(void *closure, const void *hd, const char *buf,
                             size_t size, const upb_bufhandle *handle);
 bool upb_pbdecoder_end(void *closure, const void *handler_data);
+#ifdef UPB_USE_JIT_X64
+void *upb_pbdecoder_starttiered(void *closure, const void *hd,
+                                size_t size_hint);
+size_t upb_pbdecoder_decodetiered(void *closure, const void *hd,
+                                  const char *buf, size_t size,
+                                  const upb_bufhandle *handle);
+bool upb_pbdecoder_endtiered(void *closure, const void *hd);
+#endif
 
 // Decoder-internal functions that the JIT calls to handle fallback paths.
 int32_t upb_pbdecoder_resume(upb_pbdecoder *d, void *p, const char *buf,
@@ -136,7 +187,7 @@ extern const char *kPbDecoderStackOverflow;
 const char *upb_pbdecoder_getopname(unsigned int op);
 
 // JIT codegen entry point.
-void upb_pbdecoder_jit(mgroup *group);
+void upb_pbdecoder_jit(mgroup *group, uint32_t debugflags);
 void upb_pbdecoder_freejit(mgroup *group);
 
 // A special label that means "do field dispatch for this message and branch to
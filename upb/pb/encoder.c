@@ -58,7 +58,9 @@
  */
 
 #include "upb/pb/encoder.h"
+#include "upb/pb/encoder.int.h"
 #include "upb/pb/varint.int.h"
+#include "upb/shim/shim.h"
 
 #include <stdlib.h>
 
@@ -88,7 +90,8 @@ static bool reserve(upb_pb_encoder *e, size_t bytes) {
     }
 
     char *realloc_from = (e->buf == e->initbuf) ? NULL : e->buf;
-    char *new_buf = realloc(realloc_from, new_size);
+    char *new_buf = upb_realloc(e->alloc, realloc_from,
+                                realloc_from ? old_size : 0, new_size);
 
     if (new_buf == NULL) {
       return false;
@@ -171,7 +174,8 @@ static bool start_delim(upb_pb_encoder *e) {
       size_t old_size =
           (e->seglimit - e->segbuf) * sizeof(upb_pb_encoder_segment);
       size_t new_size = old_size * 2;
-      upb_pb_encoder_segment *new_buf = realloc(realloc_from, new_size);
+      upb_pb_encoder_segment *new_buf = upb_realloc(
+          e->alloc, realloc_from, realloc_from ? old_size : 0, new_size);
 
       if (new_buf == NULL) {
         return false;
@@ -244,12 +248,11 @@ static void new_tag(upb_handlers *h, const upb_fielddef *f, upb_wiretype_t wt,
                     upb_handlerattr *attr) {
   uint32_t n = upb_fielddef_number(f);
 
-  tag_t *tag = malloc(sizeof(tag_t));
+  tag_t *tag = upb_malloc(upb_handlers_alloc(h), sizeof(tag_t));
   tag->bytes = upb_vencode64((n << 3) | wt, tag->tag);
 
   upb_handlerattr_init(attr);
   upb_handlerattr_sethandlerdata(attr, tag);
-  upb_handlers_addcleanup(h, tag, free);
 }
 
 static bool encode_tag(upb_pb_encoder *e, const tag_t *tag) {
@@ -468,19 +471,26 @@ void upb_pb_encoder_init(upb_pb_encoder *e, const upb_handlers *h) {
   e->segbuf = e->seginitbuf;
   e->seglimit = e->segbuf + ARRAYSIZE(e->seginitbuf);
   e->stacklimit = e->stack + ARRAYSIZE(e->stack);
+  e->alloc = &upb_alloc_global;
   upb_sink_reset(&e->input_, h, e);
 }
 
 void upb_pb_encoder_uninit(upb_pb_encoder *e) {
   if (e->buf != e->initbuf) {
-    free(e->buf);
+    upb_free(e->alloc, e->buf);
   }
 
   if (e->segbuf != e->seginitbuf) {
-    free(e->segbuf);
+    upb_free(e->alloc, e->segbuf);
   }
 }
 
+void upb_pb_encoder_setalloc(upb_pb_encoder *e, upb_alloc *alloc) {
+  // We can't switch allocators once we've allocated from the old one.
+  assert(e->buf == e->initbuf && e->segbuf == e->seginitbuf);
+  e->alloc = alloc;
+}
+
 void upb_pb_encoder_resetoutput(upb_pb_encoder *e, upb_bytessink *output) {
   upb_pb_encoder_reset(e);
   e->output_ = output;
@@ -494,3 +504,569 @@ void upb_pb_encoder_reset(upb_pb_encoder *e) {
 }
 
 upb_sink *upb_pb_encoder_input(upb_pb_encoder *e) { return &e->input_; }
+
+
+/* upb::pb::SerializerMethod **************************************************/
+
+// The serializer does not go through handlers at all; see encoder.int.h for
+// what a method is compiled to.  With UPB_USE_JIT_X64 the method is then
+// turned into machine code, otherwise it is interpreted, which already avoids
+// the per-field handler calls, sink frames and segment buffering of the
+// Encoder.
+
+// Fills in "sf" for field "f" of "h".  Returns 0 if the field should not be
+// serialized, 1 if it should and -1 (setting "status") if it can't be.
+static int getsfield(const upb_handlers *h, const upb_fielddef *f, sfield *sf,
+                     upb_status *status) {
+  upb_descriptortype_t type = upb_fielddef_descriptortype(f);
+  upb_selector_t sel;
+  const upb_shim_data *d;
+  upb_fieldtype_t ctype = upb_fielddef_type(f);
+
+  memset(sf, 0, sizeof(*sf));
+
+  if (upb_fielddef_isseq(f) && !upb_fielddef_isprimitive(f)) {
+    // Repeated strings and submessages have no shims, so there is nothing we
+    // could read them from.
+    bool ok = upb_handlers_getselector(f, UPB_HANDLER_STARTSEQ, &sel);
+    UPB_ASSERT_VAR(ok, ok);
+    if (!upb_handlers_gethandler(h, sel)) return 0;
+    upb_status_seterrf(status, "Can't serialize repeated field %s.",
+                       upb_fielddef_name(f));
+    return -1;
+  } else if (upb_fielddef_isseq(f)) {
+    bool ok = upb_handlers_getselector(
+        f, upb_handlers_getprimitivehandlertype(f), &sel);
+    UPB_ASSERT_VAR(ok, ok);
+    if (!upb_handlers_gethandler(h, sel)) return 0;
+    d = upb_shim_getarray(h, sel, &ctype);
+    sf->kind = SFIELD_ARRAY;
+    sf->packed = upb_fielddef_packed(f);
+  } else if (upb_fielddef_isstring(f)) {
+    bool ok = upb_handlers_getselector(f, UPB_HANDLER_STARTSTR, &sel);
+    UPB_ASSERT_VAR(ok, ok);
+    if (!upb_handlers_gethandler(h, sel)) return 0;
+    d = upb_shim_getstrview(h, sel);
+    sf->kind = SFIELD_STRING;
+  } else if (upb_fielddef_issubmsg(f)) {
+    bool ok = upb_handlers_getselector(f, UPB_HANDLER_STARTSUBMSG, &sel);
+    UPB_ASSERT_VAR(ok, ok);
+    if (!upb_handlers_gethandler(h, sel)) return 0;
+    d = upb_shim_getsubmsg(h, sel);
+    sf->kind = SFIELD_SUBMSG;
+  } else {
+    bool ok = upb_handlers_getselector(
+        f, upb_handlers_getprimitivehandlertype(f), &sel);
+    UPB_ASSERT_VAR(ok, ok);
+    if (!upb_handlers_gethandler(h, sel)) return 0;
+    d = upb_shim_getdata(h, sel, &ctype);
+    sf->kind = SFIELD_SCALAR;
+  }
+
+  if (!d) {
+    upb_status_seterrf(status, "Handler for field %s is not a shim.",
+                       upb_fielddef_name(f));
+    return -1;
+  }
+
+  upb_wiretype_t wt = sf->packed ? UPB_WIRE_TYPE_DELIMITED
+                                 : upb_pb_native_wire_types[type];
+  sf->number = upb_fielddef_number(f);
+  sf->type = type;
+  sf->ctype = ctype;
+  sf->taglen = upb_vencode64((sf->number << 3) | wt, sf->tag);
+  if (type == UPB_DESCRIPTOR_TYPE_GROUP) {
+    sf->endtaglen = upb_vencode64(
+        (sf->number << 3) | UPB_WIRE_TYPE_END_GROUP, sf->endtag);
+  }
+  sf->offset = d->offset;
+  sf->hasbit = d->hasbit;
+  sf->elemsize = d->size;
+  return 1;
+}
+
+static int cmpsfield(const void *a, const void *b) {
+  const sfield *fa = a, *fb = b;
+  return fa->number < fb->number ? -1 : (fa->number > fb->number);
+}
+
+// Checks that every message reachable from "h" can be serialized, so that
+// compile() can't fail halfway through.  "seen" holds the handlers already
+// checked.
+static bool check(const upb_handlers *h, upb_inttable *seen,
+                  upb_status *status) {
+  if (upb_inttable_lookupptr(seen, h, NULL)) return true;
+  upb_inttable_insertptr(seen, h, upb_value_bool(true));
+
+  upb_msg_iter i;
+  for (upb_msg_begin(&i, upb_handlers_msgdef(h)); !upb_msg_done(&i);
+       upb_msg_next(&i)) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    sfield sf;
+    int ret = getsfield(h, f, &sf, status);
+    if (ret < 0) return false;
+    if (ret > 0 && sf.kind == SFIELD_SUBMSG) {
+      const upb_handlers *sub = upb_handlers_getsubhandlers(h, f);
+      if (sub && !check(sub, seen, status)) return false;
+    }
+  }
+  return true;
+}
+
+static void freemethod(upb_pb_serializermethod *m) {
+#ifdef UPB_USE_JIT_X64
+  upb_pb_serializermethod_freejit(m);
+#endif
+  free(m->fields);
+  free(m);
+}
+
+// Compiles "h" and any submessages that aren't in the cache yet into
+// "added", which maps upb_handlers* -> upb_pb_serializermethod* like the
+// cache does.  Returns NULL if we run out of memory; the caller then frees
+// everything in "added".
+static const upb_pb_serializermethod *compile(upb_pb_serializercache *c,
+                                              const upb_handlers *h,
+                                              upb_inttable *added) {
+  upb_value v;
+  if (upb_inttable_lookupptr(&c->methods, h, &v) ||
+      upb_inttable_lookupptr(added, h, &v)) {
+    return upb_value_getptr(v);
+  }
+
+  const upb_msgdef *md = upb_handlers_msgdef(h);
+  upb_pb_serializermethod *m = malloc(sizeof(*m));
+  if (!m) return NULL;
+  // One extra, so that a message without fields isn't a malloc(0).
+  m->fields = malloc((upb_msgdef_numfields(md) + 1) * sizeof(sfield));
+  m->nfields = 0;
+#ifdef UPB_USE_JIT_X64
+  m->jit_measure = NULL;
+  m->jit_write = NULL;
+  m->jit_code = NULL;
+  m->jit_size = 0;
+#endif
+
+  // Added before compiling the fields, so recursive types find it.
+  if (!m->fields || !upb_inttable_insertptr(added, h, upb_value_ptr(m))) {
+    freemethod(m);
+    return NULL;
+  }
+
+  upb_msg_iter i;
+  for (upb_msg_begin(&i, md); !upb_msg_done(&i); upb_msg_next(&i)) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    sfield *sf = &m->fields[m->nfields];
+    if (getsfield(h, f, sf, NULL) <= 0) continue;
+    if (sf->kind == SFIELD_SUBMSG) {
+      const upb_handlers *sub = upb_handlers_getsubhandlers(h, f);
+      if (sub && !(sf->sub = compile(c, sub, added))) return NULL;
+    }
+    m->nfields++;
+  }
+
+  // Written in field number order, like other encoders do.
+  qsort(m->fields, m->nfields, sizeof(sfield), cmpsfield);
+  return m;
+}
+
+
+/* upb::pb::SerializerCache ***************************************************/
+
+void upb_pb_serializercache_init(upb_pb_serializercache *c) {
+  upb_inttable_init(&c->methods, UPB_CTYPE_PTR);
+  c->allow_jit_ = true;
+}
+
+void upb_pb_serializercache_uninit(upb_pb_serializercache *c) {
+  upb_inttable_iter i;
+  upb_inttable_begin(&i, &c->methods);
+  for (; !upb_inttable_done(&i); upb_inttable_next(&i)) {
+    upb_handlers_unref((const upb_handlers*)upb_inttable_iter_key(&i), c);
+    freemethod(upb_value_getptr(upb_inttable_iter_value(&i)));
+  }
+  upb_inttable_uninit(&c->methods);
+}
+
+bool upb_pb_serializercache_allowjit(const upb_pb_serializercache *c) {
+  return c->allow_jit_;
+}
+
+bool upb_pb_serializercache_setallowjit(upb_pb_serializercache *c,
+                                        bool allow) {
+  if (upb_inttable_count(&c->methods) > 0)
+    return false;
+  c->allow_jit_ = allow;
+  return true;
+}
+
+const upb_pb_serializermethod *upb_pb_serializercache_getmethod(
+    upb_pb_serializercache *c, const upb_handlers *h, upb_status *status) {
+  upb_value v;
+  if (upb_inttable_lookupptr(&c->methods, h, &v)) {
+    return upb_value_getptr(v);
+  }
+
+  upb_inttable seen;
+  upb_inttable_init(&seen, UPB_CTYPE_BOOL);
+  bool ok = check(h, &seen, status);
+  upb_inttable_uninit(&seen);
+  if (!ok) return NULL;
+
+  upb_inttable added;
+  const upb_pb_serializermethod *ret = NULL;
+  if (upb_inttable_init(&added, UPB_CTYPE_PTR)) {
+    ret = compile(c, h, &added);
+  }
+
+  // The new methods only go into the cache once all of them are complete.
+  upb_inttable_iter i;
+  upb_inttable_begin(&i, &added);
+  for (; ret && !upb_inttable_done(&i); upb_inttable_next(&i)) {
+    if (!upb_inttable_insert(&c->methods, upb_inttable_iter_key(&i),
+                             upb_inttable_iter_value(&i))) {
+      ret = NULL;
+    }
+  }
+
+  upb_inttable_begin(&i, &added);
+  for (; !upb_inttable_done(&i); upb_inttable_next(&i)) {
+    upb_pb_serializermethod *m = upb_value_getptr(upb_inttable_iter_value(&i));
+    if (ret) {
+      upb_handlers_ref((const upb_handlers*)upb_inttable_iter_key(&i), c);
+#ifdef UPB_USE_JIT_X64
+      if (c->allow_jit_) upb_pb_serializermethod_jit(m);
+#endif
+    } else {
+      upb_inttable_remove(&c->methods, upb_inttable_iter_key(&i), NULL);
+      freemethod(m);
+    }
+  }
+  upb_inttable_uninit(&added);
+
+  if (!ret) upb_status_seterrmsg(status, "Out of memory.");
+  return ret;
+}
+
+bool upb_pb_serializermethod_isnative(const upb_pb_serializermethod *m) {
+#ifdef UPB_USE_JIT_X64
+  return m->jit_code != NULL;
+#else
+  UPB_UNUSED(m);
+  return false;
+#endif
+}
+
+
+/* upb::pb::Serializer ********************************************************/
+
+static bool hasbitset(const char *msg, int32_t hasbit) {
+  return (msg[hasbit / 8] & (1 << (hasbit % 8))) != 0;
+}
+
+// Returns the value at "p" as it goes on the wire: the bits of fixed-width
+// types, and the varint value of the others.
+static uint64_t wireval(const sfield *f, const char *p) {
+  int32_t i32;
+  int64_t i64;
+  uint32_t u32;
+  uint64_t u64;
+  switch (f->ctype) {
+    case UPB_TYPE_INT32:
+    case UPB_TYPE_ENUM:
+      memcpy(&i32, p, 4);
+      if (f->type == UPB_DESCRIPTOR_TYPE_SINT32) return upb_zzenc_32(i32);
+      if (f->type == UPB_DESCRIPTOR_TYPE_SFIXED32) return (uint32_t)i32;
+      return (int64_t)i32;  // Negative values are sign-extended to 64 bits.
+    case UPB_TYPE_INT64:
+      memcpy(&i64, p, 8);
+      if (f->type == UPB_DESCRIPTOR_TYPE_SINT64) return upb_zzenc_64(i64);
+      return i64;
+    case UPB_TYPE_UINT32:
+    case UPB_TYPE_FLOAT:
+      memcpy(&u32, p, 4);
+      return u32;
+    case UPB_TYPE_UINT64:
+    case UPB_TYPE_DOUBLE:
+      memcpy(&u64, p, 8);
+      return u64;
+    case UPB_TYPE_BOOL:
+      return *(const bool*)p;
+    default:
+      assert(false);
+      return 0;
+  }
+}
+
+// Returns 4 or 8 for fixed-width types, 0 for varints.
+static size_t fixedsize(const sfield *f) {
+  switch (upb_pb_native_wire_types[f->type]) {
+    case UPB_WIRE_TYPE_32BIT: return 4;
+    case UPB_WIRE_TYPE_64BIT: return 8;
+    default: return 0;
+  }
+}
+
+static size_t valsize(const sfield *f, const char *p) {
+  size_t fixed = fixedsize(f);
+  return fixed ? fixed : upb_varint_size(wireval(f, p));
+}
+
+static char *putval(const sfield *f, const char *p, char *out) {
+  // TODO(haberman): byte-swap for big endian.
+  uint64_t val = wireval(f, p);
+  size_t fixed = fixedsize(f);
+  if (fixed) {
+    memcpy(out, &val, fixed);
+    return out + fixed;
+  }
+  return out + upb_vencode64(val, out);
+}
+
+static bool isset(const sfield *f, const char *msg) {
+  const char *p = msg + f->offset;
+  switch (f->kind) {
+    case SFIELD_SCALAR:
+      // Without a hasbit, only non-zero values are written.
+      return f->hasbit >= 0 ? hasbitset(msg, f->hasbit) : wireval(f, p) != 0;
+    case SFIELD_STRING:
+      return f->hasbit >= 0 ? hasbitset(msg, f->hasbit)
+                            : ((const upb_shim_strview*)p)->size > 0;
+    case SFIELD_ARRAY:
+      return ((const upb_shim_array*)p)->len > 0;
+    case SFIELD_SUBMSG:
+      return *(void* const*)p &&
+             (f->hasbit < 0 || hasbitset(msg, f->hasbit));
+  }
+  return false;
+}
+
+// Reserves a slot in s->lens for a length that we will know later.
+static bool newlen(upb_pb_measurestate *ms, size_t *slot) {
+  upb_pb_serializer *s = ms->s;
+  if (ms->n == s->lenssize) {
+    size_t size = s->lenssize ? s->lenssize * 2 : 32;
+    size_t *lens = upb_realloc(s->alloc, s->lens,
+                               s->lenssize * sizeof(size_t),
+                               size * sizeof(size_t));
+    if (!lens) {
+      upb_status_seterrmsg(ms->status, "Out of memory.");
+      return false;
+    }
+    s->lens = lens;
+    s->lenssize = size;
+  }
+  *slot = ms->n++;
+  return true;
+}
+
+static bool measure(upb_pb_measurestate *ms, const upb_pb_serializermethod *m,
+                    const char *msg, int depth, size_t *size);
+static char *serialize(upb_pb_writestate *ws, const upb_pb_serializermethod *m,
+                       const char *msg, char *out);
+
+bool upb_pb_serializer_measurefield(upb_pb_measurestate *ms, const sfield *f,
+                                    const char *msg, int depth,
+                                    size_t *total) {
+  if (!isset(f, msg)) return true;
+  const char *p = msg + f->offset;
+  switch (f->kind) {
+    case SFIELD_SCALAR:
+      *total += f->taglen + valsize(f, p);
+      break;
+    case SFIELD_STRING: {
+      size_t len = ((const upb_shim_strview*)p)->size;
+      *total += f->taglen + upb_varint_size(len) + len;
+      break;
+    }
+    case SFIELD_ARRAY: {
+      const upb_shim_array *arr = (const upb_shim_array*)p;
+      const char *elem = arr->data;
+      size_t fixed = fixedsize(f);
+      size_t len = fixed * arr->len;
+      size_t i;
+      if (!fixed) {
+        for (i = 0; i < arr->len; i++, elem += f->elemsize) {
+          len += valsize(f, elem);
+        }
+      }
+      if (f->packed) {
+        size_t slot;
+        if (!newlen(ms, &slot)) return false;
+        ms->s->lens[slot] = len;
+        *total += f->taglen + upb_varint_size(len) + len;
+      } else {
+        *total += f->taglen * arr->len + len;
+      }
+      break;
+    }
+    case SFIELD_SUBMSG: {
+      const char *sub = *(const char* const*)p;
+      size_t slot, len = 0;
+      if (!newlen(ms, &slot)) return false;
+      if (f->sub && !measure(ms, f->sub, sub, depth + 1, &len)) {
+        return false;
+      }
+      ms->s->lens[slot] = len;
+      if (f->type == UPB_DESCRIPTOR_TYPE_GROUP) {
+        *total += f->taglen + len + f->endtaglen;
+      } else {
+        *total += f->taglen + upb_varint_size(len) + len;
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+// First pass: computes the encoded size of "msg", storing the lengths of
+// submessages and packed fields in s->lens (from ms->n on).
+static bool measure(upb_pb_measurestate *ms, const upb_pb_serializermethod *m,
+                    const char *msg, int depth, size_t *size) {
+  if (depth > UPB_PBENCODER_MAX_NESTING) {
+    upb_status_seterrmsg(ms->status, "Nesting too deep.");
+    return false;
+  }
+
+#ifdef UPB_USE_JIT_X64
+  if (m->jit_measure) return m->jit_measure(ms, msg, depth, size);
+#endif
+
+  size_t total = 0;
+  const sfield *f;
+  for (f = m->fields; f < m->fields + m->nfields; f++) {
+    if (!upb_pb_serializer_measurefield(ms, f, msg, depth, &total)) {
+      return false;
+    }
+  }
+
+  *size = total;
+  return true;
+}
+
+char *upb_pb_serializer_writefield(upb_pb_writestate *ws, const sfield *f,
+                                   const char *msg, char *out) {
+  if (!isset(f, msg)) return out;
+  const char *p = msg + f->offset;
+  switch (f->kind) {
+    case SFIELD_SCALAR:
+      memcpy(out, f->tag, f->taglen);
+      out = putval(f, p, out + f->taglen);
+      break;
+    case SFIELD_STRING: {
+      const upb_shim_strview *view = (const upb_shim_strview*)p;
+      memcpy(out, f->tag, f->taglen);
+      out += f->taglen;
+      out += upb_vencode64(view->size, out);
+      memcpy(out, view->data, view->size);
+      out += view->size;
+      break;
+    }
+    case SFIELD_ARRAY: {
+      const upb_shim_array *arr = (const upb_shim_array*)p;
+      const char *elem = arr->data;
+      size_t i;
+      if (f->packed) {
+        memcpy(out, f->tag, f->taglen);
+        out += f->taglen;
+        out += upb_vencode64(ws->s->lens[ws->n++], out);
+      }
+      for (i = 0; i < arr->len; i++, elem += f->elemsize) {
+        if (!f->packed) {
+          memcpy(out, f->tag, f->taglen);
+          out += f->taglen;
+        }
+        out = putval(f, elem, out);
+      }
+      break;
+    }
+    case SFIELD_SUBMSG: {
+      const char *sub = *(const char* const*)p;
+      size_t len = ws->s->lens[ws->n++];
+      memcpy(out, f->tag, f->taglen);
+      out += f->taglen;
+      if (f->type != UPB_DESCRIPTOR_TYPE_GROUP) {
+        out += upb_vencode64(len, out);
+      }
+      if (f->sub) out = serialize(ws, f->sub, sub, out);
+      if (f->type == UPB_DESCRIPTOR_TYPE_GROUP) {
+        memcpy(out, f->endtag, f->endtaglen);
+        out += f->endtaglen;
+      }
+      break;
+    }
+  }
+  return out;
+}
+
+// Second pass: writes "msg" at "out", consuming s->lens in the same order
+// that measure() filled it in.  Returns the end of what was written.
+static char *serialize(upb_pb_writestate *ws, const upb_pb_serializermethod *m,
+                       const char *msg, char *out) {
+#ifdef UPB_USE_JIT_X64
+  if (m->jit_write) return m->jit_write(ws, msg, out);
+#endif
+
+  const sfield *f;
+  for (f = m->fields; f < m->fields + m->nfields; f++) {
+    out = upb_pb_serializer_writefield(ws, f, msg, out);
+  }
+  return out;
+}
+
+void upb_pb_serializer_init(upb_pb_serializer *s) {
+  s->alloc = &upb_alloc_global;
+  s->buf = NULL;
+  s->bufsize = 0;
+  s->lens = NULL;
+  s->lenssize = 0;
+}
+
+void upb_pb_serializer_uninit(upb_pb_serializer *s) {
+  upb_free(s->alloc, s->buf);
+  upb_free(s->alloc, s->lens);
+}
+
+void upb_pb_serializer_setalloc(upb_pb_serializer *s, upb_alloc *alloc) {
+  // We can't switch allocators once we've allocated from the old one.
+  assert(s->buf == NULL && s->lens == NULL);
+  s->alloc = alloc;
+}
+
+bool upb_pb_serializer_run(upb_pb_serializer *s,
+                           const upb_pb_serializermethod *m, const void *msg,
+                           upb_bytessink *output, upb_status *status) {
+  upb_pb_measurestate ms;
+  size_t size;
+  ms.s = s;
+  ms.n = 0;
+  ms.status = status;
+  if (!measure(&ms, m, msg, 0, &size)) return false;
+
+  if (size > s->bufsize) {
+    size_t bufsize = s->bufsize ? s->bufsize : 256;
+    while (bufsize < size) bufsize *= 2;
+    char *buf = upb_realloc(s->alloc, s->buf, s->bufsize, bufsize);
+    if (!buf) {
+      upb_status_seterrmsg(status, "Out of memory.");
+      return false;
+    }
+    s->buf = buf;
+    s->bufsize = bufsize;
+  }
+
+  upb_pb_writestate ws;
+  ws.s = s;
+  ws.n = 0;
+  char *end = serialize(&ws, m, msg, s->buf);
+  UPB_ASSERT_VAR(end, end == s->buf + size);
+
+  void *subc;
+  if (!upb_bytessink_start(output, size, &subc) ||
+      upb_bytessink_putbuf(output, subc, s->buf, size, NULL) != size ||
+      !upb_bytessink_end(output)) {
+    upb_status_seterrmsg(status, "Output refused the data.");
+    return false;
+  }
+  return true;
+}
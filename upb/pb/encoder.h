@@ -10,6 +10,11 @@
  * This encoder implementation does not have any access to any out-of-band or
  * precomputed lengths for submessages, so it must buffer submessages internally
  * before it can emit the first byte.
+ *
+ * When the data is already in C structs that upb::Shim handlers decode into,
+ * upb::pb::Serializer is much faster: it walks the structs directly, using a
+ * SerializerMethod compiled from the shims, and can compute every length
+ * before writing anything.
  */
 
 #ifndef UPB_ENCODER_H_
@@ -21,11 +26,17 @@
 namespace upb {
 namespace pb {
 class Encoder;
+class Serializer;
+class SerializerCache;
+class SerializerMethod;
 }  // namespace pb
 }  // namespace upb
 #endif
 
 UPB_DECLARE_TYPE(upb::pb::Encoder, upb_pb_encoder);
+UPB_DECLARE_TYPE(upb::pb::Serializer, upb_pb_serializer);
+UPB_DECLARE_TYPE(upb::pb::SerializerCache, upb_pb_serializercache);
+UPB_DECLARE_TYPE(upb::pb::SerializerMethod, upb_pb_serializermethod);
 
 #define UPB_PBENCODER_MAX_NESTING 100
 
@@ -78,6 +89,11 @@ UPB_DEFINE_CLASS0(upb::pb::Encoder,
   // Resets the output pointer which will serve as our closure.
   void ResetOutput(BytesSink* output);
 
+  // Sets the allocator used when the encoder outgrows its internal buffers,
+  // for example an Arena that holds all memory for the current request.
+  // Must be called before anything is encoded.
+  void SetAllocator(Allocator* alloc);
+
   // The input to the encoder.
   Sink* input();
 
@@ -112,11 +128,113 @@ UPB_DEFINE_STRUCT0(upb_pb_encoder, UPB_QUOTE(
   int depth;
 
   // Initial buffers for the output buffer and segment buffer.  If we outgrow
-  // these we will dynamically allocate bigger ones.
+  // these we will allocate bigger ones from "alloc".
+  upb_alloc *alloc;
   char initbuf[256];
   upb_pb_encoder_segment seginitbuf[32];
 )));
 
+/* upb::pb::SerializerMethod **************************************************/
+
+// A SerializerMethod is the compiled form of one set of shim handlers: for
+// every field it has the pre-encoded tag, the wire encoding and where the
+// value lives in the struct, sorted by field number.  Its layout is private.
+// When the JIT is available the method is also compiled to machine code.
+#ifdef __cplusplus
+namespace upb {
+namespace pb {
+class SerializerMethod {
+ public:
+  // Whether this method is native code; see SerializerCache::allow_jit().
+  bool is_native() const;
+
+ private:
+  UPB_DISALLOW_POD_OPS(SerializerMethod, upb::pb::SerializerMethod);
+};
+}  // namespace pb
+}  // namespace upb
+#endif
+
+/* upb::pb::SerializerCache ***************************************************/
+
+//
+// Like DecoderMethods from a CodeCache, SerializerMethods are compiled once
+// and then shared, so the cache should be long-lived.  It is not thread-safe,
+// but the methods it returns may be used from any number of threads.
+UPB_DEFINE_CLASS0(upb::pb::SerializerCache,
+ public:
+  SerializerCache();
+  ~SerializerCache();
+
+  // Returns the SerializerMethod for the structs that the shims in "h" (and
+  // its subhandlers) decode into; see upb/shim/shim.h.  Fields without
+  // handlers are not serialized, since they have no place in the struct.
+  // Returns NULL and sets "status" if a field has a handler that is not a
+  // shim, or is a repeated string or submessage (which have no shims).
+  //
+  // The method is owned by the cache and lives as long as it does.
+  const SerializerMethod* GetSerializerMethod(const Handlers* h,
+                                              Status* status);
+
+  // Whether the cache is allowed to generate machine code.  Defaults to true.
+  // Like CodeCache::allow_jit(), this is only a request: without
+  // UPB_USE_JIT_X64 every method is interpreted.
+  bool allow_jit() const;
+
+  // This may only be called before any methods are compiled; returns false
+  // if it is called too late.
+  bool set_allow_jit(bool allow);
+
+ private:
+  UPB_DISALLOW_COPY_AND_ASSIGN(SerializerCache);
+,
+UPB_DEFINE_STRUCT0(upb_pb_serializercache,
+  // Maps upb_handlers* -> upb_pb_serializermethod*.  The cache holds a ref on
+  // every upb_handlers in it.
+  upb_inttable methods;
+
+  bool allow_jit_;
+));
+
+/* upb::pb::Serializer ********************************************************/
+
+// Serializes structs with a SerializerMethod.  Like the Encoder, it keeps its
+// buffers between runs, so reusing one is cheaper than creating a new one for
+// every message.
+//
+// The struct is walked twice: once to compute the lengths of all submessages
+// and packed fields, and once to write the output into a buffer of exactly
+// the right size, which is passed to the output in a single PutBuffer().
+UPB_DEFINE_CLASS0(upb::pb::Serializer,
+ public:
+  Serializer();
+  ~Serializer();
+
+  // Sets the allocator for the serializer's buffers.  Must be called before
+  // anything is serialized.
+  void SetAllocator(Allocator* alloc);
+
+  // Serializes the struct at "msg" to "output".  Returns false and sets
+  // "status" on error.
+  bool Serialize(const SerializerMethod* method, const void* msg,
+                 BytesSink* output, Status* status);
+
+ private:
+  UPB_DISALLOW_COPY_AND_ASSIGN(Serializer);
+,
+UPB_DEFINE_STRUCT0(upb_pb_serializer, UPB_QUOTE(
+  upb_alloc *alloc;
+
+  // The output buffer.
+  char *buf;
+  size_t bufsize;
+
+  // Lengths of the submessages and packed fields, in the order in which they
+  // are written, filled in by the first pass and used by the second.
+  size_t *lens;
+  size_t lenssize;
+)));
+
 UPB_BEGIN_EXTERN_C
 
 const upb_handlers *upb_pb_encoder_newhandlers(const upb_msgdef *m,
@@ -126,6 +244,22 @@ upb_sink *upb_pb_encoder_input(upb_pb_encoder *p);
 void upb_pb_encoder_init(upb_pb_encoder *e, const upb_handlers *h);
 void upb_pb_encoder_resetoutput(upb_pb_encoder *e, upb_bytessink *output);
 void upb_pb_encoder_uninit(upb_pb_encoder *e);
+void upb_pb_encoder_setalloc(upb_pb_encoder *e, upb_alloc *alloc);
+
+void upb_pb_serializercache_init(upb_pb_serializercache *c);
+void upb_pb_serializercache_uninit(upb_pb_serializercache *c);
+const upb_pb_serializermethod *upb_pb_serializercache_getmethod(
+    upb_pb_serializercache *c, const upb_handlers *h, upb_status *status);
+bool upb_pb_serializercache_allowjit(const upb_pb_serializercache *c);
+bool upb_pb_serializercache_setallowjit(upb_pb_serializercache *c, bool allow);
+bool upb_pb_serializermethod_isnative(const upb_pb_serializermethod *m);
+
+void upb_pb_serializer_init(upb_pb_serializer *s);
+void upb_pb_serializer_uninit(upb_pb_serializer *s);
+void upb_pb_serializer_setalloc(upb_pb_serializer *s, upb_alloc *alloc);
+bool upb_pb_serializer_run(upb_pb_serializer *s,
+                           const upb_pb_serializermethod *m, const void *msg,
+                           upb_bytessink *output, upb_status *status);
 
 UPB_END_EXTERN_C
 
@@ -145,6 +279,9 @@ inline void Encoder::Reset() {
 inline void Encoder::ResetOutput(BytesSink* output) {
   upb_pb_encoder_resetoutput(this, output);
 }
+inline void Encoder::SetAllocator(Allocator* alloc) {
+  upb_pb_encoder_setalloc(this, alloc);
+}
 inline Sink* Encoder::input() {
   return upb_pb_encoder_input(this);
 }
@@ -153,6 +290,39 @@ inline reffed_ptr<const Handlers> Encoder::NewHandlers(
   const Handlers* h = upb_pb_encoder_newhandlers(md, &h);
   return reffed_ptr<const Handlers>(h, &h);
 }
+inline SerializerCache::SerializerCache() {
+  upb_pb_serializercache_init(this);
+}
+inline SerializerCache::~SerializerCache() {
+  upb_pb_serializercache_uninit(this);
+}
+inline const SerializerMethod* SerializerCache::GetSerializerMethod(
+    const Handlers* h, Status* status) {
+  return upb_pb_serializercache_getmethod(this, h, status);
+}
+inline bool SerializerCache::allow_jit() const {
+  return upb_pb_serializercache_allowjit(this);
+}
+inline bool SerializerCache::set_allow_jit(bool allow) {
+  return upb_pb_serializercache_setallowjit(this, allow);
+}
+inline bool SerializerMethod::is_native() const {
+  return upb_pb_serializermethod_isnative(this);
+}
+inline Serializer::Serializer() {
+  upb_pb_serializer_init(this);
+}
+inline Serializer::~Serializer() {
+  upb_pb_serializer_uninit(this);
+}
+inline void Serializer::SetAllocator(Allocator* alloc) {
+  upb_pb_serializer_setalloc(this, alloc);
+}
+inline bool Serializer::Serialize(const SerializerMethod* method,
+                                  const void* msg, BytesSink* output,
+                                  Status* status) {
+  return upb_pb_serializer_run(this, method, msg, output, status);
+}
 }  // namespace pb
 }  // namespace upb
 
@@ -0,0 +1,96 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2014 Google Inc.  See LICENSE for details.
+ *
+ * Internal-only definitions for the serializer, shared by encoder.c and the
+ * x64 JIT for SerializerMethods (compile_encoder_x64.c).
+ */
+
+#ifndef UPB_ENCODER_INT_H_
+#define UPB_ENCODER_INT_H_
+
+#include "upb/pb/encoder.h"
+
+// Each message type is compiled into a list of fields, each of which says
+// where its value lives in the struct (which we learn from the shims that
+// decode into it) and how to encode it.
+
+typedef enum {
+  SFIELD_SCALAR,
+  SFIELD_STRING,
+  SFIELD_ARRAY,
+  SFIELD_SUBMSG
+} sfieldkind;
+
+typedef struct {
+  uint32_t number;
+  uint8_t kind;       // sfieldkind
+  uint8_t type;       // upb_descriptortype_t
+  uint8_t ctype;      // upb_fieldtype_t of the value in the struct.
+  bool packed;
+
+  // Pre-encoded tags.  "endtag" is only used by groups.
+  uint8_t taglen, endtaglen;
+  char tag[5], endtag[5];
+
+  size_t offset;
+  int32_t hasbit;
+
+  // Arrays: sizeof() one element.
+  size_t elemsize;
+
+  // Submessages; NULL if the submessage has no handlers, in which case it is
+  // always written empty.
+  const upb_pb_serializermethod *sub;
+} sfield;
+
+// State for the first pass, which measures the struct.
+typedef struct {
+  upb_pb_serializer *s;
+  size_t n;  // Next free slot in s->lens.
+  upb_status *status;
+} upb_pb_measurestate;
+
+// State for the second pass, which writes it.
+typedef struct {
+  const upb_pb_serializer *s;
+  size_t n;  // Next slot of s->lens to consume.
+} upb_pb_writestate;
+
+// Machine code for the two passes over one message type; these have the
+// same contract as measure() and serialize() in encoder.c, minus the nesting
+// check.
+typedef bool upb_pb_jitmeasure(upb_pb_measurestate *ms, const char *msg,
+                               int depth, size_t *size);
+typedef char *upb_pb_jitwrite(upb_pb_writestate *ws, const char *msg,
+                              char *out);
+
+struct upb_pb_serializermethod {
+  sfield *fields;
+  size_t nfields;
+
+#ifdef UPB_USE_JIT_X64
+  // NULL if the method is interpreted.
+  upb_pb_jitmeasure *jit_measure;
+  upb_pb_jitwrite *jit_write;
+  char *jit_code;
+  size_t jit_size;
+#endif
+};
+
+// Measure or write a single field if it is set.  The interpreter uses these
+// for every field; the JIT only for arrays and submessages.
+bool upb_pb_serializer_measurefield(upb_pb_measurestate *ms, const sfield *f,
+                                    const char *msg, int depth, size_t *total);
+char *upb_pb_serializer_writefield(upb_pb_writestate *ws, const sfield *f,
+                                   const char *msg, char *out);
+
+#ifdef UPB_USE_JIT_X64
+// Generates machine code for "m", whose fields must be final.  Leaves "m"
+// interpreted if the code can't be mapped.
+void upb_pb_serializermethod_jit(upb_pb_serializermethod *m);
+void upb_pb_serializermethod_freejit(upb_pb_serializermethod *m);
+#endif
+
+#endif  // UPB_ENCODER_INT_H_
@@ -6,13 +6,13 @@ set verbose off\n\n"
 
 IO.popen("nm -S /tmp/upb-jit-code.so").each_line { |line|
   # Input lines look like this:
-  #   000000000000575a T X.0x10.OP_CHECKDELIM
+  #   000000000000575a T X.DecoderTest.0x10.OP_CHECKDELIM
   #
   # For each one we want to emit a command that looks like:
-  #   b X.0x10.OP_CHECKDELIM
+  #   b X.DecoderTest.0x10.OP_CHECKDELIM
   #   commands
   #     silent
-  #     printf "buf_ofs=%d data_rem=%d delim_rem=%d X.0x10.OP_CHECKDELIM\n", $rbx - (long)((upb_pbdecoder*)($r15))->buf, $r12 - $rbx, $rbp - $rbx
+  #     printf "buf_ofs=%d data_rem=%d delim_rem=%d X.DecoderTest.0x10.OP_CHECKDELIM\n", $rbx - (long)((upb_pbdecoder*)($r15))->buf, $r12 - $rbx, $rbp - $rbx
   #     continue
   #   end
 
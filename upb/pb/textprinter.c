@@ -4,8 +4,9 @@
  * Copyright (c) 2009 Google Inc.  See LICENSE for details.
  * Author: Josh Haberman <jhaberman@gmail.com>
  *
- * OPT: This is not optimized at all.  It uses printf() which parses the format
- * string every time, and it allocates memory for every put.
+ * OPT: This is not optimized much.  It uses printf(), which parses the format
+ * string every time, though it prints into our output buffer rather than
+ * allocating memory for every put.
  */
 
 #include "upb/pb/textprinter.h"
@@ -21,22 +22,57 @@
 
 #define CHECK(x) if ((x) < 0) goto err;
 
+// The size of the buffer that output collects in before we pass it to the
+// sink.
+#define BUFSIZE 16384
+
 static const char *shortname(const char *longname) {
   const char *last = strrchr(longname, '.');
   return last ? last + 1 : longname;
 }
 
+// Allocates the output buffer when we first start a message rather than in
+// upb_textprinter_init(), so that SetAllocator() can still take effect.  If
+// this fails, print() writes straight to the sink.
+static void allocbuf(upb_textprinter *p) {
+  p->buf_ = upb_malloc(p->alloc, BUFSIZE);
+  p->ptr_ = p->buf_;
+  p->end_ = p->buf_ ? p->buf_ + BUFSIZE : NULL;
+}
+
+// Passes the output collected so far to the sink.  We do this when the buffer
+// fills up and at the end of the top-level message.
+static void flush(upb_textprinter *p) {
+  if (p->ptr_ != p->buf_) {
+    upb_bytessink_putbuf(p->output_, p->subc, p->buf_, p->ptr_ - p->buf_, NULL);
+    p->ptr_ = p->buf_;
+  }
+}
+
+static void print(upb_textprinter *p, const char *buf, size_t len) {
+  if (len > (size_t)(p->end_ - p->ptr_)) {
+    flush(p);
+    if (len > (size_t)(p->end_ - p->ptr_)) {
+      // Too big to be worth copying.
+      upb_bytessink_putbuf(p->output_, p->subc, buf, len, NULL);
+      return;
+    }
+  }
+  memcpy(p->ptr_, buf, len);
+  p->ptr_ += len;
+}
+
 static int indent(upb_textprinter *p) {
   int i;
   if (!p->single_line_)
     for (i = 0; i < p->indent_depth_; i++)
-      upb_bytessink_putbuf(p->output_, p->subc, "  ", 2, NULL);
+      print(p, "  ", 2);
   return 0;
 }
 
 static int endfield(upb_textprinter *p) {
   const char ch = (p->single_line_ ? ' ' : '\n');
-  upb_bytessink_putbuf(p->output_, p->subc, &ch, 1, NULL);
+  print(p, &ch, 1);
   return 0;
 }
 
@@ -53,7 +89,7 @@ static int putescaped(upb_textprinter *p, const char *buf, size_t len,
 
   for (; buf < end; buf++) {
     if (dstend - dst < 4) {
-      upb_bytessink_putbuf(p->output_, p->subc, dstbuf, dst - dstbuf, NULL);
+      print(p, dstbuf, dst - dstbuf);
       dst = dstbuf;
     }
 
@@ -81,7 +117,7 @@ static int putescaped(upb_textprinter *p, const char *buf, size_t len,
     last_hex_escape = is_hex_escape;
   }
   // Flush remaining data.
-  upb_bytessink_putbuf(p->output_, p->subc, dstbuf, dst - dstbuf, NULL);
+  print(p, dstbuf, dst - dstbuf);
   return 0;
 }
 
@@ -89,21 +125,41 @@ bool putf(upb_textprinter *p, const char *fmt, ...) {
   va_list args;
   va_start(args, fmt);
 
-  // Run once to get the length of the string.
+  // Try printing straight into the output buffer.  vsnprintf() needs room for
+  // a NULL terminator, even though we don't.
   va_list args_copy;
   va_copy(args_copy, args);
-  int len = vsnprintf(NULL, 0, fmt, args_copy);
+  size_t room = p->end_ - p->ptr_;
+  int len = vsnprintf(p->ptr_, room, fmt, args_copy);
   va_end(args_copy);
+  if (len < 0) {
+    va_end(args);
+    return false;
+  }
 
-  // + 1 for NULL terminator (vsnprintf() requires it even if we don't).
-  char *str = malloc(len + 1);
-  if (!str) return false;
-  int written = vsnprintf(str, len + 1, fmt, args);
-  va_end(args);
-  UPB_ASSERT_VAR(written, written == len);
+  if ((size_t)len < room) {
+    va_end(args);
+    p->ptr_ += len;
+    return true;
+  }
 
-  bool ok = upb_bytessink_putbuf(p->output_, p->subc, str, len, NULL);
-  free(str);
+  flush(p);
+  room = p->end_ - p->ptr_;
+  bool ok = true;
+  if ((size_t)len < room) {
+    vsnprintf(p->ptr_, room, fmt, args);
+    p->ptr_ += len;
+  } else {
+    // Too big for the buffer.
+    char *str = upb_malloc(p->alloc, len + 1);
+    ok = str != NULL;
+    if (ok) {
+      vsnprintf(str, len + 1, fmt, args);
+      upb_bytessink_putbuf(p->output_, p->subc, str, len, NULL);
+      upb_free(p->alloc, str);
+    }
+  }
+  va_end(args);
   return ok;
 }
 
@@ -114,6 +170,7 @@ static bool textprinter_startmsg(void *c, const void *hd) {
   UPB_UNUSED(hd);
   upb_textprinter *p = c;
   if (p->indent_depth_ == 0) {
+    if (!p->buf_) allocbuf(p);
     upb_bytessink_start(p->output_, 0, &p->subc);
   }
   return true;
@@ -124,6 +181,7 @@ static bool textprinter_endmsg(void *c, const void *hd, upb_status *s) {
   UPB_UNUSED(s);
   upb_textprinter *p = c;
   if (p->indent_depth_ == 0) {
+    flush(p);
     upb_bytessink_end(p->output_);
   }
   return true;
@@ -229,7 +287,7 @@ static bool textprinter_endsubmsg(void *closure, const void *handler_data) {
   upb_textprinter *p = closure;
   p->indent_depth_--;
   CHECK(indent(p));
-  upb_bytessink_putbuf(p->output_, p->subc, "}", 1, NULL);
+  print(p, "}", 1);
   CHECK(endfield(p));
   return true;
 err:
@@ -242,16 +300,21 @@ err:
 void upb_textprinter_init(upb_textprinter *p, const upb_handlers *h) {
   p->single_line_ = false;
   p->indent_depth_ = 0;
+  p->alloc = &upb_alloc_global;
+  p->buf_ = NULL;
+  p->ptr_ = NULL;
+  p->end_ = NULL;
   upb_sink_reset(&p->input_, h, p);
 }
 
 void upb_textprinter_uninit(upb_textprinter *p) {
-  UPB_UNUSED(p);
+  upb_free(p->alloc, p->buf_);
 }
 
 void upb_textprinter_reset(upb_textprinter *p, bool single_line) {
   p->single_line_ = single_line;
   p->indent_depth_ = 0;
+  p->ptr_ = p->buf_;
 }
 
 static void onmreg(const void *c, upb_handlers *h) {
@@ -320,9 +383,16 @@ upb_sink *upb_textprinter_input(upb_textprinter *p) { return &p->input_; }
 
 bool upb_textprinter_resetoutput(upb_textprinter *p, upb_bytessink *output) {
   p->output_ = output;
+  p->ptr_ = p->buf_;
   return true;
 }
 
 void upb_textprinter_setsingleline(upb_textprinter *p, bool single_line) {
   p->single_line_ = single_line;
 }
+
+void upb_textprinter_setalloc(upb_textprinter *p, upb_alloc *alloc) {
+  // We can't switch allocators once we've allocated from the old one.
+  assert(!p->buf_);
+  p->alloc = alloc;
+}
@@ -25,9 +25,15 @@ UPB_DEFINE_CLASS0(upb::pb::TextPrinter,
   // The given handlers must have come from NewHandlers().  It must outlive the
   // TextPrinter.
   explicit TextPrinter(const upb::Handlers* handlers);
+  ~TextPrinter();
 
   void SetSingleLineMode(bool single_line);
 
+  // Sets the allocator for the printer's output buffer, for example an Arena
+  // that holds all memory for the current request.  Must be called before
+  // anything is printed.
+  void SetAllocator(Allocator* alloc);
+
   bool ResetOutput(BytesSink* output);
   Sink* input();
 
@@ -43,6 +49,13 @@ UPB_DEFINE_STRUCT0(upb_textprinter,
   int indent_depth_;
   bool single_line_;
   void *subc;
+
+  // Output that we haven't passed to "output_" yet, in a buffer from "alloc"
+  // that we allocate when we first print something.
+  upb_alloc *alloc;
+  char *buf_;
+  char *ptr_;
+  char *end_;
 ));
 
 UPB_BEGIN_EXTERN_C  // {
@@ -52,6 +65,7 @@ void upb_textprinter_init(upb_textprinter *p, const upb_handlers *h);
 void upb_textprinter_uninit(upb_textprinter *p);
 bool upb_textprinter_resetoutput(upb_textprinter *p, upb_bytessink *output);
 void upb_textprinter_setsingleline(upb_textprinter *p, bool single_line);
+void upb_textprinter_setalloc(upb_textprinter *p, upb_alloc *alloc);
 upb_sink *upb_textprinter_input(upb_textprinter *p);
 
 const upb_handlers *upb_textprinter_newhandlers(const upb_msgdef *m,
@@ -66,9 +80,13 @@ namespace pb {
 inline TextPrinter::TextPrinter(const upb::Handlers* handlers) {
   upb_textprinter_init(this, handlers);
 }
+inline TextPrinter::~TextPrinter() { upb_textprinter_uninit(this); }
 inline void TextPrinter::SetSingleLineMode(bool single_line) {
   upb_textprinter_setsingleline(this, single_line);
 }
+inline void TextPrinter::SetAllocator(Allocator* alloc) {
+  upb_textprinter_setalloc(this, alloc);
+}
 inline bool TextPrinter::ResetOutput(BytesSink* output) {
   return upb_textprinter_resetoutput(this, output);
 }
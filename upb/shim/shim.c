@@ -7,7 +7,35 @@
 
 #include "upb/shim/shim.h"
 
-#include <stdlib.h>
+#include <string.h>
+
+static upb_shim_data *newdata(upb_handlers *h, size_t offset, int32_t hasbit) {
+  upb_shim_data *d = upb_malloc(upb_handlers_alloc(h), sizeof(*d));
+  if (!d) return NULL;
+  d->offset = offset;
+  d->hasbit = hasbit;
+  d->arena_offset = -1;
+  d->size = 0;
+  d->wiresize = 0;
+  d->child_arena_offset = -1;
+  return d;
+}
+
+static void sethas(uint8_t *m, int32_t hasbit) {
+  if (hasbit >= 0) m[hasbit / 8] |= 1 << (hasbit % 8);
+}
+
+// Returns the allocator of the arena that closure "m" points to, or NULL.
+static upb_alloc *getalloc(uint8_t *m, const upb_shim_data *d) {
+  upb_arena *a;
+  if (d->arena_offset < 0) return NULL;
+  memcpy(&a, &m[d->arena_offset], sizeof(a));
+  return a ? upb_arena_alloc(a) : NULL;
+}
+
+// A shim's handler function as the upb_func* that upb_handlers_gethandler()
+// returns.  Going through void (*)(void) keeps -Wcast-function-type quiet.
+#define SHIMFUNC(f) ((upb_func*)(void (*)(void))(f))
 
 // Fallback implementation if the shim is not specialized by the JIT.
 #define SHIM_WRITER(type, ctype)                                              \
@@ -31,15 +59,12 @@ SHIM_WRITER(bool,   bool)
 
 bool upb_shim_set(upb_handlers *h, const upb_fielddef *f, size_t offset,
                   int32_t hasbit) {
-  upb_shim_data *d = malloc(sizeof(*d));
+  upb_shim_data *d = newdata(h, offset, hasbit);
   if (!d) return false;
-  d->offset = offset;
-  d->hasbit = hasbit;
 
   upb_handlerattr attr = UPB_HANDLERATTR_INITIALIZER;
   upb_handlerattr_sethandlerdata(&attr, d);
   upb_handlerattr_setalwaysok(&attr, true);
-  upb_handlers_addcleanup(h, d, free);
 
 #define TYPE(u, l) \
   case UPB_TYPE_##u: \
@@ -68,19 +93,19 @@ const upb_shim_data *upb_shim_getdata(const upb_handlers *h, upb_selector_t s,
                                       upb_fieldtype_t *type) {
   upb_func *f = upb_handlers_gethandler(h, s);
 
-  if ((upb_int64_handlerfunc*)f == upb_shim_setint64) {
+  if (f == SHIMFUNC(upb_shim_setint64)) {
     *type = UPB_TYPE_INT64;
-  } else if ((upb_int32_handlerfunc*)f == upb_shim_setint32) {
+  } else if (f == SHIMFUNC(upb_shim_setint32)) {
     *type = UPB_TYPE_INT32;
-  } else if ((upb_uint64_handlerfunc*)f == upb_shim_setuint64) {
+  } else if (f == SHIMFUNC(upb_shim_setuint64)) {
     *type = UPB_TYPE_UINT64;
-  } else if ((upb_uint32_handlerfunc*)f == upb_shim_setuint32) {
+  } else if (f == SHIMFUNC(upb_shim_setuint32)) {
     *type = UPB_TYPE_UINT32;
-  } else if ((upb_double_handlerfunc*)f == upb_shim_setdouble) {
+  } else if (f == SHIMFUNC(upb_shim_setdouble)) {
     *type = UPB_TYPE_DOUBLE;
-  } else if ((upb_float_handlerfunc*)f == upb_shim_setfloat) {
+  } else if (f == SHIMFUNC(upb_shim_setfloat)) {
     *type = UPB_TYPE_FLOAT;
-  } else if ((upb_bool_handlerfunc*)f == upb_shim_setbool) {
+  } else if (f == SHIMFUNC(upb_shim_setbool)) {
     *type = UPB_TYPE_BOOL;
   } else {
     return NULL;
@@ -88,3 +113,257 @@ const upb_shim_data *upb_shim_getdata(const upb_handlers *h, upb_selector_t s,
 
   return (const upb_shim_data*)upb_handlers_gethandlerdata(h, s);
 }
+
+
+/* String views ***************************************************************/
+
+static void *startstrview(void *c, const void *hd, size_t size_hint) {
+  uint8_t *m = c;
+  const upb_shim_data *d = hd;
+  upb_shim_strview *v = (upb_shim_strview*)&m[d->offset];
+  UPB_UNUSED(size_hint);
+  sethas(m, d->hasbit);
+  v->data = NULL;
+  v->size = 0;
+  return c;
+}
+
+static size_t strview(void *c, const void *hd, const char *buf, size_t n,
+                      const upb_bufhandle *handle) {
+  uint8_t *m = c;
+  const upb_shim_data *d = hd;
+  upb_shim_strview *v = (upb_shim_strview*)&m[d->offset];
+  UPB_UNUSED(handle);
+
+  if (v->size == 0) {
+    v->data = buf;
+    v->size = n;
+    return n;
+  } else if (v->data + v->size == buf) {
+    v->size += n;
+    return n;
+  }
+
+  // The string is split across buffers, so we can't alias it.
+  // OPT: strings split into many pieces are copied once per piece.
+  upb_alloc *alloc = getalloc(m, d);
+  char *copy = alloc ? upb_malloc(alloc, v->size + n) : NULL;
+  if (!copy) return 0;
+  memcpy(copy, v->data, v->size);
+  memcpy(copy + v->size, buf, n);
+  v->data = copy;
+  v->size += n;
+  return n;
+}
+
+bool upb_shim_setstrview(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                         int32_t hasbit, int32_t arena_offset) {
+  assert(upb_fielddef_isstring(f) && !upb_fielddef_isseq(f));
+  upb_shim_data *d = newdata(h, offset, hasbit);
+  if (!d) return false;
+  d->arena_offset = arena_offset;
+
+  upb_handlerattr attr = UPB_HANDLERATTR_INITIALIZER;
+  upb_handlerattr_sethandlerdata(&attr, d);
+  upb_handlerattr_setalwaysok(&attr, true);
+  bool ok = upb_handlers_setstartstr(h, f, startstrview, &attr);
+  upb_handlerattr_uninit(&attr);
+
+  // Copying a split string can run out of memory.
+  upb_handlerattr_init(&attr);
+  upb_handlerattr_sethandlerdata(&attr, d);
+  ok = ok && upb_handlers_setstring(h, f, strview, &attr);
+  upb_handlerattr_uninit(&attr);
+  return ok;
+}
+
+const upb_shim_data *upb_shim_getstrview(const upb_handlers *h,
+                                         upb_selector_t s) {
+  upb_func *f = upb_handlers_gethandler(h, s);
+  if (f != SHIMFUNC(startstrview) && f != SHIMFUNC(strview)) return NULL;
+  return (const upb_shim_data*)upb_handlers_gethandlerdata(h, s);
+}
+
+
+/* Arrays *********************************************************************/
+
+// Makes room for at least "size" elements.
+static bool reserve(uint8_t *m, const upb_shim_data *d, upb_shim_array *arr,
+                    size_t size) {
+  if (size <= arr->size) return true;
+  upb_alloc *alloc = getalloc(m, d);
+  void *data = alloc ? upb_realloc(alloc, arr->data, arr->size * d->size,
+                                   size * d->size)
+                     : NULL;
+  if (!data) return false;
+  arr->data = data;
+  arr->size = size;
+  return true;
+}
+
+static void *startarray(void *c, const void *hd, size_t size_hint) {
+  uint8_t *m = c;
+  const upb_shim_data *d = hd;
+  upb_shim_array *arr = (upb_shim_array*)&m[d->offset];
+  sethas(m, d->hasbit);
+  if (d->wiresize > 0) {
+    // The hint is exact for packed fixed-width fields.  If this fails, the
+    // appends will try again and report it.
+    reserve(m, d, arr, arr->len + size_hint / d->wiresize);
+  }
+  return c;
+}
+
+#define SHIM_APPENDER(type, ctype)                                            \
+  static bool append ## type (void *c, const void *hd, ctype val) {          \
+    uint8_t *m = c;                                                           \
+    const upb_shim_data *d = hd;                                              \
+    upb_shim_array *arr = (upb_shim_array*)&m[d->offset];                     \
+    if (arr->len == arr->size &&                                              \
+        !reserve(m, d, arr, UPB_MAX(arr->size * 2, 8))) {                     \
+      return false;                                                           \
+    }                                                                         \
+    ((ctype*)arr->data)[arr->len++] = val;                                    \
+    return true;                                                              \
+  }                                                                           \
+
+SHIM_APPENDER(double, double)
+SHIM_APPENDER(float,  float)
+SHIM_APPENDER(int32,  int32_t)
+SHIM_APPENDER(int64,  int64_t)
+SHIM_APPENDER(uint32, uint32_t)
+SHIM_APPENDER(uint64, uint64_t)
+SHIM_APPENDER(bool,   bool)
+#undef SHIM_APPENDER
+
+bool upb_shim_setarray(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                       int32_t hasbit, int32_t arena_offset) {
+  assert(upb_fielddef_isseq(f) && upb_fielddef_isprimitive(f));
+  upb_shim_data *d = newdata(h, offset, hasbit);
+  if (!d) return false;
+  d->arena_offset = arena_offset;
+
+  switch (upb_fielddef_descriptortype(f)) {
+    case UPB_DESCRIPTOR_TYPE_FIXED32:
+    case UPB_DESCRIPTOR_TYPE_SFIXED32:
+    case UPB_DESCRIPTOR_TYPE_FLOAT:
+      d->wiresize = 4;
+      break;
+    case UPB_DESCRIPTOR_TYPE_FIXED64:
+    case UPB_DESCRIPTOR_TYPE_SFIXED64:
+    case UPB_DESCRIPTOR_TYPE_DOUBLE:
+      d->wiresize = 8;
+      break;
+    default:
+      break;
+  }
+
+  upb_handlerattr attr = UPB_HANDLERATTR_INITIALIZER;
+  upb_handlerattr_sethandlerdata(&attr, d);
+  upb_handlerattr_setalwaysok(&attr, true);
+  bool ok = upb_handlers_setstartseqhint(h, f, startarray, &attr);
+  upb_handlerattr_uninit(&attr);
+
+  // Growing the array can run out of memory.
+  upb_handlerattr_init(&attr);
+  upb_handlerattr_sethandlerdata(&attr, d);
+
+#define TYPE(u, l, ctype) \
+  case UPB_TYPE_##u: \
+    d->size = sizeof(ctype); \
+    ok = ok && upb_handlers_set##l(h, f, append##l, &attr); break;
+
+  switch (upb_fielddef_type(f)) {
+    TYPE(INT64,  int64,  int64_t);
+    TYPE(INT32,  int32,  int32_t);
+    TYPE(ENUM,   int32,  int32_t);
+    TYPE(UINT64, uint64, uint64_t);
+    TYPE(UINT32, uint32, uint32_t);
+    TYPE(DOUBLE, double, double);
+    TYPE(FLOAT,  float,  float);
+    TYPE(BOOL,   bool,   bool);
+    default: assert(false); ok = false; break;
+  }
+#undef TYPE
+
+  upb_handlerattr_uninit(&attr);
+  return ok;
+}
+
+const upb_shim_data *upb_shim_getarray(const upb_handlers *h, upb_selector_t s,
+                                       upb_fieldtype_t *type) {
+  upb_func *f = upb_handlers_gethandler(h, s);
+
+  if (f == SHIMFUNC(startarray)) {
+    // No type for the StartSequence selector.
+  } else if (f == SHIMFUNC(appendint64)) {
+    *type = UPB_TYPE_INT64;
+  } else if (f == SHIMFUNC(appendint32)) {
+    *type = UPB_TYPE_INT32;
+  } else if (f == SHIMFUNC(appenduint64)) {
+    *type = UPB_TYPE_UINT64;
+  } else if (f == SHIMFUNC(appenduint32)) {
+    *type = UPB_TYPE_UINT32;
+  } else if (f == SHIMFUNC(appenddouble)) {
+    *type = UPB_TYPE_DOUBLE;
+  } else if (f == SHIMFUNC(appendfloat)) {
+    *type = UPB_TYPE_FLOAT;
+  } else if (f == SHIMFUNC(appendbool)) {
+    *type = UPB_TYPE_BOOL;
+  } else {
+    return NULL;
+  }
+
+  return (const upb_shim_data*)upb_handlers_gethandlerdata(h, s);
+}
+
+
+/* Submessages ****************************************************************/
+
+static void *startsubmsg(void *c, const void *hd) {
+  uint8_t *m = c;
+  const upb_shim_data *d = hd;
+  uint8_t *child;
+  memcpy(&child, &m[d->offset], sizeof(child));
+
+  if (!child) {
+    upb_alloc *alloc = getalloc(m, d);
+    child = alloc ? upb_malloc(alloc, d->size) : NULL;
+    if (!child) return UPB_BREAK;
+    memset(child, 0, d->size);
+    if (d->child_arena_offset >= 0) {
+      memcpy(&child[d->child_arena_offset], &m[d->arena_offset],
+             sizeof(upb_arena*));
+    }
+    memcpy(&m[d->offset], &child, sizeof(child));
+  }
+
+  sethas(m, d->hasbit);
+  return child;
+}
+
+bool upb_shim_setsubmsg(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                        int32_t hasbit, size_t size, int32_t arena_offset,
+                        int32_t child_arena_offset) {
+  assert(upb_fielddef_issubmsg(f) && !upb_fielddef_isseq(f));
+  assert(size > 0 && arena_offset >= 0);
+  upb_shim_data *d = newdata(h, offset, hasbit);
+  if (!d) return false;
+  d->arena_offset = arena_offset;
+  d->size = size;
+  d->child_arena_offset = child_arena_offset;
+
+  // Allocating the child can run out of memory, so this is not alwaysok.
+  upb_handlerattr attr = UPB_HANDLERATTR_INITIALIZER;
+  upb_handlerattr_sethandlerdata(&attr, d);
+  bool ok = upb_handlers_setstartsubmsg(h, f, startsubmsg, &attr);
+  upb_handlerattr_uninit(&attr);
+  return ok;
+}
+
+const upb_shim_data *upb_shim_getsubmsg(const upb_handlers *h,
+                                        upb_selector_t s) {
+  upb_func *f = upb_handlers_gethandler(h, s);
+  if (f != SHIMFUNC(startsubmsg)) return NULL;
+  return (const upb_shim_data*)upb_handlers_gethandlerdata(h, s);
+}
@@ -11,8 +11,12 @@
  * handlers and emit specialized code for them instead of actually calling the
  * handler.
  *
- * The functionality is very simple/limited right now but may expand to be able
- * to call another function.
+ * Besides storing scalars, shims can store strings, append to repeated scalar
+ * fields and allocate submessages, which is enough to decode into plain C
+ * structs without calling any functions on the common path.  Those shims need
+ * memory, which they get from a upb_arena that the closure points to: the
+ * closure stores a "upb_arena*" at a caller-chosen offset, and the submessage
+ * shim copies it into each child it allocates.
  */
 
 #ifndef UPB_SHIM_H
@@ -23,14 +27,48 @@
 typedef struct {
   size_t offset;
   int32_t hasbit;
+
+  // The members below are only used by the string, array and submessage shims.
+
+  // Offset of the "upb_arena*" in the closure, or -1 if there is none.
+  int32_t arena_offset;
+
+  // Arrays: sizeof() one element.  Submessages: sizeof() the child struct.
+  size_t size;
+
+  // Arrays: encoded size of one packed element if it is fixed, otherwise 0.
+  uint32_t wiresize;
+
+  // Submessages: offset of the "upb_arena*" in the child, or -1.
+  int32_t child_arena_offset;
 } upb_shim_data;
 
+// What the string shim stores.  "data" points into the decoder's input buffer
+// when the string arrived in a single piece (which is the common case), so the
+// input must outlive the struct.  Strings that were split across buffers are
+// copied into the arena instead.
+typedef struct {
+  const char *data;
+  size_t size;
+} upb_shim_strview;
+
+// What the array shim appends to: "len" of "size" elements at "data" are in
+// use.  "data" may start out as NULL or as a caller-provided buffer; when it is
+// full it is replaced with a bigger one from the arena.
+typedef struct {
+  void *data;
+  size_t len;
+  size_t size;
+} upb_shim_array;
+
 #ifdef __cplusplus
 
 namespace upb {
 
 struct Shim {
   typedef upb_shim_data Data;
+  typedef upb_shim_strview StringView;
+  typedef upb_shim_array Array;
 
   // Sets a handler for the given field that writes the value to the given
   // offset and, if hasbit >= 0, sets a bit at the given bit offset.  Returns
@@ -41,6 +79,39 @@ struct Shim {
   // stores the type in "type".  Otherwise returns NULL.
   static const Data* GetData(const Handlers* h, Handlers::Selector s,
                              FieldDef::Type* type);
+
+  // Sets handlers for the given string/bytes field that store a StringView at
+  // the given offset and, if hasbit >= 0, set the hasbit.  The arena is only
+  // needed for strings split across buffers; without one (arena_ofs == -1)
+  // those fail to parse.
+  static bool SetStringView(Handlers* h, const FieldDef* f, size_t ofs,
+                            int32_t hasbit, int32_t arena_ofs);
+
+  // Sets handlers for the given repeated scalar field that append its values
+  // to the Array at the given offset and, if hasbit >= 0, set the hasbit.
+  // Growing the array requires an arena.  Packed fixed-width fields are
+  // reserved up front, using the size hint.
+  static bool SetArray(Handlers* h, const FieldDef* f, size_t ofs,
+                       int32_t hasbit, int32_t arena_ofs);
+
+  // Sets a handler for the given non-repeated submessage field that allocates
+  // a zeroed child struct of "size" bytes from the arena (unless the pointer
+  // at "ofs" is already set), stores the pointer at "ofs" and sets the hasbit
+  // if hasbit >= 0.  The child becomes the closure for the submessage, and if
+  // child_arena_ofs >= 0 the arena pointer is copied there.  The caller must
+  // still set handlers for the submessage itself.
+  static bool SetSubMessage(Handlers* h, const FieldDef* f, size_t ofs,
+                            int32_t hasbit, size_t size, int32_t arena_ofs,
+                            int32_t child_arena_ofs);
+
+  // If the handler for "s" was set by the corresponding function above,
+  // returns its data.  Otherwise returns NULL.  "s" may be the StartString or
+  // String selector for GetStringViewData(), and the StartSequence or value
+  // selector for GetArrayData(), which only sets "type" for the latter.
+  static const Data* GetStringViewData(const Handlers* h, Handlers::Selector s);
+  static const Data* GetArrayData(const Handlers* h, Handlers::Selector s,
+                                  FieldDef::Type* type);
+  static const Data* GetSubMessageData(const Handlers* h, Handlers::Selector s);
 };
 
 }  // namespace upb
@@ -54,6 +125,19 @@ bool upb_shim_set(upb_handlers *h, const upb_fielddef *f, size_t offset,
                   int32_t hasbit);
 const upb_shim_data *upb_shim_getdata(const upb_handlers *h, upb_selector_t s,
                                       upb_fieldtype_t *type);
+bool upb_shim_setstrview(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                         int32_t hasbit, int32_t arena_offset);
+bool upb_shim_setarray(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                       int32_t hasbit, int32_t arena_offset);
+bool upb_shim_setsubmsg(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                        int32_t hasbit, size_t size, int32_t arena_offset,
+                        int32_t child_arena_offset);
+const upb_shim_data *upb_shim_getstrview(const upb_handlers *h,
+                                         upb_selector_t s);
+const upb_shim_data *upb_shim_getarray(const upb_handlers *h, upb_selector_t s,
+                                       upb_fieldtype_t *type);
+const upb_shim_data *upb_shim_getsubmsg(const upb_handlers *h,
+                                        upb_selector_t s);
 
 UPB_END_EXTERN_C  // }
 
@@ -68,6 +152,33 @@ inline const Shim::Data* Shim::GetData(const Handlers* h, Handlers::Selector s,
                                        FieldDef::Type* type) {
   return upb_shim_getdata(h, s, type);
 }
+inline bool Shim::SetStringView(Handlers* h, const FieldDef* f, size_t ofs,
+                                int32_t hasbit, int32_t arena_ofs) {
+  return upb_shim_setstrview(h, f, ofs, hasbit, arena_ofs);
+}
+inline bool Shim::SetArray(Handlers* h, const FieldDef* f, size_t ofs,
+                           int32_t hasbit, int32_t arena_ofs) {
+  return upb_shim_setarray(h, f, ofs, hasbit, arena_ofs);
+}
+inline bool Shim::SetSubMessage(Handlers* h, const FieldDef* f, size_t ofs,
+                                int32_t hasbit, size_t size, int32_t arena_ofs,
+                                int32_t child_arena_ofs) {
+  return upb_shim_setsubmsg(h, f, ofs, hasbit, size, arena_ofs,
+                            child_arena_ofs);
+}
+inline const Shim::Data* Shim::GetStringViewData(const Handlers* h,
+                                                 Handlers::Selector s) {
+  return upb_shim_getstrview(h, s);
+}
+inline const Shim::Data* Shim::GetArrayData(const Handlers* h,
+                                            Handlers::Selector s,
+                                            FieldDef::Type* type) {
+  return upb_shim_getarray(h, s, type);
+}
+inline const Shim::Data* Shim::GetSubMessageData(const Handlers* h,
+                                                 Handlers::Selector s) {
+  return upb_shim_getsubmsg(h, s);
+}
 }  // namespace upb
 #endif
 
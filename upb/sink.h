@@ -155,8 +155,10 @@ UPB_DEFINE_CLASS0(upb::Sink,
   //
   // For StartSubMessage(), the function will write a sink for the string to
   // "sub." The sub-sink must be used for any/all handlers called within the
-  // submessage.
+  // submessage.  If the encoded length of the submessage is known, passing it
+  // as "size_hint" lets handlers preallocate; 0 means unknown.
   bool StartSubMessage(Handlers::Selector s, Sink* sub);
+  bool StartSubMessage(Handlers::Selector s, size_t size_hint, Sink* sub);
   bool EndSubMessage(Handlers::Selector s);
 
   // For repeated fields of any type, the sequence of values must be wrapped in
@@ -164,8 +166,9 @@ UPB_DEFINE_CLASS0(upb::Sink,
   //
   // For StartSequence(), the function will write a sink for the string to
   // "sub." The sub-sink must be used for any/all handlers called within the
-  // sequence.
+  // sequence.  "size_hint" is as for StartSubMessage().
   bool StartSequence(Handlers::Selector s, Sink* sub);
+  bool StartSequence(Handlers::Selector s, size_t size_hint, Sink* sub);
   bool EndSequence(Handlers::Selector s);
 
   // Copy and assign specifically allowed.
@@ -349,20 +352,32 @@ UPB_INLINE bool upb_sink_endmsg(upb_sink *s, upb_status *status) {
   return endmsg(s->closure, hd, status);
 }
 
-UPB_INLINE bool upb_sink_startseq(upb_sink *s, upb_selector_t sel,
-                                  upb_sink *sub) {
+// "size_hint" is the encoded length of the sequence in bytes if it is known
+// (ie. for packed fields), otherwise 0.  It is only passed along to handlers
+// that were registered with upb_handlers_setstartseqhint().
+UPB_INLINE bool upb_sink_startseqhint(upb_sink *s, upb_selector_t sel,
+                                      size_t size_hint, upb_sink *sub) {
   sub->closure = s->closure;
   sub->handlers = s->handlers;
   if (!s->handlers) return true;
-  upb_startfield_handlerfunc *startseq =
-      (upb_startfield_handlerfunc*)upb_handlers_gethandler(s->handlers, sel);
+  upb_func *startseq = upb_handlers_gethandler(s->handlers, sel);
 
   if (!startseq) return true;
   const void *hd = upb_handlers_gethandlerdata(s->handlers, sel);
-  sub->closure = startseq(s->closure, hd);
+  if (upb_handlers_takessizehint(s->handlers, sel)) {
+    sub->closure = ((upb_startfieldhint_handlerfunc*)startseq)(
+        s->closure, hd, size_hint);
+  } else {
+    sub->closure = ((upb_startfield_handlerfunc*)startseq)(s->closure, hd);
+  }
   return sub->closure ? true : false;
 }
 
+UPB_INLINE bool upb_sink_startseq(upb_sink *s, upb_selector_t sel,
+                                  upb_sink *sub) {
+  return upb_sink_startseqhint(s, sel, 0, sub);
+}
+
 UPB_INLINE bool upb_sink_endseq(upb_sink *s, upb_selector_t sel) {
   if (!s->handlers) return true;
   upb_endfield_handlerfunc *endseq =
@@ -397,23 +412,34 @@ UPB_INLINE bool upb_sink_endstr(upb_sink *s, upb_selector_t sel) {
   return endstr(s->closure, hd);
 }
 
-UPB_INLINE bool upb_sink_startsubmsg(upb_sink *s, upb_selector_t sel,
-                                     upb_sink *sub) {
+// Like upb_sink_startseqhint(), "size_hint" is the encoded length of the
+// submessage if it is known, otherwise 0.
+UPB_INLINE bool upb_sink_startsubmsghint(upb_sink *s, upb_selector_t sel,
+                                         size_t size_hint, upb_sink *sub) {
   sub->closure = s->closure;
   if (!s->handlers) {
     sub->handlers = NULL;
     return true;
   }
   sub->handlers = upb_handlers_getsubhandlers_sel(s->handlers, sel);
-  upb_startfield_handlerfunc *startsubmsg =
-      (upb_startfield_handlerfunc*)upb_handlers_gethandler(s->handlers, sel);
+  upb_func *startsubmsg = upb_handlers_gethandler(s->handlers, sel);
 
   if (!startsubmsg) return true;
   const void *hd = upb_handlers_gethandlerdata(s->handlers, sel);
-  sub->closure = startsubmsg(s->closure, hd);
+  if (upb_handlers_takessizehint(s->handlers, sel)) {
+    sub->closure = ((upb_startfieldhint_handlerfunc*)startsubmsg)(
+        s->closure, hd, size_hint);
+  } else {
+    sub->closure = ((upb_startfield_handlerfunc*)startsubmsg)(s->closure, hd);
+  }
   return sub->closure ? true : false;
 }
 
+UPB_INLINE bool upb_sink_startsubmsg(upb_sink *s, upb_selector_t sel,
+                                     upb_sink *sub) {
+  return upb_sink_startsubmsghint(s, sel, 0, sub);
+}
+
 UPB_INLINE bool upb_sink_endsubmsg(upb_sink *s, upb_selector_t sel) {
   if (!s->handlers) return true;
   upb_endfield_handlerfunc *endsubmsg =
@@ -478,12 +504,20 @@ inline bool Sink::EndString(Handlers::Selector sel) {
 inline bool Sink::StartSubMessage(Handlers::Selector sel, Sink* sub) {
   return upb_sink_startsubmsg(this, sel, sub);
 }
+inline bool Sink::StartSubMessage(Handlers::Selector sel, size_t size_hint,
+                                  Sink* sub) {
+  return upb_sink_startsubmsghint(this, sel, size_hint, sub);
+}
 inline bool Sink::EndSubMessage(Handlers::Selector sel) {
   return upb_sink_endsubmsg(this, sel);
 }
 inline bool Sink::StartSequence(Handlers::Selector sel, Sink* sub) {
   return upb_sink_startseq(this, sel, sub);
 }
+inline bool Sink::StartSequence(Handlers::Selector sel, size_t size_hint,
+                                Sink* sub) {
+  return upb_sink_startseqhint(this, sel, size_hint, sub);
+}
 inline bool Sink::EndSequence(Handlers::Selector sel) {
   return upb_sink_endseq(this, sel);
 }
@@ -55,6 +55,7 @@ upb_symtab *upb_symtab_new(const void *owner) {
 void upb_symtab_freeze(upb_symtab *s) {
   assert(!upb_symtab_isfrozen(s));
   upb_refcounted *r = UPB_UPCAST(s);
+  upb_strtable_compact(&s->symtab);
   // The symtab does not take ref2's (see refcounted.h) on the defs, because
   // defs cannot refer back to the table and therefore cannot create cycles.  So
   // 0 will suffice for maxdepth here.
@@ -12,13 +12,33 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef UPB_HAVE_CRC32C
+#include <nmmintrin.h>
+#endif
+
+// The hash function for the string keys of tables built at runtime.
+#if defined(UPB_TABLE_HASH_MURMUR2)
+#define UPB_TABLE_HASH UPB_HASH_MURMUR2
+#elif defined(UPB_TABLE_HASH_CRC32C)
+#ifndef UPB_HAVE_CRC32C
+#error "UPB_TABLE_HASH_CRC32C requires SSE4.2 (eg. -msse4.2)"
+#endif
+#define UPB_TABLE_HASH UPB_HASH_CRC32C
+#else
+#define UPB_TABLE_HASH UPB_HASH_WYHASH
+#endif
+
 #define UPB_MAXARRSIZE 16  // 64k.
 
 // From Chromium.
 #define ARRAY_SIZE(x) \
     ((sizeof(x)/sizeof(0[x])) / ((size_t)(!(sizeof(x) % sizeof(0[x])))))
 
+#ifdef UPB_USE_SWISSTABLE
+static const double MAX_LOAD = 0.875;
+#else
 static const double MAX_LOAD = 0.85;
+#endif
 
 // The minimum utilization of the array part of a mixed hash/array table.  This
 // is a speed/memory-usage tradeoff (though it's not straightforward because of
@@ -50,24 +70,28 @@ char *upb_strdup2(const char *s, size_t len) {
 }
 
 // A type to represent the lookup key of either a strtable or an inttable.
-typedef struct {
-  upb_tabkey key;
+// Unlike a upb_tabkey, a string here is just a pointer and length.
+typedef union {
+  struct {
+    const char *str;
+    size_t len;
+  } str;
+  uintptr_t num;
 } lookupkey_t;
 
 static lookupkey_t strkey2(const char *str, size_t len) {
   lookupkey_t k;
-  k.key.s.str = (char*)str;
-  k.key.s.length = len;
+  k.str.str = str;
+  k.str.len = len;
   return k;
 }
 
 static lookupkey_t intkey(uintptr_t key) {
   lookupkey_t k;
-  k.key = upb_intkey(key);
+  k.num = key;
   return k;
 }
 
-typedef uint32_t hashfunc_t(upb_tabkey key);
 typedef bool eqlfunc_t(upb_tabkey k1, lookupkey_t k2);
 
 /* Base table (shared code) ***************************************************/
@@ -78,9 +102,211 @@ static upb_tabent *mutable_entries(upb_table *t) {
 }
 
 static bool isfull(upb_table *t) {
+#ifdef UPB_USE_SWISSTABLE
+  // Tombstones take up slots as much as entries do.
+  return (double)(t->count + t->deleted + 1) / upb_table_size(t) > MAX_LOAD;
+#else
   return (double)(t->count + 1) / upb_table_size(t) > MAX_LOAD;
+#endif
+}
+
+// The size to rebuild "t" at when it is full.
+static uint8_t grow_lg2(const upb_table *t) {
+#ifdef UPB_USE_SWISSTABLE
+  // If it is mostly tombstones, rebuilding at the same size will do.
+  if (t->count + 1 <= upb_table_size(t) * MAX_LOAD / 2) return t->size_lg2;
+#endif
+  return t->size_lg2 + 1;
+}
+
+// Looks up "key" in a table with the chained layout.
+static const upb_tabent *findentry(const upb_table *t, lookupkey_t key,
+                                   uint32_t hash, eqlfunc_t *eql) {
+  if (t->size_lg2 == 0) return NULL;
+  const upb_tabent *e = upb_getentry(t, hash);
+  if (upb_tabent_isempty(e)) return NULL;
+  while (1) {
+    if (e->hash == hash && eql(e->key, key)) return e;
+    if ((e = e->next) == NULL) return NULL;
+  }
+}
+
+#ifdef UPB_USE_SWISSTABLE
+
+// Tables built at runtime are open-addressed, in the style of Google's "Swiss
+// tables" (absl::flat_hash_map).  Next to the slots is an array of control
+// bytes, one per slot: EMPTY, DELETED (a tombstone) or, for a full slot, 7
+// bits of its key's hash.  A lookup hashes the key once and then scans a
+// group of control bytes at a time -- 16 with SSE2 -- comparing keys only in
+// the slots whose control byte matches, until it reaches a group with an
+// empty slot.  So a miss rarely compares a key at all.  The slots hold just
+// keys and values, with no chain pointers.
+//
+// There are GROUP control bytes past the end that mirror the first GROUP
+// slots (repeatedly, in tables smaller than that), so that a group can start
+// at any slot.
+//
+// Statically-initialized tables still have the chained layout; their
+// "entries" are non-NULL and we look them up as before.  They are never
+// modified.
+
+#define EMPTY UPB_SWISS_EMPTY
+#define DELETED 0xfe
+#define GROUP UPB_SWISS_GROUP
+
+// Returns a mask of the empty or deleted slots in the group at "ctrl".
+static unsigned group_free(const uint8_t *ctrl) {
+#ifdef __SSE2__
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+  unsigned mask = 0;
+  int i;
+  for (i = 0; i < GROUP; i++) mask |= (unsigned)(ctrl[i] >> 7) << i;
+  return mask;
+#endif
+}
+
+static uint8_t *mutable_ctrl(upb_table *t) { return (uint8_t*)t->ctrl; }
+
+static upb_tabslot *mutable_slots(upb_table *t) {
+  return (upb_tabslot*)t->slots;
+}
+
+static void setctrl(upb_table *t, size_t i, uint8_t c) {
+  size_t size = upb_table_size(t);
+  uint8_t *ctrl = mutable_ctrl(t);
+  size_t j;
+  ctrl[i] = c;
+  for (j = i; j < GROUP; j += size) ctrl[size + j] = c;
+}
+
+static bool init(upb_table *t, upb_ctype_t ctype, uint8_t size_lg2) {
+  t->count = 0;
+  t->deleted = 0;
+  t->ctype = ctype;
+  t->size_lg2 = size_lg2;
+  t->mask = upb_table_size(t) ? upb_table_size(t) - 1 : 0;
+  t->entries = NULL;
+  t->ctrl = NULL;
+  t->slots = NULL;
+  size_t size = upb_table_size(t);
+  if (size > 0) {
+    // One allocation: the slots, then the control bytes.
+    size_t slot_bytes = size * sizeof(upb_tabslot);
+    char *mem = malloc(slot_bytes + size + GROUP);
+    if (!mem) return false;
+    t->slots = (upb_tabslot*)mem;
+    t->ctrl = (uint8_t*)mem + slot_bytes;
+    memset(mutable_ctrl(t), EMPTY, size + GROUP);
+  }
+  return true;
+}
+
+static void uninit(upb_table *t) {
+  assert(!t->entries);
+  free(mutable_slots(t));
+}
+
+static size_t tablebytes(const upb_table *t) {
+  size_t size = upb_table_size(t);
+  if (t->ctrl) {
+    return size * sizeof(upb_tabslot) + size + GROUP;
+  } else {
+    return t->entries ? size * sizeof(upb_tabent) : 0;
+  }
+}
+
+static bool isfullslot(const upb_table *t, size_t i) {
+  return t->ctrl ? t->ctrl[i] < EMPTY : !upb_tabent_isempty(&t->entries[i]);
+}
+
+static const upb_tabkey *keyat(const upb_table *t, size_t i) {
+  return t->ctrl ? &t->slots[i].key : &t->entries[i].key;
+}
+
+static _upb_value *valat(const upb_table *t, size_t i) {
+  upb_table *mut = (upb_table*)t;
+  return t->ctrl ? &mutable_slots(mut)[i].val : &mutable_entries(mut)[i].val;
+}
+
+// Returns the index of "key" in "t", or SIZE_MAX if it isn't there.
+static size_t findslot(const upb_table *t, lookupkey_t key, uint32_t hash,
+                       eqlfunc_t *eql) {
+  if (!t->ctrl) {
+    const upb_tabent *e = findentry(t, key, hash, eql);
+    return e ? (size_t)(e - t->entries) : SIZE_MAX;
+  }
+
+  uint64_t h = upb_swiss_mixhash(hash);
+  uint8_t tag = h & 0x7f;
+  size_t pos = (h >> 7) & t->mask;
+  size_t step = 0;
+  while (1) {
+    const uint8_t *group = t->ctrl + pos;
+    unsigned mask;
+    for (mask = upb_swiss_match(group, tag); mask; mask &= mask - 1) {
+      size_t i = (pos + upb_swiss_lowbit(mask)) & t->mask;
+      if (eql(t->slots[i].key, key)) return i;
+    }
+    if (upb_swiss_match(group, EMPTY)) return SIZE_MAX;
+    // Triangular probing, which visits every group of a power-of-two table.
+    step += GROUP;
+    pos = (pos + step) & t->mask;
+  }
+}
+
+static _upb_value *findval(const upb_table *t, lookupkey_t key, uint32_t hash,
+                           eqlfunc_t *eql) {
+  size_t i = findslot(t, key, hash, eql);
+  return i == SIZE_MAX ? NULL : valat(t, i);
+}
+
+// The given key must not already exist in the table.
+static void insert(upb_table *t, lookupkey_t key, upb_tabkey tabkey,
+                   upb_value val, uint32_t hash, eqlfunc_t *eql) {
+  UPB_UNUSED(eql);
+  assert(!t->entries);
+  assert(findslot(t, key, hash, eql) == SIZE_MAX);
+  assert(val.ctype == t->ctype);
+
+  // Since the key isn't there, it can go in the first free slot.
+  uint64_t h = upb_swiss_mixhash(hash);
+  size_t pos = (h >> 7) & t->mask;
+  size_t step = 0;
+  unsigned mask;
+  while (!(mask = group_free(t->ctrl + pos))) {
+    step += GROUP;
+    pos = (pos + step) & t->mask;
+  }
+  size_t i = (pos + upb_swiss_lowbit(mask)) & t->mask;
+
+  if (t->ctrl[i] == DELETED) t->deleted--;
+  t->count++;
+  setctrl(t, i, h & 0x7f);
+  upb_tabslot *slot = &mutable_slots(t)[i];
+  slot->key = tabkey;
+  slot->val = val.val;
+  assert(findslot(t, key, hash, eql) == i);
 }
 
+static bool rm(upb_table *t, lookupkey_t key, upb_value *val,
+               upb_tabkey *removed, uint32_t hash, eqlfunc_t *eql) {
+  assert(!t->entries);
+  size_t i = findslot(t, key, hash, eql);
+  if (i == SIZE_MAX) return false;
+
+  const upb_tabslot *slot = &t->slots[i];
+  if (val) _upb_value_setval(val, slot->val, t->ctype);
+  if (removed) *removed = slot->key;
+  // Lookups have to probe past this slot, so it can't just become empty.
+  setctrl(t, i, DELETED);
+  t->count--;
+  t->deleted++;
+  return true;
+}
+
+#else  // UPB_USE_SWISSTABLE
+
 static bool init(upb_table *t, upb_ctype_t ctype, uint8_t size_lg2) {
   t->count = 0;
   t->ctype = ctype;
@@ -99,6 +325,22 @@ static bool init(upb_table *t, upb_ctype_t ctype, uint8_t size_lg2) {
 
 static void uninit(upb_table *t) { free(mutable_entries(t)); }
 
+static size_t tablebytes(const upb_table *t) {
+  return t->entries ? upb_table_size(t) * sizeof(upb_tabent) : 0;
+}
+
+static bool isfullslot(const upb_table *t, size_t i) {
+  return !upb_tabent_isempty(&t->entries[i]);
+}
+
+static const upb_tabkey *keyat(const upb_table *t, size_t i) {
+  return &t->entries[i].key;
+}
+
+static _upb_value *valat(const upb_table *t, size_t i) {
+  return &mutable_entries((upb_table*)t)[i].val;
+}
+
 static upb_tabent *emptyent(upb_table *t) {
   upb_tabent *e = mutable_entries(t) + upb_table_size(t);
   while (1) { if (upb_tabent_isempty(--e)) return e; assert(e > t->entries); }
@@ -108,38 +350,16 @@ static upb_tabent *getentry_mutable(upb_table *t, uint32_t hash) {
   return (upb_tabent*)upb_getentry(t, hash);
 }
 
-static const upb_tabent *findentry(const upb_table *t, lookupkey_t key,
-                                   uint32_t hash, eqlfunc_t *eql) {
-  if (t->size_lg2 == 0) return NULL;
-  const upb_tabent *e = upb_getentry(t, hash);
-  if (upb_tabent_isempty(e)) return NULL;
-  while (1) {
-    if (eql(e->key, key)) return e;
-    if ((e = e->next) == NULL) return NULL;
-  }
-}
-
-static upb_tabent *findentry_mutable(upb_table *t, lookupkey_t key,
-                                     uint32_t hash, eqlfunc_t *eql) {
-  return (upb_tabent*)findentry(t, key, hash, eql);
-}
-
-static bool lookup(const upb_table *t, lookupkey_t key, upb_value *v,
-                   uint32_t hash, eqlfunc_t *eql) {
-  const upb_tabent *e = findentry(t, key, hash, eql);
-  if (e) {
-    if (v) {
-      _upb_value_setval(v, e->val, t->ctype);
-    }
-    return true;
-  } else {
-    return false;
-  }
+static _upb_value *findval(const upb_table *t, lookupkey_t key, uint32_t hash,
+                           eqlfunc_t *eql) {
+  upb_tabent *e = (upb_tabent*)findentry(t, key, hash, eql);
+  return e ? &e->val : NULL;
 }
 
 // The given key must not already exist in the table.
-static void insert(upb_table *t, lookupkey_t key, upb_value val,
-                   uint32_t hash, hashfunc_t *hashfunc, eqlfunc_t *eql) {
+static void insert(upb_table *t, lookupkey_t key, upb_tabkey tabkey,
+                   upb_value val, uint32_t hash, eqlfunc_t *eql) {
+  UPB_UNUSED(key);
   UPB_UNUSED(eql);
   assert(findentry(t, key, hash, eql) == NULL);
   assert(val.ctype == t->ctype);
@@ -153,7 +373,7 @@ static void insert(upb_table *t, lookupkey_t key, upb_value val,
     // Collision.
     upb_tabent *new_e = emptyent(t);
     // Head of collider's chain.
-    upb_tabent *chain = getentry_mutable(t, hashfunc(mainpos_e->key));
+    upb_tabent *chain = getentry_mutable(t, mainpos_e->hash);
     if (chain == mainpos_e) {
       // Existing ent is in its main posisiton (it has the same hash as us, and
       // is the head of our chain).  Insert to new ent and append to this chain.
@@ -174,8 +394,9 @@ static void insert(upb_table *t, lookupkey_t key, upb_value val,
       our_e->next = NULL;
     }
   }
-  our_e->key = key.key;
+  our_e->key = tabkey;
   our_e->val = val.val;
+  our_e->hash = hash;
   assert(findentry(t, key, hash, eql) == our_e);
 }
 
@@ -183,25 +404,25 @@ static bool rm(upb_table *t, lookupkey_t key, upb_value *val,
                upb_tabkey *removed, uint32_t hash, eqlfunc_t *eql) {
   upb_tabent *chain = getentry_mutable(t, hash);
   if (upb_tabent_isempty(chain)) return false;
-  if (eql(chain->key, key)) {
+  if (chain->hash == hash && eql(chain->key, key)) {
     // Element to remove is at the head of its chain.
     t->count--;
     if (val) {
       _upb_value_setval(val, chain->val, t->ctype);
     }
+    if (removed) *removed = chain->key;
     if (chain->next) {
       upb_tabent *move = (upb_tabent*)chain->next;
       *chain = *move;
-      if (removed) *removed = move->key;
       move->key.num = 0;  // Make the slot empty.
     } else {
-      if (removed) *removed = chain->key;
       chain->key.num = 0;  // Make the slot empty.
     }
     return true;
   } else {
     // Element to remove is either in a non-head position or not in the table.
-    while (chain->next && !eql(chain->next->key, key))
+    while (chain->next &&
+           !(chain->next->hash == hash && eql(chain->next->key, key)))
       chain = (upb_tabent*)chain->next;
     if (chain->next) {
       // Found element to remove.
@@ -220,11 +441,21 @@ static bool rm(upb_table *t, lookupkey_t key, upb_value *val,
   }
 }
 
+#endif  // UPB_USE_SWISSTABLE
+
+static bool lookup(const upb_table *t, lookupkey_t key, upb_value *v,
+                   uint32_t hash, eqlfunc_t *eql) {
+  const _upb_value *val = findval(t, key, hash, eql);
+  if (!val) return false;
+  if (v) _upb_value_setval(v, *val, t->ctype);
+  return true;
+}
+
 static size_t next(const upb_table *t, size_t i) {
   do {
     if (++i >= upb_table_size(t))
       return SIZE_MAX;
-  } while(upb_tabent_isempty(&t->entries[i]));
+  } while(!isfullslot(t, i));
 
   return i;
 }
@@ -236,31 +467,123 @@ static size_t begin(const upb_table *t) {
 
 /* upb_strtable ***************************************************************/
 
-// A simple "subclass" of upb_table that only adds a hash function for strings.
+// A "subclass" of upb_table that adds a hash function for strings, and
+// storage for the keys.
+//
+// Rather than each key being a separate allocation, they are laid out one
+// after another (each a length prefix, the string and a NULL) in blocks that
+// the table owns.  A resize copies the remaining keys into a single new block
+// with room to spare, and after that we add blocks of at least double the
+// size as we need them.  Removing a key leaves its bytes behind; when more
+// than half of the bytes in the blocks are dead like this and we need
+// another block, we rebuild the table at the same size instead.
+
+typedef struct upb_tabkeyblock {
+  struct upb_tabkeyblock *prev;
+  size_t size;
+  char data[];
+} upb_tabkeyblock;
+
+#define MIN_KEYBLOCK 256
+
+static size_t keysize(size_t len) { return 4 + len + 1; }
+
+// Adds a block of exactly "size" bytes.
+static bool newblock(upb_strtable *t, size_t size) {
+  upb_tabkeyblock *block = malloc(sizeof(*block) + size);
+  if (!block) return false;
+  block->prev = t->keys;
+  block->size = size;
+  t->keys = block;
+  t->keys_ptr = block->data;
+  t->keys_end = block->data + size;
+  return true;
+}
 
-static uint32_t strhash(upb_tabkey key) {
-  return MurmurHash2(key.s.str, key.s.length, 0);
+// Makes sure the newest block has at least "bytes" free.
+static bool reservekeys(upb_strtable *t, size_t bytes) {
+  if ((size_t)(t->keys_end - t->keys_ptr) >= bytes) return true;
+  size_t size = UPB_MAX(bytes, MIN_KEYBLOCK);
+  if (t->keys) size = UPB_MAX(size, t->keys->size * 2);
+  return newblock(t, size);
+}
+
+// Copies "str" into the newest block, which must have room for it.
+static upb_tabkey addkey(upb_strtable *t, const char *str, size_t len) {
+  assert((size_t)(t->keys_end - t->keys_ptr) >= keysize(len));
+  assert(len <= UINT32_MAX);
+  unsigned char *p = (unsigned char*)t->keys_ptr;
+  p[0] = len & 0xff;
+  p[1] = (len >> 8) & 0xff;
+  p[2] = (len >> 16) & 0xff;
+  p[3] = (len >> 24) & 0xff;
+  memcpy(p + 4, str, len);
+  p[4 + len] = '\0';
+  upb_tabkey k;
+  k.str = t->keys_ptr;
+  t->keys_ptr += keysize(len);
+  t->keys_used += keysize(len);
+  return k;
+}
+
+static uint32_t strhash(const upb_strtable *t, const char *str, size_t len) {
+  switch (t->hashfn) {
+    case UPB_HASH_MURMUR2:
+      return MurmurHash2(str, len, 0);
+    case UPB_HASH_WYHASH:
+      return upb_wyhash(str, len, 0);
+#ifdef UPB_HAVE_CRC32C
+    case UPB_HASH_CRC32C:
+      return upb_crc32chash(str, len, 0);
+#endif
+    default:
+      // A static table generated by a build with a hash this one lacks.
+      assert(false);
+      return 0;
+  }
 }
 
 static bool streql(upb_tabkey k1, lookupkey_t k2) {
-  return k1.s.length == k2.key.s.length &&
-         memcmp(k1.s.str, k2.key.s.str, k1.s.length) == 0;
+  size_t len;
+  const char *str = upb_tabstr(k1, &len);
+  return len == k2.str.len && memcmp(str, k2.str.str, len) == 0;
+}
+
+static bool strtable_init(upb_strtable *t, upb_ctype_t ctype,
+                          uint8_t size_lg2) {
+  t->hashfn = UPB_TABLE_HASH;
+  t->keys = NULL;
+  t->keys_ptr = NULL;
+  t->keys_end = NULL;
+  t->keys_used = 0;
+  t->keys_dead = 0;
+  return init(&t->t, ctype, size_lg2);
 }
 
 bool upb_strtable_init(upb_strtable *t, upb_ctype_t ctype) {
-  return init(&t->t, ctype, 2);
+  return strtable_init(t, ctype, 2);
 }
 
 void upb_strtable_uninit(upb_strtable *t) {
-  for (size_t i = 0; i < upb_table_size(&t->t); i++)
-    free((void*)t->t.entries[i].key.s.str);
+  upb_tabkeyblock *block = t->keys;
+  while (block) {
+    upb_tabkeyblock *prev = block->prev;
+    free(block);
+    block = prev;
+  }
   uninit(&t->t);
 }
 
-bool upb_strtable_resize(upb_strtable *t, size_t size_lg2) {
+// Rebuilds "t" with 2^size_lg2 entries, and with its keys in a single block
+// of "key_bytes" (which must be enough for them).
+static bool rebuild(upb_strtable *t, size_t size_lg2, size_t key_bytes) {
   upb_strtable new_table;
-  if (!init(&new_table.t, t->t.ctype, size_lg2))
+  if (!strtable_init(&new_table, t->t.ctype, size_lg2))
+    return false;
+  if (key_bytes > 0 && !newblock(&new_table, key_bytes)) {
+    upb_strtable_uninit(&new_table);
     return false;
+  }
   upb_strtable_iter i;
   upb_strtable_begin(&i, t);
   for ( ; !upb_strtable_done(&i); upb_strtable_next(&i)) {
@@ -275,34 +598,61 @@ bool upb_strtable_resize(upb_strtable *t, size_t size_lg2) {
   return true;
 }
 
+bool upb_strtable_resize(upb_strtable *t, size_t size_lg2) {
+  // Room for the keys we have and as many again.
+  return rebuild(t, size_lg2, (t->keys_used - t->keys_dead) * 2);
+}
+
+void upb_strtable_compact(upb_strtable *t) {
+  // The smallest size we could have inserted the keys into without a resize,
+  // and exactly enough room for them.  If this fails the table is unchanged,
+  // which is fine.
+  uint8_t size_lg2 = 1;
+  while ((double)t->t.count / (1 << size_lg2) > MAX_LOAD) size_lg2++;
+  rebuild(t, size_lg2, t->keys_used - t->keys_dead);
+}
+
+size_t upb_strtable_bytes(const upb_strtable *t) {
+  size_t bytes = tablebytes(&t->t);
+  const upb_tabkeyblock *block;
+  for (block = t->keys; block; block = block->prev) {
+    bytes += sizeof(*block) + block->size;
+  }
+  return bytes;
+}
+
 bool upb_strtable_insert2(upb_strtable *t, const char *k, size_t len,
                           upb_value v) {
   if (isfull(&t->t)) {
     // Need to resize.  New table of double the size, add old elements to it.
-    if (!upb_strtable_resize(t, t->t.size_lg2 + 1)) {
+    if (!upb_strtable_resize(t, grow_lg2(&t->t))) {
+      return false;
+    }
+  } else if ((size_t)(t->keys_end - t->keys_ptr) < keysize(len) &&
+             t->keys_dead > t->keys_used / 2) {
+    // Reclaim the space of removed keys rather than add another block.
+    if (!upb_strtable_resize(t, t->t.size_lg2)) {
       return false;
     }
   }
-  if ((k = upb_strdup2(k, len)) == NULL) return false;
+  if (!reservekeys(t, keysize(len))) return false;
 
-  lookupkey_t key = strkey2(k, len);
-  uint32_t hash = MurmurHash2(key.key.s.str, key.key.s.length, 0);
-  insert(&t->t, key, v, hash, &strhash, &streql);
+  uint32_t hash = strhash(t, k, len);
+  insert(&t->t, strkey2(k, len), addkey(t, k, len), v, hash, &streql);
   return true;
 }
 
 bool upb_strtable_lookup2(const upb_strtable *t, const char *key, size_t len,
                           upb_value *v) {
-  uint32_t hash = MurmurHash2(key, len, 0);
+  uint32_t hash = strhash(t, key, len);
   return lookup(&t->t, strkey2(key, len), v, hash, &streql);
 }
 
 bool upb_strtable_remove2(upb_strtable *t, const char *key, size_t len,
                          upb_value *val) {
-  uint32_t hash = MurmurHash2(key, strlen(key), 0);
-  upb_tabkey tabkey;
-  if (rm(&t->t, strkey2(key, len), val, &tabkey, hash, &streql)) {
-    free((void*)tabkey.s.str);
+  uint32_t hash = strhash(t, key, len);
+  if (rm(&t->t, strkey2(key, len), val, NULL, hash, &streql)) {
+    t->keys_dead += keysize(len);
     return true;
   } else {
     return false;
@@ -311,9 +661,6 @@ bool upb_strtable_remove2(upb_strtable *t, const char *key, size_t len,
 
 // Iteration
 
-static const upb_tabent *str_tabent(const upb_strtable_iter *i) {
-  return &i->t->t.entries[i->index];
-}
 
 void upb_strtable_begin(upb_strtable_iter *i, const upb_strtable *t) {
   i->t = t;
@@ -326,22 +673,25 @@ void upb_strtable_next(upb_strtable_iter *i) {
 
 bool upb_strtable_done(const upb_strtable_iter *i) {
   return i->index >= upb_table_size(&i->t->t) ||
-         upb_tabent_isempty(str_tabent(i));
+         !isfullslot(&i->t->t, i->index);
 }
 
 const char *upb_strtable_iter_key(upb_strtable_iter *i) {
   assert(!upb_strtable_done(i));
-  return str_tabent(i)->key.s.str;
+  size_t len;
+  return upb_tabstr(*keyat(&i->t->t, i->index), &len);
 }
 
 size_t upb_strtable_iter_keylength(upb_strtable_iter *i) {
   assert(!upb_strtable_done(i));
-  return str_tabent(i)->key.s.length;
+  size_t len;
+  upb_tabstr(*keyat(&i->t->t, i->index), &len);
+  return len;
 }
 
 upb_value upb_strtable_iter_value(const upb_strtable_iter *i) {
   assert(!upb_strtable_done(i));
-  return _upb_value_val(str_tabent(i)->val, i->t->t.ctype);
+  return _upb_value_val(*valat(&i->t->t, i->index), i->t->t.ctype);
 }
 
 void upb_strtable_iter_setdone(upb_strtable_iter *i) {
@@ -361,10 +711,8 @@ bool upb_strtable_iter_isequal(const upb_strtable_iter *i1,
 // For inttables we use a hybrid structure where small keys are kept in an
 // array and large keys are put in the hash table.
 
-static uint32_t inthash(upb_tabkey key) { return upb_inthash(key.num); }
-
 static bool inteql(upb_tabkey k1, lookupkey_t k2) {
-  return k1.num == k2.key.num;
+  return k1.num == k2.num;
 }
 
 static _upb_value *mutable_array(upb_inttable *t) {
@@ -375,9 +723,7 @@ static _upb_value *inttable_val(upb_inttable *t, uintptr_t key) {
   if (key < t->array_size) {
     return upb_arrhas(t->array[key]) ? &(mutable_array(t)[key]) : NULL;
   } else {
-    upb_tabent *e =
-        findentry_mutable(&t->t, intkey(key), upb_inthash(key), &inteql);
-    return e ? &e->val : NULL;
+    return findval(&t->t, intkey(key), upb_inthash(key), &inteql);
   }
 }
 
@@ -441,15 +787,15 @@ bool upb_inttable_insert(upb_inttable *t, uintptr_t key, upb_value val) {
     if (isfull(&t->t)) {
       // Need to resize the hash part, but we re-use the array part.
       upb_table new_table;
-      if (!init(&new_table, t->t.ctype, t->t.size_lg2 + 1))
+      if (!init(&new_table, t->t.ctype, grow_lg2(&t->t)))
         return false;
       size_t i;
       for (i = begin(&t->t); i < upb_table_size(&t->t); i = next(&t->t, i)) {
-        const upb_tabent *e = &t->t.entries[i];
+        uintptr_t k = keyat(&t->t, i)->num;
         upb_value v;
-        _upb_value_setval(&v, e->val, t->t.ctype);
-        uint32_t hash = upb_inthash(e->key.num);
-        insert(&new_table, intkey(e->key.num), v, hash, &inthash, &inteql);
+        _upb_value_setval(&v, *valat(&t->t, i), t->t.ctype);
+        insert(&new_table, intkey(k), upb_intkey(k), v, upb_inthash(k),
+               &inteql);
       }
 
       assert(t->t.count == new_table.count);
@@ -457,7 +803,8 @@ bool upb_inttable_insert(upb_inttable *t, uintptr_t key, upb_value val) {
       uninit(&t->t);
       t->t = new_table;
     }
-    insert(&t->t, intkey(key), val, upb_inthash(key), &inthash, &inteql);
+    insert(&t->t, intkey(key), upb_intkey(key), val, upb_inthash(key),
+           &inteql);
   }
   check(t);
   return true;
@@ -579,12 +926,12 @@ void upb_inttable_compact(upb_inttable *t) {
   *t = new_t;
 }
 
+size_t upb_inttable_bytes(const upb_inttable *t) {
+  return tablebytes(&t->t) + t->array_size * sizeof(_upb_value);
+}
+
 // Iteration.
 
-static const upb_tabent *int_tabent(const upb_inttable_iter *i) {
-  assert(!i->array_part);
-  return &i->t->t.entries[i->index];
-}
 
 static _upb_value int_arrent(const upb_inttable_iter *i) {
   assert(i->array_part);
@@ -619,19 +966,19 @@ bool upb_inttable_done(const upb_inttable_iter *i) {
            !upb_arrhas(int_arrent(i));
   } else {
     return i->index >= upb_table_size(&i->t->t) ||
-           upb_tabent_isempty(int_tabent(i));
+           !isfullslot(&i->t->t, i->index);
   }
 }
 
 uintptr_t upb_inttable_iter_key(const upb_inttable_iter *i) {
   assert(!upb_inttable_done(i));
-  return i->array_part ? i->index : int_tabent(i)->key.num;
+  return i->array_part ? i->index : keyat(&i->t->t, i->index)->num;
 }
 
 upb_value upb_inttable_iter_value(const upb_inttable_iter *i) {
   assert(!upb_inttable_done(i));
   return _upb_value_val(
-      i->array_part ? i->t->array[i->index] : int_tabent(i)->val,
+      i->array_part ? i->t->array[i->index] : *valat(&i->t->t, i->index),
       i->t->t.ctype);
 }
 
@@ -819,3 +1166,138 @@ uint32_t MurmurHash2(const void * key, size_t len, uint32_t seed) {
 #undef MIX
 
 #endif // UPB_UNALIGNED_READS_OK
+
+// Unaligned loads in host byte order (memcpy() compiles to a plain load).
+static uint64_t read8(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static uint64_t read4(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+// Reads 0-8 bytes into a word, with overlapping loads rather than a loop.
+static uint64_t readsmall(const uint8_t *p, size_t len) {
+  if (len >= 4) {
+    return (read4(p) << 32) | read4(p + len - 4);
+  } else if (len > 0) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+  } else {
+    return 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// wyhash (final version 4.2), by Wang Yi (released into the public domain).
+// Reformatted for upb, with the default secret.  Keys of up to 16 bytes take
+// two overlapping loads and one multiply, and longer ones 16 or 48 bytes per
+// step, so there's no byte-at-a-time tail.
+
+// Sets *a and *b to the low and high halves of their 128-bit product.
+static void wymum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static uint64_t wymix(uint64_t a, uint64_t b) {
+  wymum(&a, &b);
+  return a ^ b;
+}
+
+static const uint64_t wysecret[4] = {
+  0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+  0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL,
+};
+
+uint64_t upb_wyhash(const void *key, size_t len, uint64_t seed) {
+  const uint8_t *p = (const uint8_t*)key;
+  const uint64_t *s = wysecret;
+  uint64_t a, b;
+  seed ^= wymix(seed ^ s[0], s[1]);
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+      b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+    } else {
+      a = readsmall(p, len);
+      b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = wymix(read8(p) ^ s[1], read8(p + 8) ^ seed);
+        see1 = wymix(read8(p + 16) ^ s[2], read8(p + 24) ^ see1);
+        see2 = wymix(read8(p + 32) ^ s[3], read8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = wymix(read8(p) ^ s[1], read8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = read8(p + i - 16);
+    b = read8(p + i - 8);
+  }
+  a ^= s[1];
+  b ^= seed;
+  wymum(&a, &b);
+  return wymix(a ^ s[0] ^ len, b ^ s[1]);
+}
+
+#ifdef UPB_HAVE_CRC32C
+//-----------------------------------------------------------------------------
+// A hash built on the SSE4.2 CRC32C instruction, which takes 8 bytes at a
+// time.  Two CRCs run over alternate words (one over every word would tell us
+// nothing the other doesn't, since CRC is linear), and the final mix from
+// MurmurHash3 spreads their 64 bits over the whole result, since tables use
+// the low bits.
+
+uint64_t upb_crc32chash(const void *key, size_t len, uint64_t seed) {
+  const uint8_t *p = (const uint8_t*)key;
+  const uint8_t *end = p + len;
+  uint64_t a = (uint32_t)seed;
+  uint64_t b = (uint32_t)(seed >> 32) ^ len;
+  if (len > 16) {
+    for (; end - p > 16; p += 16) {
+      a = _mm_crc32_u64(a, read8(p));
+      b = _mm_crc32_u64(b, read8(p + 8));
+    }
+    p = end - 16;
+  }
+  if (len > 8) {
+    a = _mm_crc32_u64(a, read8(p));
+    b = _mm_crc32_u64(b, read8(end - 8));
+  } else {
+    a = _mm_crc32_u64(a, readsmall(p, len));
+  }
+
+  uint64_t h = (b << 32) | a;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+#endif
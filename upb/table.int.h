@@ -9,8 +9,12 @@
  * (strtable) hash tables.
  *
  * The table uses chained scatter with Brent's variation (inspired by the Lua
- * implementation of hash tables).  The hash function for strings is Austin
- * Appleby's "MurmurHash."
+ * implementation of hash tables).  The hash function for strings is wyhash,
+ * or with UPB_TABLE_HASH_MURMUR2 or UPB_TABLE_HASH_CRC32C defined, Austin
+ * Appleby's "MurmurHash" or one built on the SSE4.2 CRC32C instruction.
+ * Building with UPB_USE_SWISSTABLE instead gives tables built at runtime an
+ * open-addressed layout with SIMD-probed control bytes, in the style of
+ * absl::flat_hash_map; see table.c.  The API is the same either way.
  *
  * The inttable uses uintptr_t as its key, which guarantees it can be used to
  * store pointers or integers of at least 32 bits (upb isn't really useful on
@@ -28,6 +32,10 @@
 #include <string.h>
 #include "upb/upb.h"
 
+#if defined(UPB_USE_SWISSTABLE) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -154,24 +162,20 @@ FUNCS(fptr,     fptr,         upb_func*,    UPB_CTYPE_FPTR);
 
 typedef union {
   uintptr_t num;
-  struct {
-    // We own this. NULL-terminated but may also contain binary data; see
-    // explicit length below.
-    // TODO: move the length to the start of the string in order to reduce
-    // tabkey's size (to one machine word) in a way that supports static
-    // initialization.
-    const char *str;
-    size_t length;
-  } s;
+  // A string key points to its length, as a 4-byte little-endian integer,
+  // followed by the string itself and a NULL terminator (the string may also
+  // contain NULLs; the length is what counts).  Tables built at runtime keep
+  // these in memory of their own; see upb_strtable.
+  const char *str;
 } upb_tabkey;
 
 #define UPB_TABKEY_NUM(n) {n}
 #ifdef UPB_C99
-// Given that |s| is a string literal, sizeof(s) gives us a
-// compile-time-constant strlen(). We must ensure that this works for static
-// data initializers.
-#define UPB_TABKEY_STR(strval) { .s = { .str = strval,                    \
-                                        .length = sizeof(strval) - 1 } }
+// The preprocessor can't compute the length prefix, so it is passed as four
+// one-character string literals, least significant first, eg.
+// UPB_TABKEY_STR("\004", "\000", "\000", "\000", "name").
+#define UPB_TABKEY_STR(len1, len2, len3, len4, strval) \
+  { .str = len1 len2 len3 len4 strval }
 #endif
 // TODO(haberman): C++
 #define UPB_TABKEY_NONE {0}
@@ -184,8 +188,20 @@ typedef struct _upb_tabent {
   // upb_table is known to be non-const.  This requires a bit of care, but
   // the subtlety is confined to table.c.
   const struct _upb_tabent *next;
+
+  // The hash of "key", so that lookups can pass over entries with other keys
+  // without comparing them, which for strings would mean reading the key.
+  uint32_t hash;
 } upb_tabent;
 
+#ifdef UPB_USE_SWISSTABLE
+// A slot of an open-addressed table.
+typedef struct {
+  upb_tabkey key;
+  _upb_value val;
+} upb_tabslot;
+#endif
+
 typedef struct {
   size_t count;          // Number of entries in the hash part.
   size_t mask;           // Mask to turn hash value -> bucket.
@@ -198,14 +214,102 @@ typedef struct {
   // declare that in C.  So we have to make it const so that we can statically
   // initialize const hash tables.  Then we cast away const when we have to.
   const upb_tabent *entries;
+
+#ifdef UPB_USE_SWISSTABLE
+  // Tables built at runtime leave "entries" NULL and use these instead: a
+  // control byte per slot (plus a group's worth mirrored at the end), the
+  // slots, and the number of slots holding tombstones.  Statically-initialized
+  // tables leave them NULL.
+  const uint8_t *ctrl;
+  const upb_tabslot *slots;
+  size_t deleted;
+#endif
 } upb_table;
 
+#ifdef UPB_USE_SWISSTABLE
+// Probing of the open-addressed layout (see table.c), here so that
+// upb_inttable_lookup32() can be inlined.  A full slot's control byte is 7
+// bits of its mixed hash; UPB_SWISS_EMPTY ends a probe.
+#define UPB_SWISS_EMPTY 0x80
+
+#ifdef __SSE2__
+#define UPB_SWISS_GROUP 16
+
+// Returns a mask of the bytes in the group at "ctrl" that are "b".
+UPB_INLINE unsigned upb_swiss_match(const uint8_t *ctrl, uint8_t b) {
+  __m128i v = _mm_loadu_si128((const __m128i*)ctrl);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(b)));
+}
+#else
+#define UPB_SWISS_GROUP 8
+
+UPB_INLINE unsigned upb_swiss_match(const uint8_t *ctrl, uint8_t b) {
+  unsigned mask = 0;
+  int i;
+  for (i = 0; i < UPB_SWISS_GROUP; i++) mask |= (unsigned)(ctrl[i] == b) << i;
+  return mask;
+}
+#endif
+
+UPB_INLINE int upb_swiss_lowbit(unsigned mask) {
+#ifdef __GNUC__
+  return __builtin_ctz(mask);
+#else
+  int i = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+// Our hashes of integer keys are the keys themselves, so we mix them (and
+// string hashes too, for uniformity) before taking a slot from the high bits
+// and the control byte from the low 7.
+UPB_INLINE uint64_t upb_swiss_mixhash(uint32_t hash) {
+  uint64_t h = hash * 0x9e3779b97f4a7c15ULL;
+  return h ^ (h >> 32);
+}
+
+#define UPB_TABLE_INIT(count, mask, ctype, size_lg2, entries) \
+  {count, mask, ctype, size_lg2, entries, NULL, NULL, 0}
+#else
+#define UPB_TABLE_INIT(count, mask, ctype, size_lg2, entries) \
+  {count, mask, ctype, size_lg2, entries}
+#endif
+
+struct upb_tabkeyblock;
+
+// The hash functions for string keys.
+typedef enum {
+  UPB_HASH_MURMUR2 = 0,
+  UPB_HASH_WYHASH  = 1,
+  UPB_HASH_CRC32C  = 2,
+} upb_hashfn_t;
+
 typedef struct {
   upb_table t;
+
+  // The function the keys were hashed with.  Tables built at runtime use the
+  // one chosen at build time; statically-initialized tables use whichever
+  // one they were generated with.
+  upb_hashfn_t hashfn;
+
+  // Tables built at runtime own their keys, which are packed one after
+  // another into blocks of memory.  "keys" is the newest block, and its free
+  // space runs from "keys_ptr" to "keys_end".  Statically-initialized tables
+  // have no blocks.
+  struct upb_tabkeyblock *keys;
+  char *keys_ptr;
+  char *keys_end;
+  size_t keys_used;  // Bytes taken by the keys in all blocks.
+  size_t keys_dead;  // Bytes of those keys that have since been removed.
 } upb_strtable;
 
-#define UPB_STRTABLE_INIT(count, mask, ctype, size_lg2, entries) \
-  {{count, mask, ctype, size_lg2, entries}}
+#define UPB_STRTABLE_INIT(count, mask, ctype, size_lg2, entries, hashfn) \
+  {UPB_TABLE_INIT(count, mask, ctype, size_lg2, entries), hashfn, NULL, NULL, \
+   NULL, 0, 0}
 
 typedef struct {
   upb_table t;              // For entries that don't fit in the array part.
@@ -215,7 +319,7 @@ typedef struct {
 } upb_inttable;
 
 #define UPB_INTTABLE_INIT(count, mask, ctype, size_lg2, ent, a, asize, acount) \
-  {{count, mask, ctype, size_lg2, ent}, a, asize, acount}
+  {UPB_TABLE_INIT(count, mask, ctype, size_lg2, ent), a, asize, acount}
 
 #define UPB_EMPTY_INTTABLE_INIT(ctype) \
   UPB_INTTABLE_INIT(0, 0, ctype, 0, NULL, NULL, 0, 0)
@@ -238,6 +342,21 @@ UPB_INLINE bool upb_tabent_isempty(const upb_tabent *e) {
 // Used by some of the unit tests for generic hashing functionality.
 uint32_t MurmurHash2(const void * key, size_t len, uint32_t seed);
 
+// The other string hashes, also exposed for the tests and benchmarks.
+// Tables use a seed of 0 and the low 32 bits.
+uint64_t upb_wyhash(const void *key, size_t len, uint64_t seed);
+#ifdef __SSE4_2__
+#define UPB_HAVE_CRC32C
+uint64_t upb_crc32chash(const void *key, size_t len, uint64_t seed);
+#endif
+
+// Returns the string of a string key and sets "*len" to its length.
+UPB_INLINE const char *upb_tabstr(upb_tabkey key, size_t *len) {
+  const unsigned char *p = (const unsigned char*)key.str;
+  *len = p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  return key.str + 4;
+}
+
 UPB_INLINE upb_tabkey upb_intkey(uintptr_t key) {
   upb_tabkey k;
   k.num = key;
@@ -248,7 +367,8 @@ UPB_INLINE uint32_t upb_inthash(uintptr_t key) {
   return (uint32_t)key;
 }
 
-static const upb_tabent *upb_getentry(const upb_table *t, uint32_t hash) {
+UPB_INLINE const upb_tabent *upb_getentry(const upb_table *t,
+                                         uint32_t hash) {
   return t->entries + (hash & t->mask);
 }
 
@@ -331,6 +451,16 @@ bool upb_inttable_lookupptr(
 // inserting more entries is legal, but will likely require a table resize.
 void upb_inttable_compact(upb_inttable *t);
 
+// Likewise for string tables, which also gather their keys into a single
+// block of exactly the size they need.  Defs do this to their tables when
+// they are frozen.
+void upb_strtable_compact(upb_strtable *t);
+
+// Returns the bytes of memory the table occupies, not counting the
+// upb_inttable/upb_strtable struct itself.
+size_t upb_inttable_bytes(const upb_inttable *t);
+size_t upb_strtable_bytes(const upb_strtable *t);
+
 // A special-case inlinable version of the lookup routine for 32-bit integers.
 UPB_INLINE bool upb_inttable_lookup32(const upb_inttable *t, uint32_t key,
                                       upb_value *v) {
@@ -345,6 +475,34 @@ UPB_INLINE bool upb_inttable_lookup32(const upb_inttable *t, uint32_t key,
     }
   } else {
     const upb_tabent *e;
+#ifdef UPB_USE_SWISSTABLE
+    if (t->t.ctrl) {
+      uint64_t h = upb_swiss_mixhash(upb_inthash(key));
+      uint8_t tag = h & 0x7f;
+      size_t pos = (h >> 7) & t->t.mask;
+      size_t step = 0;
+      // Most keys are in the first slot they hash to.
+      if (t->t.ctrl[pos] == tag && t->t.slots[pos].key.num == key) {
+        _upb_value_setval(v, t->t.slots[pos].val, t->t.ctype);
+        return true;
+      }
+      while (1) {
+        const uint8_t *group = t->t.ctrl + pos;
+        unsigned mask;
+        for (mask = upb_swiss_match(group, tag); mask; mask &= mask - 1) {
+          const upb_tabslot *slot =
+              &t->t.slots[(pos + upb_swiss_lowbit(mask)) & t->t.mask];
+          if (slot->key.num == key) {
+            _upb_value_setval(v, slot->val, t->t.ctype);
+            return true;
+          }
+        }
+        if (upb_swiss_match(group, UPB_SWISS_EMPTY)) return false;
+        step += UPB_SWISS_GROUP;
+        pos = (pos + step) & t->t.mask;
+      }
+    }
+#endif
     if (t->t.entries == NULL) return false;
     for (e = upb_getentry(&t->t, upb_inthash(key)); true; e = e->next) {
       if ((uint32_t)e->key.num == key) {
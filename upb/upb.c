@@ -80,3 +80,151 @@ void upb_status_copy(upb_status *to, const upb_status *from) {
   if (!to) return;
   *to = *from;
 }
+
+
+/* upb_alloc ******************************************************************/
+
+static void *upb_global_allocfunc(upb_alloc *alloc, void *ptr, size_t oldsize,
+                                  size_t size) {
+  UPB_UNUSED(alloc);
+  UPB_UNUSED(oldsize);
+  if (size == 0) {
+    free(ptr);
+    return NULL;
+  } else {
+    return realloc(ptr, size);
+  }
+}
+
+upb_alloc upb_alloc_global = {&upb_global_allocfunc};
+
+
+/* upb_arena ******************************************************************/
+
+typedef struct mem_block {
+  struct mem_block *next;
+  // Data follows.
+} mem_block;
+
+typedef struct cleanup_ent {
+  struct cleanup_ent *next;
+  upb_cleanup_func *func;
+  void *ud;
+} cleanup_ent;
+
+static const size_t memblock_reserve = UPB_ARENA_ALIGN_UP(sizeof(mem_block));
+
+static void *upb_arena_malloc(upb_arena *a, size_t size) {
+  size = UPB_ARENA_ALIGN_UP(size);
+
+  if ((size_t)(a->end - a->ptr) < size) {
+    size_t block_size = UPB_MAX(size, a->next_block_size) + memblock_reserve;
+    mem_block *block = upb_malloc(a->block_alloc, block_size);
+    if (!block) return NULL;
+    block->next = a->block_head;
+    a->block_head = block;
+    a->next_block_size = UPB_MIN(a->next_block_size * 2, UPB_ARENA_MAX_BLOCK);
+
+    char *start = (char*)block + memblock_reserve;
+    char *end = (char*)block + block_size;
+    if ((size_t)(end - start) - size < (size_t)(a->end - a->ptr)) {
+      // A large allocation that would leave less free space in the new block
+      // than the current one has: give it a block of its own and keep
+      // allocating from the current one.
+      a->bytes_allocated += size;
+      return start;
+    }
+    a->ptr = start;
+    a->end = end;
+  }
+
+  void *ret = a->ptr;
+  a->ptr += size;
+  a->bytes_allocated += size;
+  return ret;
+}
+
+static void *upb_arena_allocfunc(upb_alloc *alloc, void *ptr, size_t oldsize,
+                                 size_t size) {
+  upb_arena *a = (upb_arena*)alloc;  // upb_alloc is our first member.
+
+  if (size == 0) {
+    // Individual frees are a no-op; everything is freed with the arena.
+    return NULL;
+  }
+
+  if (ptr && (char*)ptr + UPB_ARENA_ALIGN_UP(oldsize) == a->ptr) {
+    // This was the most recent allocation, so we may be able to grow or
+    // shrink it in place.
+    size_t have = UPB_ARENA_ALIGN_UP(oldsize);
+    size_t want = UPB_ARENA_ALIGN_UP(size);
+    if (want <= have || want - have <= (size_t)(a->end - a->ptr)) {
+      a->ptr = (char*)ptr + want;
+      a->bytes_allocated += want - have;
+      return ptr;
+    }
+  }
+
+  if (ptr && size <= oldsize) return ptr;
+
+  void *ret = upb_arena_malloc(a, size);
+  if (ret && ptr) memcpy(ret, ptr, oldsize);
+  return ret;
+}
+
+void upb_arena_init(upb_arena *a) {
+  upb_arena_init2(a, NULL, 0, &upb_alloc_global);
+}
+
+void upb_arena_init2(upb_arena *a, void *mem, size_t n, upb_alloc *alloc) {
+  a->alloc.func = &upb_arena_allocfunc;
+  a->block_alloc = alloc ? alloc : &upb_alloc_global;
+  a->block_head = NULL;
+  a->cleanup_head = NULL;
+  a->next_block_size = UPB_ARENA_MIN_BLOCK;
+  a->bytes_allocated = 0;
+
+  // Align the seed block, which could be anywhere (a char array on the stack,
+  // for example).
+  char *start = mem;
+  char *end = start + n;
+  if (mem) {
+    start = (char*)UPB_ARENA_ALIGN_UP((uintptr_t)start);
+    if (start > end) start = end;
+  }
+  a->ptr = start;
+  a->end = end;
+}
+
+void upb_arena_uninit(upb_arena *a) {
+  cleanup_ent *ent = a->cleanup_head;
+  while (ent) {
+    ent->func(ent->ud);
+    ent = ent->next;
+  }
+
+  // Cleanup entries themselves live in the blocks, so they go away here.
+  mem_block *block = a->block_head;
+  while (block) {
+    mem_block *next = block->next;
+    upb_free(a->block_alloc, block);
+    block = next;
+  }
+
+  a->block_head = NULL;
+  a->cleanup_head = NULL;
+}
+
+bool upb_arena_addcleanup(upb_arena *a, upb_cleanup_func *func, void *ud) {
+  cleanup_ent *ent = upb_malloc(&a->alloc, sizeof(cleanup_ent));
+  if (!ent) return false;
+  ent->func = func;
+  ent->ud = ud;
+  ent->next = a->cleanup_head;
+  a->cleanup_head = ent;
+  return true;
+}
+
+size_t upb_arena_bytesallocated(const upb_arena *a) {
+  return a->bytes_allocated;
+}
@@ -455,4 +455,168 @@ inline void Status::CopyFrom(const Status& other) {
 
 #endif
 
+/* upb::Allocator *************************************************************/
+
+#ifdef __cplusplus
+namespace upb {
+class Allocator;
+class Arena;
+}
+#endif
+
+UPB_DECLARE_TYPE(upb::Allocator, upb_alloc);
+UPB_DECLARE_TYPE(upb::Arena, upb_arena);
+
+// A single function implements malloc (ptr == NULL), realloc and free
+// (size == 0), much like lua_Alloc.  "oldsize" is the size that "ptr" was
+// allocated with, so that allocators don't need to track it themselves.  The
+// allocator itself is passed so that implementations can embed a upb_alloc as
+// the first member of a larger struct holding their state.
+typedef void *upb_alloc_func(upb_alloc *alloc, void *ptr, size_t oldsize,
+                             size_t size);
+
+// A generic allocator interface.  Any subsystem that allocates memory on behalf
+// of a specific request (as opposed to long-lived, refcounted objects like defs
+// and handlers) should let the caller supply one of these.
+UPB_DEFINE_CLASS0(upb::Allocator,
+ public:
+  void* Malloc(size_t size);
+  void* Realloc(void* ptr, size_t oldsize, size_t size);
+  void Free(void* ptr);
+,
+UPB_DEFINE_STRUCT0(upb_alloc,
+  upb_alloc_func *func;
+));
+
+// Allocator that uses malloc()/realloc()/free().
+extern upb_alloc upb_alloc_global;
+
+UPB_INLINE void *upb_malloc(upb_alloc *alloc, size_t size) {
+  return alloc->func(alloc, NULL, 0, size);
+}
+
+UPB_INLINE void *upb_realloc(upb_alloc *alloc, void *ptr, size_t oldsize,
+                             size_t size) {
+  return alloc->func(alloc, ptr, oldsize, size);
+}
+
+UPB_INLINE void upb_free(upb_alloc *alloc, void *ptr) {
+  alloc->func(alloc, ptr, 0, 0);
+}
+
+
+/* upb::Arena *****************************************************************/
+
+typedef void upb_cleanup_func(void *ud);
+
+// The arena's first block is this big (unless a seed block is given), and
+// every subsequent block is twice as big as the previous one, up to
+// UPB_ARENA_MAX_BLOCK.
+#define UPB_ARENA_MIN_BLOCK 256
+#define UPB_ARENA_MAX_BLOCK (64 * 1024)
+
+// Every allocation is aligned to this.  Exposed so that code which bumps the
+// arena's pointer directly (like JIT-inlined upb::Shim handlers) stays in sync.
+#define UPB_ARENA_ALIGN 8
+#define UPB_ARENA_ALIGN_UP(size) \
+    (((size) + UPB_ARENA_ALIGN - 1) / UPB_ARENA_ALIGN * UPB_ARENA_ALIGN)
+
+UPB_BEGIN_EXTERN_C
+
+// Forward-declared so it can be a friend of the C++ class.
+UPB_INLINE upb_alloc *upb_arena_alloc(upb_arena *a);
+
+UPB_END_EXTERN_C
+
+// A bump allocator.  Allocations are carved sequentially out of large blocks,
+// and Free() is a no-op: everything is freed at once when the arena is
+// destroyed, without touching the heap for each individual object.  An
+// optional "seed" block provided by the caller (eg. on the stack) is used
+// before any blocks are allocated, so small requests need not touch the heap
+// at all.
+//
+// Like upb::Sink, an arena may only be used from a single thread at a time.
+UPB_DEFINE_CLASS0(upb::Arena,
+ public:
+  Arena();
+
+  // Uses "seed" (which must outlive the arena) as its first block.  Further
+  // blocks are allocated with "block_alloc", or the global heap if NULL.
+  Arena(void* seed, size_t len, Allocator* block_alloc);
+
+  // Frees all memory allocated from the arena, after running cleanups.
+  ~Arena();
+
+  // The allocator interface to the arena.
+  Allocator* allocator();
+
+  // Registers a function to run when the arena is destroyed, in reverse order
+  // of registration.  Returns false on out-of-memory.
+  bool AddCleanup(upb_cleanup_func* func, void* ud);
+
+  // Total bytes handed out by this arena.
+  size_t BytesAllocated() const;
+
+ private:
+  UPB_DISALLOW_COPY_AND_ASSIGN(Arena);
+  friend UPB_INLINE upb_alloc* ::upb_arena_alloc(upb_arena* a);
+,
+UPB_DEFINE_STRUCT0(upb_arena,
+  // We implement the allocator interface.  This must be the first member.
+  upb_alloc alloc;
+
+  // Allocator for the blocks we allocate, usually upb_alloc_global.
+  upb_alloc *block_alloc;
+
+  // Free space in the current block.
+  char *ptr;
+  char *end;
+
+  // Linked lists of allocated blocks and cleanups.
+  void *block_head;
+  void *cleanup_head;
+
+  size_t next_block_size;
+  size_t bytes_allocated;
+));
+
+UPB_BEGIN_EXTERN_C
+
+void upb_arena_init(upb_arena *a);
+void upb_arena_init2(upb_arena *a, void *mem, size_t n, upb_alloc *alloc);
+void upb_arena_uninit(upb_arena *a);
+bool upb_arena_addcleanup(upb_arena *a, upb_cleanup_func *func, void *ud);
+size_t upb_arena_bytesallocated(const upb_arena *a);
+
+UPB_INLINE upb_alloc *upb_arena_alloc(upb_arena *a) { return &a->alloc; }
+
+UPB_END_EXTERN_C
+
+#ifdef __cplusplus
+
+namespace upb {
+
+inline void* Allocator::Malloc(size_t size) { return upb_malloc(this, size); }
+inline void* Allocator::Realloc(void* ptr, size_t oldsize, size_t size) {
+  return upb_realloc(this, ptr, oldsize, size);
+}
+inline void Allocator::Free(void* ptr) { upb_free(this, ptr); }
+
+inline Arena::Arena() { upb_arena_init(this); }
+inline Arena::Arena(void* seed, size_t len, Allocator* block_alloc) {
+  upb_arena_init2(this, seed, len, block_alloc);
+}
+inline Arena::~Arena() { upb_arena_uninit(this); }
+inline Allocator* Arena::allocator() { return upb_arena_alloc(this); }
+inline bool Arena::AddCleanup(upb_cleanup_func* func, void* ud) {
+  return upb_arena_addcleanup(this, func, ud);
+}
+inline size_t Arena::BytesAllocated() const {
+  return upb_arena_bytesallocated(this);
+}
+
+}  // namespace upb
+
+#endif
+
 #endif  /* UPB_H_ */